@@ -26,6 +26,7 @@
 #include "windirstat.h"
 #include "dirstatdoc.h"
 #include "dirstatview.h"
+#include "ScanStatistics.h"
 #include "TreeListControl.h"
 
 #ifdef _DEBUG
@@ -53,8 +54,78 @@ namespace
     const UINT HOTNODE_CY = 9;
     const UINT HOTNODE_X = 0;
 
+    // Subitems beyond this are not cached (bit count of VISIBLEINFO::textValid).
+    const int MAXCACHEDTEXTS = 32;
+
+    // Below this count MultikeySort() falls back to insertion sort.
+    const int INSERTIONSORT_THRESHOLD = 16;
+
+    // A precomputed sort key of CTreeListItem::SortSiblings()
+    struct SORTKEY
+    {
+        LPCTSTR key;
+        CTreeListItem *item;
+    };
+
+    inline void Swap(SORTKEY& a, SORTKEY& b)
+    {
+        SORTKEY t = a;
+        a = b;
+        b = t;
+    }
+
+    // Multikey quicksort (Bentley/Sedgewick), a MSD radix sort of the keys,
+    // which ignores the first depth characters. Each step looks at one
+    // character only, so common prefixes are not compared again and again.
+    //
+    void MultikeySort(SORTKEY *a, int n, int depth)
+    {
+        while(n > INSERTIONSORT_THRESHOLD)
+        {
+            // Three way partition by the character at depth
+            _TUCHAR pivot = (_TUCHAR)a[n / 2].key[depth];
+            int lt = 0;
+            int gt = n;
+            int i = 0;
+            while(i < gt)
+            {
+                _TUCHAR c = (_TUCHAR)a[i].key[depth];
+                if(c < pivot)
+                {
+                    Swap(a[lt++], a[i++]);
+                }
+                else if(c > pivot)
+                {
+                    Swap(a[i], a[--gt]);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+
+            MultikeySort(a, lt, depth);
+            if(pivot != 0)
+            {
+                MultikeySort(a + lt, gt - lt, depth + 1);
+            }
+
+            a += gt;
+            n -= gt;
+        }
+
+        for(int i = 1; i < n; i++)
+        {
+            for(int j = i; j > 0 && _tcscmp(a[j - 1].key + depth, a[j].key + depth) > 0; j--)
+            {
+                Swap(a[j - 1], a[j]);
+            }
+        }
+    }
 }
 
+const SSorting *CTreeListItem::_sorting = NULL;
+
 CTreeListItem::CTreeListItem()
 {
     m_parent = NULL;
@@ -99,6 +170,43 @@ CString CTreeListItem::GetText(int /*subitem*/) const
     return _T("test");
 }
 
+// During a scan the list is repainted several times per second,
+// but the texts of most visible items don't change. So we format
+// them only once per GetTextVersion() of the item and its parent.
+//
+CString CTreeListItem::GetCachedText(int subitem) const
+{
+    if(!IsVisible() || subitem < 0 || subitem >= MAXCACHEDTEXTS)
+    {
+        return GetText(subitem);
+    }
+
+    UINT version = GetTextVersion();
+    UINT parentVersion = (GetParent() != NULL ? GetParent()->GetTextVersion() : 0);
+    UINT generation = GetFormatGeneration();
+
+    if(m_vi->textVersion != version || m_vi->parentTextVersion != parentVersion || m_vi->formatGeneration != generation)
+    {
+        m_vi->textValid = 0;
+        m_vi->textVersion = version;
+        m_vi->parentTextVersion = parentVersion;
+        m_vi->formatGeneration = generation;
+    }
+
+    DWORD bit = 1UL << subitem;
+    if((m_vi->textValid & bit) == 0)
+    {
+        if(subitem >= m_vi->text.GetSize())
+        {
+            m_vi->text.SetSize(subitem + 1);
+        }
+        m_vi->text[subitem] = GetText(subitem);
+        m_vi->textValid |= bit;
+    }
+
+    return m_vi->text[subitem];
+}
+
 int CTreeListItem::GetImage() const
 {
     ASSERT(IsVisible());
@@ -155,20 +263,83 @@ void CTreeListItem::UncacheImage()
 void CTreeListItem::SortChildren()
 {
     ASSERT(IsVisible());
+    CStatisticsTimer timer(SC_SORTING);
+
     m_vi->sortedChildren.SetSize(GetChildrenCount());
     for(int i = 0; i < GetChildrenCount(); i++)
     {
         m_vi->sortedChildren[i]= GetTreeListChild(i);
     }
 
-    qsort(m_vi->sortedChildren.GetData(), m_vi->sortedChildren.GetSize(), sizeof(CTreeListItem *), &_compareProc);
+    SortSiblings(m_vi->sortedChildren.GetData(), (int)m_vi->sortedChildren.GetSize(), GetTreeListControl()->GetSorting());
+}
+
+// Default: no sort keys, CompareSibling() does the job.
+//
+bool CTreeListItem::GetSortKey(int /*subitem*/, CString& /*key*/) const
+{
+    return false;
+}
+
+// Sorts siblings by CompareS(). If the items have sort keys for the
+// first column (GetSortKey()), the keys are computed once per item
+// and sorted with MultikeySort() instead of calling CompareSibling()
+// O(n log n) times. Only items with equal keys are compared by CompareS().
+//
+void CTreeListItem::SortSiblings(CTreeListItem **items, int count, const SSorting& sorting)
+{
+    _sorting = &sorting;
+
+    CString dummy;
+    if(count < 2 || !items[0]->GetSortKey(sorting.column1, dummy))
+    {
+        qsort(items, count, sizeof(CTreeListItem *), &_compareProc);
+        return;
+    }
+
+    CStringArray keys;
+    keys.SetSize(count);
+    CArray<SORTKEY, SORTKEY&> sortKeys;
+    sortKeys.SetSize(count);
+
+    int i = 0;
+    for(i = 0; i < count; i++)
+    {
+        VERIFY(items[i]->GetSortKey(sorting.column1, keys[i]));
+        sortKeys[i].key = keys[i];
+        sortKeys[i].item = items[i];
+    }
+
+    MultikeySort(sortKeys.GetData(), count, 0);
+
+    // Copy back runs of equal keys, in reverse run order if descending.
+    for(i = 0; i < count; )
+    {
+        int end = i + 1;
+        while(end < count && _tcscmp(sortKeys[i].key, sortKeys[end].key) == 0)
+        {
+            end++;
+        }
+
+        int dest = (sorting.ascending1 ? i : count - end);
+        for(int j = i; j < end; j++)
+        {
+            items[dest + j - i] = sortKeys[j].item;
+        }
+        if(end - i > 1)
+        {
+            qsort(items + dest, end - i, sizeof(CTreeListItem *), &_compareProc);
+        }
+
+        i = end;
+    }
 }
 
 int __cdecl CTreeListItem::_compareProc(const void *p1, const void *p2)
 {
     CTreeListItem *item1 = *(CTreeListItem **)p1;
     CTreeListItem *item2 = *(CTreeListItem **)p2;
-    return item1->CompareS(item2, GetTreeListControl()->GetSorting());
+    return item1->CompareS(item2, *_sorting);
 }
 
 CTreeListItem *CTreeListItem::GetSortedChild(int i)
@@ -277,6 +448,12 @@ void CTreeListItem::SetVisible(bool visible)
         }
         m_vi->image = -1;
         m_vi->isExpanded = false;
+        m_vi->textValid = 0;
+        m_vi->textVersion = 0;
+        m_vi->parentTextVersion = 0;
+        m_vi->formatGeneration = 0;
+        m_vi->shownVersion = GetTextVersion();
+        m_vi->shownParentVersion = (GetParent() != NULL ? GetParent()->GetTextVersion() : 0);
     }
     else
     {
@@ -285,6 +462,26 @@ void CTreeListItem::SetVisible(bool visible)
         m_vi = NULL;
     }
 }
+// Return: true, if the texts of the item may have changed since
+// the last call (or since the item has become visible).
+//
+bool CTreeListItem::PollTextChanged()
+{
+    ASSERT(IsVisible());
+
+    UINT version = GetTextVersion();
+    UINT parentVersion = (GetParent() != NULL ? GetParent()->GetTextVersion() : 0);
+
+    if(m_vi->shownVersion == version && m_vi->shownParentVersion == parentVersion)
+    {
+        return false;
+    }
+
+    m_vi->shownVersion = version;
+    m_vi->shownParentVersion = parentVersion;
+    return true;
+}
+
 int CTreeListItem::GetIndent() const
 {
     ASSERT(IsVisible());
@@ -336,6 +533,10 @@ IMPLEMENT_DYNAMIC(CTreeListControl, COwnerDrawnListControl)
 CTreeListControl::CTreeListControl(CDirstatView *dirstatView, int rowHeight)
     : COwnerDrawnListControl(_T("treelist"), rowHeight)
     , m_dirstatView(dirstatView)
+    , m_lastFrame(0)
+    , m_updateDepth(0)
+    , m_sortPending(false)
+    , m_redrawLocked(false)
 {
     ASSERT(_theTreeListControl == NULL);
     _theTreeListControl = this;
@@ -461,6 +662,22 @@ void CTreeListControl::SetRootItem(CTreeListItem *root)
     }
 }
 
+// Other than SetRootItem(), which may find the items deleted already,
+// this collapses and hides the items, so that they can be inserted again
+// (e.g. when the root becomes a child of a new root).
+//
+void CTreeListControl::RemoveAllRows()
+{
+    SetRedraw(false);
+    for(int i = GetItemCount() - 1; i >= 0; i--)
+    {
+        DeleteItem(i);
+    }
+    SetRedraw(true);
+
+    m_selectionAnchor = NULL;
+}
+
 void CTreeListControl::DeselectAll()
 {
     for(int i = 0; i < GetItemCount(); i++)
@@ -1098,9 +1315,50 @@ void CTreeListControl::OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags)
     }
 }
 
+// Brackets around adding many children (e.g. the results of a read job).
+// In between, OnChildrenAdded() only inserts the rows. EndUpdate()
+// sorts the list and repaints it once. The brackets may be nested.
+//
+void CTreeListControl::BeginUpdate()
+{
+    m_updateDepth++;
+}
+
+void CTreeListControl::EndUpdate()
+{
+    ASSERT(m_updateDepth > 0);
+    if(--m_updateDepth > 0)
+    {
+        return;
+    }
+
+    if(m_redrawLocked)
+    {
+        m_redrawLocked = false;
+        SetRedraw(true);
+        Invalidate(false);
+    }
+
+    if(m_sortPending)
+    {
+        m_sortPending = false;
+        Sort();
+    }
+}
+
 void CTreeListControl::OnChildAdded(CTreeListItem *parent, CTreeListItem *child)
 {
-    if(!parent->IsVisible())
+    ASSERT(parent->GetTreeListChild(parent->GetChildrenCount() - 1) == child);
+    OnChildrenAdded(parent, parent->GetChildrenCount() - 1);
+}
+
+// The children first...GetChildrenCount()-1 of parent have been added.
+// If the parent is expanded, they are inserted all at once
+// and the list is sorted only once.
+//
+void CTreeListControl::OnChildrenAdded(CTreeListItem *parent, int first)
+{
+    if(!parent->IsVisible() || first >= parent->GetChildrenCount())
     {
         return;
     }
@@ -1108,16 +1366,25 @@ void CTreeListControl::OnChildAdded(CTreeListItem *parent, CTreeListItem *child)
     int p = FindTreeItem(parent);
     ASSERT(p != -1);
 
+    BeginUpdate();
+
     if(parent->IsExpanded())
     {
-        InsertItem(p + 1, child);
-        RedrawItems(p, p);
-        Sort();
-    }
-    else
-    {
-        RedrawItems(p, p);
+        if(!m_redrawLocked)
+        {
+            m_redrawLocked = true;
+            SetRedraw(false);
+        }
+
+        for(int i = first; i < parent->GetChildrenCount(); i++)
+        {
+            InsertItem(p + 1 + i - first, parent->GetTreeListChild(i));
+        }
+        m_sortPending = true;
     }
+    RedrawItems(p, p);
+
+    EndUpdate();
 }
 
 void CTreeListControl::OnChildRemoved(CTreeListItem *parent, CTreeListItem *child)
@@ -1171,6 +1438,94 @@ void CTreeListControl::Sort()
     COwnerDrawnListControl::SortItems();
 }
 
+// Called by the directory list during a scan (HINT_SOMEWORKDONE), which
+// may be many times per frame. Sort() would repaint the whole list each
+// time. So we do the work only once per FRAME_INTERVAL, and only if the
+// order of the items has actually changed, we sort the list control.
+// Otherwise we only invalidate the cells, whose data has changed.
+//
+void CTreeListControl::UpdateDuringWork()
+{
+    DWORD now = ::GetTickCount();
+    if(now - m_lastFrame < FRAME_INTERVAL)
+    {
+        return;
+    }
+    m_lastFrame = now;
+
+    for(int i = 0; i < GetItemCount(); i++)
+    {
+        if(GetItem(i)->IsExpanded())
+        {
+            GetItem(i)->SortChildren();
+        }
+    }
+
+    // The top level items (the root) are followed by their descendants.
+    int i = 0;
+    while(i < GetItemCount())
+    {
+        if(GetItem(i)->GetParent() != NULL || !IsInSortedOrder(GetItem(i), i))
+        {
+            COwnerDrawnListControl::SortItems();
+            break;
+        }
+    }
+
+    // After SortItems() this only updates the versions.
+    InvalidateChangedItems();
+}
+
+// Checks, whether the list items from index i on are item and its
+// visible descendants in the order of the sorted children.
+// Advances i behind them.
+//
+bool CTreeListControl::IsInSortedOrder(CTreeListItem *item, int& i)
+{
+    if(i >= GetItemCount() || GetItem(i) != item)
+    {
+        return false;
+    }
+    i++;
+
+    if(item->IsExpanded())
+    {
+        for(int c = 0; c < item->GetChildrenCount(); c++)
+        {
+            if(!IsInSortedOrder(item->GetSortedChild(c), i))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Invalidates the cells of the rows on screen, whose data has changed since
+// the last call. Column 0 (the tree) doesn't depend on the data.
+// DrawItem() draws only the cells within the update region, and
+// everything invalidated within one frame is painted by one WM_PAINT.
+//
+void CTreeListControl::InvalidateChangedItems()
+{
+    int columns = GetHeaderCtrl()->GetItemCount();
+    int first = GetTopIndex();
+    int last = min(first + GetCountPerPage() + 1, GetItemCount());
+
+    for(int i = first; i < last; i++)
+    {
+        if(!GetItem(i)->PollTextChanged())
+        {
+            continue;
+        }
+
+        for(int col = 1; col < columns; col++)
+        {
+            InvalidateRect(GetWholeSubitemRect(i, col), false);
+        }
+    }
+}
+
 void CTreeListControl::EnsureItemVisible(const CTreeListItem *item)
 {
     if(item == NULL)
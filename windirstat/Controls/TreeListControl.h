@@ -58,6 +58,19 @@ class CTreeListItem: public COwnerDrawnListItem
         CArray<CTreeListItem *, CTreeListItem *> sortedChildren;
 
         CPacman pacman;
+
+        // Cache of the texts of the subitems (see GetCachedText()).
+        // Bit i of textValid is set, if text[i] is valid. The whole cache
+        // is invalid, as soon as one of the versions differs.
+        CStringArray text;
+        DWORD textValid;
+        UINT textVersion;       // GetTextVersion()
+        UINT parentTextVersion; // GetParent()->GetTextVersion()
+        UINT formatGeneration;  // GetFormatGeneration()
+
+        // Versions at the last PollTextChanged() (see CTreeListControl::InvalidateChangedItems()).
+        UINT shownVersion;
+        UINT shownParentVersion;
     };
 
 public:
@@ -65,14 +78,21 @@ public:
     virtual ~CTreeListItem();
 
     virtual int CompareSibling(const CTreeListItem *tlib, int subitem) const =0;
+    virtual bool GetSortKey(int subitem, CString& key) const;
 
     virtual bool DrawSubitem(int subitem, CDC *pdc, CRect rc, UINT state, int *width, int *focusLeft) const;
     virtual CString GetText(int subitem) const;
+    virtual CString GetCachedText(int subitem) const;
     virtual int GetImage() const;
     virtual int Compare(const CSortingListItem *other, int subitem) const;
     virtual CTreeListItem *GetTreeListChild(int i) const =0;
     virtual int GetChildrenCount() const =0;
     virtual int GetImageToCache() const =0;
+    // Must change, whenever the result of GetText() changes.
+    // Texts may depend on the parent as well (e.g. percentages).
+    virtual UINT GetTextVersion() const =0;
+
+    static void SortSiblings(CTreeListItem **items, int count, const SSorting& sorting);
 
     void DrawPacman(CDC *pdc, const CRect& rc, COLORREF bgColor) const;
     void UncacheImage();
@@ -82,7 +102,7 @@ public:
     CTreeListItem *GetParent() const;
     void SetParent(CTreeListItem *parent);
     bool HasSiblings() const;
-    bool HasChildren() const;
+    virtual bool HasChildren() const;
     bool IsExpanded() const;
     void SetExpanded(bool expanded =true);
     bool IsVisible() const;
@@ -92,10 +112,12 @@ public:
     void SetPlusMinusRect(const CRect& rc) const;
     CRect GetTitleRect() const;
     void SetTitleRect(const CRect& rc) const;
+    bool PollTextChanged();
 
 protected:
     static int __cdecl _compareProc(const void *p1, const void *p2);
     static CTreeListControl *GetTreeListControl();
+    static const SSorting *_sorting;    // Used by _compareProc()
     void StartPacman(bool start);
     bool DrivePacman(ULONGLONG readJobs);
     int GetScrollPosition();
@@ -119,6 +141,9 @@ class CTreeListControl: public COwnerDrawnListControl
     static CTreeListControl *_theTreeListControl;
 
 public:
+    // Minimum time between two updates of the list during a scan (60 frames per second)
+    static const DWORD FRAME_INTERVAL = 16;
+
     static CTreeListControl *GetTheTreeListControl();
 
     CTreeListControl(CDirstatView *dirstatView, int rowHeight = -1);
@@ -127,7 +152,11 @@ public:
     virtual BOOL CreateEx(DWORD dwExStyle, DWORD dwStyle, const RECT& rect, CWnd* pParentWnd, UINT nID);
     virtual void SysColorChanged();
     void SetRootItem(CTreeListItem *root);
+    void RemoveAllRows();
+    void BeginUpdate();
+    void EndUpdate();
     void OnChildAdded(CTreeListItem *parent, CTreeListItem *child);
+    void OnChildrenAdded(CTreeListItem *parent, int first);
     void OnChildRemoved(CTreeListItem *parent, CTreeListItem *childdata);
     void OnRemovingAllChildren(CTreeListItem *parent);
     CTreeListItem *GetItem(int i);
@@ -137,6 +166,7 @@ public:
     void SelectItem(const CTreeListItem *item);
     void SelectSingleItem(const CTreeListItem *item);
     void Sort();
+    void UpdateDuringWork();
     void EnsureItemVisible(const CTreeListItem *item);
     void ExpandItem(CTreeListItem *item);
     int FindTreeItem(const CTreeListItem *item);
@@ -170,6 +200,9 @@ protected:
     void ExtendSelection(int i);
     void UpdateDocumentSelection();
 
+    bool IsInSortedOrder(CTreeListItem *item, int& i);
+    void InvalidateChangedItems();
+
     CTreeListItem *m_selectionAnchor;
     //
     /////////////////////////////////////////////////////
@@ -181,6 +214,10 @@ protected:
     CImageList *m_imageList;    // We don't use the system-supplied SetImageList(), but MySetImageList().
     int m_lButtonDownItem;      // Set in OnLButtonDown(). -1 if not item hit.
     bool m_lButtonDownOnPlusMinusRect;  // Set in OnLButtonDown(). True, if plus-minus-rect hit.
+    DWORD m_lastFrame;          // TickCount of the last UpdateDuringWork() which did something
+    int m_updateDepth;          // Nesting depth of BeginUpdate()/EndUpdate()
+    bool m_sortPending;         // Rows have been inserted since BeginUpdate(), so EndUpdate() sorts.
+    bool m_redrawLocked;        // SetRedraw(false) since BeginUpdate()
 
     DECLARE_MESSAGE_MAP()
 
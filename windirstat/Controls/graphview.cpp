@@ -28,6 +28,8 @@
 #include "dirstatdoc.h"
 #include "dirstatview.h"
 #include "item.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
 
 #include "graphview.h"
 
@@ -150,8 +152,10 @@ void CGraphView::DrawEmptyView(CDC *pDC)
 
 void CGraphView::OnDraw(CDC* pDC)
 {
-    CItem *root = GetDocument()->GetRootItem();
-    if(root != NULL && root->IsDone())
+    CStatisticsTimer timer(SC_PAINTING); // The layout is measured separately (SC_TREEMAP).
+    CTraceScope scope(TE_GRAPHVIEW);
+
+    if(GetDocument()->IsTreemapAvailable())
     {
         if(m_recalculationSuspended || !m_showTreemap)
         {
@@ -171,6 +175,7 @@ void CGraphView::OnDraw(CDC* pDC)
             if(!IsDrawn())
             {
                 CWaitCursor wc;
+                scope.SetArgs(1, 0);
 
                 m_bitmap.CreateCompatibleBitmap(pDC, m_size.cx, m_size.cy);
 
@@ -181,7 +186,18 @@ void CGraphView::OnDraw(CDC* pDC)
                     DrawZoomFrame(&dcmem, rc);
                 }
 
-                m_treemap.DrawTreemap(&dcmem, rc, GetDocument()->GetZoomItem(), GetOptions()->GetTreemapOptions());
+                CItem *zoom = GetDocument()->GetZoomItem();
+                if(!zoom->IsDone())
+                {
+                    // Scan preview. Subtrees smaller than a pixel (and empty ones) need not be sorted.
+                    zoom->SortChildrenForPreview(zoom->TmiGetSize() / max(1, rc.Width() * rc.Height()) + 1);
+                }
+
+                {
+                    CStatisticsTimer timer(SC_TREEMAP);
+                    CTraceScope scope(TE_TREEMAP, rc.Width(), rc.Height());
+                    m_treemap.DrawTreemap(&dcmem, rc, zoom, GetOptions()->GetTreemapOptions());
+                }
 
                 // Cause OnIdle() to be called once.
                 ::PostThreadMessage(::GetCurrentThreadId(), WM_NULL, 0, 0);
@@ -392,8 +408,7 @@ void CGraphView::OnSize(UINT nType, int cx, int cy)
 
 void CGraphView::OnLButtonDown(UINT nFlags, CPoint point)
 {
-    CItem *root = GetDocument()->GetRootItem();
-    if(root != NULL && root->IsDone() && IsDrawn())
+    if(GetDocument()->IsTreemapAvailable() && IsDrawn())
     {
         const CItem *item = (const CItem *)m_treemap.FindItemByPoint(GetDocument()->GetZoomItem(), point);
         if(item == NULL)
@@ -490,7 +505,9 @@ void CGraphView::OnSetFocus(CWnd* /*pOldWnd*/)
 
 void CGraphView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
 {
-    if(!GetDocument()->IsRootDone())
+    // While a session is scanning, the roots which are done can be shown,
+    // and with the scan preview, the undone ones, too.
+    if(!GetDocument()->IsTreemapAvailable())
     {
         Inactivate();
     }
@@ -526,6 +543,19 @@ void CGraphView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
         }
         break;
 
+    case HINT_SCANPREVIEW:
+        {
+            // Other than Inactivate(), this keeps the old preview
+            // on the screen, until the new one is drawn.
+            if(m_bitmap.m_hObject != NULL)
+            {
+                m_bitmap.DeleteObject();
+            }
+            RedrawWindow();
+        }
+        break;
+
+    case HINT_ZOOMEDSPACECHANGED:
     case HINT_TREEMAPSTYLECHANGED:
         {
             Inactivate();
@@ -546,8 +576,7 @@ void CGraphView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
 
 void CGraphView::OnContextMenu(CWnd* /*pWnd*/, CPoint ptscreen)
 {
-    CItem *root = GetDocument()->GetRootItem();
-    if(root != NULL && root->IsDone())
+    if(GetDocument()->IsTreemapAvailable())
     {
         CMenu menu;
         menu.LoadMenu(IDR_POPUPGRAPH);
@@ -558,8 +587,7 @@ void CGraphView::OnContextMenu(CWnd* /*pWnd*/, CPoint ptscreen)
 
 void CGraphView::OnMouseMove(UINT /*nFlags*/, CPoint point)
 {
-    CItem *root = GetDocument()->GetRootItem();
-    if(root != NULL && root->IsDone() && IsDrawn())
+    if(GetDocument()->IsTreemapAvailable() && IsDrawn())
     {
         const CItem *item = (const CItem *)m_treemap.FindItemByPoint(GetDocument()->GetZoomItem(), point);
         if(item != NULL)
@@ -0,0 +1,245 @@
+// histogramview.cpp - Implementation of CHistogramView
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "dirstatdoc.h"
+#include "item.h"
+#include "FileHistogram.h"
+#include "selectobject.h"
+#include "histogramview.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const int MARGIN = 4;           // Pixels around and between the charts
+    const int LABELWIDTH = 56;      // Width of the bucket labels
+    const int VALUEWIDTH = 72;      // Width of the values right of the bars
+}
+
+IMPLEMENT_DYNCREATE(CHistogramView, CView)
+
+BEGIN_MESSAGE_MAP(CHistogramView, CView)
+    ON_WM_ERASEBKGND()
+END_MESSAGE_MAP()
+
+CHistogramView::CHistogramView()
+{
+}
+
+CHistogramView::~CHistogramView()
+{
+}
+
+void CHistogramView::OnUpdate(CView * /*pSender*/, LPARAM lHint, CObject *)
+{
+    switch (lHint)
+    {
+    case HINT_NULL:
+    case HINT_NEWROOT:
+    case HINT_SELECTIONCHANGED:
+    case HINT_SHOWNEWSELECTION:
+    case HINT_SOMEWORKDONE:
+    case HINT_REDRAWWINDOW:
+    case HINT_LISTSTYLECHANGED:
+        InvalidateRect(NULL);
+        break;
+
+    default:
+        break;
+    }
+}
+
+BOOL CHistogramView::OnEraseBkgnd(CDC* /*pDC*/)
+{
+    return true;
+}
+
+void CHistogramView::OnDraw(CDC* pDC)
+{
+    CRect rc;
+    GetClientRect(rc);
+
+    // Paint into a bitmap to avoid flickering during the scan.
+    CDC dcmem;
+    dcmem.CreateCompatibleDC(pDC);
+    CBitmap bm;
+    bm.CreateCompatibleBitmap(pDC, rc.Width(), rc.Height());
+    CSelectObject sobm(&dcmem, &bm);
+    CSelectStockObject sofont(&dcmem, DEFAULT_GUI_FONT);
+    CSetBkMode bk(&dcmem, TRANSPARENT);
+    CSetTextColor tc(&dcmem, ::GetSysColor(COLOR_WINDOWTEXT));
+
+    dcmem.FillSolidRect(rc, ::GetSysColor(COLOR_WINDOW));
+
+    CFileHistogram histogram;
+    if(!CollectHistogram(histogram))
+    {
+        CRect rcText = rc;
+        rcText.DeflateRect(MARGIN, MARGIN);
+        dcmem.DrawText(LoadString(IDS_HISTOGRAMNOFILES), rcText, DT_SINGLELINE | DT_LEFT | DT_TOP | DT_NOPREFIX);
+    }
+    else
+    {
+        CStringArray labels;
+        CArray<ULONGLONG, ULONGLONG> values;
+
+        CRect rcAge = rc;
+        rcAge.bottom = rc.top + rc.Height() * CFileHistogram::AGEBUCKETS / (CFileHistogram::AGEBUCKETS + CFileHistogram::SIZEBUCKETS);
+
+        int i = 0;
+        for(i = 0; i < CFileHistogram::AGEBUCKETS; i++)
+        {
+            labels.Add(CFileHistogram::GetAgeBucketLabel(i));
+            values.Add(histogram.GetAgeBytes(i));
+        }
+        DrawChart(&dcmem, rcAge, LoadString(IDS_HISTOGRAMAGE), labels, values, true, GetOptions()->GetTreelistColor(0));
+
+        labels.RemoveAll();
+        values.RemoveAll();
+
+        CRect rcSize = rc;
+        rcSize.top = rcAge.bottom;
+
+        for(i = 0; i < CFileHistogram::SIZEBUCKETS; i++)
+        {
+            labels.Add(CFileHistogram::GetSizeBucketLabel(i));
+            values.Add(histogram.GetSizeCount(i));
+        }
+        DrawChart(&dcmem, rcSize, LoadString(IDS_HISTOGRAMSIZE), labels, values, false, GetOptions()->GetTreelistColor(1));
+    }
+
+    pDC->BitBlt(rc.left, rc.top, rc.Width(), rc.Height(), &dcmem, rc.left, rc.top, SRCCOPY);
+}
+
+// Sums up the histograms of the selected items, or of the root item,
+// if nothing is selected.
+// Return: false, if there is nothing to show.
+//
+bool CHistogramView::CollectHistogram(CFileHistogram& histogram)
+{
+    CArray<const CItem *, const CItem *> items;
+    for(size_t i = 0; i < GetDocument()->GetSelectionCount(); i++)
+    {
+        items.Add(GetDocument()->GetSelection(i));
+    }
+    if(items.GetSize() == 0 && GetDocument()->GetRootItem() != NULL)
+    {
+        items.Add(GetDocument()->GetRootItem());
+    }
+
+    bool files = false;
+    for(int j = 0; j < items.GetSize(); j++)
+    {
+        const CItem *item = items[j];
+        if(item->GetHistogram() != NULL)
+        {
+            histogram.Add(*item->GetHistogram());
+            files = files || item->GetFilesCount() > 0;
+        }
+        else if(item->GetType() == IT_FILE)
+        {
+            histogram.AddFile(item->GetSize(), item->GetLastChange());
+            files = true;
+        }
+    }
+    return files;
+}
+
+// Draws a title and one horizontal bar per bucket. The longest bar
+// fills the available width.
+//
+void CHistogramView::DrawChart(CDC *pdc, CRect rc, LPCTSTR title, const CStringArray& labels, const CArray<ULONGLONG, ULONGLONG>& values, bool bytes, COLORREF color)
+{
+    rc.DeflateRect(MARGIN, MARGIN);
+
+    CSize sz = pdc->GetTextExtent(title);
+    CRect rcTitle = rc;
+    rcTitle.bottom = rcTitle.top + sz.cy;
+    pdc->DrawText(title, rcTitle, DT_SINGLELINE | DT_LEFT | DT_VCENTER | DT_NOPREFIX | DT_END_ELLIPSIS);
+    rc.top = rcTitle.bottom + MARGIN;
+
+    int count = (int)values.GetSize();
+    if(count == 0 || rc.Height() <= 0)
+    {
+        return;
+    }
+
+    ULONGLONG maximum = 0;
+    int i = 0;
+    for(i = 0; i < count; i++)
+    {
+        maximum = max(maximum, values[i]);
+    }
+
+    int barsWidth = rc.Width() - LABELWIDTH - VALUEWIDTH;
+    for(i = 0; i < count; i++)
+    {
+        CRect rcRow = rc;
+        rcRow.top = rc.top + rc.Height() * i / count;
+        rcRow.bottom = rc.top + rc.Height() * (i + 1) / count;
+
+        CRect rcLabel = rcRow;
+        rcLabel.right = rcLabel.left + LABELWIDTH;
+        pdc->DrawText(labels[i], rcLabel, DT_SINGLELINE | DT_LEFT | DT_VCENTER | DT_NOPREFIX);
+
+        int width = 0;
+        if(maximum > 0 && barsWidth > 0)
+        {
+            width = (int)((double)values[i] * barsWidth / maximum);
+        }
+
+        CRect rcBar = rcRow;
+        rcBar.left = rcLabel.right;
+        rcBar.right = rcBar.left + width;
+        rcBar.DeflateRect(0, 1);
+        pdc->FillSolidRect(rcBar, color);
+
+        CRect rcValue = rcRow;
+        rcValue.left = rcBar.right + MARGIN;
+        pdc->DrawText(bytes ? FormatBytes(values[i]) : FormatCount(values[i]), rcValue, DT_SINGLELINE | DT_LEFT | DT_VCENTER | DT_NOPREFIX);
+    }
+}
+
+#ifdef _DEBUG
+void CHistogramView::AssertValid() const
+{
+    CView::AssertValid();
+}
+
+void CHistogramView::Dump(CDumpContext& dc) const
+{
+    CView::Dump(dc);
+}
+
+CDirstatDoc* CHistogramView::GetDocument() const // Nicht-Debugversion ist inline
+{
+    ASSERT(m_pDocument->IsKindOf(RUNTIME_CLASS(CDirstatDoc)));
+    return (CDirstatDoc*)m_pDocument;
+}
+#endif //_DEBUG
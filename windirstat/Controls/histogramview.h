@@ -0,0 +1,69 @@
+// histogramview.h - Declaration of CHistogramView
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_HISTOGRAMVIEW_H__
+#define __WDS_HISTOGRAMVIEW_H__
+#pragma once
+
+class CDirstatDoc;
+class CFileHistogram;
+
+//
+// CHistogramView. The view below the type view, which shows the
+// file age and size histograms (CFileHistogram) of the selection.
+//
+class CHistogramView: public CView
+{
+protected:
+    CHistogramView();
+    DECLARE_DYNCREATE(CHistogramView)
+
+public:
+    virtual ~CHistogramView();
+    CDirstatDoc* GetDocument() const;
+
+protected:
+    virtual void OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint);
+    virtual void OnDraw(CDC* pDC);
+
+    bool CollectHistogram(CFileHistogram& histogram);
+    void DrawChart(CDC *pdc, CRect rc, LPCTSTR title, const CStringArray& labels, const CArray<ULONGLONG, ULONGLONG>& values, bool bytes, COLORREF color);
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg BOOL OnEraseBkgnd(CDC* pDC);
+
+public:
+    #ifdef _DEBUG
+        virtual void AssertValid() const;
+        virtual void Dump(CDumpContext& dc) const;
+    #endif
+};
+
+#ifndef _DEBUG  // Debugversion in histogramview.cpp
+inline CDirstatDoc* CHistogramView::GetDocument() const
+   { return reinterpret_cast<CDirstatDoc*>(m_pDocument); }
+#endif
+
+#endif // __WDS_HISTOGRAMVIEW_H__
@@ -25,6 +25,8 @@
 #include "stdafx.h"
 #include "windirstat.h"
 #include "treemap.h"    // CColorSpace
+#include "ScanStatistics.h"
+#include "EventTrace.h"
 #include "ownerdrawnlistcontrol.h"
 
 #ifdef _DEBUG
@@ -85,7 +87,7 @@ void COwnerDrawnListItem::DrawLabel(COwnerDrawnListControl *list, CImageList *il
     rcRest.DeflateRect(list->GetTextXMargin(), 0);
 
     CRect rcLabel = rcRest;
-    pdc->DrawText(GetText(0), rcLabel, DT_SINGLELINE | DT_VCENTER | DT_WORD_ELLIPSIS | DT_CALCRECT | DT_NOPREFIX);
+    pdc->DrawText(GetCachedText(0), rcLabel, DT_SINGLELINE | DT_VCENTER | DT_WORD_ELLIPSIS | DT_CALCRECT | DT_NOPREFIX);
 
     rcLabel.InflateRect(LABEL_INFLATE_CX, 0);
     rcLabel.top = rcRest.top + LABEL_Y_MARGIN;
@@ -120,7 +122,7 @@ void COwnerDrawnListItem::DrawLabel(COwnerDrawnListControl *list, CImageList *il
     if(width == NULL)
     {
         // Draw the actual text
-        pdc->DrawText(GetText(0), rcRest, DT_SINGLELINE | DT_VCENTER | DT_WORD_ELLIPSIS | DT_NOPREFIX);
+        pdc->DrawText(GetCachedText(0), rcRest, DT_SINGLELINE | DT_VCENTER | DT_WORD_ELLIPSIS | DT_NOPREFIX);
     }
 
     rcLabel.InflateRect(1, 1);
@@ -212,6 +214,7 @@ COwnerDrawnListControl::COwnerDrawnListControl(LPCTSTR name, int rowHeight)
     , m_showGrid(false)
     , m_showStripes(false)
     , m_showFullRowSelection(false)
+    , m_offscreenSize(0, 0)
 {
     ASSERT(rowHeight > 0);
     InitializeColors();
@@ -454,12 +457,12 @@ void COwnerDrawnListControl::DrawItem(LPDRAWITEMSTRUCT pdis)
         rcItem.right--;
     }
 
-    CDC dcmem;
-
-    dcmem.CreateCompatibleDC(pdc);
-    CBitmap bm;
-    bm.CreateCompatibleBitmap(pdc, rcItem.Width(), rcItem.Height());
-    CSelectObject sobm(&dcmem, &bm);
+    CDC *pdcmem = GetOffscreenDC(pdc, rcItem.Size());
+    if(pdcmem == NULL)
+    {
+        return;
+    }
+    CDC& dcmem = *pdcmem;
 
     dcmem.FillSolidRect(rcItem - rcItem.TopLeft(), GetItemBackgroundColor(pdis->itemID));
 
@@ -480,6 +483,14 @@ void COwnerDrawnListControl::DrawItem(LPDRAWITEMSTRUCT pdis)
 
         CRect rcDraw = rc - rcItem.TopLeft();
 
+        // During a scan only the changed cells are invalidated
+        // (see CTreeListControl::InvalidateChangedItems()).
+        if(!pdc->RectVisible(rc))
+        {
+            rcFocus.right = rcDraw.right;
+            continue;
+        }
+
         int focusLeft = rcDraw.left;
         if(!item->DrawSubitem(subitem, &dcmem, rcDraw, pdis->itemState, NULL, &focusLeft))
         {
@@ -489,7 +500,8 @@ void COwnerDrawnListControl::DrawItem(LPDRAWITEMSTRUCT pdis)
             rcText.DeflateRect(TEXT_X_MARGIN, 0);
             CSetBkMode bk(&dcmem, TRANSPARENT);
             CSelectObject sofont(&dcmem, GetFont());
-            CString s = item->GetText(subitem);
+            // Copying the cached CString only increments its reference count.
+            CString s = item->GetCachedText(subitem);
             UINT align = IsColumnRightAligned(subitem) ? DT_RIGHT : DT_LEFT;
 
             // Get the correct color in case of compressed or encrypted items
@@ -527,6 +539,50 @@ void COwnerDrawnListControl::DrawItem(LPDRAWITEMSTRUCT pdis)
     }
 }
 
+// Returns a memory DC with a DIB section of at least the given size selected.
+// The DIB section is kept, so that DrawItem() doesn't create a bitmap per row.
+// Return: NULL, if the DIB section could not be created.
+//
+CDC *COwnerDrawnListControl::GetOffscreenDC(CDC *pdc, CSize size)
+{
+    if(m_offscreenDC.m_hDC == NULL)
+    {
+        if(!m_offscreenDC.CreateCompatibleDC(pdc))
+        {
+            return NULL;
+        }
+    }
+
+    if(m_offscreenSize.cx < size.cx || m_offscreenSize.cy < size.cy)
+    {
+        CSize newSize(max(size.cx, m_offscreenSize.cx), max(size.cy, m_offscreenSize.cy));
+
+        BITMAPINFO bmi;
+        ZeroMemory(&bmi, sizeof(bmi));
+        bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+        bmi.bmiHeader.biWidth = newSize.cx;
+        bmi.bmiHeader.biHeight = -newSize.cy;   // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        void *bits = NULL;
+        HBITMAP hbm = ::CreateDIBSection(pdc->m_hDC, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+        if(hbm == NULL)
+        {
+            VTRACE(_T("CreateDIBSection(%d, %d) failed: %u"), newSize.cx, newSize.cy, ::GetLastError());
+            return NULL;
+        }
+
+        m_offscreenDC.SelectObject(CBitmap::FromHandle(hbm));
+        m_offscreenBitmap.DeleteObject();
+        m_offscreenBitmap.Attach(hbm);
+        m_offscreenSize = newSize;
+    }
+
+    return &m_offscreenDC;
+}
+
 bool COwnerDrawnListControl::IsColumnRightAligned(int col)
 {
     HDITEM hditem;
@@ -608,6 +664,7 @@ int COwnerDrawnListControl::GetSubItemWidth(COwnerDrawnListItem *item, int subit
 
 BEGIN_MESSAGE_MAP(COwnerDrawnListControl, CSortingListControl)
     ON_WM_ERASEBKGND()
+    ON_WM_PAINT()
     ON_NOTIFY(HDN_DIVIDERDBLCLICKA, 0, OnHdnDividerdblclick)
     ON_NOTIFY(HDN_DIVIDERDBLCLICKW, 0, OnHdnDividerdblclick)
     ON_WM_VSCROLL()
@@ -616,6 +673,15 @@ BEGIN_MESSAGE_MAP(COwnerDrawnListControl, CSortingListControl)
     ON_WM_SHOWWINDOW()
 END_MESSAGE_MAP()
 
+// Only measured. The list control calls DrawItem() for the rows.
+//
+void COwnerDrawnListControl::OnPaint()
+{
+    CStatisticsTimer timer(SC_PAINTING);
+    CTraceScope scope(TE_PAINT);
+    CSortingListControl::OnPaint();
+}
+
 BOOL COwnerDrawnListControl::OnEraseBkgnd(CDC* pDC)
 {
     int i = 0;
@@ -46,6 +46,8 @@ public:
 
     // This text is drawn, if DrawSubitem returns false
     virtual CString GetText(int subitem) const = 0;
+    // GetText(), possibly from a cache. Used for drawing.
+    virtual CString GetCachedText(int subitem) const { return GetText(subitem); }
     // This color is used for the  current item
     virtual COLORREF GetItemTextColor() const { return ::GetSysColor(COLOR_WINDOWTEXT); }
 
@@ -111,6 +113,7 @@ public:
 protected:
     void InitializeColors();
     virtual void DrawItem(LPDRAWITEMSTRUCT pdis);
+    CDC *GetOffscreenDC(CDC *pdc, CSize size);
     int GetSubItemWidth(COwnerDrawnListItem *item, int subitem);
     bool IsColumnRightAligned(int col);
 
@@ -121,9 +124,13 @@ protected:
     int m_yFirstItem;               // Top of a first list item
     COLORREF m_windowColor;         // The default background color if !m_showStripes
     COLORREF m_stripeColor;         // The stripe color, used for every other item if m_showStripes
+    CBitmap m_offscreenBitmap;      // DIB section, in which DrawItem() draws a row
+    CSize m_offscreenSize;          // Size of m_offscreenBitmap
+    CDC m_offscreenDC;              // Memory DC with m_offscreenBitmap selected. Destroyed before the bitmap.
 
     DECLARE_MESSAGE_MAP()
     afx_msg BOOL OnEraseBkgnd(CDC* pDC);
+    afx_msg void OnPaint();
     afx_msg void OnHdnDividerdblclick(NMHDR *pNMHDR, LRESULT *pResult);
     afx_msg void OnVScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar);
     afx_msg void OnHdnItemchanging(NMHDR *pNMHDR, LRESULT *pResult);
@@ -51,6 +51,7 @@ void CPacman::Reset()
     m_position = 0;
     m_mouthOpening = true;
     m_aperture = 0;
+    m_lastUpdate = ::GetTickCount();
 }
 
 void CPacman::SetBackgroundColor(COLORREF color)
@@ -65,6 +66,11 @@ void CPacman::SetSpeed(double speed)
 
 void CPacman::Start(bool start)
 {
+    // Called with each frame, so don't disturb a running animation.
+    if(m_moving == start)
+    {
+        return;
+    }
     m_moving = start;
     m_lastUpdate = ::GetTickCount();
 }
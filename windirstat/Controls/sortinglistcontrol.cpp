@@ -24,6 +24,8 @@
 
 #include "stdafx.h"
 #include "windirstat.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
 #include "sortinglistcontrol.h"
 
 #ifdef _DEBUG
@@ -204,6 +206,9 @@ CSortingListItem *CSortingListControl::GetSortingListItem(int i)
 
 void CSortingListControl::SortItems()
 {
+    CStatisticsTimer timer(SC_SORTING);
+    CTraceScope scope(TE_SORT, GetItemCount());
+
     VERIFY(CListCtrl::SortItems(&_CompareFunc, (DWORD_PTR)&m_sorting));
 
     HDITEM hditem;
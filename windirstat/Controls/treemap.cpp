@@ -37,6 +37,9 @@
 
 static const double PALETTE_BRIGHTNESS = 0.6;
 
+// Color of the lines of COLORFLAG_PENDING
+static const COLORREF PENDING_HATCHCOLOR = RGB(64, 64, 64);
+
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -1124,6 +1127,9 @@ void CTreemap::RenderRectangle(CDC *pdc, const CRect& rc, const double *surface,
 {
     double brightness = m_options.brightness;
 
+    bool pending = ((color & COLORFLAG_PENDING) != 0);
+    color &= ~COLORFLAG_PENDING;
+
     if((color & COLORFLAG_MASK) != 0)
     {
         DWORD flags = (color & COLORFLAG_MASK);
@@ -1151,6 +1157,11 @@ void CTreemap::RenderRectangle(CDC *pdc, const CRect& rc, const double *surface,
     {
         DrawSolidRect(pdc, rc, color, brightness);
     }
+
+    if(pending)
+    {
+        DrawHatch(pdc, rc);
+    }
 }
 
 void CTreemap::DrawSolidRect(CDC *pdc, const CRect& rc, COLORREF col, double brightness)
@@ -1170,6 +1181,14 @@ void CTreemap::DrawSolidRect(CDC *pdc, const CRect& rc, COLORREF col, double bri
     pdc->FillSolidRect(rc, RGB(red, green, blue));
 }
 
+void CTreemap::DrawHatch(CDC *pdc, const CRect& rc)
+{
+    CBrush brush(HS_BDIAGONAL, PENDING_HATCHCOLOR);
+    int bkMode = pdc->SetBkMode(TRANSPARENT);
+    pdc->FillRect(rc, &brush);
+    pdc->SetBkMode(bkMode);
+}
+
 void CTreemap::DrawCushion(CDC *pdc, const CRect& rc, const double *surface, COLORREF col, double brightness)
 {
     // Cushion parameters
@@ -67,6 +67,11 @@ public:
     static const DWORD COLORFLAG_LIGHTER = 0x02000000;
     static const DWORD COLORFLAG_MASK    = 0x03000000;
 
+    // Can be added, too. The rectangle is hatched. Used for the
+    // part of a drive, which has not yet been scanned (scan preview).
+    //
+    static const DWORD COLORFLAG_PENDING = 0x04000000;
+
     //
     // Item. Interface which must be supported by the tree items.
     // If you prefer to use the getHead()/getNext() pattern rather
@@ -234,6 +239,9 @@ protected:
     // Draws the surface using FillSolidRect()
     void DrawSolidRect(CDC *pdc, const CRect& rc, COLORREF col, double brightness);
 
+    // Hatches a rendered rectangle (COLORFLAG_PENDING)
+    void DrawHatch(CDC *pdc, const CRect& rc);
+
     // Adds a new ridge to surface
     static void AddRidge(const CRect& rc, double *surface, double h);
 
@@ -40,6 +40,8 @@ CExtensionListControl::CListItem::CListItem(CExtensionListControl *list, LPCTSTR
 {
     m_list = list;
     m_extension = extension;
+    m_extensionKey = extension;
+    m_extensionKey.MakeLower();
     m_record = r;
     m_image = -1;
 }
@@ -148,6 +150,19 @@ CString CExtensionListControl::CListItem::GetDescription() const
     return m_description;
 }
 
+// The sort key is computed once, so that sorting doesn't
+// case fold the descriptions again for every comparison.
+//
+const CString& CExtensionListControl::CListItem::GetDescriptionKey() const
+{
+    if(m_descriptionKey.IsEmpty())
+    {
+        m_descriptionKey = GetDescription();
+        m_descriptionKey.MakeLower();
+    }
+    return m_descriptionKey;
+}
+
 CString CExtensionListControl::CListItem::GetBytesPercent() const
 {
     CString s;
@@ -175,7 +190,7 @@ int CExtensionListControl::CListItem::Compare(const CSortingListItem *baseOther,
     {
     case COL_EXTENSION:
         {
-            r = signum(GetExtension().CompareNoCase(other->GetExtension()));
+            r = signum(_tcscmp(m_extensionKey, other->m_extensionKey));
         }
         break;
 
@@ -194,7 +209,7 @@ int CExtensionListControl::CListItem::Compare(const CSortingListItem *baseOther,
 
     case COL_DESCRIPTION:
         {
-            r = signum(GetDescription().CompareNoCase(other->GetDescription()));
+            r = signum(_tcscmp(GetDescriptionKey(), other->GetDescriptionKey()));
         }
         break;
 
@@ -472,8 +487,9 @@ void CTypeView::OnUpdate(CView * /*pSender*/, LPARAM lHint, CObject *)
     switch (lHint)
     {
     case HINT_NEWROOT:
+    case HINT_SCANPREVIEW:
     case 0:
-        if(IsShowTypes() && GetDocument()->IsRootDone())
+        if(IsShowTypes() && (GetDocument()->IsAnyRootDone() || GetDocument()->OptionScanPreview()))
         {
             m_extensionListControl.SetRootSize(GetDocument()->GetRootSize());
             m_extensionListControl.SetExtensionData(GetDocument()->GetExtensionData());
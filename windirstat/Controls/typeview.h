@@ -64,14 +64,17 @@ protected:
         void DrawColor(CDC *pdc, CRect rc, UINT state, int *width) const;
 
         CString GetDescription() const;
+        const CString& GetDescriptionKey() const;
         CString GetBytesPercent() const;
 
         double GetBytesFraction() const;
 
         CExtensionListControl *m_list;
         CString m_extension;
+        CString m_extensionKey;             // Lower case m_extension for Compare()
         SExtensionRecord m_record;
         mutable CString m_description;
+        mutable CString m_descriptionKey;   // Lower case m_description for Compare()
         mutable int m_image;
     };
 
@@ -0,0 +1,243 @@
+// DeleteQueue.cpp - Implementation of CDeleteQueue and CDeleteThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "EventTrace.h"
+#include "DeleteQueue.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+const UINT WMU_DELETEPROGRESS = ::RegisterWindowMessage(_T("{6B1C7A52-2F0E-4D8B-9C55-0E4F3A7B21D1}"));
+const UINT WMU_DELETEFINISHED = ::RegisterWindowMessage(_T("{A3E07C19-5D64-47B2-8F1A-6C92D0B4E857}"));
+
+CCriticalSection CDeleteQueue::_cs;
+CDeleteQueue::CQueuedPathList CDeleteQueue::_queue;
+bool CDeleteQueue::_threadRunning = false;
+HWND CDeleteQueue::_notifyWindow = NULL;
+UINT CDeleteQueue::_serial = 0;
+
+void CDeleteQueue::SetNotifyWindow(HWND hwnd)
+{
+    CSingleLock lock(&_cs, true);
+    _notifyWindow = hwnd;
+    _serial++;
+}
+
+// Called by the main frame when it is destroyed.
+// The thread continues deleting, but doesn't report anything any more.
+//
+void CDeleteQueue::InvalidateNotifyWindow()
+{
+    SetNotifyWindow(NULL);
+}
+
+// Appends the paths to the queue and starts the worker thread, if necessary.
+//
+void CDeleteQueue::Enqueue(const CStringArray& paths, bool toTrashBin)
+{
+    CSingleLock lock(&_cs, true);
+
+    for(int i = 0; i < paths.GetSize(); i++)
+    {
+        QUEUEDPATH qp;
+        qp.path = paths[i];
+        qp.toTrashBin = toTrashBin;
+        _queue.AddTail(qp);
+    }
+
+    if(!_threadRunning && _queue.GetCount() > 0)
+    {
+        _threadRunning = true;
+        new CDeleteThread; // deletes itself
+    }
+}
+
+UINT CDeleteQueue::GetSerial()
+{
+    CSingleLock lock(&_cs, true);
+    return _serial;
+}
+
+bool CDeleteQueue::IsBusy()
+{
+    CSingleLock lock(&_cs, true);
+    return _threadRunning;
+}
+
+int CDeleteQueue::GetPendingCount()
+{
+    CSingleLock lock(&_cs, true);
+    return (int)_queue.GetCount();
+}
+
+// Called by the thread. Removes all leading paths with the same
+// toTrashBin flag from the queue. If the queue is empty, the thread
+// unregisters itself (atomically with respect to Enqueue()).
+// Return: false, if the thread shall terminate.
+//
+bool CDeleteQueue::PopBatch(CStringArray& paths, bool& toTrashBin, HWND& notify, UINT& serial)
+{
+    CSingleLock lock(&_cs, true);
+
+    paths.RemoveAll();
+    notify = _notifyWindow;
+    serial = _serial;
+
+    if(_queue.IsEmpty())
+    {
+        _threadRunning = false;
+        return false;
+    }
+
+    toTrashBin = _queue.GetHead().toTrashBin;
+    while(!_queue.IsEmpty() && _queue.GetHead().toTrashBin == toTrashBin)
+    {
+        paths.Add(_queue.RemoveHead().path);
+    }
+    return true;
+}
+
+HWND CDeleteQueue::GetNotifyWindow(UINT& serial)
+{
+    CSingleLock lock(&_cs, true);
+    serial = _serial;
+    return _notifyWindow;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The constructor starts the thread.
+//
+CDeleteThread::CDeleteThread()
+{
+    ASSERT(m_bAutoDelete);
+    VERIFY(CreateThread());
+}
+
+BOOL CDeleteThread::InitInstance()
+{
+    // The shell may need COM for the recycle bin.
+    HRESULT hrInit = ::CoInitialize(NULL);
+
+    CEventTrace::SetThreadName("Delete");
+
+    CStringArray paths;
+    bool toTrashBin = false;
+    HWND notify = NULL;
+    UINT serial = 0;
+
+    while(CDeleteQueue::PopBatch(paths, toTrashBin, notify, serial))
+    {
+        DeleteBatch(paths, toTrashBin, notify);
+    }
+
+    // We are unregistered now. Don't touch the queue any more.
+    if(notify != NULL)
+    {
+        ::SendMessage(notify, WMU_DELETEFINISHED, serial, 0);
+    }
+
+    if(SUCCEEDED(hrInit))
+    {
+        ::CoUninitialize();
+    }
+
+    CEventTrace::ReleaseThreadBuffer();
+
+    ASSERT(m_bAutoDelete); // Object will delete itself.
+    return false; // no Run(), please!
+}
+
+// Deletes all paths with one SHFileOperation() call and then reports
+// for each path, whether it has actually gone.
+// Return: false, if the operation failed or has been aborted.
+//
+bool CDeleteThread::DeleteBatch(const CStringArray& paths, bool toTrashBin, HWND notify)
+{
+    CTraceScope scope(TE_DELETEBATCH, paths.GetSize(), toTrashBin);
+
+    // Build the double-null-terminated list
+    int len = 1;
+    int i = 0;
+    for(i = 0; i < paths.GetSize(); i++)
+    {
+        len += paths[i].GetLength() + 1;
+    }
+
+    CArray<TCHAR, TCHAR> from;
+    from.SetSize(len);
+    LPTSTR p = from.GetData();
+    for(i = 0; i < paths.GetSize(); i++)
+    {
+        int n = paths[i].GetLength();
+        memcpy(p, (LPCTSTR)paths[i], n * sizeof(TCHAR));
+        p[n] = 0;
+        p += n + 1;
+    }
+    *p = 0;
+
+    SHFILEOPSTRUCT sfos;
+    ZeroMemory(&sfos, sizeof(sfos));
+    sfos.wFunc = FO_DELETE;
+    sfos.pFrom = from.GetData();
+    sfos.fFlags = toTrashBin ? FOF_ALLOWUNDO : 0;
+    sfos.hwnd = notify;
+
+    int r = ::SHFileOperation(&sfos);
+    if(r != 0)
+    {
+        VTRACE(_T("SHFileOperation() returned 0x%08X"), r);
+    }
+
+    for(i = 0; i < paths.GetSize(); i++)
+    {
+        UINT serial = 0;
+        HWND hwnd = CDeleteQueue::GetNotifyWindow(serial);
+        if(hwnd == NULL)
+        {
+            continue;
+        }
+
+        DELETEPROGRESS dp;
+        dp.path = paths[i];
+        dp.deleted = (::GetFileAttributes(paths[i]) == INVALID_FILE_ATTRIBUTES);
+        dp.toTrashBin = toTrashBin;
+        dp.done = i + 1;
+        dp.total = (int)paths.GetSize();
+        dp.pending = CDeleteQueue::GetPendingCount();
+
+        // Theoretically the window may have been destroyed at this point.
+        // SendMessage() to a non-existing window simply fails immediately.
+        // If the system recycled the window handle, we are safe, because
+        // WMU_DELETEPROGRESS is a unique registered message, and a new
+        // main frame would have a new serial.
+        ::SendMessage(hwnd, WMU_DELETEPROGRESS, serial, (LPARAM)&dp);
+    }
+
+    return r == 0 && !sfos.fAnyOperationsAborted;
+}
@@ -0,0 +1,102 @@
+// DeleteQueue.h - Declaration of CDeleteQueue and CDeleteThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#ifndef __WDS_DELETEQUEUE_H__
+#define __WDS_DELETEQUEUE_H__
+#pragma once
+
+//
+// Registered messages sent (SendMessage) by the delete thread
+// to the notification window (the main frame).
+// WMU_DELETEPROGRESS: wParam = serial, lParam = const DELETEPROGRESS *
+// WMU_DELETEFINISHED: wParam = serial, lParam = 0
+//
+extern const UINT WMU_DELETEPROGRESS;
+extern const UINT WMU_DELETEFINISHED;
+
+//
+// Data passed with WMU_DELETEPROGRESS. Only valid during the SendMessage().
+//
+struct DELETEPROGRESS
+{
+    LPCTSTR path;       // The path which has been processed
+    bool deleted;       // false, if the path still exists (aborted or failed)
+    bool toTrashBin;    // Whether the path has been moved to the recycle bin
+    int done;           // Number of paths processed in this batch so far (including this one)
+    int total;          // Number of paths in this batch
+    int pending;        // Number of paths still waiting in the queue
+};
+
+//
+// CDeleteQueue. Queue of paths to be deleted by a background thread.
+// Consecutive paths with equal toTrashBin flag are batched into
+// one single SHFileOperation() call (double-null-terminated list).
+// The public methods are called by the gui thread.
+//
+class CDeleteQueue
+{
+public:
+    static void SetNotifyWindow(HWND hwnd);
+    static void InvalidateNotifyWindow();
+    static UINT GetSerial();
+
+    static void Enqueue(const CStringArray& paths, bool toTrashBin);
+    static bool IsBusy();
+    static int GetPendingCount();
+
+private:
+    friend class CDeleteThread;
+
+    struct QUEUEDPATH
+    {
+        CString path;
+        bool toTrashBin;
+    };
+    typedef CList<QUEUEDPATH, const QUEUEDPATH&> CQueuedPathList;
+
+    static bool PopBatch(CStringArray& paths, bool& toTrashBin, HWND& notify, UINT& serial);
+    static HWND GetNotifyWindow(UINT& serial);
+
+    static CCriticalSection _cs;    // Synchronizes all the following members
+    static CQueuedPathList _queue;  // Paths waiting for deletion
+    static bool _threadRunning;     // Whether a CDeleteThread is alive
+    static HWND _notifyWindow;      // Receiver of the WMU_DELETE* messages
+    static UINT _serial;            // Serial number of _notifyWindow
+};
+
+//
+// CDeleteThread. Drains the CDeleteQueue and terminates itself
+// as soon as the queue is empty.
+//
+class CDeleteThread: public CWinThread
+{
+public:
+    CDeleteThread();
+    virtual BOOL InitInstance();
+
+protected:
+    bool DeleteBatch(const CStringArray& paths, bool toTrashBin, HWND notify);
+};
+
+#endif // __WDS_DELETEQUEUE_H__
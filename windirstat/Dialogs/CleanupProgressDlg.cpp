@@ -0,0 +1,381 @@
+// CleanupProgressDlg.cpp - Implementation of CCleanupProgressDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "CleanupProgressDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    // Posted by CProcessWaiter. wParam = command, lParam = 0
+    const UINT WMU_PROCESSEXITED = WM_USER + 100;
+
+    // The progress control only has 16 bit before comctl32 4.70 (PBM_SETRANGE32).
+    // We use a fixed range and scale.
+    const int PROGRESS_RANGE = 1000;
+}
+
+IMPLEMENT_DYNAMIC(CCleanupProgressDlg, CDialog)
+
+CCleanupProgressDlg::CCleanupProgressDlg(LPCTSTR app, bool showConsoleWindow, int maxProcesses, CWnd* pParent /*=NULL*/)
+    : CDialog(CCleanupProgressDlg::IDD, pParent)
+    , m_app(app)
+    , m_showConsoleWindow(showConsoleWindow)
+    , m_maxProcesses(max(1, min(maxProcesses, MAXCLEANUPPROCESSES)))
+    , m_finishedCount(0)
+    , m_failedCount(0)
+    , m_canceled(false)
+{
+}
+
+CCleanupProgressDlg::~CCleanupProgressDlg()
+{
+    ASSERT(m_running.GetSize() == 0);
+}
+
+// Adds a command. Commands must be added in depth first order,
+// i.e. the commands of subdirectories before the command of their parent.
+// Return: index of the new command.
+//
+int CCleanupProgressDlg::AddCommand(LPCTSTR path, LPCTSTR commandLine)
+{
+    COMMAND cmd;
+    cmd.path = path;
+    cmd.commandLine = commandLine;
+    cmd.parent = -1;
+    cmd.pendingChildren = 0;
+    cmd.started = false;
+    cmd.finished = false;
+    cmd.exitCode = 0;
+    return (int)m_commands.Add(cmd);
+}
+
+// The command "parent" will not be started before "command" has terminated.
+//
+void CCleanupProgressDlg::SetCommandParent(int command, int parent)
+{
+    ASSERT(parent > command);
+    m_commands[command].parent = parent;
+}
+
+int CCleanupProgressDlg::GetCommandCount() const
+{
+    return (int)m_commands.GetSize();
+}
+
+int CCleanupProgressDlg::GetFailedCount() const
+{
+    return m_failedCount;
+}
+
+bool CCleanupProgressDlg::WasCanceled() const
+{
+    return m_canceled;
+}
+
+// Returns up to maxLines lines "path: exit code / error message"
+// of the commands which failed.
+//
+CString CCleanupProgressDlg::GetFailureReport(int maxLines) const
+{
+    CString report;
+    int lines = 0;
+    for(int i = 0; i < m_commands.GetSize() && lines < maxLines; i++)
+    {
+        const COMMAND& cmd = m_commands[i];
+        if(!cmd.finished || (cmd.error.IsEmpty() && cmd.exitCode == 0))
+        {
+            continue;
+        }
+
+        CString line;
+        if(!cmd.error.IsEmpty())
+        {
+            line.Format(_T("%s: %s\r\n"), (LPCTSTR)cmd.path, (LPCTSTR)cmd.error);
+        }
+        else
+        {
+            line.FormatMessage(IDS_sEXITCODEd, (LPCTSTR)cmd.path, cmd.exitCode);
+            line += _T("\r\n");
+        }
+        report += line;
+        lines++;
+    }
+    return report;
+}
+
+void CCleanupProgressDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Control(pDX, IDC_PROGRESS, m_progress);
+    DDX_Text(pDX, IDC_CURRENTPATH, m_currentPath);
+    DDX_Text(pDX, IDC_STATUS, m_status);
+}
+
+BEGIN_MESSAGE_MAP(CCleanupProgressDlg, CDialog)
+    ON_MESSAGE(WMU_PROCESSEXITED, OnProcessExited)
+END_MESSAGE_MAP()
+
+BOOL CCleanupProgressDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    // Count the children of each command
+    int i = 0;
+    for(i = 0; i < m_commands.GetSize(); i++)
+    {
+        if(m_commands[i].parent >= 0)
+        {
+            ASSERT(m_commands[i].parent > i);
+            m_commands[m_commands[i].parent].pendingChildren++;
+        }
+    }
+
+    // The leaves are ready from the beginning, in depth first order.
+    // Their parents are queued by FinishCommand().
+    for(i = 0; i < m_commands.GetSize(); i++)
+    {
+        if(m_commands[i].pendingChildren == 0)
+        {
+            m_ready.AddTail(i);
+        }
+    }
+
+    m_progress.SetRange(0, PROGRESS_RANGE);
+
+    StartReadyCommands();
+    UpdateStatus();
+
+    // None could be started.
+    CheckEnd();
+
+    return TRUE;
+}
+
+// Cancel (or Escape or the close box) doesn't end the dialog immediately.
+// We don't start new commands, but wait for the running ones.
+//
+void CCleanupProgressDlg::OnCancel()
+{
+    m_canceled = true;
+    GetDlgItem(IDCANCEL)->EnableWindow(false);
+    UpdateStatus();
+
+    if(m_running.GetSize() == 0)
+    {
+        EndDialog(IDCANCEL);
+    }
+}
+
+LRESULT CCleanupProgressDlg::OnProcessExited(WPARAM command, LPARAM)
+{
+    ReapProcess((int)command);
+
+    if(!m_canceled)
+    {
+        StartReadyCommands();
+    }
+
+    UpdateStatus();
+    CheckEnd();
+
+    return 0;
+}
+
+void CCleanupProgressDlg::CheckEnd()
+{
+    if(m_running.GetSize() == 0)
+    {
+        if(m_canceled)
+        {
+            EndDialog(IDCANCEL);
+        }
+        else if(m_finishedCount == m_commands.GetSize())
+        {
+            EndDialog(IDOK);
+        }
+    }
+}
+
+// Called, when the CProcessWaiter of command has seen its process terminate.
+//
+void CCleanupProgressDlg::ReapProcess(int command)
+{
+    for(int i = 0; i < m_running.GetSize(); i++)
+    {
+        if(m_running[i].command != command)
+        {
+            continue;
+        }
+
+        DWORD exitCode = 0;
+        if(!::GetExitCodeProcess(m_running[i].process, &exitCode))
+        {
+            exitCode = ::GetLastError();
+        }
+        ::CloseHandle(m_running[i].process);
+        m_running.RemoveAt(i);
+
+        FinishCommand(command, exitCode);
+        return;
+    }
+    ASSERT(0);
+}
+
+// Starts ready commands, as long as there are free slots.
+// A command is ready, when the commands of all subdirectories are finished.
+//
+void CCleanupProgressDlg::StartReadyCommands()
+{
+    while(!m_ready.IsEmpty() && m_running.GetSize() < m_maxProcesses)
+    {
+        int i = m_ready.RemoveHead();
+        ASSERT(!m_commands[i].started);
+        ASSERT(m_commands[i].pendingChildren == 0);
+
+        if(!StartCommand(i))
+        {
+            FinishCommand(i, 0);
+        }
+    }
+}
+
+// Return: false, if the process could not be created.
+//
+bool CCleanupProgressDlg::StartCommand(int i)
+{
+    COMMAND& cmd = m_commands[i];
+    cmd.started = true;
+
+    STARTUPINFO si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESHOWWINDOW;
+    si.wShowWindow = m_showConsoleWindow ? SW_SHOWNORMAL : SW_HIDE;
+
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&pi, sizeof(pi));
+
+    CString cmdline = cmd.commandLine;
+    BOOL b = ::CreateProcess(
+        m_app,
+        cmdline.GetBuffer(),
+        NULL,
+        NULL,
+        false,
+        0,
+        NULL,
+        cmd.path,
+        &si,
+        &pi
+    );
+    cmdline.ReleaseBuffer();
+    if(!b)
+    {
+        cmd.error = MdGetWinErrorText(::GetLastError());
+        return false;
+    }
+
+    ::CloseHandle(pi.hThread);
+
+    RUNNING r;
+    r.command = i;
+    r.process = pi.hProcess;
+    m_running.Add(r);
+
+    new CProcessWaiter(pi.hProcess, m_hWnd, i); // deletes itself
+
+    m_currentPath = cmd.path;
+    return true;
+}
+
+void CCleanupProgressDlg::FinishCommand(int i, DWORD exitCode)
+{
+    COMMAND& cmd = m_commands[i];
+    ASSERT(cmd.started);
+    ASSERT(!cmd.finished);
+
+    cmd.finished = true;
+    cmd.exitCode = exitCode;
+    m_finishedCount++;
+
+    if(exitCode != 0 || !cmd.error.IsEmpty())
+    {
+        m_failedCount++;
+    }
+
+    if(cmd.parent >= 0)
+    {
+        ASSERT(m_commands[cmd.parent].pendingChildren > 0);
+        if(--m_commands[cmd.parent].pendingChildren == 0)
+        {
+            m_ready.AddTail(cmd.parent);
+        }
+    }
+}
+
+void CCleanupProgressDlg::UpdateStatus()
+{
+    int total = (int)m_commands.GetSize();
+
+    m_status.FormatMessage(m_canceled ? IDS_CLEANUPCANCELEDdddd : IDS_CLEANUPSTATUSdddd,
+        m_finishedCount, total, (int)m_running.GetSize(), m_failedCount);
+
+    if(total > 0)
+    {
+        m_progress.SetPos((int)((ULONGLONG)m_finishedCount * PROGRESS_RANGE / total));
+    }
+
+    UpdateData(false);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The constructor starts the thread.
+//
+CProcessWaiter::CProcessWaiter(HANDLE process, HWND notify, int command)
+    : m_process(process)
+    , m_notify(notify)
+    , m_command(command)
+{
+    ASSERT(m_bAutoDelete);
+    VERIFY(CreateThread());
+}
+
+BOOL CProcessWaiter::InitInstance()
+{
+    ::WaitForSingleObject(m_process, INFINITE);
+
+    // The dialog ends only after all its processes have terminated,
+    // so m_notify is valid. The dialog closes m_process then.
+    ::PostMessage(m_notify, WMU_PROCESSEXITED, m_command, 0);
+
+    ASSERT(m_bAutoDelete); // Object will delete itself.
+    return false; // no Run(), please!
+}
@@ -0,0 +1,121 @@
+// CleanupProgressDlg.h - Declaration of CCleanupProgressDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#ifndef __WDS_CLEANUPPROGRESSDLG_H__
+#define __WDS_CLEANUPPROGRESSDLG_H__
+#pragma once
+
+//
+// CCleanupProgressDlg. Runs the commands of a recursive user defined
+// cleanup with up to m_maxProcesses concurrent child processes.
+// A command is started only after the commands of all its subdirectories
+// have terminated, so that the depth first order of the former serial
+// implementation is retained. The exit code of each command is collected.
+// A CProcessWaiter per process tells us, when it has terminated, so that
+// the next command is started at once.
+//
+class CCleanupProgressDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CCleanupProgressDlg)
+    enum { IDD = IDD_CLEANUPPROGRESS };
+
+    struct COMMAND
+    {
+        CString path;           // Directory the command works on (for feedback)
+        CString commandLine;    // Complete command line for CreateProcess()
+        int parent;             // Index of the command of the parent directory, or -1
+        int pendingChildren;    // # Commands of subdirectories not yet terminated
+        bool started;
+        bool finished;
+        DWORD exitCode;         // Valid if finished
+        CString error;          // Not empty, if the process could not be created
+    };
+
+    struct RUNNING
+    {
+        int command;
+        HANDLE process;
+    };
+
+public:
+    CCleanupProgressDlg(LPCTSTR app, bool showConsoleWindow, int maxProcesses, CWnd* pParent = NULL);
+    virtual ~CCleanupProgressDlg();
+
+    int AddCommand(LPCTSTR path, LPCTSTR commandLine);
+    void SetCommandParent(int command, int parent);
+
+    int GetCommandCount() const;
+    int GetFailedCount() const;
+    bool WasCanceled() const;
+    CString GetFailureReport(int maxLines) const;
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+    virtual void OnCancel();
+
+    void ReapProcess(int command);
+    void CheckEnd();
+    void StartReadyCommands();
+    bool StartCommand(int i);
+    void FinishCommand(int i, DWORD exitCode);
+    void UpdateStatus();
+
+    const CString m_app;            // COMSPEC
+    const bool m_showConsoleWindow;
+    const int m_maxProcesses;
+
+    CArray<COMMAND, COMMAND&> m_commands;   // In depth first order (children before parents)
+    CArray<RUNNING, RUNNING&> m_running;    // Currently running processes
+    CList<int, int> m_ready;    // Commands without pending children, not yet started
+    int m_finishedCount;
+    int m_failedCount;
+    bool m_canceled;
+
+    CProgressCtrl m_progress;
+    CString m_currentPath;
+    CString m_status;
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg LRESULT OnProcessExited(WPARAM command, LPARAM);
+};
+
+//
+// CProcessWaiter. Waits for a child process of the CCleanupProgressDlg
+// and posts WMU_PROCESSEXITED to the dialog, when it has terminated.
+// Then it terminates itself.
+//
+class CProcessWaiter: public CWinThread
+{
+public:
+    CProcessWaiter(HANDLE process, HWND notify, int command);
+    virtual BOOL InitInstance();
+
+protected:
+    const HANDLE m_process;     // Owned by the dialog, which closes it after WMU_PROCESSEXITED
+    const HWND m_notify;
+    const int m_command;
+};
+
+#endif // __WDS_CLEANUPPROGRESSDLG_H__
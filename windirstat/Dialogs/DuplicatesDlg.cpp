@@ -0,0 +1,225 @@
+// DuplicatesDlg.cpp - Implementation of CDuplicatesDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "dirstatdoc.h"
+#include "DuplicatesDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const UINT TIMER_ID = 4711;
+    const UINT TIMER_INTERVAL = 200; // ms
+
+    // See CCleanupProgressDlg
+    const int PROGRESS_RANGE = 1000;
+
+    enum
+    {
+        COL_SIZE,
+        COL_FILES,
+        COL_RECLAIMABLE
+    };
+
+    enum
+    {
+        COL_NAME,
+        COL_FOLDER
+    };
+}
+
+IMPLEMENT_DYNAMIC(CDuplicatesDlg, CDialog)
+
+CDuplicatesDlg::CDuplicatesDlg(const CItem *root, CFileHashMap& hashes, CHashCache *cache, CWnd* pParent /*=NULL*/)
+    : CDialog(CDuplicatesDlg::IDD, pParent)
+    , m_root(root)
+    , m_finder(hashes, cache)
+{
+}
+
+CDuplicatesDlg::~CDuplicatesDlg()
+{
+}
+
+void CDuplicatesDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Control(pDX, IDC_PROGRESS, m_progress);
+    DDX_Text(pDX, IDC_STATUS, m_status);
+    DDX_Control(pDX, IDC_DUPLICATEGROUPS, m_groups);
+    DDX_Control(pDX, IDC_DUPLICATEFILES, m_files);
+}
+
+BEGIN_MESSAGE_MAP(CDuplicatesDlg, CDialog)
+    ON_WM_TIMER()
+    ON_WM_DESTROY()
+    ON_NOTIFY(LVN_ITEMCHANGED, IDC_DUPLICATEGROUPS, OnLvnItemchangedGroups)
+END_MESSAGE_MAP()
+
+BOOL CDuplicatesDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    m_progress.SetRange(0, PROGRESS_RANGE);
+
+    m_groups.SetExtendedStyle(m_groups.GetExtendedStyle() | LVS_EX_FULLROWSELECT);
+    m_groups.InsertColumn(COL_SIZE,        LoadString(IDS_TREECOL_SIZE),               LVCFMT_RIGHT, 80, COL_SIZE);
+    m_groups.InsertColumn(COL_FILES,       LoadString(IDS_TREECOL_FILES),              LVCFMT_RIGHT, 60, COL_FILES);
+    m_groups.InsertColumn(COL_RECLAIMABLE, LoadString(IDS_DUPLICATESCOL_RECLAIMABLE), LVCFMT_RIGHT, 80, COL_RECLAIMABLE);
+
+    m_files.SetExtendedStyle(m_files.GetExtendedStyle() | LVS_EX_FULLROWSELECT);
+    m_files.InsertColumn(COL_NAME,   LoadString(IDS_TREECOL_NAME),       LVCFMT_LEFT, 150, COL_NAME);
+    m_files.InsertColumn(COL_FOLDER, LoadString(IDS_TOPFILESCOL_FOLDER), LVCFMT_LEFT, 300, COL_FOLDER);
+
+    {
+        CWaitCursor wc;
+        m_finder.Start(m_root);
+    }
+    UpdateStatus();
+
+    SetTimer(TIMER_ID, TIMER_INTERVAL, NULL);
+
+    return TRUE;
+}
+
+// The finder's destructor waits for the threads, which stop after
+// the current chunk.
+//
+void CDuplicatesDlg::OnCancel()
+{
+    m_finder.Cancel();
+    CDialog::OnCancel();
+}
+
+void CDuplicatesDlg::OnTimer(UINT_PTR /*nIDEvent*/)
+{
+    if(m_finder.Poll())
+    {
+        KillTimer(TIMER_ID);
+        FillGroups();
+    }
+    UpdateStatus();
+}
+
+void CDuplicatesDlg::OnDestroy()
+{
+    KillTimer(TIMER_ID);
+    CDialog::OnDestroy();
+}
+
+void CDuplicatesDlg::UpdateStatus()
+{
+    int filesDone, filesTotal;
+    ULONGLONG bytesDone, bytesTotal;
+    m_finder.GetProgress(filesDone, filesTotal, bytesDone, bytesTotal);
+
+    switch (m_finder.GetStage())
+    {
+    case CDuplicateFinder::DS_PARTIALHASH:
+        m_status.FormatMessage(IDS_DUPLICATESPARTIALdds, filesDone, filesTotal, (LPCTSTR)FormatBytes(bytesDone));
+        break;
+
+    case CDuplicateFinder::DS_FULLHASH:
+        m_status.FormatMessage(IDS_DUPLICATESFULLdds, filesDone, filesTotal, (LPCTSTR)FormatBytes(bytesDone));
+        break;
+
+    case CDuplicateFinder::DS_DONE:
+        m_status.FormatMessage(IDS_DUPLICATESRESULTds, m_finder.GetGroupCount(), (LPCTSTR)FormatBytes(m_finder.GetReclaimableBytes()));
+        bytesDone = bytesTotal = 1;
+        break;
+    }
+
+    if(bytesTotal > 0)
+    {
+        m_progress.SetPos((int)(bytesDone * PROGRESS_RANGE / bytesTotal));
+    }
+
+    UpdateData(false);
+}
+
+void CDuplicatesDlg::FillGroups()
+{
+    m_groups.SetRedraw(false);
+    m_groups.DeleteAllItems();
+    for(int i = 0; i < m_finder.GetGroupCount(); i++)
+    {
+        const DUPLICATEGROUP& group = m_finder.GetGroup(i);
+
+        int item = m_groups.InsertItem(i, FormatBytes(group.size));
+        m_groups.SetItemText(item, COL_FILES, FormatCount(group.pathCount));
+        m_groups.SetItemText(item, COL_RECLAIMABLE, FormatBytes(group.size * (group.pathCount - 1)));
+        m_groups.SetItemData(item, i);
+    }
+    m_groups.SetRedraw(true);
+}
+
+// Lists the files of the group and selects those still in the tree.
+//
+void CDuplicatesDlg::SelectGroup(int group)
+{
+    const DUPLICATEGROUP& g = m_finder.GetGroup(group);
+
+    CArray<CItem *, CItem *> items;
+
+    m_files.SetRedraw(false);
+    m_files.DeleteAllItems();
+    for(int i = 0; i < g.pathCount; i++)
+    {
+        CString path = m_finder.GetPath(g.firstPath + i);
+
+        int n = path.ReverseFind(wds::chrBackslash);
+        int item = m_files.InsertItem(i, path.Mid(n + 1));
+        m_files.SetItemText(item, COL_FOLDER, path.Left(n));
+
+        path.MakeLower();
+        CItem *file = GetDocument()->GetRootItem()->FindDirectoryByPath(path);
+        if(file != NULL)
+        {
+            items.Add(file);
+        }
+    }
+    m_files.SetRedraw(true);
+
+    GetDocument()->SelectItems(items);
+    GetDocument()->UpdateAllViews(NULL, HINT_SELECTIONCHANGED);
+}
+
+void CDuplicatesDlg::OnLvnItemchangedGroups(NMHDR *pNMHDR, LRESULT *pResult)
+{
+    LPNMLISTVIEW pNMLV = reinterpret_cast<LPNMLISTVIEW>(pNMHDR);
+    *pResult = 0;
+
+    if((pNMLV->uChanged & LVIF_STATE) == 0 || (pNMLV->uNewState & LVIS_SELECTED) == 0)
+    {
+        return;
+    }
+
+    SelectGroup((int)m_groups.GetItemData(pNMLV->iItem));
+}
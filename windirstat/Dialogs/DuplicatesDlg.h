@@ -0,0 +1,72 @@
+// DuplicatesDlg.h - Declaration of CDuplicatesDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_DUPLICATESDLG_H__
+#define __WDS_DUPLICATESDLG_H__
+#pragma once
+
+#include "DuplicateFinder.h"
+
+class CItem;
+
+//
+// CDuplicatesDlg. Runs a CDuplicateFinder on the tree and lists the groups
+// of duplicates by reclaimable bytes. Selecting a group selects its files,
+// so that the treemap highlights them.
+// The groups hold paths, not items, so that they survive deletions.
+//
+class CDuplicatesDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CDuplicatesDlg)
+    enum { IDD = IDD_DUPLICATES };
+
+public:
+    CDuplicatesDlg(const CItem *root, CFileHashMap& hashes, CHashCache *cache, CWnd* pParent = NULL);
+    virtual ~CDuplicatesDlg();
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+    virtual void OnCancel();
+
+    void UpdateStatus();
+    void FillGroups();
+    void SelectGroup(int group);
+
+    const CItem *m_root;
+    CDuplicateFinder m_finder;
+
+    CProgressCtrl m_progress;
+    CString m_status;
+    CListCtrl m_groups;
+    CListCtrl m_files;
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg void OnTimer(UINT_PTR nIDEvent);
+    afx_msg void OnDestroy();
+    afx_msg void OnLvnItemchangedGroups(NMHDR *pNMHDR, LRESULT *pResult);
+};
+
+#endif // __WDS_DUPLICATESDLG_H__
@@ -0,0 +1,184 @@
+// GrowthDlg.cpp - Implementation of CGrowthDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "dirstatdoc.h"
+#include "options.h"
+#include "ScanDiff.h"
+#include "GrowthDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    // Nodes created per zoom. Limits the time and memory of a zoom
+    // into a huge subtree; its deeper levels remain collapsed.
+    const int EXPANDNODES = 20000;
+
+    CString FormatSigned(LONGLONG n, bool bytes)
+    {
+        ULONGLONG magnitude = (ULONGLONG)(n < 0 ? -n : n);
+        CString s = (bytes ? FormatBytes(magnitude) : FormatCount(magnitude));
+        return (n < 0 ? _T("-") : _T("+")) + s;
+    }
+}
+
+IMPLEMENT_DYNAMIC(CGrowthDlg, CDialog)
+
+CGrowthDlg::CGrowthDlg(CScanDiff *diff, CWnd* pParent /*=NULL*/)
+    : CDialog(CGrowthDlg::IDD, pParent)
+    , m_diff(diff)
+    , m_zoom(NULL)
+{
+}
+
+CGrowthDlg::~CGrowthDlg()
+{
+}
+
+void CGrowthDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Text(pDX, IDC_GROWTHZOOM, m_zoomText);
+    DDX_Text(pDX, IDC_STATUS, m_status);
+}
+
+BEGIN_MESSAGE_MAP(CGrowthDlg, CDialog)
+    ON_WM_PAINT()
+    ON_WM_MOUSEMOVE()
+    ON_WM_LBUTTONDOWN()
+    ON_BN_CLICKED(IDC_GROWTHZOOMOUT, OnBnClickedZoomout)
+END_MESSAGE_MAP()
+
+BOOL CGrowthDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    Zoom(m_diff->GetRoot());
+
+    return TRUE;
+}
+
+// "path: +bytes, +files"
+//
+CString CGrowthDlg::FormatNode(const CDiffNode *node)
+{
+    CString s;
+    s.FormatMessage(IDS_GROWTHNODEsss, (LPCTSTR)node->GetPath(), (LPCTSTR)FormatSigned(node->GetDeltaSize(), true), (LPCTSTR)FormatSigned(node->GetDeltaFiles(), false));
+    return s;
+}
+
+// The IDC_GROWTHTREEMAP control is invisible. It only defines the
+// rectangle, which we paint ourselves.
+//
+CRect CGrowthDlg::GetTreemapRect()
+{
+    CRect rc;
+    GetDlgItem(IDC_GROWTHTREEMAP)->GetWindowRect(rc);
+    ScreenToClient(rc);
+    return rc;
+}
+
+CDiffNode *CGrowthDlg::FindNodeByPoint(CPoint point)
+{
+    CRect rc = GetTreemapRect();
+    if(!rc.PtInRect(point) || m_zoom->TmiGetSize() == 0)
+    {
+        return NULL;
+    }
+
+    // The treemap has been drawn into a bitmap at (0, 0).
+    return (CDiffNode *)m_treemap.FindItemByPoint(m_zoom, point - rc.TopLeft());
+}
+
+void CGrowthDlg::Zoom(CDiffNode *node)
+{
+    CWaitCursor wc;
+
+    m_zoom = node;
+    m_diff->ExpandBelow(m_zoom, EXPANDNODES);
+
+    m_zoomText = FormatNode(m_zoom);
+    m_status.Empty();
+    UpdateData(false);
+
+    GetDlgItem(IDC_GROWTHZOOMOUT)->EnableWindow(m_zoom->GetParent() != NULL);
+    InvalidateRect(GetTreemapRect(), false);
+}
+
+void CGrowthDlg::OnPaint()
+{
+    CPaintDC dc(this);
+    m_treemap.DrawTreemapDoubleBuffered(&dc, GetTreemapRect(), m_zoom, GetOptions()->GetTreemapOptions());
+}
+
+void CGrowthDlg::OnMouseMove(UINT nFlags, CPoint point)
+{
+    CDiffNode *node = FindNodeByPoint(point);
+    CString status = (node != NULL ? FormatNode(node) : CString());
+    if(status != m_status)
+    {
+        m_status = status;
+        UpdateData(false);
+    }
+
+    CDialog::OnMouseMove(nFlags, point);
+}
+
+// Zooms into the child of the zoom node, which contains the point,
+// and selects the item below the point in the directory list.
+//
+void CGrowthDlg::OnLButtonDown(UINT nFlags, CPoint point)
+{
+    CDiffNode *node = FindNodeByPoint(point);
+    if(node != NULL)
+    {
+        GetDocument()->UpdateAllViews(NULL, HINT_EXTENDSELECTION, (CObject *)node->GetNewItem());
+
+        CDiffNode *child = node;
+        while(child != m_zoom && child->GetParent() != m_zoom)
+        {
+            child = child->GetParent();
+        }
+        if(child != m_zoom && !IsLeaf(child->GetNewItem()->GetType()))
+        {
+            Zoom(child);
+        }
+    }
+
+    CDialog::OnLButtonDown(nFlags, point);
+}
+
+void CGrowthDlg::OnBnClickedZoomout()
+{
+    if(m_zoom->GetParent() != NULL)
+    {
+        Zoom(m_zoom->GetParent());
+    }
+}
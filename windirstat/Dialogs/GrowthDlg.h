@@ -0,0 +1,74 @@
+// GrowthDlg.h - Declaration of CGrowthDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_GROWTHDLG_H__
+#define __WDS_GROWTHDLG_H__
+#pragma once
+
+#include "treemap.h"
+
+class CScanDiff;
+class CDiffNode;
+
+//
+// CGrowthDlg. Shows a CScanDiff as a treemap, in which the area of a
+// rectangle is the growth of the item since the older scan.
+// Clicking a rectangle zooms into the subtree (expanding the diff there)
+// and selects the item in the directory list. Like CTopFilesDlg, it is not
+// opened while the CDeleteQueue is busy, as the nodes point to the items.
+//
+class CGrowthDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CGrowthDlg)
+    enum { IDD = IDD_GROWTH };
+
+public:
+    CGrowthDlg(CScanDiff *diff, CWnd* pParent = NULL);
+    virtual ~CGrowthDlg();
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+
+    static CString FormatNode(const CDiffNode *node);
+
+    CRect GetTreemapRect();
+    CDiffNode *FindNodeByPoint(CPoint point);
+    void Zoom(CDiffNode *node);
+
+    CScanDiff *m_diff;
+    CDiffNode *m_zoom;
+    CTreemap m_treemap;
+    CString m_zoomText;
+    CString m_status;
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg void OnPaint();
+    afx_msg void OnMouseMove(UINT nFlags, CPoint point);
+    afx_msg void OnLButtonDown(UINT nFlags, CPoint point);
+    afx_msg void OnBnClickedZoomout();
+};
+
+#endif // __WDS_GROWTHDLG_H__
@@ -0,0 +1,81 @@
+// QueryDlg.cpp - Implementation of CQueryDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ItemQuery.h"
+#include "QueryDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+IMPLEMENT_DYNAMIC(CQueryDlg, CDialog)
+
+CQueryDlg::CQueryDlg(CWnd* pParent /*=NULL*/)
+    : CDialog(CQueryDlg::IDD, pParent)
+    , m_query(CPersistence::GetQuery())
+{
+}
+
+CQueryDlg::~CQueryDlg()
+{
+}
+
+void CQueryDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Text(pDX, IDC_QUERY, m_query);
+}
+
+BOOL CQueryDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    SetDlgItemText(IDC_QUERYSYNTAX, LoadString(IDS_QUERYSYNTAX));
+
+    return TRUE;
+}
+
+void CQueryDlg::OnOK()
+{
+    if(!UpdateData())
+    {
+        return;
+    }
+
+    CItemQuery query;
+    CString error;
+    if(!query.Compile(m_query, error))
+    {
+        AfxMessageBox(error);
+        GotoDlgCtrl(GetDlgItem(IDC_QUERY));
+        return;
+    }
+
+    CPersistence::SetQuery(m_query);
+
+    CDialog::OnOK();
+}
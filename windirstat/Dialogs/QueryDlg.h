@@ -0,0 +1,51 @@
+// QueryDlg.h - Declaration of CQueryDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_QUERYDLG_H__
+#define __WDS_QUERYDLG_H__
+#pragma once
+
+//
+// CQueryDlg. Asks for a query (see CItemQuery) and rejects it,
+// if it doesn't compile. The last query is persistent.
+//
+class CQueryDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CQueryDlg)
+    enum { IDD = IDD_QUERY };
+
+public:
+    CQueryDlg(CWnd* pParent = NULL);
+    virtual ~CQueryDlg();
+
+    CString m_query;    // [out]
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+    virtual void OnOK();
+};
+
+#endif // __WDS_QUERYDLG_H__
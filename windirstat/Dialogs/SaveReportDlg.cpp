@@ -0,0 +1,70 @@
+// SaveReportDlg.cpp - Implementation of CSaveReportDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "SaveReportDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+IMPLEMENT_DYNAMIC(CSaveReportDlg, CDialog)
+
+CSaveReportDlg::CSaveReportDlg(CWnd* pParent /*=NULL*/)
+    : CDialog(CSaveReportDlg::IDD, pParent)
+    , m_format(CPersistence::GetReportFormat())
+    , m_maxDepth(CPersistence::GetReportMaxDepth())
+    , m_minSizeKB(CPersistence::GetReportMinSize())
+{
+}
+
+CSaveReportDlg::~CSaveReportDlg()
+{
+}
+
+void CSaveReportDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Radio(pDX, IDC_REPORTCSV, m_format);
+    DDX_Text(pDX, IDC_REPORTDEPTH, m_maxDepth);
+    DDV_MinMaxInt(pDX, m_maxDepth, 0, 1000);
+    DDX_Text(pDX, IDC_REPORTMINSIZE, m_minSizeKB);
+    DDV_MinMaxInt(pDX, m_minSizeKB, 0, INT_MAX);
+}
+
+void CSaveReportDlg::OnOK()
+{
+    if(!UpdateData())
+    {
+        return;
+    }
+
+    CPersistence::SetReportFormat(m_format);
+    CPersistence::SetReportMaxDepth(m_maxDepth);
+    CPersistence::SetReportMinSize(m_minSizeKB);
+
+    CDialog::OnOK();
+}
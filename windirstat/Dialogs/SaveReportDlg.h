@@ -0,0 +1,52 @@
+// SaveReportDlg.h - Declaration of CSaveReportDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SAVEREPORTDLG_H__
+#define __WDS_SAVEREPORTDLG_H__
+#pragma once
+
+//
+// CSaveReportDlg. Asks for the format and the limits of a report
+// (see CReportWriter). The values are persistent.
+//
+class CSaveReportDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CSaveReportDlg)
+    enum { IDD = IDD_SAVEREPORT };
+
+public:
+    CSaveReportDlg(CWnd* pParent = NULL);
+    virtual ~CSaveReportDlg();
+
+    int m_format;       // [out] REPORTFORMAT
+    int m_maxDepth;     // [out] 0 = all levels
+    int m_minSizeKB;    // [out] Items smaller than this are omitted
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual void OnOK();
+};
+
+#endif // __WDS_SAVEREPORTDLG_H__
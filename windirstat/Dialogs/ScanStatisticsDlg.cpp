@@ -0,0 +1,125 @@
+// ScanStatisticsDlg.cpp - Implementation of CScanStatisticsDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ScanStatistics.h"
+#include "ScanStatisticsDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const UINT TIMER_ID = 4711;
+    const UINT TIMER_INTERVAL = 1000; // ms
+}
+
+CScanStatisticsDlg *CScanStatisticsDlg::_instance = NULL;
+
+IMPLEMENT_DYNAMIC(CScanStatisticsDlg, CDialog)
+
+// Creates the dialog or brings the existing one to the top.
+//
+void CScanStatisticsDlg::Show(CWnd *parent)
+{
+    if(_instance == NULL)
+    {
+        _instance = new CScanStatisticsDlg;
+        if(!_instance->Create(IDD, parent))
+        {
+            delete _instance;
+            _instance = NULL;
+            return;
+        }
+    }
+
+    _instance->ShowWindow(SW_SHOWNORMAL);
+    _instance->BringWindowToTop();
+}
+
+CScanStatisticsDlg::CScanStatisticsDlg()
+    : CDialog()
+{
+}
+
+CScanStatisticsDlg::~CScanStatisticsDlg()
+{
+}
+
+BEGIN_MESSAGE_MAP(CScanStatisticsDlg, CDialog)
+    ON_WM_TIMER()
+    ON_WM_DESTROY()
+END_MESSAGE_MAP()
+
+BOOL CScanStatisticsDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    UpdateReport();
+    SetTimer(TIMER_ID, TIMER_INTERVAL, NULL);
+
+    return TRUE;
+}
+
+// Modeless: Escape, the close box and the Close button must not call EndDialog().
+//
+void CScanStatisticsDlg::OnCancel()
+{
+    DestroyWindow();
+}
+
+void CScanStatisticsDlg::PostNcDestroy()
+{
+    ASSERT(_instance == this);
+    _instance = NULL;
+    delete this;
+}
+
+void CScanStatisticsDlg::OnTimer(UINT_PTR /*nIDEvent*/)
+{
+    UpdateReport();
+}
+
+void CScanStatisticsDlg::OnDestroy()
+{
+    KillTimer(TIMER_ID);
+    CDialog::OnDestroy();
+}
+
+void CScanStatisticsDlg::UpdateReport()
+{
+    CString report = CScanStatistics::GetReport();
+
+    CString old;
+    GetDlgItemText(IDC_STATISTICS, old);
+
+    // Avoid flicker and keep the selection, if nothing has changed.
+    if(report != old)
+    {
+        SetDlgItemText(IDC_STATISTICS, report);
+    }
+}
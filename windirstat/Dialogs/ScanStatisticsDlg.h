@@ -0,0 +1,60 @@
+// ScanStatisticsDlg.h - Declaration of CScanStatisticsDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SCANSTATISTICSDLG_H__
+#define __WDS_SCANSTATISTICSDLG_H__
+#pragma once
+
+//
+// CScanStatisticsDlg. Modeless dialog showing CScanStatistics::GetReport().
+// The text is updated every second, so that it can be watched while
+// a scan is running. There is at most one instance, which deletes itself.
+//
+class CScanStatisticsDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CScanStatisticsDlg)
+    enum { IDD = IDD_SCANSTATISTICS };
+
+public:
+    static void Show(CWnd *parent);
+
+protected:
+    static CScanStatisticsDlg *_instance;
+
+    CScanStatisticsDlg();
+    virtual ~CScanStatisticsDlg();
+
+    virtual BOOL OnInitDialog();
+    virtual void OnCancel();
+    virtual void PostNcDestroy();
+
+    void UpdateReport();
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg void OnTimer(UINT_PTR nIDEvent);
+    afx_msg void OnDestroy();
+};
+
+#endif // __WDS_SCANSTATISTICSDLG_H__
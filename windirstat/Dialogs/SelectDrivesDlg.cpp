@@ -24,6 +24,7 @@
 
 #include "stdafx.h"
 #include "windirstat.h"
+#include "VolumeInfoCache.h"
 #include "SelectDrivesDlg.h"
 
 #ifdef _DEBUG
@@ -44,30 +45,9 @@ namespace
 
     const UINT WMU_OK = WM_USER + 100;
 
-    static UINT WMU_THREADFINISHED = ::RegisterWindowMessage(_T("{F03D3293-86E0-4c87-B559-5FD103F5AF58}"));
-
-    // Return: false, if drive not accessible
-    bool RetrieveDriveInformation(LPCTSTR path, CString& name, ULONGLONG& total, ULONGLONG& free)
-    {
-        CString volumeName;
-
-        if(!GetVolumeName(path, volumeName))
-        {
-            return false;
-        }
-
-        name = FormatVolumeName(path, volumeName);
-
-        if(!CDirstatApp::getDiskFreeSpace(path, total, free))
-        {
-            return false;
-        }
-
-        // This condition *can* become true if quotas exist!
-        //ASSERT(free <= total);
-
-        return true;
-    }
+    // Timeouts of the CVolumeInfoCache are only detected when we ask it.
+    const UINT TIMER_ID = 4711;
+    const UINT TIMER_INTERVAL = 1000; // ms
 }
 
 
@@ -85,34 +65,23 @@ CDriveItem::CDriveItem(CDrivesList *list, LPCTSTR pszPath)
     , m_isRemote(DRIVE_REMOTE == ::GetDriveType(m_path))
     , m_querying(true)
 {
-
-    /*
-    For local drives we could do this synchronously:
-        if(!m_isRemote)
-        {
-            m_querying = false;
-
-            CString name = m_name;
-            ULONGLONG total = 0;
-            ULONGLONG free = 0;
-
-            bool success = RetrieveDriveInformation(m_path, name, total, free);
-            SetDriveInformation(success, name, total, free);
-        }
-    */
 }
 
-void CDriveItem::StartQuery(HWND dialog, UINT serial)
+// Takes the information from the CVolumeInfoCache. If it is not available
+// (or outdated), the cache queries the drive in the background and
+// posts WMU_VOLUMEINFO to the dialog.
+// Return: false, if there is no information yet.
+//
+bool CDriveItem::UpdateFromCache()
 {
-    ASSERT(dialog != NULL);
-
-    ASSERT(m_querying); // The synchronous query in the constructor is commented out.
-
-    if(m_querying)
+    VOLUMEINFO info;
+    if(!CVolumeInfoCache::Lookup(m_path, info))
     {
-        new CDriveInformationThread(m_path, (LPARAM)this, dialog, serial);
-        // (will delete itself when finished.)
+        return false;
     }
+
+    SetDriveInformation(info.success, FormatVolumeName(m_path, info.volumeName), info.total, info.free);
+    return true;
 }
 
 void CDriveItem::SetDriveInformation(bool success, LPCTSTR name, ULONGLONG total, ULONGLONG free)
@@ -292,117 +261,6 @@ CString CDriveItem::GetDrive() const
 }
 
 
-/////////////////////////////////////////////////////////////////////////////
-
-CSet<CDriveInformationThread *, CDriveInformationThread *> CDriveInformationThread::_runningThreads;
-CCriticalSection CDriveInformationThread::_csRunningThreads;
-
-void CDriveInformationThread::AddRunningThread()
-{
-    CSingleLock lock(&_csRunningThreads, true);
-    _runningThreads.SetKey(this);
-}
-
-void CDriveInformationThread::RemoveRunningThread()
-{
-    CSingleLock lock(&_csRunningThreads, true);
-    _runningThreads.RemoveKey(this);
-}
-
-
-// This static method is called by the dialog when the dialog gets closed.
-// We set the m_dialog members of all running threads to null, so that
-// they don't send messages around to a no-more-existing window.
-//
-void CDriveInformationThread::InvalidateDialogHandle()
-{
-    CSingleLock lock(&_csRunningThreads, true);
-
-    POSITION pos = _runningThreads.GetStartPosition();
-    while(pos != NULL)
-    {
-        CDriveInformationThread *thread;
-        _runningThreads.GetNextAssoc(pos, thread);
-
-        CSingleLock lockObj(&thread->m_cs, true);
-        thread->m_dialog = NULL;
-    }
-}
-
-void CDriveInformationThread::OnAppExit()
-{
-    // We need not do anything here.
-}
-
-// The constructor starts the thread.
-//
-CDriveInformationThread::CDriveInformationThread(LPCTSTR path, LPARAM driveItem, HWND dialog, UINT serial)
-    : m_path(path)
-    , m_driveItem(driveItem)
-    , m_serial(serial)
-    , m_dialog(dialog)
-    , m_totalBytes(0)
-    , m_freeBytes(0)
-    , m_success(false)
-{
-    ASSERT(m_bAutoDelete);
-
-    AddRunningThread();
-
-    VERIFY(CreateThread());
-}
-
-BOOL CDriveInformationThread::InitInstance()
-{
-    m_success = RetrieveDriveInformation(m_path, m_name, m_totalBytes, m_freeBytes);
-
-#ifdef TESTTHREADS
-    srand(::GetTickCount());
-    ::Sleep((rand() & 0x07) * 1000);
-#endif
-
-    HWND dialog = NULL;
-
-    {
-        CSingleLock lock(&m_cs, true);
-        dialog = m_dialog;
-        // Of course, we must release m_cs here to avoid deadlocks.
-    }
-
-    if(dialog != NULL)
-    {
-        // Theoretically the dialog may have been closed at this point.
-        // SendMessage() to a non-existing window simply fails immediately.
-        // If in the meantime the system recycled the window handle,
-        // (it may even belong to another process now?!),
-        // we are safe, because WMU_THREADFINISHED is a unique registered message.
-        // (Well if the other process crashes because of our message, there is nothing we can do about it.)
-        // If the window handle is recycled by a new Select drives dialog,
-        // its new serial will prevent it from reacting.
-        ::SendMessage(dialog, WMU_THREADFINISHED, m_serial, (LPARAM)this);
-    }
-
-    RemoveRunningThread();
-
-    ASSERT(m_bAutoDelete); // Object will delete itself.
-    return false; // no Run(), please!
-}
-
-// This method is only called by the gui thread, while we hang
-// in SendMessage(dialog, WMU_THREADFINISHED, 0, this).
-// So we need no synchronization.
-//
-LPARAM CDriveInformationThread::GetDriveInformation(bool& success, CString& name, ULONGLONG& total, ULONGLONG& free)
-{
-    name = m_name;
-    total = m_totalBytes;
-    free = m_freeBytes;
-    success = m_success;
-
-    return m_driveItem;
-}
-
-
 /////////////////////////////////////////////////////////////////////////////
 
 IMPLEMENT_DYNAMIC(CDrivesList, COwnerDrawnListControl)
@@ -503,13 +361,11 @@ void CDrivesList::MeasureItem(LPMEASUREITEMSTRUCT mis)
 
 IMPLEMENT_DYNAMIC(CSelectDrivesDlg, CDialog)
 
-UINT CSelectDrivesDlg::_serial;
-
 CSelectDrivesDlg::CSelectDrivesDlg(CWnd* pParent /*=NULL*/)
     : CDialog(CSelectDrivesDlg::IDD, pParent)
     , m_layout(this, _T("sddlg"))
+    , m_previousNotifyWindow(NULL)
 {
-    _serial++;
 }
 
 CSelectDrivesDlg::~CSelectDrivesDlg()
@@ -538,7 +394,8 @@ BEGIN_MESSAGE_MAP(CSelectDrivesDlg, CDialog)
     ON_WM_GETMINMAXINFO()
     ON_WM_DESTROY()
     ON_MESSAGE(WMU_OK, OnWmuOk)
-    ON_REGISTERED_MESSAGE(WMU_THREADFINISHED, OnWmuThreadFinished)
+    ON_REGISTERED_MESSAGE(WMU_VOLUMEINFO, OnWmuVolumeInfo)
+    ON_WM_TIMER()
     ON_WM_SYSCOLORCHANGE()
 END_MESSAGE_MAP()
 
@@ -549,11 +406,7 @@ BOOL CSelectDrivesDlg::OnInitDialog()
 
     CDialog::OnInitDialog();
 
-    if(WMU_THREADFINISHED == 0)
-    {
-        VTRACE(_T("RegisterMessage() failed. Using WM_USER + 123"));
-        WMU_THREADFINISHED = WM_USER + 123;
-    }
+    m_previousNotifyWindow = CVolumeInfoCache::SetNotifyWindow(m_hWnd);
 
     ModifyStyle(0, WS_CLIPCHILDREN);
 
@@ -608,7 +461,7 @@ BOOL CSelectDrivesDlg::OnInitDialog()
             continue;
         }
 
-        // The check of remote drives will be done in the background by the CDriveInformationThread.
+        // The check of remote drives will be done in the background by the CVolumeInfoCache.
         if(type != DRIVE_REMOTE && !DriveExists(s))
         {
             continue;
@@ -616,7 +469,7 @@ BOOL CSelectDrivesDlg::OnInitDialog()
 
         CDriveItem *item = new CDriveItem(&m_list, s);
         m_list.InsertListItem(m_list.GetItemCount(), item);
-        item->StartQuery(m_hWnd, _serial);
+        item->UpdateFromCache();
 
         for(int k = 0; k < m_selectedDrives.GetSize(); k++)
         {
@@ -630,6 +483,8 @@ BOOL CSelectDrivesDlg::OnInitDialog()
 
     m_list.SortItems();
 
+    SetTimer(TIMER_ID, TIMER_INTERVAL, NULL);
+
     m_radio = CPersistence::GetSelectDrivesRadio();
     UpdateData(false);
 
@@ -833,7 +688,8 @@ void CSelectDrivesDlg::OnGetMinMaxInfo(MINMAXINFO* mmi)
 
 void CSelectDrivesDlg::OnDestroy()
 {
-    CDriveInformationThread::InvalidateDialogHandle();
+    KillTimer(TIMER_ID);
+    CVolumeInfoCache::SetNotifyWindow(m_previousNotifyWindow);
 
     m_layout.OnDestroy();
     CDialog::OnDestroy();
@@ -845,48 +701,36 @@ LRESULT CSelectDrivesDlg::OnWmuOk(WPARAM, LPARAM)
     return 0;
 }
 
-// This message is _sent_ by a CDriveInformationThread.
+// This message is posted by the CVolumeInfoCache.
 //
-LRESULT CSelectDrivesDlg::OnWmuThreadFinished(WPARAM serial, LPARAM lparam)
+LRESULT CSelectDrivesDlg::OnWmuVolumeInfo(WPARAM serial, LPARAM)
 {
-    if(serial != _serial)
+    if(serial != CVolumeInfoCache::GetSerial())
     {
-        VTRACE(_T("OnWmuThreadFinished: invalid serial (window handle recycled?)"));
+        VTRACE(_T("OnWmuVolumeInfo: invalid serial (window handle recycled?)"));
         return 0;
     }
 
-    CDriveInformationThread *thread = (CDriveInformationThread *)lparam;
-
-    bool success;
-    CString name;
-    ULONGLONG total;
-    ULONGLONG free;
-
-    LPARAM driveItem = thread->GetDriveInformation(success, name, total, free);
+    UpdateDriveInformation();
+    return 0;
+}
 
-    // For paranoia's sake we check, whether driveItem is in our list.
-    // (and we so find its index.)
-    LVFINDINFO fi;
-    ZeroMemory(&fi, sizeof(fi));
-    fi.flags = LVFI_PARAM;
-    fi.lParam = driveItem;
+void CSelectDrivesDlg::OnTimer(UINT_PTR /*nIDEvent*/)
+{
+    UpdateDriveInformation();
+}
 
-    int i = m_list.FindItem(&fi);
-    if(i == -1)
+void CSelectDrivesDlg::UpdateDriveInformation()
+{
+    for(int i = 0; i < m_list.GetItemCount(); i++)
     {
-        VTRACE(_T("OnWmuThreadFinished: item not found!"));
-        return 0;
+        if(m_list.GetItem(i)->UpdateFromCache())
+        {
+            m_list.RedrawItems(i, i);
+        }
     }
 
-    CDriveItem *item = (CDriveItem *)driveItem;
-
-    item->SetDriveInformation(success, name, total, free);
-
-    m_list.RedrawItems(i, i);
-
     m_list.SortItems();
-
-    return 0;
 }
 
 void CSelectDrivesDlg::OnSysColorChange()
@@ -50,7 +50,7 @@ class CDriveItem: public COwnerDrawnListItem
 {
 public:
     CDriveItem(CDrivesList *list, LPCTSTR pszPath);
-    void StartQuery(HWND dialog, UINT serial);
+    bool UpdateFromCache();
 
     void SetDriveInformation(bool success, LPCTSTR name, ULONGLONG total, ULONGLONG free);
 
@@ -69,7 +69,7 @@ private:
     CString m_path;         // e.g. "C:\"
     bool m_isRemote;        // Whether the drive type is DRIVE_REMOTE (network drive)
 
-    bool m_querying;        // Information thread is running.
+    bool m_querying;        // No information from the CVolumeInfoCache yet.
     bool m_success;         // Drive is accessible. false while m_querying is true.
 
     CString m_name;         // e.g. "BOOT (C:)"
@@ -79,45 +79,6 @@ private:
     double m_used;          // used space / total space
 };
 
-//
-// CDriveInformationThread. Does the GetVolumeInformation() call, which
-// may hang for ca. 30 sec, it a network drive is not accessible.
-//
-class CDriveInformationThread: public CWinThread
-{
-    // Set of all running CDriveInformationThreads.
-    // Used by InvalidateDialogHandle().
-    static CSet<CDriveInformationThread *, CDriveInformationThread *> _runningThreads;
-    static CCriticalSection _csRunningThreads;
-
-    // The objects register and unregister themselves in _runningThreads
-    void AddRunningThread();
-    void RemoveRunningThread();
-
-public:
-    static void InvalidateDialogHandle();
-    static void OnAppExit();
-
-    CDriveInformationThread(LPCTSTR path, LPARAM driveItem, HWND dialog, UINT serial);
-    virtual BOOL InitInstance();
-
-    LPARAM GetDriveInformation(bool& success, CString& name, ULONGLONG& total, ULONGLONG& free);
-
-private:
-    const CString m_path;       // Path like "C:\"
-    const LPARAM m_driveItem;   // The list item, we belong to
-
-    CCriticalSection m_cs;  // for m_dialog
-    HWND m_dialog;          // synchronized by m_cs
-    const UINT m_serial;    // serial number of m_dialog
-
-    // "[out]"-parameters
-    CString m_name;         // Result: name like "BOOT (C:)", valid if m_success
-    ULONGLONG m_totalBytes; // Result: capacity of the drive, valid if m_success
-    ULONGLONG m_freeBytes;  // Result: free space on the drive, valid if m_success
-    bool m_success;         // Result: false, iff drive is unaccessible.
-};
-
 //
 // CDrivesList.
 //
@@ -165,12 +126,13 @@ protected:
     virtual void OnOK();
 
     void UpdateButtons();
+    void UpdateDriveInformation();
 
-    static UINT _serial;    // Each Instance of this dialog gets a serial number
     CDrivesList m_list;
     CButton m_okButton;
     CStringArray m_selectedDrives;
     CLayout m_layout;
+    HWND m_previousNotifyWindow;    // Receiver of WMU_VOLUMEINFO before we took over (the main frame)
     // Callback function for the dialog shown by SHBrowseForFolder()
     // MUST be static!
     static int CALLBACK BrowseCallbackProc(HWND hWnd, UINT uMsg, LPARAM lParam, LPARAM lpData);
@@ -188,7 +150,8 @@ protected:
     afx_msg void OnGetMinMaxInfo(MINMAXINFO* lpMMI);
     afx_msg void OnDestroy();
     afx_msg LRESULT OnWmuOk(WPARAM, LPARAM);
-    afx_msg LRESULT OnWmuThreadFinished(WPARAM, LPARAM lparam);
+    afx_msg LRESULT OnWmuVolumeInfo(WPARAM serial, LPARAM);
+    afx_msg void OnTimer(UINT_PTR nIDEvent);
     afx_msg void OnSysColorChange();
 };
 
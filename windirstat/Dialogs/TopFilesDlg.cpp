@@ -0,0 +1,137 @@
+// TopFilesDlg.cpp - Implementation of CTopFilesDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "dirstatdoc.h"
+#include "TopFiles.h"
+#include "TopFilesDlg.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const int FILECOUNT = 1000; // Number of files listed
+
+    enum
+    {
+        COL_NAME,
+        COL_SIZE,
+        COL_LASTCHANGE,
+        COL_FOLDER
+    };
+}
+
+IMPLEMENT_DYNAMIC(CTopFilesDlg, CDialog)
+
+CTopFilesDlg::CTopFilesDlg(const CItem *root, CWnd* pParent /*=NULL*/)
+    : CDialog(CTopFilesDlg::IDD, pParent)
+    , m_root(root)
+    , m_order(CPersistence::GetTopFilesOrder())
+{
+}
+
+CTopFilesDlg::~CTopFilesDlg()
+{
+}
+
+void CTopFilesDlg::DoDataExchange(CDataExchange* pDX)
+{
+    CDialog::DoDataExchange(pDX);
+    DDX_Control(pDX, IDC_TOPFILESORDER, m_orderCombo);
+    DDX_Control(pDX, IDC_TOPFILES, m_list);
+}
+
+BEGIN_MESSAGE_MAP(CTopFilesDlg, CDialog)
+    ON_CBN_SELENDOK(IDC_TOPFILESORDER, OnCbnSelendokOrder)
+    ON_NOTIFY(LVN_ITEMCHANGED, IDC_TOPFILES, OnLvnItemchangedList)
+END_MESSAGE_MAP()
+
+BOOL CTopFilesDlg::OnInitDialog()
+{
+    CDialog::OnInitDialog();
+
+    m_orderCombo.AddString(LoadString(IDS_TOPFILES_LARGEST));
+    m_orderCombo.AddString(LoadString(IDS_TOPFILES_NEWEST));
+    m_orderCombo.AddString(LoadString(IDS_TOPFILES_OLDEST));
+    m_orderCombo.SetCurSel(m_order);
+
+    m_list.SetExtendedStyle(m_list.GetExtendedStyle() | LVS_EX_FULLROWSELECT);
+    m_list.InsertColumn(COL_NAME,       LoadString(IDS_TREECOL_NAME),       LVCFMT_LEFT, 150, COL_NAME);
+    m_list.InsertColumn(COL_SIZE,       LoadString(IDS_TREECOL_SIZE),       LVCFMT_RIGHT, 70, COL_SIZE);
+    m_list.InsertColumn(COL_LASTCHANGE, LoadString(IDS_TREECOL_LASTCHANGE), LVCFMT_LEFT, 110, COL_LASTCHANGE);
+    m_list.InsertColumn(COL_FOLDER,     LoadString(IDS_TOPFILESCOL_FOLDER), LVCFMT_LEFT, 250, COL_FOLDER);
+
+    UpdateList();
+
+    return TRUE;
+}
+
+void CTopFilesDlg::UpdateList()
+{
+    CWaitCursor wc;
+
+    CArray<const CItem *, const CItem *> files;
+    CTopFiles::Find(m_root, (TOPFILESORDER)m_order, FILECOUNT, files);
+
+    m_list.SetRedraw(false);
+    m_list.DeleteAllItems();
+    for(int i = 0; i < files.GetSize(); i++)
+    {
+        const CItem *file = files[i];
+
+        int item = m_list.InsertItem(i, file->GetName());
+        m_list.SetItemText(item, COL_SIZE, FormatBytes(file->GetSize()));
+        m_list.SetItemText(item, COL_LASTCHANGE, FormatFileTime(file->GetLastChange()));
+        m_list.SetItemText(item, COL_FOLDER, file->GetFolderPath());
+        m_list.SetItemData(item, (DWORD_PTR)file);
+    }
+    m_list.SetRedraw(true);
+}
+
+void CTopFilesDlg::OnCbnSelendokOrder()
+{
+    m_order = m_orderCombo.GetCurSel();
+    CPersistence::SetTopFilesOrder(m_order);
+    UpdateList();
+}
+
+void CTopFilesDlg::OnLvnItemchangedList(NMHDR *pNMHDR, LRESULT *pResult)
+{
+    LPNMLISTVIEW pNMLV = reinterpret_cast<LPNMLISTVIEW>(pNMHDR);
+    *pResult = 0;
+
+    if((pNMLV->uChanged & LVIF_STATE) == 0 || (pNMLV->uNewState & LVIS_SELECTED) == 0)
+    {
+        return;
+    }
+
+    // Like a click into the treemap
+    CItem *file = (CItem *)m_list.GetItemData(pNMLV->iItem);
+    GetDocument()->UpdateAllViews(NULL, HINT_EXTENDSELECTION, (CObject *)file);
+}
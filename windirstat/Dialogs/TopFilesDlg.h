@@ -0,0 +1,64 @@
+// TopFilesDlg.h - Declaration of CTopFilesDlg
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_TOPFILESDLG_H__
+#define __WDS_TOPFILESDLG_H__
+#pragma once
+
+class CItem;
+
+//
+// CTopFilesDlg. Lists the largest, newest or oldest files of the tree
+// (see CTopFiles). Clicking a file selects it in the directory list.
+// The list holds pointers to the items. The dialog is modal, and it is
+// not opened while the CDeleteQueue is busy (see
+// CDirstatDoc::OnUpdateEditTopfiles()), so the tree cannot change meanwhile.
+//
+class CTopFilesDlg : public CDialog
+{
+    DECLARE_DYNAMIC(CTopFilesDlg)
+    enum { IDD = IDD_TOPFILES };
+
+public:
+    CTopFilesDlg(const CItem *root, CWnd* pParent = NULL);
+    virtual ~CTopFilesDlg();
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+
+    void UpdateList();
+
+    const CItem *m_root;
+    int m_order;            // TOPFILESORDER
+    CComboBox m_orderCombo;
+    CListCtrl m_list;
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg void OnCbnSelendokOrder();
+    afx_msg void OnLvnItemchangedList(NMHDR *pNMHDR, LRESULT *pResult);
+};
+
+#endif // __WDS_TOPFILESDLG_H__
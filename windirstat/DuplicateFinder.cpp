@@ -0,0 +1,713 @@
+// DuplicateFinder.cpp - Implementation of CDuplicateFinder and CHashThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include <winioctl.h>
+#include "windirstat.h"
+#include "item.h"
+#include "EventTrace.h"
+#include "XxHash.h"
+#include "HashCache.h"
+#include "DuplicateFinder.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const DWORD PARTIALHASHBYTES = 64 * 1024;
+    const DWORD READBUFFERSIZE = 1024 * 1024;
+
+    // signum(a - b) doesn't work for unsigned types.
+    template<class T> int compare(T a, T b)
+    {
+        return a < b ? -1 : a == b ? 0 : 1;
+    }
+}
+
+CDuplicateFinder::CDuplicateFinder(CFileHashMap& hashes, CHashCache *cache)
+    : m_hashes(hashes)
+    , m_cache(cache)
+    , m_stage(DS_DONE)
+    , m_canceled(false)
+    , m_filesDone(0)
+    , m_filesTotal(0)
+    , m_bytesDone(0)
+    , m_bytesTotal(0)
+{
+}
+
+CDuplicateFinder::~CDuplicateFinder()
+{
+    Cancel();
+    DeleteThreads();
+}
+
+// Collects the files of equal size below root and starts stage 2.
+//
+void CDuplicateFinder::Start(const CItem *root)
+{
+    ASSERT(m_threads.GetSize() == 0);
+
+    CArray<const CItem *, const CItem *> files;
+    RecurseCollectFiles(root, files);
+    qsort(files.GetData(), files.GetSize(), sizeof(const CItem *), &_compareItemsBySize);
+
+    for(int i = 0; i < files.GetSize(); )
+    {
+        int j = i + 1;
+        while(j < files.GetSize() && files[j]->GetSize() == files[i]->GetSize())
+        {
+            j++;
+        }
+
+        for(int k = i; j - i >= 2 && k < j; k++)
+        {
+            CANDIDATE c;
+            c.path = files[k]->GetPath();
+            c.size = files[k]->GetSize();
+            c.lastChange = files[k]->GetLastChange();
+            c.volume = GetVolumeIndex(c.path);
+            c.firstCluster = -1;
+            c.partialHash = 0;
+            c.fullHash = 0;
+            c.hasPartialHash = false;
+            c.hasFullHash = false;
+            c.failed = false;
+
+            CString key = c.path;
+            key.MakeLower();
+
+            FILEHASH fh;
+            if(m_hashes.Lookup(key, fh) && fh.size == c.size && fh.lastChange == c.lastChange)
+            {
+                c.partialHash = fh.partialHash;
+                c.hasPartialHash = true;
+                c.fullHash = fh.fullHash;
+                c.hasFullHash = fh.hasFullHash;
+            }
+
+            m_candidates.Add(c);
+        }
+        i = j;
+    }
+
+    StartStage(DS_PARTIALHASH);
+}
+
+// Called periodically by the GUI thread. Starts the next stage,
+// when the threads of the current one have finished.
+// Return: true, if the search is done (or has been canceled).
+//
+bool CDuplicateFinder::Poll()
+{
+    if(m_stage == DS_DONE)
+    {
+        return true;
+    }
+
+    if(AreThreadsRunning())
+    {
+        return false;
+    }
+    DeleteThreads();
+
+    if(m_canceled)
+    {
+        m_stage = DS_DONE;
+        return true;
+    }
+
+    StoreHashes();
+
+    if(m_stage == DS_PARTIALHASH)
+    {
+        StartStage(DS_FULLHASH);
+        return false;
+    }
+
+    BuildGroups();
+    m_stage = DS_DONE;
+    return true;
+}
+
+// The threads stop after the current file.
+//
+void CDuplicateFinder::Cancel()
+{
+    m_canceled = true;
+}
+
+bool CDuplicateFinder::IsCanceled() const
+{
+    return m_canceled;
+}
+
+CDuplicateFinder::STAGE CDuplicateFinder::GetStage() const
+{
+    return m_stage;
+}
+
+// Progress of the current stage
+//
+void CDuplicateFinder::GetProgress(int& filesDone, int& filesTotal, ULONGLONG& bytesDone, ULONGLONG& bytesTotal)
+{
+    CSingleLock lock(&m_cs, true);
+    filesDone = m_filesDone;
+    filesTotal = m_filesTotal;
+    bytesDone = m_bytesDone;
+    bytesTotal = m_bytesTotal;
+}
+
+int CDuplicateFinder::GetGroupCount() const
+{
+    return (int)m_groups.GetSize();
+}
+
+// The groups are sorted by reclaimable bytes, descending.
+//
+const DUPLICATEGROUP& CDuplicateFinder::GetGroup(int i) const
+{
+    return m_groups[i];
+}
+
+CString CDuplicateFinder::GetPath(int i) const
+{
+    return m_paths[i];
+}
+
+// Bytes which would be freed, if only one file of each group remained.
+//
+ULONGLONG CDuplicateFinder::GetReclaimableBytes() const
+{
+    ULONGLONG bytes = 0;
+    for(int i = 0; i < m_groups.GetSize(); i++)
+    {
+        bytes += m_groups[i].size * (m_groups[i].pathCount - 1);
+    }
+    return bytes;
+}
+
+int __cdecl CDuplicateFinder::_compareItemsBySize(const void *p1, const void *p2)
+{
+    const CItem *item1 = *(const CItem **)p1;
+    const CItem *item2 = *(const CItem **)p2;
+    return compare(item1->GetSize(), item2->GetSize());
+}
+
+int __cdecl CDuplicateFinder::_compareByPartialHash(const void *p1, const void *p2)
+{
+    const CANDIDATE *c1 = *(const CANDIDATE **)p1;
+    const CANDIDATE *c2 = *(const CANDIDATE **)p2;
+    int r = compare(c1->size, c2->size);
+    if(r == 0)
+    {
+        r = compare(c1->partialHash, c2->partialHash);
+    }
+    return r;
+}
+
+int __cdecl CDuplicateFinder::_compareByFullHash(const void *p1, const void *p2)
+{
+    const CANDIDATE *c1 = *(const CANDIDATE **)p1;
+    const CANDIDATE *c2 = *(const CANDIDATE **)p2;
+    int r = compare(c1->size, c2->size);
+    if(r == 0)
+    {
+        r = compare(c1->fullHash, c2->fullHash);
+    }
+    if(r == 0)
+    {
+        r = c1->path.CompareNoCase(c2->path);
+    }
+    return r;
+}
+
+// Files of a folder are usually close together on the disk.
+//
+int __cdecl CDuplicateFinder::_compareByPath(const void *p1, const void *p2)
+{
+    const CANDIDATE *c1 = *(const CANDIDATE **)p1;
+    const CANDIDATE *c2 = *(const CANDIDATE **)p2;
+    int r = compare(c1->volume, c2->volume);
+    if(r == 0)
+    {
+        r = c1->path.CompareNoCase(c2->path);
+    }
+    return r;
+}
+
+int __cdecl CDuplicateFinder::_compareByCluster(const void *p1, const void *p2)
+{
+    const CANDIDATE *c1 = *(const CANDIDATE **)p1;
+    const CANDIDATE *c2 = *(const CANDIDATE **)p2;
+    int r = compare(c1->volume, c2->volume);
+    if(r == 0)
+    {
+        r = compare(c1->firstCluster, c2->firstCluster);
+    }
+    return r;
+}
+
+int __cdecl CDuplicateFinder::_compareGroups(const void *p1, const void *p2)
+{
+    const DUPLICATEGROUP *g1 = (const DUPLICATEGROUP *)p1;
+    const DUPLICATEGROUP *g2 = (const DUPLICATEGROUP *)p2;
+    return compare(g2->size * (g2->pathCount - 1), g1->size * (g1->pathCount - 1));
+}
+
+// Empty files are all equal, they are not worth a report.
+//
+void CDuplicateFinder::RecurseCollectFiles(const CItem *item, CArray<const CItem *, const CItem *>& files)
+{
+    for(int i = 0; i < item->GetChildrenCount(); i++)
+    {
+        const CItem *child = item->GetChild(i);
+        if(child->GetType() == IT_FILE)
+        {
+            if(child->GetSize() > 0)
+            {
+                files.Add(child);
+            }
+        }
+        else if(!IsLeaf(child->GetType()))
+        {
+            RecurseCollectFiles(child, files);
+        }
+    }
+}
+
+// The volume is approximated by the drive or the UNC share of the path.
+//
+int CDuplicateFinder::GetVolumeIndex(const CString& path)
+{
+    CString volume;
+    if(path.Left(2) == _T("\\\\"))
+    {
+        int i = path.Find(wds::chrBackslash, 2);
+        i = (i == -1 ? -1 : path.Find(wds::chrBackslash, i + 1));
+        volume = (i == -1 ? path : path.Left(i));
+    }
+    else
+    {
+        volume = path.Left(2);
+    }
+    volume.MakeLower();
+
+    for(int i = 0; i < m_volumes.GetSize(); i++)
+    {
+        if(m_volumes[i] == volume)
+        {
+            return i;
+        }
+    }
+    return (int)m_volumes.Add(volume);
+}
+
+void CDuplicateFinder::StartStage(STAGE stage)
+{
+    m_stage = stage;
+
+    CArray<CANDIDATE *, CANDIDATE *> jobs;
+    if(stage == DS_PARTIALHASH)
+    {
+        for(int i = 0; i < m_candidates.GetSize(); i++)
+        {
+            if(!m_candidates[i].hasPartialHash)
+            {
+                jobs.Add(&m_candidates[i]);
+            }
+        }
+        qsort(jobs.GetData(), jobs.GetSize(), sizeof(CANDIDATE *), &_compareByPath);
+    }
+    else
+    {
+        ASSERT(stage == DS_FULLHASH);
+
+        CArray<CANDIDATE *, CANDIDATE *> sorted;
+        for(int i = 0; i < m_candidates.GetSize(); i++)
+        {
+            if(!m_candidates[i].failed)
+            {
+                sorted.Add(&m_candidates[i]);
+            }
+        }
+        qsort(sorted.GetData(), sorted.GetSize(), sizeof(CANDIDATE *), &_compareByPartialHash);
+
+        for(int i = 0; i < sorted.GetSize(); )
+        {
+            int j = i + 1;
+            while(j < sorted.GetSize() && _compareByPartialHash(&sorted[i], &sorted[j]) == 0)
+            {
+                j++;
+            }
+            for(int k = i; j - i >= 2 && k < j; k++)
+            {
+                if(!sorted[k]->hasFullHash)
+                {
+                    jobs.Add(sorted[k]);
+                }
+            }
+            i = j;
+        }
+        qsort(jobs.GetData(), jobs.GetSize(), sizeof(CANDIDATE *), &_compareByCluster);
+    }
+
+    StartThreads(jobs, stage == DS_FULLHASH);
+}
+
+// Starts one thread per volume. jobs are sorted by volume.
+//
+void CDuplicateFinder::StartThreads(CArray<CANDIDATE *, CANDIDATE *>& jobs, bool fullHash)
+{
+    {
+        CSingleLock lock(&m_cs, true);
+        m_filesDone = 0;
+        m_filesTotal = (int)jobs.GetSize();
+        m_bytesDone = 0;
+        m_bytesTotal = 0;
+        for(int i = 0; i < jobs.GetSize(); i++)
+        {
+            m_bytesTotal += (fullHash ? jobs[i]->size : min(jobs[i]->size, 2 * PARTIALHASHBYTES));
+        }
+    }
+
+    CHashThread *thread = NULL;
+    for(int i = 0; i < jobs.GetSize(); i++)
+    {
+        if(i == 0 || jobs[i]->volume != jobs[i - 1]->volume)
+        {
+            thread = new CHashThread(this, fullHash);
+            m_threads.Add(thread);
+        }
+        thread->AddJob(jobs[i]);
+    }
+
+    for(int i = 0; i < m_threads.GetSize(); i++)
+    {
+        m_threads[i]->Start();
+    }
+}
+
+bool CDuplicateFinder::AreThreadsRunning()
+{
+    for(int i = 0; i < m_threads.GetSize(); i++)
+    {
+        if(WAIT_TIMEOUT == ::WaitForSingleObject(m_threads[i]->m_hThread, 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Waits for the threads.
+//
+void CDuplicateFinder::DeleteThreads()
+{
+    for(int i = 0; i < m_threads.GetSize(); i++)
+    {
+        ::WaitForSingleObject(m_threads[i]->m_hThread, INFINITE);
+        delete m_threads[i];
+    }
+    m_threads.RemoveAll();
+}
+
+void CDuplicateFinder::StoreHashes()
+{
+    for(int i = 0; i < m_candidates.GetSize(); i++)
+    {
+        const CANDIDATE& c = m_candidates[i];
+        if(c.failed || !c.hasPartialHash)
+        {
+            continue;
+        }
+
+        FILEHASH fh;
+        fh.size = c.size;
+        fh.lastChange = c.lastChange;
+        fh.partialHash = c.partialHash;
+        fh.fullHash = c.fullHash;
+        fh.hasFullHash = c.hasFullHash;
+
+        CString key = c.path;
+        key.MakeLower();
+        m_hashes.SetAt(key, fh);
+    }
+}
+
+void CDuplicateFinder::BuildGroups()
+{
+    CArray<CANDIDATE *, CANDIDATE *> sorted;
+    for(int i = 0; i < m_candidates.GetSize(); i++)
+    {
+        if(!m_candidates[i].failed && m_candidates[i].hasFullHash)
+        {
+            sorted.Add(&m_candidates[i]);
+        }
+    }
+    qsort(sorted.GetData(), sorted.GetSize(), sizeof(CANDIDATE *), &_compareByFullHash);
+
+    for(int i = 0; i < sorted.GetSize(); )
+    {
+        int j = i + 1;
+        while(j < sorted.GetSize() && sorted[j]->size == sorted[i]->size && sorted[j]->fullHash == sorted[i]->fullHash)
+        {
+            j++;
+        }
+
+        if(j - i >= 2)
+        {
+            DUPLICATEGROUP group;
+            group.size = sorted[i]->size;
+            group.firstPath = (int)m_paths.GetSize();
+            group.pathCount = j - i;
+            for(int k = i; k < j; k++)
+            {
+                m_paths.Add(sorted[k]->path);
+            }
+            m_groups.Add(group);
+        }
+        i = j;
+    }
+
+    qsort(m_groups.GetData(), m_groups.GetSize(), sizeof(DUPLICATEGROUP), &_compareGroups);
+
+    m_candidates.RemoveAll();
+}
+
+// Called by the threads.
+//
+void CDuplicateFinder::AddProgress(ULONGLONG bytes, int files)
+{
+    CSingleLock lock(&m_cs, true);
+    m_bytesDone += bytes;
+    m_filesDone += files;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+CHashThread::CHashThread(CDuplicateFinder *finder, bool fullHash)
+    : m_finder(finder)
+    , m_fullHash(fullHash)
+{
+    m_bAutoDelete = false; // CDuplicateFinder waits for us and deletes us.
+}
+
+void CHashThread::AddJob(CDuplicateFinder::CANDIDATE *candidate)
+{
+    m_jobs.Add(candidate);
+}
+
+void CHashThread::Start()
+{
+    VERIFY(CreateThread());
+}
+
+BOOL CHashThread::InitInstance()
+{
+    CEventTrace::SetThreadName("Hash");
+
+    m_buffer.SetSize(READBUFFERSIZE);
+
+    for(int i = 0; i < m_jobs.GetSize() && !m_finder->IsCanceled(); i++)
+    {
+        CDuplicateFinder::CANDIDATE *c = m_jobs[i];
+
+        HANDLE file = ::CreateFile(c->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, m_fullHash ? FILE_FLAG_SEQUENTIAL_SCAN : 0, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            c->failed = true;
+        }
+        else
+        {
+            if(!m_fullHash)
+            {
+                c->firstCluster = GetFirstCluster(file);
+            }
+
+            BY_HANDLE_FILE_INFORMATION info;
+            if(!IsUnchanged(c, file, info))
+            {
+                c->failed = true;
+            }
+            else if(m_finder->m_cache == NULL || !LookupCache(c, info))
+            {
+                if(m_fullHash)
+                {
+                    HashFull(c, file);
+                }
+                else
+                {
+                    HashPartial(c, file);
+                }
+                if(m_finder->m_cache != NULL && !c->failed)
+                {
+                    AddToCache(c, info);
+                }
+            }
+            ::CloseHandle(file);
+        }
+
+        m_finder->AddProgress(0, 1);
+    }
+
+    CEventTrace::ReleaseThreadBuffer();
+
+    return false; // no Run(), please!
+}
+
+// We hash with the size known from the scan. A file, which has changed
+// since the scan, might be listed as duplicate of its former content,
+// so we skip it like a file which can't be read.
+// Return: false, if the file has changed (or we can't tell).
+//
+bool CHashThread::IsUnchanged(const CDuplicateFinder::CANDIDATE *c, HANDLE file, BY_HANDLE_FILE_INFORMATION& info)
+{
+    if(!::GetFileInformationByHandle(file, &info))
+    {
+        return false;
+    }
+
+    ULONGLONG size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    return size == c->size && ::CompareFileTime(&info.ftLastWriteTime, &c->lastChange) == 0;
+}
+
+// Return: true, if the cache knows the hashes needed in this stage.
+//
+bool CHashThread::LookupCache(CDuplicateFinder::CANDIDATE *c, const BY_HANDLE_FILE_INFORMATION& info)
+{
+    FILEHASH fh;
+    if(!m_finder->m_cache->Lookup(info, fh) || (m_fullHash && !fh.hasFullHash))
+    {
+        return false;
+    }
+
+    c->partialHash = fh.partialHash;
+    c->hasPartialHash = true;
+    c->fullHash = fh.fullHash;
+    c->hasFullHash = fh.hasFullHash;
+
+    m_finder->AddProgress(m_fullHash ? c->size : min(c->size, 2 * PARTIALHASHBYTES), 0);
+    return true;
+}
+
+void CHashThread::AddToCache(CDuplicateFinder::CANDIDATE *c, const BY_HANDLE_FILE_INFORMATION& info)
+{
+    FILEHASH fh;
+    fh.size = c->size;
+    fh.lastChange = c->lastChange;
+    fh.partialHash = c->partialHash;
+    fh.fullHash = c->fullHash;
+    fh.hasFullHash = c->hasFullHash;
+    m_finder->m_cache->Add(info, fh);
+}
+
+// Hashes the first and the last PARTIALHASHBYTES. If the file is not
+// larger than that, this is the full hash.
+//
+void CHashThread::HashPartial(CDuplicateFinder::CANDIDATE *c, HANDLE file)
+{
+    CXxHash64 hash;
+    if(c->size <= 2 * PARTIALHASHBYTES)
+    {
+        if(!Read(file, (DWORD)c->size, hash))
+        {
+            c->failed = true;
+            return;
+        }
+        c->fullHash = hash.Final();
+        c->hasFullHash = true;
+    }
+    else
+    {
+        LARGE_INTEGER tail;
+        tail.QuadPart = c->size - PARTIALHASHBYTES;
+        if(!Read(file, PARTIALHASHBYTES, hash) || !::SetFilePointerEx(file, tail, NULL, FILE_BEGIN) || !Read(file, PARTIALHASHBYTES, hash))
+        {
+            c->failed = true;
+            return;
+        }
+    }
+
+    c->partialHash = hash.Final();
+    c->hasPartialHash = true;
+}
+
+void CHashThread::HashFull(CDuplicateFinder::CANDIDATE *c, HANDLE file)
+{
+    CXxHash64 hash;
+    for(ULONGLONG done = 0; done < c->size; done += READBUFFERSIZE)
+    {
+        if(m_finder->IsCanceled() || !Read(file, (DWORD)min(c->size - done, READBUFFERSIZE), hash))
+        {
+            c->failed = true;
+            return;
+        }
+    }
+    c->fullHash = hash.Final();
+    c->hasFullHash = true;
+}
+
+// Reads exactly bytes (at most READBUFFERSIZE) into the hash.
+// Return: false, if the file could not be read or is shorter now.
+//
+bool CHashThread::Read(HANDLE file, DWORD bytes, CXxHash64& hash)
+{
+    ASSERT(bytes <= READBUFFERSIZE);
+
+    DWORD read = 0;
+    if(!::ReadFile(file, m_buffer.GetData(), bytes, &read, NULL) || read != bytes)
+    {
+        return false;
+    }
+    hash.Update(m_buffer.GetData(), read);
+    m_finder->AddProgress(read, 0);
+    return true;
+}
+
+// Return: the logical cluster number of the first extent of the file,
+// or -1, if it isn't known (e.g. the file is resident in the MFT, or the
+// file system doesn't tell).
+//
+LONGLONG CHashThread::GetFirstCluster(HANDLE file)
+{
+    STARTING_VCN_INPUT_BUFFER input;
+    input.StartingVcn.QuadPart = 0;
+
+    // Room for one extent. More extents give ERROR_MORE_DATA, which is fine.
+    RETRIEVAL_POINTERS_BUFFER output;
+    ZeroMemory(&output, sizeof(output));
+
+    DWORD bytes = 0;
+    BOOL b = ::DeviceIoControl(file, FSCTL_GET_RETRIEVAL_POINTERS, &input, sizeof(input), &output, sizeof(output), &bytes, NULL);
+    if((!b && ::GetLastError() != ERROR_MORE_DATA) || output.ExtentCount == 0)
+    {
+        return -1;
+    }
+    return output.Extents[0].Lcn.QuadPart;
+}
@@ -0,0 +1,187 @@
+// DuplicateFinder.h - Declaration of CDuplicateFinder and CHashThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_DUPLICATEFINDER_H__
+#define __WDS_DUPLICATEFINDER_H__
+#pragma once
+
+class CItem;
+class CHashThread;
+class CXxHash64;
+class CHashCache;
+
+//
+// Content hashes of a file (CXxHash64). They are valid as long as
+// size and last change of the file are unchanged.
+//
+struct FILEHASH
+{
+    ULONGLONG size;
+    FILETIME lastChange;
+    ULONGLONG partialHash;  // Of the first and the last PARTIALHASHBYTES (or the whole file)
+    ULONGLONG fullHash;     // Valid if hasFullHash
+    bool hasFullHash;
+};
+
+// Key is the lower case path
+typedef CMap<CString, LPCTSTR, FILEHASH, const FILEHASH&> CFileHashMap;
+
+//
+// A set of files with equal contents
+//
+struct DUPLICATEGROUP
+{
+    ULONGLONG size;         // Of each file
+    int firstPath;          // See CDuplicateFinder::GetPath()
+    int pathCount;          // >= 2
+};
+
+//
+// CDuplicateFinder. Finds files with equal contents in three stages,
+// each of which only looks at the files still in question:
+//
+// 1. Files are grouped by their size, which the tree already knows.
+// 2. Files of equal size get a partial hash of their first and last
+//    PARTIALHASHBYTES. For small files this is the full hash already.
+// 3. Files with equal size and partial hash get a full hash.
+//
+// Stages 2 and 3 run on one CHashThread per volume, so that volumes are
+// read in parallel, but each disk reads one file at a time. Stage 3 reads
+// the files of a volume in the order of their first cluster (as far as
+// known from stage 2) to keep the disk heads moving forward.
+//
+// Hashes are taken from and stored into a CFileHashMap (by path) and,
+// if given, a CHashCache (by file identity), so that unchanged files are
+// not read again.
+//
+// The GUI thread calls Start() and then Poll() periodically, until it
+// returns true. The threads work on copies of the paths, not on the items.
+//
+class CDuplicateFinder
+{
+    friend class CHashThread;
+
+public:
+    enum STAGE
+    {
+        DS_PARTIALHASH,
+        DS_FULLHASH,
+        DS_DONE
+    };
+
+    CDuplicateFinder(CFileHashMap& hashes, CHashCache *cache);
+    ~CDuplicateFinder();
+
+    void Start(const CItem *root);
+    bool Poll();
+    void Cancel();
+    bool IsCanceled() const;
+
+    STAGE GetStage() const;
+    void GetProgress(int& filesDone, int& filesTotal, ULONGLONG& bytesDone, ULONGLONG& bytesTotal);
+
+    int GetGroupCount() const;
+    const DUPLICATEGROUP& GetGroup(int i) const;
+    CString GetPath(int i) const;
+    ULONGLONG GetReclaimableBytes() const;
+
+private:
+    struct CANDIDATE
+    {
+        CString path;
+        ULONGLONG size;
+        FILETIME lastChange;
+        int volume;             // Index into m_volumes
+        LONGLONG firstCluster;  // -1, if unknown
+        ULONGLONG partialHash;
+        ULONGLONG fullHash;
+        bool hasPartialHash;
+        bool hasFullHash;
+        bool failed;            // Could not be read, or has changed since the scan
+    };
+
+    static int __cdecl _compareItemsBySize(const void *p1, const void *p2);
+    static int __cdecl _compareByPartialHash(const void *p1, const void *p2);
+    static int __cdecl _compareByFullHash(const void *p1, const void *p2);
+    static int __cdecl _compareByPath(const void *p1, const void *p2);
+    static int __cdecl _compareByCluster(const void *p1, const void *p2);
+    static int __cdecl _compareGroups(const void *p1, const void *p2);
+
+    void RecurseCollectFiles(const CItem *item, CArray<const CItem *, const CItem *>& files);
+    int GetVolumeIndex(const CString& path);
+    void StartStage(STAGE stage);
+    void StartThreads(CArray<CANDIDATE *, CANDIDATE *>& jobs, bool fullHash);
+    bool AreThreadsRunning();
+    void DeleteThreads();
+    void StoreHashes();
+    void BuildGroups();
+    void AddProgress(ULONGLONG bytes, int files);
+
+    CFileHashMap& m_hashes;
+    CHashCache *m_cache;                    // May be NULL
+    CArray<CANDIDATE, CANDIDATE&> m_candidates;
+    CStringArray m_volumes;                 // "c:", "\\server\share", ...
+    CArray<CHashThread *, CHashThread *> m_threads;
+    STAGE m_stage;
+    volatile bool m_canceled;
+
+    CCriticalSection m_cs;                  // Protects the progress
+    int m_filesDone;
+    int m_filesTotal;
+    ULONGLONG m_bytesDone;
+    ULONGLONG m_bytesTotal;
+
+    CArray<DUPLICATEGROUP, DUPLICATEGROUP&> m_groups;
+    CStringArray m_paths;                   // Of the groups
+};
+
+//
+// CHashThread. Hashes the files of one volume for the CDuplicateFinder.
+//
+class CHashThread: public CWinThread
+{
+public:
+    CHashThread(CDuplicateFinder *finder, bool fullHash);
+
+    void AddJob(CDuplicateFinder::CANDIDATE *candidate);
+    void Start();
+    virtual BOOL InitInstance();
+
+protected:
+    static bool IsUnchanged(const CDuplicateFinder::CANDIDATE *c, HANDLE file, BY_HANDLE_FILE_INFORMATION& info);
+    bool LookupCache(CDuplicateFinder::CANDIDATE *c, const BY_HANDLE_FILE_INFORMATION& info);
+    void AddToCache(CDuplicateFinder::CANDIDATE *c, const BY_HANDLE_FILE_INFORMATION& info);
+    void HashPartial(CDuplicateFinder::CANDIDATE *c, HANDLE file);
+    void HashFull(CDuplicateFinder::CANDIDATE *c, HANDLE file);
+    bool Read(HANDLE file, DWORD bytes, CXxHash64& hash);
+    static LONGLONG GetFirstCluster(HANDLE file);
+
+    CDuplicateFinder *m_finder;
+    const bool m_fullHash;
+    CArray<CDuplicateFinder::CANDIDATE *, CDuplicateFinder::CANDIDATE *> m_jobs;
+    CArray<BYTE, BYTE> m_buffer;
+};
+
+#endif // __WDS_DUPLICATEFINDER_H__
@@ -0,0 +1,385 @@
+// EnumerationQueue.cpp - Implementation of CEnumerationQueue and CEnumerationThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "EventTrace.h"
+#include "ScanStatistics.h"
+#include "FileFindWDS.h"
+#include "EnumerationQueue.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+const UINT WMU_ENUMERATED = ::RegisterWindowMessage(_T("{8D4F2B17-C3A6-4E59-B0D8-57E1A9C46F32}"));
+
+namespace
+{
+    // Read ahead: directories per volume, which have been requested, but
+    // not yet fetched. A Fetch() of a directory, which has not been
+    // requested, is always queued.
+    const int MAXREADAHEAD = 256;
+}
+
+CCriticalSection CEnumerationQueue::_cs;
+CEnumerationQueue::CQueuedPatternList CEnumerationQueue::_queue;
+CEnumerationQueue::CResultMap CEnumerationQueue::_results;
+CEnumerationQueue::CVolumeCountMap CEnumerationQueue::_requested;
+CEnumerationQueue::CVolumeSet CEnumerationQueue::_busyVolumes;
+UINT CEnumerationQueue::_lastId = 0;
+bool CEnumerationQueue::_waiting = false;
+HWND CEnumerationQueue::_notifyWindow = NULL;
+UINT CEnumerationQueue::_serial = 0;
+
+void CEnumerationQueue::SetNotifyWindow(HWND hwnd)
+{
+    CSingleLock lock(&_cs, true);
+    _notifyWindow = hwnd;
+    _serial++;
+}
+
+// Called by the main frame when it is destroyed.
+//
+void CEnumerationQueue::InvalidateNotifyWindow()
+{
+    SetNotifyWindow(NULL);
+}
+
+UINT CEnumerationQueue::GetSerial()
+{
+    CSingleLock lock(&_cs, true);
+    return _serial;
+}
+
+// Reads ahead: queues the enumeration of pattern (CItem::GetFindPattern()),
+// unless it has already been requested or its volume has MAXREADAHEAD
+// requests already. In that case Fetch() will queue it.
+//
+void CEnumerationQueue::Request(LPCTSTR pattern)
+{
+    CSingleLock lock(&_cs, true);
+
+    RESULT *result = NULL;
+    if(_results.Lookup(pattern, result))
+    {
+        return;
+    }
+
+    CString volume = CScanStatistics::GetVolumeOfPath(pattern);
+    int requested = 0;
+    if(_requested.Lookup(volume, requested) && requested >= MAXREADAHEAD)
+    {
+        return;
+    }
+
+    Enqueue(pattern, volume, false);
+}
+
+// Takes the entries of pattern, if they have arrived. Otherwise queues
+// them, if they have not been requested; WMU_ENUMERATED will be posted,
+// when they arrive.
+// counts: the duration of the enumeration.
+// Return: the entries, which the caller deletes, or NULL, if they have
+// not yet arrived.
+//
+CDirEntryArray *CEnumerationQueue::Fetch(LPCTSTR pattern, LONGLONG& counts)
+{
+    CSingleLock lock(&_cs, true);
+
+    RESULT *result = NULL;
+    if(!_results.Lookup(pattern, result))
+    {
+        // We are waiting for it, so it goes before the read ahead.
+        Enqueue(pattern, CScanStatistics::GetVolumeOfPath(pattern), true);
+        _waiting = true;
+        return NULL;
+    }
+    if(result->entries == NULL)
+    {
+        _waiting = true;
+        return NULL;
+    }
+
+    CDirEntryArray *entries = result->entries;
+    result->entries = NULL;
+    counts = result->counts;
+
+    RemoveResult(pattern, result);
+    return entries;
+}
+
+// Forgets all requests of path and the directories below it, e.g. because
+// the items have been deleted or are refreshed. A running enumeration
+// is not interrupted, but its result is dropped.
+//
+void CEnumerationQueue::Cancel(LPCTSTR path)
+{
+    CSingleLock lock(&_cs, true);
+
+    POSITION pos = _queue.GetHeadPosition();
+    while(pos != NULL)
+    {
+        POSITION current = pos;
+        if(IsBelow(_queue.GetNext(pos).pattern, path))
+        {
+            _queue.RemoveAt(current);
+        }
+    }
+
+    CStringArray cancelled;
+    pos = _results.GetStartPosition();
+    while(pos != NULL)
+    {
+        CString pattern;
+        RESULT *result = NULL;
+        _results.GetNextAssoc(pos, pattern, result);
+        if(IsBelow(pattern, path))
+        {
+            cancelled.Add(pattern);
+        }
+    }
+    for(int i = 0; i < cancelled.GetSize(); i++)
+    {
+        RESULT *result = NULL;
+        VERIFY(_results.Lookup(cancelled[i], result));
+        RemoveResult(cancelled[i], result);
+    }
+}
+
+// Called by CDirstatDoc, before the item tree is deleted.
+//
+void CEnumerationQueue::Reset()
+{
+    CSingleLock lock(&_cs, true);
+
+    _queue.RemoveAll();
+
+    POSITION pos = _results.GetStartPosition();
+    while(pos != NULL)
+    {
+        CString pattern;
+        RESULT *result = NULL;
+        _results.GetNextAssoc(pos, pattern, result);
+        delete result->entries;
+        delete result;
+    }
+    _results.RemoveAll();
+    _requested.RemoveAll();
+    _waiting = false;
+}
+
+// Adds a RESULT for pattern and queues it (at the head, if urgent).
+// Starts the thread of volume, if necessary.
+//
+void CEnumerationQueue::Enqueue(LPCTSTR pattern, const CString& volume, bool urgent)
+{
+    RESULT *result = new RESULT;
+    result->id = ++_lastId;
+    result->volume = volume;
+    result->counts = 0;
+    result->entries = NULL;
+    _results.SetAt(pattern, result);
+
+    int requested = 0;
+    _requested.Lookup(volume, requested);
+    _requested.SetAt(volume, requested + 1);
+
+    QUEUEDPATTERN qp;
+    qp.pattern = pattern;
+    qp.volume = volume;
+    qp.id = result->id;
+    if(urgent)
+    {
+        _queue.AddHead(qp);
+    }
+    else
+    {
+        _queue.AddTail(qp);
+    }
+
+    bool busy = false;
+    if(!_busyVolumes.Lookup(volume, busy))
+    {
+        _busyVolumes.SetAt(volume, true);
+        new CEnumerationThread(volume); // deletes itself
+    }
+}
+
+// Removes and deletes the result (fetched or cancelled).
+//
+void CEnumerationQueue::RemoveResult(LPCTSTR pattern, RESULT *result)
+{
+    int requested = 0;
+    VERIFY(_requested.Lookup(result->volume, requested));
+    if(requested > 1)
+    {
+        _requested.SetAt(result->volume, requested - 1);
+    }
+    else
+    {
+        _requested.RemoveKey(result->volume);
+    }
+
+    _results.RemoveKey(pattern);
+    delete result->entries;
+    delete result;
+}
+
+// Whether pattern ("C:\dir\*.*") enumerates path ("C:\dir") or a directory below it.
+//
+bool CEnumerationQueue::IsBelow(const CString& pattern, LPCTSTR path)
+{
+    int n = lstrlen(path);
+    if(pattern.GetLength() <= n || _tcsnicmp(pattern, path, n) != 0)
+    {
+        return false;
+    }
+    return pattern[n] == wds::chrBackslash || (n > 0 && path[n - 1] == wds::chrBackslash);
+}
+
+// Called by the threads. Removes the first pattern of volume from the queue.
+// If there is none, the thread unregisters itself (atomically with respect
+// to Request()).
+// Return: false, if the thread shall terminate.
+//
+bool CEnumerationQueue::PopPattern(const CString& volume, CString& pattern, UINT& id)
+{
+    CSingleLock lock(&_cs, true);
+
+    POSITION pos = _queue.GetHeadPosition();
+    while(pos != NULL)
+    {
+        POSITION current = pos;
+        const QUEUEDPATTERN& qp = _queue.GetNext(pos);
+        if(qp.volume == volume)
+        {
+            pattern = qp.pattern;
+            id = qp.id;
+            _queue.RemoveAt(current);
+            return true;
+        }
+    }
+
+    _busyVolumes.RemoveKey(volume);
+    return false;
+}
+
+// Called by the threads. Takes over entries. They are dropped, if the
+// request has been cancelled (or cancelled and requested again) meanwhile.
+//
+void CEnumerationQueue::StoreResult(const CString& pattern, UINT id, CDirEntryArray *entries, LONGLONG counts)
+{
+    CSingleLock lock(&_cs, true);
+
+    RESULT *result = NULL;
+    if(!_results.Lookup(pattern, result) || result->id != id)
+    {
+        delete entries;
+        return;
+    }
+
+    result->entries = entries;
+    result->counts = counts;
+
+    // Only one message per wait, so that we don't flood the message queue.
+    if(_waiting && _notifyWindow != NULL)
+    {
+        // Posted, not sent: we hold _cs. An invalid or recycled window handle
+        // is harmless, see CDeleteThread::DeleteBatch().
+        ::PostMessage(_notifyWindow, WMU_ENUMERATED, _serial, 0);
+        _waiting = false;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The constructor starts the thread.
+//
+CEnumerationThread::CEnumerationThread(LPCTSTR volume)
+    : m_volume(volume)
+{
+    ASSERT(m_bAutoDelete);
+    VERIFY(CreateThread());
+}
+
+BOOL CEnumerationThread::InitInstance()
+{
+    CEventTrace::SetThreadName("Enumeration");
+
+    CString pattern;
+    UINT id = 0;
+    while(CEnumerationQueue::PopPattern(m_volume, pattern, id))
+    {
+        CDirEntryArray *entries = new CDirEntryArray;
+        LONGLONG start = CScanStatistics::GetCounter();
+        Enumerate(pattern, *entries);
+        CEnumerationQueue::StoreResult(pattern, id, entries, CScanStatistics::GetCounter() - start);
+    }
+
+    // We are unregistered now. Don't touch the queue any more.
+
+    CEventTrace::ReleaseThreadBuffer();
+
+    ASSERT(m_bAutoDelete); // Object will delete itself.
+    return false; // no Run(), please!
+}
+
+void CEnumerationThread::Enumerate(LPCTSTR pattern, CDirEntryArray& entries)
+{
+    CTraceScope scope(TE_ENUMERATE);
+
+    ULONGLONG files = 0;
+    ULONGLONG bytes = 0;
+
+    CFileFindWDS finder;
+    BOOL b = finder.FindFile(pattern);
+    while(b)
+    {
+        b = finder.FindNextFile();
+        if(finder.IsDots())
+        {
+            continue;
+        }
+
+        DIRENTRY entry;
+        entry.name = finder.GetFileName();
+        entry.attributes = finder.GetAttributes();
+        entry.directory = (finder.IsDirectory() != FALSE);
+        entry.length = entry.directory ? 0 : finder.GetCompressedLength();
+        // (We don't use GetLastWriteTime(CTime&) here, because, if the file has
+        // an invalid timestamp, that function would ASSERT and throw an Exception.)
+        finder.GetLastWriteTime(&entry.lastWriteTime);
+        entries.Add(entry);
+
+        if(!entry.directory)
+        {
+            files++;
+            bytes += entry.length;
+        }
+    }
+
+    scope.SetArgs(files, bytes);
+}
@@ -0,0 +1,131 @@
+// EnumerationQueue.h - Declaration of CEnumerationQueue and CEnumerationThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+#ifndef __WDS_ENUMERATIONQUEUE_H__
+#define __WDS_ENUMERATIONQUEUE_H__
+#pragma once
+
+//
+// Registered message posted (PostMessage) to the notification window,
+// when an enumeration has finished, which the gui thread has been
+// waiting for (see CEnumerationQueue::Fetch()).
+// wParam = serial, lParam = 0
+//
+extern const UINT WMU_ENUMERATED;
+
+//
+// One entry of a directory, as found by FindNextFile(). "." and ".." are skipped.
+//
+struct DIRENTRY
+{
+    CString name;
+    DWORD attributes;       // CFileFindWDS::GetAttributes()
+    ULONGLONG length;       // CFileFindWDS::GetCompressedLength(), 0 for directories
+    FILETIME lastWriteTime;
+    bool directory;
+};
+typedef CArray<DIRENTRY, const DIRENTRY&> CDirEntryArray;
+
+//
+// CEnumerationQueue. Enumerates directories (FindFirstFile() and
+// FindNextFile()) in the background, so that the gui thread never waits
+// for the file system. There is one CEnumerationThread per volume, so
+// that an unresponsive volume (e.g. a network share, which takes 30 sec
+// to time out) only delays its own directories, not those of the other
+// roots of the session.
+// The gui thread requests the entries of a directory in advance and
+// fetches them, when it is ready for them (CItem::DoWorkUntil()).
+// The entries are handed over by pointer, not copied. Per volume at most
+// MAXREADAHEAD directories are requested in advance, so that the
+// entries waiting for the gui thread don't grow with the volume.
+// The public methods are called by the gui thread.
+//
+class CEnumerationQueue
+{
+public:
+    static void SetNotifyWindow(HWND hwnd);
+    static void InvalidateNotifyWindow();
+    static UINT GetSerial();
+
+    static void Request(LPCTSTR pattern);
+    static CDirEntryArray *Fetch(LPCTSTR pattern, LONGLONG& counts);
+    static void Cancel(LPCTSTR path);
+    static void Reset();
+
+private:
+    friend class CEnumerationThread;
+
+    struct QUEUEDPATTERN
+    {
+        CString pattern;
+        CString volume;     // CScanStatistics::GetVolumeOfPath()
+        UINT id;            // RESULT::id
+    };
+    typedef CList<QUEUEDPATTERN, const QUEUEDPATTERN&> CQueuedPatternList;
+
+    struct RESULT
+    {
+        UINT id;                    // Identifies the request, see StoreResult()
+        CString volume;             // CScanStatistics::GetVolumeOfPath()
+        LONGLONG counts;            // Duration of the enumeration (performance counter counts)
+        CDirEntryArray *entries;    // NULL, until they have arrived
+    };
+    typedef CMap<CString, LPCTSTR, RESULT *, RESULT *> CResultMap;
+    typedef CMap<CString, LPCTSTR, bool, bool> CVolumeSet;
+    typedef CMap<CString, LPCTSTR, int, int> CVolumeCountMap;
+
+    static void Enqueue(LPCTSTR pattern, const CString& volume, bool urgent);
+    static void RemoveResult(LPCTSTR pattern, RESULT *result);
+    static bool IsBelow(const CString& pattern, LPCTSTR path);
+    static bool PopPattern(const CString& volume, CString& pattern, UINT& id);
+    static void StoreResult(const CString& pattern, UINT id, CDirEntryArray *entries, LONGLONG counts);
+
+    static CCriticalSection _cs;        // Synchronizes all the following members
+    static CQueuedPatternList _queue;   // Patterns waiting for their thread
+    static CResultMap _results;         // Requested patterns, whether ready or not
+    static CVolumeCountMap _requested;  // Number of _results per volume
+    static CVolumeSet _busyVolumes;     // Volumes, which have a CEnumerationThread
+    static UINT _lastId;                // Of the last request
+    static bool _waiting;               // Fetch() has returned false since the last WMU_ENUMERATED
+    static HWND _notifyWindow;          // Receiver of WMU_ENUMERATED
+    static UINT _serial;                // Serial number of _notifyWindow
+};
+
+//
+// CEnumerationThread. Enumerates the queued directories of one
+// volume and terminates itself, when there are no more.
+//
+class CEnumerationThread: public CWinThread
+{
+public:
+    CEnumerationThread(LPCTSTR volume);
+    virtual BOOL InitInstance();
+
+protected:
+    static void Enumerate(LPCTSTR pattern, CDirEntryArray& entries);
+
+    const CString m_volume;
+};
+
+#endif // __WDS_ENUMERATIONQUEUE_H__
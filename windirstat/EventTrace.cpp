@@ -0,0 +1,327 @@
+// EventTrace.cpp - Implementation of CEventTrace and CTraceScope
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    struct EVENTINFO
+    {
+        LPCSTR name;
+        LPCSTR category;
+        LPCSTR arg0;
+        LPCSTR arg1;
+    };
+
+#define WDS_TRACE_EVENT_INFO(id, name, category, arg0, arg1) { name, category, arg0, arg1 },
+
+    const EVENTINFO eventInfo[] = {
+        WDS_TRACE_EVENTS(WDS_TRACE_EVENT_INFO)
+    };
+
+#undef WDS_TRACE_EVENT_INFO
+
+    C_ASSERT(countof(eventInfo) == TE_EVENTCOUNT);
+}
+
+volatile LONG CEventTrace::_enabled = 1;
+CEventTrace::TRACEBUFFER *volatile CEventTrace::_buffers = NULL;
+__declspec(thread) CEventTrace::TRACEBUFFER *CEventTrace::_threadBuffer = NULL;
+
+void CEventTrace::Enable(bool enable)
+{
+    ::InterlockedExchange(&_enabled, enable ? 1 : 0);
+}
+
+bool CEventTrace::IsEnabled()
+{
+    return _enabled != 0;
+}
+
+// name must be a static string.
+//
+void CEventTrace::SetThreadName(LPCSTR name)
+{
+    TRACEBUFFER *buffer = GetThreadBuffer();
+    if(buffer != NULL)
+    {
+        buffer->threadName = name;
+    }
+}
+
+// Called by worker threads before they terminate.
+//
+void CEventTrace::ReleaseThreadBuffer()
+{
+    TRACEBUFFER *buffer = _threadBuffer;
+    if(buffer != NULL)
+    {
+        _threadBuffer = NULL;
+        ::InterlockedExchange(&buffer->owned, 0);
+    }
+}
+
+void CEventTrace::Instant(TRACEEVENTID event, ULONGLONG arg0, ULONGLONG arg1)
+{
+    if(IsEnabled())
+    {
+        Write(event, PH_INSTANT, CScanStatistics::GetCounter(), 0, arg0, arg1);
+    }
+}
+
+// start is a value of CScanStatistics::GetCounter(). The event ends now.
+//
+void CEventTrace::Complete(TRACEEVENTID event, LONGLONG start, ULONGLONG arg0, ULONGLONG arg1)
+{
+    if(IsEnabled())
+    {
+        Write(event, PH_COMPLETE, start, CScanStatistics::GetCounter() - start, arg0, arg1);
+    }
+}
+
+// Claims a free buffer or allocates a new one.
+// Return: NULL, if out of memory.
+//
+CEventTrace::TRACEBUFFER *CEventTrace::GetThreadBuffer()
+{
+    if(_threadBuffer != NULL)
+    {
+        return _threadBuffer;
+    }
+
+    TRACEBUFFER *buffer = NULL;
+    for(TRACEBUFFER *b = _buffers; b != NULL; b = b->next)
+    {
+        if(0 == ::InterlockedCompareExchange(&b->owned, 1, 0))
+        {
+            buffer = b;
+            break;
+        }
+    }
+
+    if(buffer == NULL)
+    {
+        // VirtualAlloc() returns zeroed memory. We don't use new here, because
+        // the buffers live until the process terminates and would be reported
+        // as memory leaks in the debug build.
+        buffer = (TRACEBUFFER *)::VirtualAlloc(NULL, sizeof(TRACEBUFFER), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if(buffer == NULL)
+        {
+            return NULL;
+        }
+        buffer->owned = 1;
+
+        TRACEBUFFER *head;
+        do
+        {
+            head = _buffers;
+            buffer->next = head;
+        }
+        while(head != ::InterlockedCompareExchangePointer((PVOID volatile *)&_buffers, buffer, head));
+    }
+
+    buffer->threadId = ::GetCurrentThreadId();
+    buffer->threadName = NULL;
+    _threadBuffer = buffer;
+    return buffer;
+}
+
+// The sequence number is reset before and set after the record is filled,
+// so that a concurrent reader can detect (and skip) a torn record.
+//
+void CEventTrace::Write(TRACEEVENTID event, WORD phase, LONGLONG timestamp, LONGLONG duration, ULONGLONG arg0, ULONGLONG arg1)
+{
+    TRACEBUFFER *buffer = GetThreadBuffer();
+    if(buffer == NULL)
+    {
+        return;
+    }
+
+    DWORD index = buffer->written;
+    TRACERECORD& record = buffer->records[index & (BUFFER_RECORDS - 1)];
+
+    ::InterlockedExchange(&record.sequence, 0);
+    record.threadId = buffer->threadId;
+    record.event = (WORD)event;
+    record.phase = phase;
+    record.timestamp = timestamp;
+    record.duration = duration;
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+    ::InterlockedExchange(&record.sequence, (LONG)(index + 1));
+
+    buffer->written = index + 1;
+}
+
+// Return: false, if the file could not be written. error is set then.
+//
+bool CEventTrace::ExportChromeTrace(LPCTSTR path, CString& error)
+{
+    // The timestamps are exported relative to the oldest record.
+    LONGLONG base = _I64_MAX;
+    CArray<TRACERECORD, TRACERECORD&> records;
+
+    for(TRACEBUFFER *buffer = _buffers; buffer != NULL; buffer = buffer->next)
+    {
+        DWORD written = buffer->written;
+        DWORD count = min(written, (DWORD)BUFFER_RECORDS);
+
+        for(DWORD i = written - count; i != written; i++)
+        {
+            const TRACERECORD& r = buffer->records[i & (BUFFER_RECORDS - 1)];
+
+            LONG sequence = r.sequence;
+            ::MemoryBarrier();
+            TRACERECORD copy = r;
+            ::MemoryBarrier();
+
+            // Skip the records which are being (over)written.
+            if(sequence != (LONG)(i + 1) || r.sequence != sequence)
+            {
+                continue;
+            }
+
+            records.Add(copy);
+            base = min(base, copy.timestamp);
+        }
+    }
+
+    try
+    {
+        CFile file(path, CFile::modeCreate | CFile::modeWrite);
+
+        CStringA s;
+        s.Format("{\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"WinDirStat\"}}",
+            ::GetCurrentProcessId());
+        file.Write(s, s.GetLength());
+
+        for(TRACEBUFFER *buffer = _buffers; buffer != NULL; buffer = buffer->next)
+        {
+            LPCSTR name = buffer->threadName;
+            if(name != NULL)
+            {
+                s.Format(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    ::GetCurrentProcessId(), buffer->threadId, name);
+                file.Write(s, s.GetLength());
+            }
+        }
+
+        for(int i = 0; i < records.GetSize(); i++)
+        {
+            s = FormatRecord(records[i], base);
+            file.Write(s, s.GetLength());
+        }
+
+        s = "\n],\"displayTimeUnit\":\"ms\"}\n";
+        file.Write(s, s.GetLength());
+        file.Close();
+    }
+    catch(CFileException *pe)
+    {
+        TCHAR szError[1024];
+        pe->GetErrorMessage(szError, countof(szError));
+        error = szError;
+        pe->Delete();
+        return false;
+    }
+
+    return true;
+}
+
+// Return: ",\n" and the JSON object of the record.
+//
+CStringA CEventTrace::FormatRecord(const TRACERECORD& record, LONGLONG base)
+{
+    ASSERT(record.event < TE_EVENTCOUNT);
+    const EVENTINFO& info = eventInfo[record.event];
+
+    CStringA s;
+    s.Format(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f",
+        info.name, info.category, ::GetCurrentProcessId(), record.threadId,
+        CScanStatistics::CountsToSeconds(record.timestamp - base) * 1000000);
+
+    CStringA t;
+    if(record.phase == PH_COMPLETE)
+    {
+        t.Format(",\"ph\":\"X\",\"dur\":%.3f", CScanStatistics::CountsToSeconds(record.duration) * 1000000);
+    }
+    else
+    {
+        t = ",\"ph\":\"i\",\"s\":\"t\"";
+    }
+    s += t;
+
+    if(info.arg0 != NULL || info.arg1 != NULL)
+    {
+        s += ",\"args\":{";
+        if(info.arg0 != NULL)
+        {
+            t.Format("\"%s\":%I64u", info.arg0, record.arg0);
+            s += t;
+        }
+        if(info.arg1 != NULL)
+        {
+            t.Format("%s\"%s\":%I64u", info.arg0 != NULL ? "," : "", info.arg1, record.arg1);
+            s += t;
+        }
+        s += "}";
+    }
+    s += "}";
+
+    return s;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+CTraceScope::CTraceScope(TRACEEVENTID event, ULONGLONG arg0, ULONGLONG arg1)
+    : m_event(event)
+    , m_start(CEventTrace::IsEnabled() ? CScanStatistics::GetCounter() : 0)
+    , m_arg0(arg0)
+    , m_arg1(arg1)
+{
+}
+
+CTraceScope::~CTraceScope()
+{
+    if(m_start != 0)
+    {
+        CEventTrace::Complete(m_event, m_start, m_arg0, m_arg1);
+    }
+}
+
+void CTraceScope::SetArgs(ULONGLONG arg0, ULONGLONG arg1)
+{
+    m_arg0 = arg0;
+    m_arg1 = arg1;
+}
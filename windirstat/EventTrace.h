@@ -0,0 +1,151 @@
+// EventTrace.h - Declaration of CEventTrace and CTraceScope
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_EVENTTRACE_H__
+#define __WDS_EVENTTRACE_H__
+#pragma once
+
+//
+// The trace events. Each entry is
+// X(id, name, category, name of arg0, name of arg1),
+// where an argument name of NULL means that the argument is not used.
+// The names are only needed by the exporter. A category
+// is one of "scan", "layout", "draw", "gui" and "io".
+//
+#define WDS_TRACE_EVENTS(X) \
+    X(TE_SCAN,          "Scan",                     "scan",     "directories",  "files")    \
+    X(TE_WORK,          "Work",                     "scan",     "ticks",        NULL)       \
+    X(TE_ENUMERATE,     "Enumerate directory",      "scan",     "files",        "bytes")    \
+    X(TE_PACMAN,        "Pacman",                   "gui",      NULL,           NULL)       \
+    X(TE_PAINT,         "Paint list",               "draw",     NULL,           NULL)       \
+    X(TE_SORT,          "Sort list",                "gui",      "items",        NULL)       \
+    X(TE_TREEMAP,       "Treemap layout",           "layout",   "width",        "height")   \
+    X(TE_GRAPHVIEW,     "Draw graph view",          "draw",     "treemap",      NULL)       \
+    X(TE_EXTENSIONDATA, "Rebuild extension data",   "gui",      "extensions",   NULL)       \
+    X(TE_DELETEBATCH,   "Delete batch",             "io",       "paths",        "toTrashBin") \
+    X(TE_VOLUMEINFO,    "Query volume information", "io",       "success",      NULL)       \
+    X(TE_PAGEOUT,       "Page out subtrees",        "io",       "pages",        "pagedOutItems") \
+    X(TE_PAGEIN,        "Page in subtree",          "io",       "items",        NULL)
+
+#define WDS_TRACE_EVENT_ID(id, name, category, arg0, arg1) id,
+
+enum TRACEEVENTID
+{
+    WDS_TRACE_EVENTS(WDS_TRACE_EVENT_ID)
+    TE_EVENTCOUNT
+};
+
+#undef WDS_TRACE_EVENT_ID
+
+//
+// CEventTrace. Records binary events into per-thread ring buffers,
+// so that the trace can stay enabled in release builds. Writing
+// doesn't take any lock and doesn't format anything: a record is
+// the event id, two counters of QueryPerformanceCounter() and two
+// numeric arguments. When a buffer is full, its oldest records are
+// overwritten.
+//
+// Each thread claims a buffer on its first event. Worker threads
+// should call ReleaseThreadBuffer() before they terminate, so that
+// the next thread can reuse the buffer (the records are kept).
+//
+// ExportChromeTrace() may be called by any thread at any time. It
+// writes the JSON format of chrome://tracing and other timeline
+// viewers. Records which are overwritten during the export are skipped.
+//
+class CEventTrace
+{
+public:
+    static void Enable(bool enable);
+    static bool IsEnabled();
+
+    static void SetThreadName(LPCSTR name);
+    static void ReleaseThreadBuffer();
+
+    static void Instant(TRACEEVENTID event, ULONGLONG arg0 = 0, ULONGLONG arg1 = 0);
+    static void Complete(TRACEEVENTID event, LONGLONG start, ULONGLONG arg0 = 0, ULONGLONG arg1 = 0);
+
+    static bool ExportChromeTrace(LPCTSTR path, CString& error);
+
+private:
+    enum { BUFFER_RECORDS = 8192 };     // Power of 2
+
+    enum
+    {
+        PH_INSTANT,
+        PH_COMPLETE
+    };
+
+    struct TRACERECORD
+    {
+        volatile LONG sequence;     // Index + 1 of the record, 0 while it is being written
+        DWORD threadId;
+        WORD event;                 // TRACEEVENTID
+        WORD phase;                 // PH_*
+        LONGLONG timestamp;         // QueryPerformanceCounter()
+        LONGLONG duration;          // Counts, PH_COMPLETE only
+        ULONGLONG arg0;
+        ULONGLONG arg1;
+    };
+
+    struct TRACEBUFFER
+    {
+        TRACEBUFFER *next;          // All buffers ever allocated. They are never freed.
+        volatile LONG owned;        // 1, while a thread uses the buffer
+        volatile DWORD threadId;    // Current or last owner
+        LPCSTR volatile threadName; // Static string or NULL
+        volatile DWORD written;     // Records written so far. Only the owner writes.
+        TRACERECORD records[BUFFER_RECORDS];
+    };
+
+    static TRACEBUFFER *GetThreadBuffer();
+    static void Write(TRACEEVENTID event, WORD phase, LONGLONG timestamp, LONGLONG duration, ULONGLONG arg0, ULONGLONG arg1);
+    static CStringA FormatRecord(const TRACERECORD& record, LONGLONG base);
+
+    static volatile LONG _enabled;
+    static TRACEBUFFER *volatile _buffers;  // Head of the list, pushed with InterlockedCompareExchangePointer()
+    static __declspec(thread) TRACEBUFFER *_threadBuffer;    // Buffer of the calling thread or NULL
+};
+
+//
+// CTraceScope. Records a complete event covering its lifetime.
+// The arguments may be set until it is destroyed.
+//
+class CTraceScope
+{
+public:
+    CTraceScope(TRACEEVENTID event, ULONGLONG arg0 = 0, ULONGLONG arg1 = 0);
+    ~CTraceScope();
+
+    void SetArgs(ULONGLONG arg0, ULONGLONG arg1);
+
+private:
+    const TRACEEVENTID m_event;
+    const LONGLONG m_start;     // 0, if tracing was disabled at construction
+    ULONGLONG m_arg0;
+    ULONGLONG m_arg1;
+};
+
+#endif // __WDS_EVENTTRACE_H__
@@ -0,0 +1,762 @@
+// ExclusionRules.cpp - Implementation of CExclusionRules
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ExclusionRules.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const LPCTSTR strExclude = _T("exclude");
+    const LPCTSTR strSummarize = _T("summarize");
+    const LPCTSTR strAnyDepth = _T("**");
+
+    const ULONGLONG FILETIME_PER_DAY = 864000000000ui64; // 100 ns units
+
+    // The DFA handles ASCII characters with a table, others with a map.
+    const int ASCII_COUNT = 128;
+}
+
+//
+// A node of the trie. The root node matches the empty path.
+//
+struct CExclusionRules::TRIENODE
+{
+    TRIENODE(bool any) : anyDepth(any), anyDepthChild(-1) { }
+    ~TRIENODE()
+    {
+        for(int i = 0; i < states.GetSize(); i++)
+        {
+            delete states[i];
+        }
+    }
+
+    bool anyDepth;                                  // Reached via **. Stays active on any component.
+    int anyDepthChild;                              // Node reached via **, or -1
+    CMap<CString, LPCTSTR, int, int> literals;      // Folded component -> node
+    CStringArray wildcardGlobs;                     // Folded components with * or ?
+    CArray<int, int> wildcardNodes;                 // ... and their nodes
+
+    CStringArray nameGlobs;                         // Folded last components of the patterns
+    CArray<int, int> nameRules;                     // ... and their rules
+
+    CArray<DFASTATE *, DFASTATE *> states;          // The DFA of nameGlobs, built on demand. [0] is the start state.
+    CMap<CString, LPCTSTR, int, int> stateIndex;    // Key of DFASTATE::positions -> index in states
+};
+
+//
+// A state of a name glob DFA, i.e. a set of NFA positions.
+//
+struct CExclusionRules::DFASTATE
+{
+    CArray<DWORD, DWORD> positions; // Sorted MAKELONG(position in glob, glob index)
+    CArray<int, int> accept;        // Sorted rules of the globs which are complete here
+    int next[ASCII_COUNT];          // Transitions, -1 if not yet computed
+    CMap<UINT, UINT, int, int> other; // Transitions of the other characters
+};
+
+
+CExclusionRules::CExclusionRules()
+    : m_now(0)
+{
+    Clear();
+}
+
+CExclusionRules::~CExclusionRules()
+{
+    for(int i = 0; i < m_nodes.GetSize(); i++)
+    {
+        delete m_nodes[i];
+    }
+}
+
+// Replaces the rules. On error, the rules are empty and error contains
+// the offending line.
+//
+bool CExclusionRules::Compile(LPCTSTR text, CString& error)
+{
+    Clear();
+
+    CString s = text;
+    int lineNumber = 0;
+    int i = 0;
+    while(i < s.GetLength())
+    {
+        int end = s.Find(_T('\n'), i);
+        if(end == -1)
+        {
+            end = s.GetLength();
+        }
+        CString line = s.Mid(i, end - i);
+        i = end + 1;
+        lineNumber++;
+
+        line.Trim();
+        if(line.IsEmpty() || line[0] == wds::chrSharp)
+        {
+            continue;
+        }
+
+        CStringArray tokens;
+        Tokenize(line, tokens);
+
+        RULE rule;
+        rule.directoriesOnly = false;
+        rule.minSize = 0;
+        rule.maxSize = _UI64_MAX;
+        rule.minAge = 0;
+        rule.maxAge = _UI64_MAX;
+
+        bool ok = (tokens.GetSize() >= 2);
+        if(ok)
+        {
+            if(tokens[0].CompareNoCase(strExclude) == 0)
+            {
+                rule.action = RA_EXCLUDE;
+            }
+            else if(tokens[0].CompareNoCase(strSummarize) == 0)
+            {
+                rule.action = RA_SUMMARIZE;
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        for(int k = 2; ok && k < tokens.GetSize(); k++)
+        {
+            ok = ParsePredicate(tokens[k], rule);
+        }
+        if(ok)
+        {
+            ok = AddRule(tokens[1], rule);
+        }
+
+        if(!ok)
+        {
+            error.FormatMessage(IDS_INVALIDEXCLUSIONRULEds, lineNumber, (LPCTSTR)line);
+            Clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CExclusionRules::Clear()
+{
+    for(int i = 0; i < m_nodes.GetSize(); i++)
+    {
+        delete m_nodes[i];
+    }
+    m_nodes.RemoveAll();
+    m_rules.RemoveAll();
+    m_active.RemoveAll();
+
+    AddNode(false);
+}
+
+bool CExclusionRules::IsEmpty() const
+{
+    return m_rules.GetSize() == 0;
+}
+
+// Determines the trie nodes which match path. Called by CItem::DoSomeWork()
+// before it reads the directory path.
+//
+void CExclusionRules::BeginDirectory(LPCTSTR path)
+{
+    FILETIME now;
+    ::GetSystemTimeAsFileTime(&now);
+    m_now = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    m_active.RemoveAll();
+    if(IsEmpty())
+    {
+        return;
+    }
+    AddActive(m_active, 0);
+
+    CString folded = FoldString(path);
+    int i = 0;
+    while(i < folded.GetLength() && m_active.GetSize() > 0)
+    {
+        int end = folded.Find(wds::chrBackslash, i);
+        if(end == -1)
+        {
+            end = folded.GetLength();
+        }
+        CString component = folded.Mid(i, end - i);
+        i = end + 1;
+
+        if(component.IsEmpty())
+        {
+            continue;
+        }
+
+        CArray<int, int> active;
+        for(int k = 0; k < m_active.GetSize(); k++)
+        {
+            const TRIENODE *node = m_nodes[m_active[k]];
+
+            if(node->anyDepth)
+            {
+                AddActive(active, m_active[k]);
+            }
+
+            int child;
+            if(node->literals.Lookup(component, child))
+            {
+                AddActive(active, child);
+            }
+
+            for(int w = 0; w < node->wildcardGlobs.GetSize(); w++)
+            {
+                if(GlobMatch(node->wildcardGlobs[w], component))
+                {
+                    AddActive(active, node->wildcardNodes[w]);
+                }
+            }
+        }
+        m_active.Copy(active);
+    }
+}
+
+// Called for every entry of the directory passed to BeginDirectory().
+//
+RULEACTION CExclusionRules::Match(LPCTSTR name, bool isDirectory, ULONGLONG size, const FILETIME& lastWriteTime)
+{
+    int best = INT_MAX;
+
+    for(int k = 0; k < m_active.GetSize(); k++)
+    {
+        TRIENODE *node = m_nodes[m_active[k]];
+        if(node->nameGlobs.GetSize() == 0)
+        {
+            continue;
+        }
+
+        int state = GetDfaStart(node);
+        for(LPCTSTR p = name; *p != 0 && node->states[state]->positions.GetSize() > 0; p++)
+        {
+            state = GetDfaNext(node, state, *p);
+        }
+
+        const CArray<int, int>& accept = node->states[state]->accept;
+        for(int i = 0; i < accept.GetSize() && accept[i] < best; i++)
+        {
+            if(Satisfies(m_rules[accept[i]], isDirectory, size, lastWriteTime))
+            {
+                best = accept[i];
+            }
+        }
+    }
+
+    return best == INT_MAX ? RA_NONE : m_rules[best].action;
+}
+
+bool CExclusionRules::Satisfies(const RULE& rule, bool isDirectory, ULONGLONG size, const FILETIME& lastWriteTime) const
+{
+    if(isDirectory)
+    {
+        if(rule.minSize > 0 || rule.maxSize < _UI64_MAX)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if(rule.directoriesOnly || rule.action == RA_SUMMARIZE)
+        {
+            return false;
+        }
+        if(size < rule.minSize || size > rule.maxSize)
+        {
+            return false;
+        }
+    }
+
+    if(rule.minAge > 0 || rule.maxAge < _UI64_MAX)
+    {
+        ULONGLONG t = ((ULONGLONG)lastWriteTime.dwHighDateTime << 32) | lastWriteTime.dwLowDateTime;
+        ULONGLONG age = (m_now > t ? m_now - t : 0);
+        if(age < rule.minAge || age > rule.maxAge)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TCHAR CExclusionRules::FoldChar(TCHAR c)
+{
+    if(c >= _T('A') && c <= _T('Z'))
+    {
+        return (TCHAR)(c + (_T('a') - _T('A')));
+    }
+    if((TBYTE)c < ASCII_COUNT)
+    {
+        return c;
+    }
+    // CharLower() converts a single character, if the high word is zero.
+    return (TCHAR)(UINT_PTR)::CharLower((LPTSTR)(UINT_PTR)(TBYTE)c);
+}
+
+CString CExclusionRules::FoldString(LPCTSTR s)
+{
+    CString folded = s;
+    for(int i = 0; i < folded.GetLength(); i++)
+    {
+        folded.SetAt(i, FoldChar(folded[i]));
+    }
+    return folded;
+}
+
+// Splits at white space. "Quoted" tokens may contain white space.
+//
+void CExclusionRules::Tokenize(const CString& line, CStringArray& tokens)
+{
+    tokens.RemoveAll();
+
+    int i = 0;
+    while(i < line.GetLength())
+    {
+        if(_istspace(line[i]))
+        {
+            i++;
+            continue;
+        }
+
+        CString token;
+        if(line[i] == _T('"'))
+        {
+            i++;
+            while(i < line.GetLength() && line[i] != _T('"'))
+            {
+                token += line[i++];
+            }
+            i++;
+        }
+        else
+        {
+            while(i < line.GetLength() && !_istspace(line[i]))
+            {
+                token += line[i++];
+            }
+        }
+        tokens.Add(token);
+    }
+}
+
+// size>N, size<N (N with optional suffix K, M, G, T), age>Nd, age<Nd
+//
+bool CExclusionRules::ParsePredicate(const CString& token, RULE& rule)
+{
+    CString t = token;
+    t.MakeLower();
+
+    bool isSize;
+    int i;
+    if(t.Left(4) == _T("size"))
+    {
+        isSize = true;
+        i = 4;
+    }
+    else if(t.Left(3) == _T("age"))
+    {
+        isSize = false;
+        i = 3;
+    }
+    else
+    {
+        return false;
+    }
+
+    if(i >= t.GetLength() || (t[i] != _T('<') && t[i] != _T('>')))
+    {
+        return false;
+    }
+    bool greater = (t[i] == _T('>'));
+    i++;
+
+    if(i >= t.GetLength() || !_istdigit(t[i]))
+    {
+        return false;
+    }
+    LPCTSTR start = (LPCTSTR)t + i;
+    LPTSTR end = NULL;
+    ULONGLONG n = _tcstoui64(start, &end, 10);
+
+    CString suffix = end;
+    ULONGLONG unit = 1;
+    if(isSize)
+    {
+        LPCTSTR suffixes = _T("kmgt");
+        if(suffix.GetLength() == 1 && _tcschr(suffixes, suffix[0]) != NULL)
+        {
+            for(LPCTSTR p = suffixes; *p != suffix[0]; p++)
+            {
+                unit *= 1024;
+            }
+            unit *= 1024;
+        }
+        else if(!suffix.IsEmpty())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if(suffix != _T("d"))
+        {
+            return false;
+        }
+        unit = FILETIME_PER_DAY;
+    }
+
+    if(n > _UI64_MAX / unit)
+    {
+        return false;
+    }
+    n *= unit;
+
+    ULONGLONG& minValue = isSize ? rule.minSize : rule.minAge;
+    ULONGLONG& maxValue = isSize ? rule.maxSize : rule.maxAge;
+    if(greater)
+    {
+        if(n == _UI64_MAX)
+        {
+            return false;
+        }
+        minValue = max(minValue, n + 1);
+    }
+    else
+    {
+        if(n == 0)
+        {
+            return false;
+        }
+        maxValue = min(maxValue, n - 1);
+    }
+    return true;
+}
+
+// Matches one folded component against a folded glob with * and ?.
+//
+bool CExclusionRules::GlobMatch(LPCTSTR glob, LPCTSTR s)
+{
+    LPCTSTR star = NULL;
+    LPCTSTR starS = NULL;
+    while(*s != 0)
+    {
+        if(*glob == _T('*'))
+        {
+            star = ++glob;
+            starS = s;
+        }
+        else if(*glob == _T('?') || *glob == *s)
+        {
+            glob++;
+            s++;
+        }
+        else if(star != NULL)
+        {
+            glob = star;
+            s = ++starS;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while(*glob == _T('*'))
+    {
+        glob++;
+    }
+    return *glob == 0;
+}
+
+// Inserts the path glob into the trie.
+// Return: false, if the pattern is invalid.
+//
+bool CExclusionRules::AddRule(const CString& pattern, RULE& rule)
+{
+    CString folded = FoldString(pattern);
+
+    bool anchored = (folded.Left(2) == _T("\\\\") || (folded.GetLength() >= 2 && folded[1] == wds::chrColon));
+
+    if(folded.Right(1) == wds::strBackslash && folded.GetLength() > 1)
+    {
+        rule.directoriesOnly = true;
+        folded = folded.Left(folded.GetLength() - 1);
+    }
+
+    CStringArray components;
+    if(!anchored)
+    {
+        components.Add(strAnyDepth);
+    }
+    int i = 0;
+    while(i < folded.GetLength())
+    {
+        int end = folded.Find(wds::chrBackslash, i);
+        if(end == -1)
+        {
+            end = folded.GetLength();
+        }
+        if(end > i)
+        {
+            components.Add(folded.Mid(i, end - i));
+        }
+        i = end + 1;
+    }
+
+    // A trailing ** means "everything below".
+    if(components.GetSize() > 0 && components[components.GetSize() - 1] == strAnyDepth)
+    {
+        components.Add(wds::strStar);
+    }
+    if(components.GetSize() < 2 && anchored)
+    {
+        return false;
+    }
+
+    int node = 0;
+    for(i = 0; i < components.GetSize() - 1; i++)
+    {
+        const CString& c = components[i];
+        int child = -1;
+
+        if(c == strAnyDepth)
+        {
+            child = m_nodes[node]->anyDepthChild;
+            if(child == -1)
+            {
+                child = AddNode(true);
+                m_nodes[node]->anyDepthChild = child;
+            }
+        }
+        else if(c.FindOneOf(_T("*?")) == -1)
+        {
+            if(!m_nodes[node]->literals.Lookup(c, child))
+            {
+                child = AddNode(false);
+                m_nodes[node]->literals.SetAt(c, child);
+            }
+        }
+        else
+        {
+            TRIENODE *n = m_nodes[node];
+            for(int w = 0; w < n->wildcardGlobs.GetSize(); w++)
+            {
+                if(n->wildcardGlobs[w] == c)
+                {
+                    child = n->wildcardNodes[w];
+                }
+            }
+            if(child == -1)
+            {
+                child = AddNode(false);
+                n->wildcardGlobs.Add(c);
+                n->wildcardNodes.Add(child);
+            }
+        }
+        node = child;
+    }
+
+    CString nameGlob = components[components.GetSize() - 1];
+    if(nameGlob.GetLength() >= 0xFFFF || m_nodes[node]->nameGlobs.GetSize() >= 0xFFFF)
+    {
+        return false;
+    }
+
+    m_nodes[node]->nameGlobs.Add(nameGlob);
+    m_nodes[node]->nameRules.Add((int)m_rules.Add(rule));
+    return true;
+}
+
+int CExclusionRules::AddNode(bool anyDepth)
+{
+    return (int)m_nodes.Add(new TRIENODE(anyDepth));
+}
+
+// Adds node and the nodes reachable via ** (which match zero components).
+//
+void CExclusionRules::AddActive(CArray<int, int>& active, int node) const
+{
+    for(int i = 0; i < active.GetSize(); i++)
+    {
+        if(active[i] == node)
+        {
+            return;
+        }
+    }
+    active.Add(node);
+
+    if(m_nodes[node]->anyDepthChild != -1)
+    {
+        AddActive(active, m_nodes[node]->anyDepthChild);
+    }
+}
+
+// Adds the NFA position and, as * matches the empty string, the positions behind stars.
+//
+void CExclusionRules::AddPosition(const TRIENODE *node, CArray<DWORD, DWORD>& positions, int glob, int position)
+{
+    const CString& g = node->nameGlobs[glob];
+    for(;;)
+    {
+        DWORD pos = MAKELONG(position, glob);
+        int i = 0;
+        while(i < positions.GetSize() && positions[i] < pos)
+        {
+            i++;
+        }
+        if(i == positions.GetSize() || positions[i] != pos)
+        {
+            positions.InsertAt(i, pos);
+        }
+
+        if(position < g.GetLength() && g[position] == _T('*'))
+        {
+            position++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+// Return: index of the DFA state of the (sorted) position set. Creates it, if necessary.
+//
+int CExclusionRules::GetDfaState(TRIENODE *node, const CArray<DWORD, DWORD>& positions)
+{
+    CString key;
+    for(int i = 0; i < positions.GetSize(); i++)
+    {
+        CString s;
+        s.Format(_T("%08X"), positions[i]);
+        key += s;
+    }
+
+    int index;
+    if(node->stateIndex.Lookup(key, index))
+    {
+        return index;
+    }
+
+    DFASTATE *state = new DFASTATE;
+    state->positions.Copy(positions);
+    for(int c = 0; c < ASCII_COUNT; c++)
+    {
+        state->next[c] = -1;
+    }
+    for(int i = 0; i < positions.GetSize(); i++)
+    {
+        int glob = HIWORD(positions[i]);
+        if(LOWORD(positions[i]) == node->nameGlobs[glob].GetLength())
+        {
+            int rule = node->nameRules[glob];
+            int k = 0;
+            while(k < state->accept.GetSize() && state->accept[k] < rule)
+            {
+                k++;
+            }
+            state->accept.InsertAt(k, rule);
+        }
+    }
+
+    index = (int)node->states.Add(state);
+    node->stateIndex.SetAt(key, index);
+    return index;
+}
+
+int CExclusionRules::GetDfaStart(TRIENODE *node)
+{
+    if(node->states.GetSize() == 0)
+    {
+        CArray<DWORD, DWORD> positions;
+        for(int g = 0; g < node->nameGlobs.GetSize(); g++)
+        {
+            AddPosition(node, positions, g, 0);
+        }
+        VERIFY(0 == GetDfaState(node, positions));
+    }
+    return 0;
+}
+
+int CExclusionRules::GetDfaNext(TRIENODE *node, int state, TCHAR c)
+{
+    c = FoldChar(c);
+    UINT u = (TBYTE)c;
+
+    DFASTATE *s = node->states[state];
+    int next;
+    if(u < ASCII_COUNT && s->next[u] != -1)
+    {
+        return s->next[u];
+    }
+    if(u >= ASCII_COUNT && s->other.Lookup(u, next))
+    {
+        return next;
+    }
+
+    CArray<DWORD, DWORD> positions;
+    for(int i = 0; i < s->positions.GetSize(); i++)
+    {
+        int glob = HIWORD(s->positions[i]);
+        int position = LOWORD(s->positions[i]);
+        const CString& g = node->nameGlobs[glob];
+        if(position >= g.GetLength())
+        {
+            continue;
+        }
+        if(g[position] == _T('*'))
+        {
+            AddPosition(node, positions, glob, position);
+        }
+        else if(g[position] == _T('?') || g[position] == c)
+        {
+            AddPosition(node, positions, glob, position + 1);
+        }
+    }
+    next = GetDfaState(node, positions);
+
+    if(u < ASCII_COUNT)
+    {
+        s->next[u] = next;
+    }
+    else
+    {
+        s->other.SetAt(u, next);
+    }
+    return next;
+}
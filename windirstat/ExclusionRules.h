@@ -0,0 +1,111 @@
+// ExclusionRules.h - Declaration of CExclusionRules
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_EXCLUSIONRULES_H__
+#define __WDS_EXCLUSIONRULES_H__
+#pragma once
+
+//
+// What CItem::DoSomeWork() does with a directory entry.
+//
+enum RULEACTION
+{
+    RA_NONE,            // No rule applies
+    RA_EXCLUDE,         // Ignore the entry. The bytes of a file are shown in <Excluded>, a directory is not entered.
+    RA_SUMMARIZE        // Directories only: count the subtree, but don't create items for it
+};
+
+//
+// CExclusionRules. The exclusion and summarize rules of the options,
+// compiled for CItem::DoSomeWork(). One rule per line:
+//
+//     exclude|summarize <pattern> [size>N|size<N] [age>Nd|age<Nd]
+//
+// N may have a suffix K, M, G or T. Size predicates only apply to files,
+// because the size of a directory is not known before it has been read.
+// Lines starting with # are comments. A <pattern> which contains a backslash
+// is a path glob; it is anchored, if it starts with a drive (C:\...) or
+// with \\, otherwise it matches at any depth. A trailing backslash restricts
+// the rule to directories. Any other pattern matches names only.
+// * and ? are wildcards within a component, ** matches any number of
+// components. Matching is case insensitive. The first matching line wins.
+//
+// All patterns are compiled into one trie over the directory components.
+// The last component of each pattern (the name glob) is attached to its
+// trie node; the name globs of a node are compiled into a lazily built DFA.
+// BeginDirectory() walks the trie once per directory, so that Match() costs
+// only one DFA run per active node (usually one) per entry.
+//
+class CExclusionRules
+{
+public:
+    CExclusionRules();
+    ~CExclusionRules();
+
+    bool Compile(LPCTSTR text, CString& error);
+    void Clear();
+    bool IsEmpty() const;
+
+    void BeginDirectory(LPCTSTR path);
+    RULEACTION Match(LPCTSTR name, bool isDirectory, ULONGLONG size, const FILETIME& lastWriteTime);
+
+    // Also used by CItemQuery
+    static CString FoldString(LPCTSTR s);
+    static bool GlobMatch(LPCTSTR glob, LPCTSTR s);
+
+private:
+    struct RULE
+    {
+        RULEACTION action;
+        bool directoriesOnly;
+        ULONGLONG minSize;      // Bytes, inclusive bounds
+        ULONGLONG maxSize;
+        ULONGLONG minAge;       // 100 ns units, inclusive bounds
+        ULONGLONG maxAge;
+    };
+
+    struct TRIENODE;
+    struct DFASTATE;
+
+    static TCHAR FoldChar(TCHAR c);
+    static void Tokenize(const CString& line, CStringArray& tokens);
+    static bool ParsePredicate(const CString& token, RULE& rule);
+    static void AddPosition(const TRIENODE *node, CArray<DWORD, DWORD>& positions, int glob, int position);
+    static int GetDfaState(TRIENODE *node, const CArray<DWORD, DWORD>& positions);
+    static int GetDfaStart(TRIENODE *node);
+    static int GetDfaNext(TRIENODE *node, int state, TCHAR c);
+
+    bool AddRule(const CString& pattern, RULE& rule);
+    int AddNode(bool anyDepth);
+    void AddActive(CArray<int, int>& active, int node) const;
+    bool Satisfies(const RULE& rule, bool isDirectory, ULONGLONG size, const FILETIME& lastWriteTime) const;
+
+    CArray<RULE, RULE&> m_rules;            // In the order of the lines
+    CArray<TRIENODE *, TRIENODE *> m_nodes; // m_nodes[0] is the root
+    CArray<int, int> m_active;              // Nodes matching the current directory
+    ULONGLONG m_now;                        // Reference time of the age predicates
+};
+
+#endif // __WDS_EXCLUSIONRULES_H__
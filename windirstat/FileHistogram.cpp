@@ -0,0 +1,174 @@
+// FileHistogram.cpp - Implementation of CFileHistogram
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "FileHistogram.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const ULONGLONG DAY = (ULONGLONG)24 * 60 * 60 * 10000000;   // in FILETIME units (100 ns)
+
+    // Upper bounds of the age buckets. The last bucket is open.
+    const ULONGLONG ageLimits[CFileHistogram::AGEBUCKETS - 1] = {
+        DAY,
+        7 * DAY,
+        30 * DAY,
+        91 * DAY,
+        182 * DAY,
+        365 * DAY,
+        2 * 365 * DAY,
+        5 * 365 * DAY,
+        10 * 365 * DAY
+    };
+
+    const LPCTSTR ageLabels[CFileHistogram::AGEBUCKETS] = {
+        _T("< 1 d"), _T("< 1 w"), _T("< 1 m"), _T("< 3 m"), _T("< 6 m"),
+        _T("< 1 y"), _T("< 2 y"), _T("< 5 y"), _T("< 10 y"), _T(">= 10 y")
+    };
+
+    const LPCTSTR sizeLabels[CFileHistogram::SIZEBUCKETS] = {
+        _T("< 1 K"), _T("< 4 K"), _T("< 16 K"), _T("< 64 K"), _T("< 256 K"),
+        _T("< 1 M"), _T("< 4 M"), _T("< 16 M"), _T("< 64 M"), _T("< 256 M"),
+        _T("< 1 G"), _T("< 4 G"), _T("< 16 G"), _T(">= 16 G")
+    };
+}
+
+// Files with a modification time in the future count as new.
+//
+int CFileHistogram::GetAgeBucket(const FILETIME& t)
+{
+    ULONGLONG time = ((ULONGLONG)t.dwHighDateTime << 32) | t.dwLowDateTime;
+    ULONGLONG now = GetReferenceTime();
+    ULONGLONG age = (time < now ? now - time : 0);
+
+    int i = 0;
+    while(i < AGEBUCKETS - 1 && age >= ageLimits[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+int CFileHistogram::GetSizeBucket(ULONGLONG size)
+{
+    // Bucket i (i > 0) holds the sizes in [1 KB * 4^(i-1), 1 KB * 4^i).
+    int i = 0;
+    for(ULONGLONG limit = 1024; i < SIZEBUCKETS - 1 && size >= limit; limit <<= 2)
+    {
+        i++;
+    }
+    return i;
+}
+
+LPCTSTR CFileHistogram::GetAgeBucketLabel(int i)
+{
+    ASSERT(i >= 0 && i < AGEBUCKETS);
+    return ageLabels[i];
+}
+
+LPCTSTR CFileHistogram::GetSizeBucketLabel(int i)
+{
+    ASSERT(i >= 0 && i < SIZEBUCKETS);
+    return sizeLabels[i];
+}
+
+ULONGLONG CFileHistogram::GetReferenceTime()
+{
+    static ULONGLONG _reference = 0;
+    if(_reference == 0)
+    {
+        FILETIME now;
+        ::GetSystemTimeAsFileTime(&now);
+        _reference = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+    }
+    return _reference;
+}
+
+CFileHistogram::CFileHistogram()
+{
+    ZeroMemory(m_ageBytes, sizeof(m_ageBytes));
+    ZeroMemory(m_sizeCounts, sizeof(m_sizeCounts));
+}
+
+void CFileHistogram::AddFile(ULONGLONG size, const FILETIME& t)
+{
+    m_ageBytes[GetAgeBucket(t)] += size;
+    m_sizeCounts[GetSizeBucket(size)]++;
+}
+
+void CFileHistogram::SubtractFile(ULONGLONG size, const FILETIME& t)
+{
+    int age = GetAgeBucket(t);
+    int bucket = GetSizeBucket(size);
+    ASSERT(m_ageBytes[age] >= size);
+    ASSERT(m_sizeCounts[bucket] > 0);
+
+    m_ageBytes[age] -= size;
+    m_sizeCounts[bucket]--;
+}
+
+void CFileHistogram::Add(const CFileHistogram& other)
+{
+    int i = 0;
+    for(i = 0; i < AGEBUCKETS; i++)
+    {
+        m_ageBytes[i] += other.m_ageBytes[i];
+    }
+    for(i = 0; i < SIZEBUCKETS; i++)
+    {
+        m_sizeCounts[i] += other.m_sizeCounts[i];
+    }
+}
+
+void CFileHistogram::Subtract(const CFileHistogram& other)
+{
+    int i = 0;
+    for(i = 0; i < AGEBUCKETS; i++)
+    {
+        ASSERT(m_ageBytes[i] >= other.m_ageBytes[i]);
+        m_ageBytes[i] -= other.m_ageBytes[i];
+    }
+    for(i = 0; i < SIZEBUCKETS; i++)
+    {
+        ASSERT(m_sizeCounts[i] >= other.m_sizeCounts[i]);
+        m_sizeCounts[i] -= other.m_sizeCounts[i];
+    }
+}
+
+ULONGLONG CFileHistogram::GetAgeBytes(int i) const
+{
+    ASSERT(i >= 0 && i < AGEBUCKETS);
+    return m_ageBytes[i];
+}
+
+ULONGLONG CFileHistogram::GetSizeCount(int i) const
+{
+    ASSERT(i >= 0 && i < SIZEBUCKETS);
+    return m_sizeCounts[i];
+}
@@ -0,0 +1,73 @@
+// FileHistogram.h - Declaration of CFileHistogram
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_FILEHISTOGRAM_H__
+#define __WDS_FILEHISTOGRAM_H__
+#pragma once
+
+//
+// CFileHistogram. Fixed bucket histograms of the files in a subtree:
+// the bytes by age and the number of files by size.
+//
+// Every directory item has one, which is maintained incrementally like the
+// other subtree totals (CItem::UpwardAddFileHistogram() etc.). So the
+// histograms can be subtracted again, when a subtree is removed.
+//
+// The ages are relative to a reference time, which is taken once per
+// process. Otherwise the bucket of a file could change while it is counted.
+// The size buckets grow by factors of 4, starting with 1 KB.
+//
+class CFileHistogram
+{
+public:
+    enum
+    {
+        AGEBUCKETS = 10,    // < 1 day, 1 week, 1, 3, 6 months, 1, 2, 5, 10 years, older
+        SIZEBUCKETS = 14    // < 1 KB, 4 KB, 16 KB, ..., 4 GB, 16 GB, larger
+    };
+
+    static int GetAgeBucket(const FILETIME& t);
+    static int GetSizeBucket(ULONGLONG size);
+    static LPCTSTR GetAgeBucketLabel(int i);
+    static LPCTSTR GetSizeBucketLabel(int i);
+
+    CFileHistogram();
+
+    void AddFile(ULONGLONG size, const FILETIME& t);
+    void SubtractFile(ULONGLONG size, const FILETIME& t);
+    void Add(const CFileHistogram& other);
+    void Subtract(const CFileHistogram& other);
+
+    ULONGLONG GetAgeBytes(int i) const;
+    ULONGLONG GetSizeCount(int i) const;
+
+private:
+    static ULONGLONG GetReferenceTime();
+
+    ULONGLONG m_ageBytes[AGEBUCKETS];       // Bytes of the files by age bucket
+    ULONGLONG m_sizeCounts[SIZEBUCKETS];    // # Files by size bucket
+};
+
+#endif // __WDS_FILEHISTOGRAM_H__
@@ -0,0 +1,566 @@
+// HashCache.cpp - Implementation of CHashCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "HashCache.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const DWORD MAGIC = 0x48534457; // "WDSH"
+
+    // Increment, if the meaning of the hashes changes (e.g. PARTIALHASHBYTES).
+    const DWORD VERSION = 1;
+
+    // Compaction is due, when the log has more than COMPACTIONMINLOG records
+    // and more than 1/COMPACTIONRATIO of the records of the sorted region.
+    const int COMPACTIONMINLOG = 4096;
+    const int COMPACTIONRATIO = 4;
+
+    // Records per WriteFile() during compaction
+    const int WRITEBATCH = 4096;
+
+    const LPCTSTR CACHEFOLDER = _T("\\WinDirStat");
+    const LPCTSTR CACHEFILE = _T("\\hashcache.dat");
+
+    void WriteAll(HANDLE file, const void *data, DWORD bytes, LPCTSTR path)
+    {
+        DWORD written = 0;
+        if(!::WriteFile(file, data, bytes, &written, NULL))
+        {
+            MdThrowLastWinerror(path);
+        }
+        if(written != bytes)
+        {
+            MdThrowWinError(ERROR_HANDLE_DISK_FULL, path);
+        }
+    }
+
+    template<class T> int compare(T a, T b)
+    {
+        return a < b ? -1 : a == b ? 0 : 1;
+    }
+}
+
+// The cache lives in the local (non-roaming) application data folder.
+// Return: empty string, if the folder is not available.
+//
+CString CHashCache::GetDefaultPath()
+{
+    CString folder;
+    BOOL b = ::SHGetSpecialFolderPath(NULL, folder.GetBuffer(MAX_PATH), CSIDL_LOCAL_APPDATA, true);
+    folder.ReleaseBuffer();
+    if(!b)
+    {
+        return wds::strEmpty;
+    }
+
+    folder += CACHEFOLDER;
+    ::CreateDirectory(folder, NULL); // may exist already
+
+    return folder + CACHEFILE;
+}
+
+CHashCache::CHashCache()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(NULL)
+    , m_sorted(NULL)
+    , m_sortedCount(0)
+{
+}
+
+CHashCache::~CHashCache()
+{
+    try
+    {
+        Close();
+    }
+    catch(CException *pe)
+    {
+        pe->Delete();
+    }
+}
+
+// Opens or creates the cache file. A file of another version is
+// started over. The caller may go on without the cache, if this throws.
+//
+void CHashCache::Open(LPCTSTR path)
+{
+    CSingleLock lock(&m_cs, true);
+    ASSERT(!IsOpen());
+
+    m_path = path;
+    OpenFile();
+
+    // E.g. the last session has been terminated. If compaction fails,
+    // we continue with the log.
+    try
+    {
+        if(IsCompactionDue())
+        {
+            Compact();
+        }
+    }
+    catch(CException *pe)
+    {
+        VTRACE(_T("Hash cache %s: %s"), (LPCTSTR)m_path, (LPCTSTR)MdGetExceptionMessage(pe));
+        pe->Delete();
+    }
+}
+
+// Compacts the cache, if due.
+//
+void CHashCache::Close()
+{
+    CSingleLock lock(&m_cs, true);
+    if(!IsOpen())
+    {
+        return;
+    }
+
+    try
+    {
+        if(IsCompactionDue())
+        {
+            Compact();
+        }
+    }
+    catch(CException *)
+    {
+        CloseFile();
+        throw;
+    }
+    CloseFile();
+}
+
+bool CHashCache::IsOpen()
+{
+    CSingleLock lock(&m_cs, true);
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+// info is from GetFileInformationByHandle().
+// Return: true, if the hashes of the file in its current state are known.
+//
+bool CHashCache::Lookup(const BY_HANDLE_FILE_INFORMATION& info, FILEHASH& hash)
+{
+    CSingleLock lock(&m_cs, true);
+    if(!IsOpen())
+    {
+        return false;
+    }
+
+    HASHCACHEKEY key = GetKey(info);
+
+    const RECORD *record = NULL;
+    int i;
+    if(m_logIndex.Lookup(key, i))
+    {
+        record = &m_log[i];
+    }
+    else
+    {
+        record = FindSorted(key);
+    }
+
+    ULONGLONG size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    if(record == NULL || record->size != size || ::CompareFileTime(&record->lastChange, &info.ftLastWriteTime) != 0)
+    {
+        return false;
+    }
+
+    hash.size = record->size;
+    hash.lastChange = record->lastChange;
+    hash.partialHash = record->partialHash;
+    hash.fullHash = record->fullHash;
+    hash.hasFullHash = ((record->flags & HRF_FULLHASH) != 0);
+    return true;
+}
+
+// Appends the hashes of the file in the state described by info.
+// The cache is only an optimization, so errors are not reported;
+// after an error the cache is closed.
+//
+void CHashCache::Add(const BY_HANDLE_FILE_INFORMATION& info, const FILEHASH& hash)
+{
+    CSingleLock lock(&m_cs, true);
+    if(!IsOpen())
+    {
+        return;
+    }
+
+    HASHCACHEKEY key = GetKey(info);
+
+    RECORD record;
+    record.volumeSerial = key.volumeSerial;
+    record.flags = (hash.hasFullHash ? HRF_FULLHASH : 0);
+    record.fileIndex = key.fileIndex;
+    record.size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    record.lastChange = info.ftLastWriteTime;
+    record.partialHash = hash.partialHash;
+    record.fullHash = (hash.hasFullHash ? hash.fullHash : 0);
+
+    try
+    {
+        AddToLog(record);
+
+        if(IsCompactionDue())
+        {
+            Compact();
+        }
+    }
+    catch(CException *pe)
+    {
+        VTRACE(_T("Hash cache %s: %s"), (LPCTSTR)m_path, (LPCTSTR)MdGetExceptionMessage(pe));
+        pe->Delete();
+        CloseFile();
+    }
+}
+
+// Merges the log into the sorted region. The new file is written beside
+// the old one and then replaces it, so a failure leaves the old file intact.
+//
+void CHashCache::Compact()
+{
+    CSingleLock lock(&m_cs, true);
+    if(!IsOpen())
+    {
+        return;
+    }
+
+    CString temp = m_path + _T(".tmp");
+    try
+    {
+        WriteCompacted(temp);
+    }
+    catch(CException *)
+    {
+        ::DeleteFile(temp);
+        throw;
+    }
+
+    CloseFile();
+
+    BOOL moved = ::MoveFileEx(temp, m_path, MOVEFILE_REPLACE_EXISTING);
+    DWORD error = ::GetLastError();
+    if(!moved)
+    {
+        ::DeleteFile(temp);
+    }
+
+    // The new file or, if the move has failed, the old one
+    OpenFile();
+
+    if(!moved)
+    {
+        MdThrowWinError(error, m_path);
+    }
+}
+
+HASHCACHEKEY CHashCache::GetKey(const BY_HANDLE_FILE_INFORMATION& info)
+{
+    HASHCACHEKEY key;
+    key.volumeSerial = info.dwVolumeSerialNumber;
+    key.fileIndex = ((ULONGLONG)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    return key;
+}
+
+HASHCACHEKEY CHashCache::GetKey(const RECORD& record)
+{
+    HASHCACHEKEY key;
+    key.volumeSerial = record.volumeSerial;
+    key.fileIndex = record.fileIndex;
+    return key;
+}
+
+int CHashCache::Compare(const HASHCACHEKEY& key, const RECORD& record)
+{
+    int r = compare(key.volumeSerial, record.volumeSerial);
+    if(r == 0)
+    {
+        r = compare(key.fileIndex, record.fileIndex);
+    }
+    return r;
+}
+
+int __cdecl CHashCache::_compareRecords(const void *p1, const void *p2)
+{
+    const RECORD *record1 = (const RECORD *)p1;
+    const RECORD *record2 = (const RECORD *)p2;
+    return Compare(GetKey(*record1), *record2);
+}
+
+// Opens m_path, maps the sorted region and reads the log.
+// On failure, nothing is left open.
+//
+void CHashCache::OpenFile()
+{
+    ASSERT(m_file == INVALID_HANDLE_VALUE);
+
+    try
+    {
+        m_file = ::CreateFile(m_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(m_file == INVALID_HANDLE_VALUE)
+        {
+            MdThrowLastWinerror(m_path);
+        }
+
+        LARGE_INTEGER size;
+        if(!::GetFileSizeEx(m_file, &size))
+        {
+            MdThrowLastWinerror(m_path);
+        }
+
+        HEADER header;
+        DWORD read = 0;
+        bool valid = (ULONGLONG)size.QuadPart >= sizeof(header)
+            && ::ReadFile(m_file, &header, sizeof(header), &read, NULL) && read == sizeof(header)
+            && header.magic == MAGIC && header.version == VERSION
+            && header.sortedCount <= ((ULONGLONG)size.QuadPart - sizeof(header)) / sizeof(RECORD)
+            && header.sortedCount <= INT_MAX;
+
+        if(!valid)
+        {
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.sortedCount = 0;
+
+            if(INVALID_SET_FILE_POINTER == ::SetFilePointer(m_file, 0, NULL, FILE_BEGIN) || !::SetEndOfFile(m_file))
+            {
+                MdThrowLastWinerror(m_path);
+            }
+            WriteAll(m_file, &header, sizeof(header), m_path);
+            size.QuadPart = sizeof(header);
+        }
+
+        m_sortedCount = (int)header.sortedCount;
+
+        // Before the mapping exists, which would prevent SetEndOfFile().
+        ReadLog(((ULONGLONG)size.QuadPart - sizeof(HEADER)) / sizeof(RECORD));
+
+        if(m_sortedCount > 0)
+        {
+            ULONGLONG bytes = sizeof(HEADER) + (ULONGLONG)m_sortedCount * sizeof(RECORD);
+
+            m_mapping = ::CreateFileMapping(m_file, NULL, PAGE_READONLY, (DWORD)(bytes >> 32), (DWORD)bytes, NULL);
+            if(m_mapping == NULL)
+            {
+                MdThrowLastWinerror(m_path);
+            }
+
+            const BYTE *view = (const BYTE *)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, (SIZE_T)bytes);
+            if(view == NULL)
+            {
+                MdThrowLastWinerror(m_path);
+            }
+            m_sorted = (const RECORD *)(view + sizeof(HEADER));
+        }
+    }
+    catch(CException *)
+    {
+        CloseFile();
+        throw;
+    }
+}
+
+void CHashCache::CloseFile()
+{
+    if(m_sorted != NULL)
+    {
+        ::UnmapViewOfFile((const BYTE *)m_sorted - sizeof(HEADER));
+        m_sorted = NULL;
+    }
+    if(m_mapping != NULL)
+    {
+        ::CloseHandle(m_mapping);
+        m_mapping = NULL;
+    }
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_sortedCount = 0;
+    m_log.RemoveAll();
+    m_logIndex.RemoveAll();
+}
+
+// Reads the records behind the sorted region into m_log.
+// recordCount is the number of complete records in the file.
+//
+void CHashCache::ReadLog(ULONGLONG recordCount)
+{
+    m_log.RemoveAll();
+    m_logIndex.RemoveAll();
+
+    LARGE_INTEGER pos;
+    pos.QuadPart = sizeof(HEADER) + (LONGLONG)m_sortedCount * sizeof(RECORD);
+    if(!::SetFilePointerEx(m_file, pos, NULL, FILE_BEGIN))
+    {
+        MdThrowLastWinerror(m_path);
+    }
+
+    int count = (int)(recordCount - m_sortedCount);
+    if(count > 0)
+    {
+        m_log.SetSize(count);
+
+        DWORD bytes = count * sizeof(RECORD);
+        DWORD read = 0;
+        if(!::ReadFile(m_file, m_log.GetData(), bytes, &read, NULL) || read != bytes)
+        {
+            MdThrowLastWinerror(m_path);
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            m_logIndex.SetAt(GetKey(m_log[i]), i);
+        }
+    }
+
+    // Cuts off an incomplete record, so that the next one is appended properly.
+    if(!::SetEndOfFile(m_file))
+    {
+        MdThrowLastWinerror(m_path);
+    }
+}
+
+// The file pointer is always at the end of the file.
+//
+void CHashCache::AddToLog(const RECORD& record)
+{
+    WriteAll(m_file, &record, sizeof(record), m_path);
+    m_logIndex.SetAt(GetKey(record), (int)m_log.Add(record));
+}
+
+const CHashCache::RECORD *CHashCache::FindSorted(const HASHCACHEKEY& key)
+{
+    int low = 0;
+    int high = m_sortedCount;
+    while(low < high)
+    {
+        int middle = low + (high - low) / 2;
+        int r = Compare(key, m_sorted[middle]);
+        if(r == 0)
+        {
+            return &m_sorted[middle];
+        }
+        if(r < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+bool CHashCache::IsCompactionDue()
+{
+    int logCount = (int)m_log.GetSize();
+    return logCount > COMPACTIONMINLOG && logCount > m_sortedCount / COMPACTIONRATIO;
+}
+
+// Writes the sorted region merged with the latest log record of each key.
+//
+void CHashCache::WriteCompacted(LPCTSTR path)
+{
+    CArray<RECORD, const RECORD&> log;
+    log.SetSize(m_logIndex.GetCount());
+
+    int n = 0;
+    POSITION pos = m_logIndex.GetStartPosition();
+    while(pos != NULL)
+    {
+        HASHCACHEKEY key;
+        int i;
+        m_logIndex.GetNextAssoc(pos, key, i);
+        log[n++] = m_log[i];
+    }
+    qsort(log.GetData(), log.GetSize(), sizeof(RECORD), &_compareRecords);
+
+    HANDLE file = ::CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        MdThrowLastWinerror(path);
+    }
+
+    try
+    {
+        HEADER header;
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.sortedCount = 0;
+        WriteAll(file, &header, sizeof(header), path);
+
+        CArray<RECORD, const RECORD&> batch;
+        batch.SetSize(0, WRITEBATCH);
+
+        int i = 0;
+        int j = 0;
+        while(i < m_sortedCount || j < log.GetSize())
+        {
+            int r = (i == m_sortedCount ? 1 : j == log.GetSize() ? -1 : _compareRecords(&m_sorted[i], &log[j]));
+            if(r < 0)
+            {
+                batch.Add(m_sorted[i++]);
+            }
+            else
+            {
+                // The log record supersedes the sorted one.
+                if(r == 0)
+                {
+                    i++;
+                }
+                batch.Add(log[j++]);
+            }
+
+            if(batch.GetSize() == WRITEBATCH || (i == m_sortedCount && j == log.GetSize()))
+            {
+                WriteAll(file, batch.GetData(), (DWORD)(batch.GetSize() * sizeof(RECORD)), path);
+                header.sortedCount += batch.GetSize();
+                batch.RemoveAll();
+            }
+        }
+
+        if(INVALID_SET_FILE_POINTER == ::SetFilePointer(file, 0, NULL, FILE_BEGIN))
+        {
+            MdThrowLastWinerror(path);
+        }
+        WriteAll(file, &header, sizeof(header), path);
+    }
+    catch(CException *)
+    {
+        ::CloseHandle(file);
+        throw;
+    }
+    ::CloseHandle(file);
+}
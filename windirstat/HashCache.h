@@ -0,0 +1,141 @@
+// HashCache.h - Declaration of CHashCache
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_HASHCACHE_H__
+#define __WDS_HASHCACHE_H__
+#pragma once
+
+#include "DuplicateFinder.h"
+
+//
+// Identity of a file, which survives renames and moves within the volume
+// (see BY_HANDLE_FILE_INFORMATION).
+//
+struct HASHCACHEKEY
+{
+    DWORD volumeSerial;
+    ULONGLONG fileIndex;
+};
+
+inline bool operator == (const HASHCACHEKEY& k1, const HASHCACHEKEY& k2)
+{
+    return k1.volumeSerial == k2.volumeSerial && k1.fileIndex == k2.fileIndex;
+}
+
+// For CMap<HASHCACHEKEY, const HASHCACHEKEY&, ...>
+template<> AFX_INLINE UINT AFXAPI HashKey<const HASHCACHEKEY&>(const HASHCACHEKEY& key)
+{
+    return (UINT)(key.fileIndex ^ (key.fileIndex >> 32)) ^ key.volumeSerial;
+}
+
+//
+// CHashCache. Persistent cache of the content hashes (FILEHASH) of files,
+// keyed by volume serial number and file index. An entry is only valid,
+// if size and last write time of the file are unchanged, so unchanged files
+// need not be read again, even in later sessions or under a new name.
+//
+// The file consists of a header, a region of records sorted by key and an
+// unsorted append-only log:
+//
+// - The sorted region is memory mapped and searched binary. It is never
+//   modified in place.
+// - New records are appended to the log and indexed in memory. A later
+//   record supersedes an earlier one with the same key.
+// - When the log grows larger than a fraction of the sorted region, the
+//   cache is compacted: log and sorted region are merged into a new file,
+//   which replaces the old one. Superseded records are dropped.
+//
+// A crash can at most lose the last, incomplete record.
+//
+// The class doesn't depend on the GUI. All methods may be called by any
+// thread; Open() and Close() throw CException *.
+//
+class CHashCache
+{
+public:
+    static CString GetDefaultPath();
+
+    CHashCache();
+    ~CHashCache();
+
+    void Open(LPCTSTR path);
+    void Close();
+    bool IsOpen();
+
+    bool Lookup(const BY_HANDLE_FILE_INFORMATION& info, FILEHASH& hash);
+    void Add(const BY_HANDLE_FILE_INFORMATION& info, const FILEHASH& hash);
+
+    void Compact();
+
+private:
+    struct HEADER
+    {
+        DWORD magic;
+        DWORD version;
+        ULONGLONG sortedCount;  // Records in the sorted region
+    };
+
+    enum
+    {
+        HRF_FULLHASH = 0x1      // fullHash is valid
+    };
+
+    struct RECORD
+    {
+        DWORD volumeSerial;
+        DWORD flags;
+        ULONGLONG fileIndex;
+        ULONGLONG size;
+        FILETIME lastChange;
+        ULONGLONG partialHash;
+        ULONGLONG fullHash;
+    };
+
+    typedef CMap<HASHCACHEKEY, const HASHCACHEKEY&, int, int> CLogIndex;
+
+    static HASHCACHEKEY GetKey(const BY_HANDLE_FILE_INFORMATION& info);
+    static HASHCACHEKEY GetKey(const RECORD& record);
+    static int Compare(const HASHCACHEKEY& key, const RECORD& record);
+    static int __cdecl _compareRecords(const void *p1, const void *p2);
+
+    void OpenFile();
+    void CloseFile();
+    void ReadLog(ULONGLONG recordCount);
+    void AddToLog(const RECORD& record);
+    const RECORD *FindSorted(const HASHCACHEKEY& key);
+    bool IsCompactionDue();
+    void WriteCompacted(LPCTSTR path);
+
+    CCriticalSection m_cs;      // Synchronizes all the following members
+    CString m_path;
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const RECORD *m_sorted;     // Mapped view of the sorted region, or NULL
+    int m_sortedCount;
+    CArray<RECORD, const RECORD&> m_log;    // The records in the log (read and appended)
+    CLogIndex m_logIndex;                   // Key -> index of the latest record in m_log
+};
+
+#endif // __WDS_HASHCACHE_H__
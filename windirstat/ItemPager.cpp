@@ -0,0 +1,388 @@
+// ItemPager.cpp - Implementation of CItemPager
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
+#include "ItemPager.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    // Estimated memory of an item: the CItem, its name, the pointer in
+    // the children array of the parent and the heap overhead.
+    // Directories have a CFileHistogram in addition, but they are rare.
+    const ULONGLONG ITEMBYTES = sizeof(CItem) + 64;
+
+    // Smaller subtrees are not worth a page.
+    const ULONGLONG MINPAGEITEMS = 1000;
+
+    // Trim() checks the budget at most once per TRIMINTERVAL.
+    const DWORD TRIMINTERVAL = 1000; // ms
+
+    // Trim() pages out, until this fraction of the budget is left.
+    const double LOWWATERMARK = 0.75;
+}
+
+CFile CItemPager::_file;
+CArray<CItemPager::PAGE *, CItemPager::PAGE *> CItemPager::_pages;
+CItemPager::CPageMap CItemPager::_paged;
+CItemPager::CLastUseMap CItemPager::_lastUse;
+ULONGLONG CItemPager::_pagedOutItems = 0;
+DWORD CItemPager::_lastTrim = 0;
+bool CItemPager::_releasing = false;
+CString CItemPager::_errorPath;
+CString CItemPager::_errorMessage;
+
+// Called by CDirstatDoc::Work(), also while the scan is running.
+// If the items exceed the memory budget, pages out the coldest
+// subtrees of root, until the low water mark is reached.
+// Return: true, if something has been paged out.
+//
+bool CItemPager::Trim(CItem *root)
+{
+    ULONGLONG budget = (ULONGLONG)GetOptions()->GetMemoryBudget() * 1024 * 1024;
+    if(budget == 0 || root == NULL)
+    {
+        return false;
+    }
+
+    DWORD now = ::GetTickCount();
+    if(now - _lastTrim < TRIMINTERVAL)
+    {
+        return false;
+    }
+    _lastTrim = now;
+
+    if(GetResidentItems() * ITEMBYTES <= budget)
+    {
+        return false;
+    }
+
+    CTraceScope scope(TE_PAGEOUT);
+
+    CArray<CItem *, CItem *> items;
+    root->CollectPagingCandidates(items, MINPAGEITEMS);
+
+    CArray<CANDIDATE, CANDIDATE&> candidates;
+    candidates.SetSize(items.GetSize());
+    int i = 0;
+    for(i = 0; i < items.GetSize(); i++)
+    {
+        DWORD lastUse = 0;
+        candidates[i].item = items[i];
+        candidates[i].age = _lastUse.Lookup(items[i], lastUse) ? now - lastUse : ULONG_MAX;
+    }
+    qsort(candidates.GetData(), candidates.GetSize(), sizeof(CANDIDATE), &_compareCandidates);
+
+    ULONGLONG lowWaterMark = (ULONGLONG)(budget * LOWWATERMARK);
+    int pagedOut = 0;
+    for(i = 0; i < candidates.GetSize() && GetResidentItems() * ITEMBYTES > lowWaterMark; i++)
+    {
+        if(!PageOut(candidates[i].item))
+        {
+            break;
+        }
+        pagedOut++;
+    }
+
+    scope.SetArgs(pagedOut, GetPagedOutItems());
+    return pagedOut > 0;
+}
+
+// Called by CDirstatDoc, before the item tree is deleted.
+//
+void CItemPager::Reset()
+{
+    for(int i = 0; i < _pages.GetSize(); i++)
+    {
+        delete _pages[i];
+    }
+    _pages.RemoveAll();
+    _paged.RemoveAll();
+    _lastUse.RemoveAll();
+    _pagedOutItems = 0;
+    _errorPath.Empty();
+    _errorMessage.Empty();
+
+    if(_file.m_hFile != CFile::hFileNull)
+    {
+        _file.Close(); // FILE_FLAG_DELETE_ON_CLOSE
+    }
+}
+
+// Reads the children of item back and deletes its page.
+// Exceptions of CFile and CArchive are passed to the caller, which
+// deletes the children read so far and then calls Forget().
+//
+void CItemPager::PageIn(CItem *item)
+{
+    CTraceScope scope(TE_PAGEIN);
+
+    int id = GetPageId(item);
+    PAGE *page = _pages[id];
+
+    _file.Seek(page->offset, CFile::begin);
+    CArchive ar(&_file, CArchive::load);
+    item->ReadChildren(ar);
+    ar.Close();
+
+    _paged.RemoveKey(item);
+    _pages[id] = NULL;
+    _pagedOutItems -= page->items;
+    _lastUse.SetAt(item, ::GetTickCount());
+
+    scope.SetArgs(page->items, 0);
+    delete page;
+}
+
+// Called by the destructor of a directory item.
+//
+void CItemPager::Forget(const CItem *item)
+{
+    if(_lastUse.IsEmpty() && _paged.IsEmpty())
+    {
+        return;
+    }
+
+    _lastUse.RemoveKey(item);
+
+    int id = 0;
+    if(_paged.Lookup(item, id))
+    {
+        _paged.RemoveKey(item);
+
+        // If PageOut() is deleting the children, the page of a nested
+        // paged out directory is referenced by the new page.
+        if(!_releasing)
+        {
+            FreePage(id);
+        }
+    }
+}
+
+// Called by CItem::PageIn(), when the children are lost.
+// Only the first error is kept, until CDirstatDoc::Work() takes it.
+//
+void CItemPager::SetError(const CItem *item, CException *pe)
+{
+    if(!_errorPath.IsEmpty())
+    {
+        return;
+    }
+
+    TCHAR buffer[1024];
+    if(!pe->GetErrorMessage(buffer, countof(buffer)))
+    {
+        buffer[0] = 0;
+    }
+    _errorPath = item->GetPath();
+    _errorMessage = buffer;
+}
+
+// Return: false, if there is no error to report.
+//
+bool CItemPager::TakeError(CString& path, CString& message)
+{
+    if(_errorPath.IsEmpty())
+    {
+        return false;
+    }
+    path = _errorPath;
+    message = _errorMessage;
+    _errorPath.Empty();
+    _errorMessage.Empty();
+    return true;
+}
+
+const CExtensionData *CItemPager::GetExtensionData(const CItem *item)
+{
+    return &_pages[GetPageId(item)]->extensions;
+}
+
+ULONGLONG CItemPager::GetResidentItems()
+{
+    return CScanStatistics::GetItemsAlive();
+}
+
+ULONGLONG CItemPager::GetPagedOutItems()
+{
+    return _pagedOutItems;
+}
+
+// Whether the item must stay in memory, because something refers to it.
+//
+bool CItemPager::IsPinned(const CItem *item)
+{
+    // The directory list shows the item (or a descendant).
+    if(item->IsVisible())
+    {
+        return true;
+    }
+
+    if(GetDocument()->GetZoomItem() != NULL && item->IsAncestorOf(GetDocument()->GetZoomItem()))
+    {
+        return true;
+    }
+
+    for(size_t i = 0; i < GetDocument()->GetSelectionCount(); i++)
+    {
+        if(item->IsAncestorOf(GetDocument()->GetSelection(i)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Appends the children of item to the file and deletes them.
+// Return: false, if the file could not be written.
+//
+bool CItemPager::PageOut(CItem *item)
+{
+    ASSERT(item->IsDone());
+    ASSERT(!item->IsPagedOut());
+
+    if(!OpenFile())
+    {
+        return false;
+    }
+
+    PAGE *page = new PAGE;
+    page->items = 0;
+
+    // Before the children are gone. Nested pages are included.
+    item->RecurseCollectExtensionData(&page->extensions);
+
+    try
+    {
+        page->offset = _file.SeekToEnd();
+        CArchive ar(&_file, CArchive::store);
+        item->WriteChildren(ar, page->items, page->nested);
+        ar.Close();
+    }
+    catch(CException *pe)
+    {
+        pe->Delete();
+        delete page;
+        return false;
+    }
+
+    int id = (int)_pages.Add(page);
+    _pagedOutItems += page->items;
+
+    _releasing = true;
+    item->ReleaseChildren();
+    _releasing = false;
+
+    _paged.SetAt(item, id);
+
+    return true;
+}
+
+// Return: false, if the temporary file could not be created.
+//
+bool CItemPager::OpenFile()
+{
+    if(_file.m_hFile != CFile::hFileNull)
+    {
+        return true;
+    }
+
+    TCHAR path[MAX_PATH];
+    TCHAR fileName[MAX_PATH];
+    if(::GetTempPath(countof(path), path) == 0 || ::GetTempFileName(path, _T("wds"), 0, fileName) == 0)
+    {
+        return false;
+    }
+
+    HANDLE h = ::CreateFile(fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if(h == INVALID_HANDLE_VALUE)
+    {
+        VTRACE(_T("Cannot create %s: %s"), fileName, MdGetWinErrorText(::GetLastError()));
+        ::DeleteFile(fileName);
+        return false;
+    }
+
+    _file.m_hFile = h;
+    return true;
+}
+
+// Deletes a page and the pages nested in it.
+// The space in the file is not reused.
+// A nested page may already be gone, if a failed PageIn() had
+// attached it to a child, which has been deleted.
+//
+void CItemPager::FreePage(int id)
+{
+    PAGE *page = _pages[id];
+    if(page == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < page->nested.GetSize(); i++)
+    {
+        FreePage(page->nested[i]);
+    }
+    _pagedOutItems -= page->items;
+    delete page;
+    _pages[id] = NULL;
+}
+
+int CItemPager::GetPageId(const CItem *item)
+{
+    int id = -1;
+    VERIFY(_paged.Lookup(item, id));
+    return id;
+}
+
+// Called by CItem::ReadChildren() for a nested paged out directory.
+//
+void CItemPager::Attach(CItem *item, int page)
+{
+    ASSERT(_pages[page] != NULL);
+    _paged.SetAt(item, page);
+}
+
+// The coldest first, then the largest.
+//
+int __cdecl CItemPager::_compareCandidates(const void *p1, const void *p2)
+{
+    const CANDIDATE *c1 = (const CANDIDATE *)p1;
+    const CANDIDATE *c2 = (const CANDIDATE *)p2;
+
+    if(c1->age != c2->age)
+    {
+        return c1->age > c2->age ? -1 : 1;
+    }
+    return signum((LONGLONG)c2->item->GetItemsCount() - (LONGLONG)c1->item->GetItemsCount());
+}
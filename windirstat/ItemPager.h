@@ -0,0 +1,108 @@
+// ItemPager.h - Declaration of CItemPager
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_ITEMPAGER_H__
+#define __WDS_ITEMPAGER_H__
+#pragma once
+
+#include "dirstatdoc.h" // CExtensionData
+
+class CItem;
+
+//
+// CItemPager. Pages cold subtrees of the item tree out to a temporary file,
+// when the estimated memory of all items exceeds the memory budget
+// (COptions::GetMemoryBudget()).
+//
+// Only done directories, which are not shown in the directory list and
+// don't contain the zoom item or a selection, are paged out. The least
+// recently paged in go first. A paged out directory keeps its subtree
+// totals, only its children are deleted. They are read back, as soon as
+// somebody asks for them (CItem::GetChildrenCount(), CItem::GetChild()),
+// e.g. when the directory is expanded, zoomed or queried.
+// The treemap draws a paged out directory as one cushion.
+//
+// If a page cannot be read back, the children are lost (CItem::IsPageLost()).
+// This can happen in the middle of anything, e.g. painting, so the error
+// is only recorded here and reported by CDirstatDoc::Work().
+//
+// The file only grows. It is deleted when the document is closed.
+// All methods are called by the gui thread.
+//
+class CItemPager
+{
+public:
+    static bool Trim(CItem *root);
+    static void Reset();
+
+    static void PageIn(CItem *item);
+    static void Forget(const CItem *item);
+    static void SetError(const CItem *item, CException *pe);
+    static bool TakeError(CString& path, CString& message);
+
+    static const CExtensionData *GetExtensionData(const CItem *item);
+    static ULONGLONG GetResidentItems();
+    static ULONGLONG GetPagedOutItems();
+
+private:
+    friend class CItem;
+
+    // A paged out list of children (see CItem::WriteChildren())
+    struct PAGE
+    {
+        ULONGLONG offset;           // Position in _file
+        ULONGLONG items;            // # Items written (not counting nested pages)
+        CArray<int, int> nested;    // Ids of the pages of paged out descendants
+        CExtensionData extensions;  // Of the whole subtree, for CItem::RecurseCollectExtensionData()
+    };
+    typedef CMap<const CItem *, const CItem *, int, int> CPageMap;
+    typedef CMap<const CItem *, const CItem *, DWORD, DWORD> CLastUseMap;
+
+    struct CANDIDATE
+    {
+        CItem *item;
+        DWORD age;                  // ms since last paged in
+    };
+
+    static bool IsPinned(const CItem *item);
+    static bool PageOut(CItem *item);
+    static bool OpenFile();
+    static void FreePage(int id);
+    static int GetPageId(const CItem *item);
+    static void Attach(CItem *item, int page);
+    static int __cdecl _compareCandidates(const void *p1, const void *p2);
+
+    static CFile _file;                 // The temporary file, if open
+    static CArray<PAGE *, PAGE *> _pages;   // Indexed by page id. NULL, when paged in again.
+    static CPageMap _paged;             // Paged out directory -> page id
+    static CLastUseMap _lastUse;        // Directory -> tick count, when last paged in
+    static ULONGLONG _pagedOutItems;    // Sum of PAGE::items
+    static DWORD _lastTrim;             // Tick count
+    static bool _releasing;             // PageOut() is deleting the children
+    static CString _errorPath;          // Of the first failed PageIn(), not yet reported. Empty, if none.
+    static CString _errorMessage;
+};
+
+#endif // __WDS_ITEMPAGER_H__
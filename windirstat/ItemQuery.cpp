@@ -0,0 +1,705 @@
+// ItemQuery.cpp - Implementation of CItemQuery
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "ExclusionRules.h"
+#include "ItemQuery.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const ULONGLONG FILETIME_PER_DAY = 864000000000ui64; // 100 ns units
+
+    // Indexed by FIELD
+    const LPCTSTR fieldNames[] = {
+        _T("size"),
+        _T("files"),
+        _T("subdirs"),
+        _T("items"),
+        _T("depth"),
+        _T("age"),
+        _T("name"),
+        _T("ext")
+    };
+
+    CString TrimBackslash(const CString& path)
+    {
+        CString s = path;
+        s.TrimRight(wds::chrBackslash);
+        return s;
+    }
+}
+
+CItemQuery::CItemQuery()
+    : m_pos(0)
+    , m_descendants(false)
+    , m_kind(QK_ANY)
+    , m_condition(-1)
+    , m_now(0)
+{
+}
+
+// Return: false, if the query is invalid. error is the message for the user then.
+//
+bool CItemQuery::Compile(LPCTSTR text, CString& error)
+{
+    m_text = text;
+    m_pos = 0;
+    m_nodes.RemoveAll();
+    m_condition = -1;
+
+    try
+    {
+        // Paths contain backslashes only, so the first slash is the axis.
+        int slash = m_text.Find(_T('/'));
+        if(slash == -1)
+        {
+            m_pos = m_text.GetLength();
+            Fail();
+        }
+        m_scope = m_text.Left(slash);
+        m_scope.Trim();
+        m_scope = TrimBackslash(m_scope);
+
+        m_pos = slash + 1;
+        m_descendants = (m_pos < m_text.GetLength() && m_text[m_pos] == _T('/'));
+        if(m_descendants)
+        {
+            m_pos++;
+        }
+
+        SkipBlanks();
+        if(m_pos < m_text.GetLength() && m_text[m_pos] == _T('*'))
+        {
+            m_kind = QK_ANY;
+            m_pos++;
+        }
+        else
+        {
+            int start = m_pos;
+            CString kind = ParseWord();
+            if(kind == _T("dir"))
+            {
+                m_kind = QK_DIRECTORY;
+            }
+            else if(kind == _T("file"))
+            {
+                m_kind = QK_FILE;
+            }
+            else
+            {
+                m_pos = start;
+                Fail();
+            }
+        }
+
+        // Several [conditions] are combined with and.
+        for(;;)
+        {
+            SkipBlanks();
+            if(m_pos == m_text.GetLength())
+            {
+                break;
+            }
+            if(m_text[m_pos] != _T('['))
+            {
+                Fail();
+            }
+            m_pos++;
+
+            int condition = ParseOr();
+
+            SkipBlanks();
+            if(m_pos == m_text.GetLength() || m_text[m_pos] != _T(']'))
+            {
+                Fail();
+            }
+            m_pos++;
+
+            m_condition = (m_condition == -1 ? condition : AddNode(QN_AND, m_condition, condition));
+        }
+    }
+    catch(CException *pe)
+    {
+        error = MdGetExceptionMessage(pe);
+        pe->Delete();
+
+        m_nodes.RemoveAll();
+        m_condition = -1;
+        return false;
+    }
+
+    return true;
+}
+
+// Collects the items matching the query into results.
+// Return: false, if the scope does not exist in the tree.
+//
+bool CItemQuery::Evaluate(CItem *root, CArray<CItem *, CItem *>& results)
+{
+    results.RemoveAll();
+
+    FILETIME now;
+    ::GetSystemTimeAsFileTime(&now);
+    m_now = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    CItem *scope = FindScope(root);
+    if(scope == NULL)
+    {
+        return false;
+    }
+
+    if(!IsLeaf(scope->GetType()))
+    {
+        Search(scope, 0, results);
+    }
+    return true;
+}
+
+void CItemQuery::Fail()
+{
+    MdThrowStringExceptionF(IDS_INVALIDQUERYds, m_pos + 1, (LPCTSTR)m_text);
+}
+
+void CItemQuery::SkipBlanks()
+{
+    while(m_pos < m_text.GetLength() && _istspace(m_text[m_pos]))
+    {
+        m_pos++;
+    }
+}
+
+// If the next word is keyword (case insensitive), skips it.
+//
+bool CItemQuery::IsKeyword(LPCTSTR keyword)
+{
+    SkipBlanks();
+    int start = m_pos;
+    if(ParseWord() == keyword)
+    {
+        return true;
+    }
+    m_pos = start;
+    return false;
+}
+
+// Return: the next run of letters in lower case.
+//
+CString CItemQuery::ParseWord()
+{
+    SkipBlanks();
+    int start = m_pos;
+    while(m_pos < m_text.GetLength() && _istalpha(m_text[m_pos]))
+    {
+        m_pos++;
+    }
+    CString word = m_text.Mid(start, m_pos - start);
+    word.MakeLower();
+    return word;
+}
+
+int CItemQuery::ParseOr()
+{
+    int left = ParseAnd();
+    while(IsKeyword(_T("or")))
+    {
+        left = AddNode(QN_OR, left, ParseAnd());
+    }
+    return left;
+}
+
+int CItemQuery::ParseAnd()
+{
+    int left = ParseUnary();
+    while(IsKeyword(_T("and")))
+    {
+        left = AddNode(QN_AND, left, ParseUnary());
+    }
+    return left;
+}
+
+int CItemQuery::ParseUnary()
+{
+    if(IsKeyword(_T("not")))
+    {
+        return AddNode(QN_NOT, ParseUnary(), -1);
+    }
+
+    SkipBlanks();
+    if(m_pos < m_text.GetLength() && m_text[m_pos] == _T('('))
+    {
+        m_pos++;
+        int node = ParseOr();
+        SkipBlanks();
+        if(m_pos == m_text.GetLength() || m_text[m_pos] != _T(')'))
+        {
+            Fail();
+        }
+        m_pos++;
+        return node;
+    }
+
+    return ParseComparison();
+}
+
+int CItemQuery::ParseComparison()
+{
+    SkipBlanks();
+    int start = m_pos;
+    CString word = ParseWord();
+
+    int field = 0;
+    while(field < countof(fieldNames) && word != fieldNames[field])
+    {
+        field++;
+    }
+    if(field == countof(fieldNames))
+    {
+        m_pos = start;
+        Fail();
+    }
+
+    SkipBlanks();
+    CString rest = m_text.Mid(m_pos, 2);
+    OPERATOR op = QO_EQUAL;
+    if(rest == _T("!="))
+    {
+        op = QO_NOTEQUAL;
+    }
+    else if(rest == _T("<="))
+    {
+        op = QO_LESSEQUAL;
+    }
+    else if(rest == _T(">="))
+    {
+        op = QO_GREATEREQUAL;
+    }
+    else if(rest.Left(1) == _T("="))
+    {
+        op = QO_EQUAL;
+    }
+    else if(rest.Left(1) == _T("<"))
+    {
+        op = QO_LESS;
+    }
+    else if(rest.Left(1) == _T(">"))
+    {
+        op = QO_GREATER;
+    }
+    else
+    {
+        Fail();
+    }
+    m_pos += (op == QO_EQUAL || op == QO_LESS || op == QO_GREATER ? 1 : 2);
+
+    int node = AddNode(QN_COMPARE, -1, -1);
+    m_nodes[node].field = (FIELD)field;
+    m_nodes[node].op = op;
+
+    if(field == QF_NAME || field == QF_EXT)
+    {
+        if(op != QO_EQUAL && op != QO_NOTEQUAL)
+        {
+            Fail();
+        }
+        CString pattern = ParsePattern();
+        if(field == QF_EXT && pattern[0] != wds::chrDot)
+        {
+            pattern = wds::chrDot + pattern;
+        }
+        m_nodes[node].pattern = CExclusionRules::FoldString(pattern);
+    }
+    else
+    {
+        m_nodes[node].value = ParseNumber((FIELD)field);
+    }
+
+    return node;
+}
+
+// Sizes may have a suffix K, M, G or T, ages must have d, w or y.
+// Return: bytes, counts or 100 ns units.
+//
+ULONGLONG CItemQuery::ParseNumber(FIELD field)
+{
+    SkipBlanks();
+    if(m_pos == m_text.GetLength() || !_istdigit(m_text[m_pos]))
+    {
+        Fail();
+    }
+
+    LPCTSTR start = (LPCTSTR)m_text + m_pos;
+    LPTSTR end = NULL;
+    ULONGLONG n = _tcstoui64(start, &end, 10);
+    m_pos += (int)(end - start);
+
+    int suffixPos = m_pos;
+    while(m_pos < m_text.GetLength() && _istalpha(m_text[m_pos]))
+    {
+        m_pos++;
+    }
+    CString suffix = m_text.Mid(suffixPos, m_pos - suffixPos);
+    suffix.MakeLower();
+
+    ULONGLONG unit = 1;
+    if(field == QF_SIZE)
+    {
+        LPCTSTR suffixes = _T("kmgt");
+        if(suffix.GetLength() == 1 && _tcschr(suffixes, suffix[0]) != NULL)
+        {
+            for(LPCTSTR p = suffixes; *p != suffix[0]; p++)
+            {
+                unit *= 1024;
+            }
+            unit *= 1024;
+        }
+        else if(!suffix.IsEmpty())
+        {
+            Fail();
+        }
+    }
+    else if(field == QF_AGE)
+    {
+        if(suffix == _T("d"))
+        {
+            unit = FILETIME_PER_DAY;
+        }
+        else if(suffix == _T("w"))
+        {
+            unit = 7 * FILETIME_PER_DAY;
+        }
+        else if(suffix == _T("y"))
+        {
+            unit = 365 * FILETIME_PER_DAY;
+        }
+        else
+        {
+            Fail();
+        }
+    }
+    else if(!suffix.IsEmpty())
+    {
+        Fail();
+    }
+
+    if(n > _UI64_MAX / unit)
+    {
+        Fail();
+    }
+    return n * unit;
+}
+
+// A glob, in double quotes if it contains blanks, ] or ).
+//
+CString CItemQuery::ParsePattern()
+{
+    SkipBlanks();
+
+    CString pattern;
+    if(m_pos < m_text.GetLength() && m_text[m_pos] == _T('"'))
+    {
+        int end = m_text.Find(_T('"'), m_pos + 1);
+        if(end == -1)
+        {
+            Fail();
+        }
+        pattern = m_text.Mid(m_pos + 1, end - m_pos - 1);
+        m_pos = end + 1;
+    }
+    else
+    {
+        int start = m_pos;
+        while(m_pos < m_text.GetLength() && !_istspace(m_text[m_pos]) && m_text[m_pos] != _T(']') && m_text[m_pos] != _T(')'))
+        {
+            m_pos++;
+        }
+        pattern = m_text.Mid(start, m_pos - start);
+    }
+
+    if(pattern.IsEmpty())
+    {
+        Fail();
+    }
+    return pattern;
+}
+
+int CItemQuery::AddNode(NODETYPE type, int left, int right)
+{
+    NODE node;
+    node.type = type;
+    node.left = left;
+    node.right = right;
+    node.field = QF_SIZE;
+    node.op = QO_EQUAL;
+    node.value = 0;
+    return (int)m_nodes.Add(node);
+}
+
+// Walks down from the root along the items whose paths are prefixes of m_scope.
+//
+CItem *CItemQuery::FindScope(CItem *root) const
+{
+    if(m_scope.IsEmpty())
+    {
+        return root;
+    }
+
+    CString scope = CExclusionRules::FoldString(m_scope);
+
+    CItem *item = root;
+    if(item->GetType() != IT_MYCOMPUTER)
+    {
+        CString path = CExclusionRules::FoldString(TrimBackslash(item->GetPath()));
+        if(path == scope)
+        {
+            return item;
+        }
+        if(scope.Left(path.GetLength() + 1) != path + wds::strBackslash)
+        {
+            return NULL;
+        }
+    }
+
+    for(;;)
+    {
+        CItem *next = NULL;
+        for(int i = 0; i < item->GetChildrenCount() && next == NULL; i++)
+        {
+            CItem *child = item->GetChild(i);
+            if(IsLeaf(child->GetType()))
+            {
+                continue;
+            }
+
+            CString path = CExclusionRules::FoldString(TrimBackslash(child->GetPath()));
+            if(path == scope)
+            {
+                return child;
+            }
+            if(scope.Left(path.GetLength() + 1) == path + wds::strBackslash)
+            {
+                next = child;
+            }
+        }
+
+        if(next == NULL)
+        {
+            return NULL;
+        }
+        item = next;
+    }
+}
+
+// item is a directory (or drive etc.) at depth, its children are at depth + 1.
+//
+void CItemQuery::Search(CItem *item, int depth, CArray<CItem *, CItem *>& results) const
+{
+    for(int i = 0; i < item->GetChildrenCount(); i++)
+    {
+        CItem *child = item->GetChild(i);
+
+        if(IsKind(child) && (m_condition == -1 || Matches(m_condition, child, depth + 1)))
+        {
+            results.Add(child);
+        }
+
+        if(m_descendants && !IsLeaf(child->GetType()) && (m_condition == -1 || MayMatchBelow(m_condition, child, depth + 1)))
+        {
+            Search(child, depth + 1, results);
+        }
+    }
+}
+
+bool CItemQuery::IsKind(const CItem *item) const
+{
+    switch (m_kind)
+    {
+    case QK_DIRECTORY:
+        return item->GetType() == IT_DIRECTORY || item->GetType() == IT_DRIVE;
+
+    case QK_FILE:
+        return item->GetType() == IT_FILE;
+
+    default:
+        return true;
+    }
+}
+
+ULONGLONG CItemQuery::GetValue(FIELD field, const CItem *item, int depth) const
+{
+    switch (field)
+    {
+    case QF_SIZE:
+        return item->GetSize();
+
+    case QF_FILES:
+        return item->GetFilesCount();
+
+    case QF_SUBDIRS:
+        return item->GetSubdirsCount();
+
+    case QF_ITEMS:
+        return item->GetItemsCount();
+
+    case QF_DEPTH:
+        return depth;
+
+    case QF_AGE:
+        {
+            FILETIME ft = item->GetLastChange();
+            ULONGLONG t = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+            return m_now > t ? m_now - t : 0;
+        }
+
+    default:
+        ASSERT(0);
+        return 0;
+    }
+}
+
+bool CItemQuery::Matches(int node, const CItem *item, int depth) const
+{
+    const NODE& n = m_nodes[node];
+    switch (n.type)
+    {
+    case QN_AND:
+        return Matches(n.left, item, depth) && Matches(n.right, item, depth);
+
+    case QN_OR:
+        return Matches(n.left, item, depth) || Matches(n.right, item, depth);
+
+    case QN_NOT:
+        return !Matches(n.left, item, depth);
+    }
+
+    if(n.field == QF_NAME || n.field == QF_EXT)
+    {
+        // Only files have an extension; for other items both = and != fail.
+        if(n.field == QF_EXT && item->GetType() != IT_FILE)
+        {
+            return false;
+        }
+        CString s = (n.field == QF_NAME ? item->GetName() : item->GetExtension());
+        bool match = CExclusionRules::GlobMatch(n.pattern, CExclusionRules::FoldString(s));
+        return match == (n.op == QO_EQUAL);
+    }
+
+    return Compare(n.op, GetValue(n.field, item, depth), n.value);
+}
+
+// Whether any item below item (which is at depth) can match the condition.
+// A false result must be certain, a true result is only a possibility.
+// Sizes and counts of descendants are at most those of item,
+// their ages at least its age, and their depths greater than depth.
+//
+bool CItemQuery::MayMatchBelow(int node, const CItem *item, int depth) const
+{
+    const NODE& n = m_nodes[node];
+    switch (n.type)
+    {
+    case QN_AND:
+        return MayMatchBelow(n.left, item, depth) && MayMatchBelow(n.right, item, depth);
+
+    case QN_OR:
+        return MayMatchBelow(n.left, item, depth) || MayMatchBelow(n.right, item, depth);
+
+    case QN_NOT:
+        return true;
+    }
+
+    switch (n.field)
+    {
+    case QF_SIZE:
+    case QF_FILES:
+    case QF_SUBDIRS:
+    case QF_ITEMS:
+        {
+            ULONGLONG upper = GetValue(n.field, item, depth);
+            switch (n.op)
+            {
+            case QO_GREATER:
+                return upper > n.value;
+            case QO_GREATEREQUAL:
+            case QO_EQUAL:
+                return upper >= n.value;
+            }
+        }
+        break;
+
+    case QF_DEPTH:
+        {
+            ULONGLONG lower = depth + 1;
+            switch (n.op)
+            {
+            case QO_LESS:
+                return lower < n.value;
+            case QO_LESSEQUAL:
+            case QO_EQUAL:
+                return lower <= n.value;
+            }
+        }
+        break;
+
+    case QF_AGE:
+        {
+            ULONGLONG lower = GetValue(n.field, item, depth);
+            switch (n.op)
+            {
+            case QO_LESS:
+                return lower < n.value;
+            case QO_LESSEQUAL:
+            case QO_EQUAL:
+                return lower <= n.value;
+            }
+        }
+        break;
+    }
+
+    return true;
+}
+
+bool CItemQuery::Compare(OPERATOR op, ULONGLONG a, ULONGLONG b)
+{
+    switch (op)
+    {
+    case QO_EQUAL:
+        return a == b;
+    case QO_NOTEQUAL:
+        return a != b;
+    case QO_LESS:
+        return a < b;
+    case QO_LESSEQUAL:
+        return a <= b;
+    case QO_GREATER:
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
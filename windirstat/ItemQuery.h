@@ -0,0 +1,150 @@
+// ItemQuery.h - Declaration of CItemQuery
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_ITEMQUERY_H__
+#define __WDS_ITEMQUERY_H__
+#pragma once
+
+class CItem;
+
+//
+// CItemQuery. A compact, XPath like query over the CItem tree:
+//
+//     [scope] / kind [condition] [condition] ...
+//     [scope] // kind [condition] ...
+//
+// scope is a path (C:\Users, \\server\share\proj); without a scope the
+// query starts at the root item. / selects the children of the scope,
+// // all its descendants. kind is dir, file or * (any item).
+// A condition is made of comparisons "field op value", and, or, not
+// and parentheses. Fields:
+//
+//     size, files, subdirs, items     Number with optional K, M, G, T
+//     depth                           Levels below the scope (children: 1)
+//     age                             Number with d, w or y (since the last change)
+//     name, ext                       Glob (* ?), = and != only
+//
+// op is =, !=, <, <=, > or >=. Values of directories are the aggregates
+// of their subtrees, as shown in the directory list. Example:
+//
+//     \\share\proj//dir[depth>5][size>10G and age>2y]
+//
+// The query is evaluated on the items directly. The aggregates stored in
+// each directory bound the values of the whole subtree (size, counts and
+// last change of a descendant never exceed those of the directory), so
+// Evaluate() skips subtrees in which no item can satisfy the condition.
+//
+class CItemQuery
+{
+public:
+    CItemQuery();
+
+    bool Compile(LPCTSTR text, CString& error);
+    bool Evaluate(CItem *root, CArray<CItem *, CItem *>& results);
+
+private:
+    enum KIND
+    {
+        QK_ANY,
+        QK_DIRECTORY,   // Directories and drives
+        QK_FILE
+    };
+
+    enum FIELD
+    {
+        QF_SIZE,
+        QF_FILES,
+        QF_SUBDIRS,
+        QF_ITEMS,
+        QF_DEPTH,
+        QF_AGE,
+        QF_NAME,
+        QF_EXT
+    };
+
+    enum OPERATOR
+    {
+        QO_EQUAL,
+        QO_NOTEQUAL,
+        QO_LESS,
+        QO_LESSEQUAL,
+        QO_GREATER,
+        QO_GREATEREQUAL
+    };
+
+    enum NODETYPE
+    {
+        QN_COMPARE,
+        QN_AND,
+        QN_OR,
+        QN_NOT
+    };
+
+    // Node of the condition tree
+    struct NODE
+    {
+        NODETYPE type;
+        int left;           // Operands (QN_AND, QN_OR, QN_NOT)
+        int right;
+        FIELD field;        // QN_COMPARE
+        OPERATOR op;
+        ULONGLONG value;    // Numeric fields, ages in 100 ns units
+        CString pattern;    // QF_NAME and QF_EXT, folded
+    };
+
+    // Parser
+    void Fail();
+    void SkipBlanks();
+    bool IsKeyword(LPCTSTR keyword);
+    CString ParseWord();
+    int ParseOr();
+    int ParseAnd();
+    int ParseUnary();
+    int ParseComparison();
+    ULONGLONG ParseNumber(FIELD field);
+    CString ParsePattern();
+    int AddNode(NODETYPE type, int left, int right);
+
+    // Evaluation
+    CItem *FindScope(CItem *root) const;
+    void Search(CItem *item, int depth, CArray<CItem *, CItem *>& results) const;
+    bool IsKind(const CItem *item) const;
+    ULONGLONG GetValue(FIELD field, const CItem *item, int depth) const;
+    bool Matches(int node, const CItem *item, int depth) const;
+    bool MayMatchBelow(int node, const CItem *item, int depth) const;
+    static bool Compare(OPERATOR op, ULONGLONG a, ULONGLONG b);
+
+    CString m_text;         // Query being compiled
+    int m_pos;              // Parser position in m_text
+
+    CString m_scope;        // Empty: the root item
+    bool m_descendants;     // // instead of /
+    KIND m_kind;
+    int m_condition;        // Root of m_nodes, -1 if none
+    CArray<NODE, NODE&> m_nodes;
+    ULONGLONG m_now;        // Reference time of age
+};
+
+#endif // __WDS_ITEMQUERY_H__
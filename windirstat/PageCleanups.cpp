@@ -110,6 +110,7 @@ BEGIN_MESSAGE_MAP(CPageCleanups, CPropertyPage)
     ON_BN_CLICKED(IDC_UP, OnBnClickedUp)
     ON_BN_CLICKED(IDC_DOWN, OnBnClickedDown)
     ON_BN_CLICKED(IDC_HELPBUTTON, OnBnClickedHelpbutton)
+    ON_EN_CHANGE(IDC_CLEANUPPROCESSES, OnEnChangeCleanupprocesses)
 END_MESSAGE_MAP()
 
 
@@ -135,6 +136,10 @@ BOOL CPageCleanups::OnInitDialog()
     m_list.SetCurSel(0);
     OnLbnSelchangeList();
 
+    // Not part of a USERDEFINEDCLEANUP, so not subject to UpdateData().
+    SetDlgItemInt(IDC_CLEANUPPROCESSES, GetOptions()->GetCleanupProcesses(), false);
+    SetModified(false);
+
     return TRUE;  // return TRUE unless you set the focus to a control
 }
 
@@ -143,6 +148,7 @@ void CPageCleanups::OnOK()
     CheckEmptyTitle();
 
     GetOptions()->SetUserDefinedCleanups(m_udc);
+    GetOptions()->SetCleanupProcesses(GetDlgItemInt(IDC_CLEANUPPROCESSES, NULL, false));
 
     CPropertyPage::OnOK();
 }
@@ -394,3 +400,8 @@ void CPageCleanups::OnBnClickedHelpbutton()
 {
     GetWDSApp()->DoContextHelp(IDH_UserDefinedCleanups);
 }
+
+void CPageCleanups::OnEnChangeCleanupprocesses()
+{
+    SetModified();
+}
@@ -104,6 +104,7 @@ protected:
     afx_msg void OnBnClickedUp();
     afx_msg void OnBnClickedDown();
     afx_msg void OnBnClickedHelpbutton();
+    afx_msg void OnEnChangeCleanupprocesses();
 };
 
 #endif // __WDS_PAGECLEANUPS_H__
@@ -0,0 +1,100 @@
+// PageExclusions.cpp - Implementation of CPageExclusions
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ExclusionRules.h"
+#include "PageExclusions.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+IMPLEMENT_DYNAMIC(CPageExclusions, CPropertyPage)
+
+CPageExclusions::CPageExclusions()
+    : CPropertyPage(CPageExclusions::IDD)
+{
+}
+
+CPageExclusions::~CPageExclusions()
+{
+}
+
+void CPageExclusions::DoDataExchange(CDataExchange* pDX)
+{
+    CPropertyPage::DoDataExchange(pDX);
+    DDX_Text(pDX, IDC_EXCLUSIONRULES, m_rules);
+}
+
+
+BEGIN_MESSAGE_MAP(CPageExclusions, CPropertyPage)
+    ON_EN_CHANGE(IDC_EXCLUSIONRULES, OnEnChangeRules)
+END_MESSAGE_MAP()
+
+
+BOOL CPageExclusions::OnInitDialog()
+{
+    CPropertyPage::OnInitDialog();
+
+    m_rules = GetOptions()->GetExclusionRules();
+    SetDlgItemText(IDC_EXCLUSIONSYNTAX, LoadString(IDS_EXCLUSIONSYNTAX));
+
+    UpdateData(false);
+    return TRUE;
+}
+
+// Called before OnOK(), too. We don't let invalid rules pass.
+//
+BOOL CPageExclusions::OnKillActive()
+{
+    if(!CPropertyPage::OnKillActive())
+    {
+        return false;
+    }
+
+    CExclusionRules rules;
+    CString error;
+    if(!rules.Compile(m_rules, error))
+    {
+        AfxMessageBox(error);
+        GetDlgItem(IDC_EXCLUSIONRULES)->SetFocus();
+        return false;
+    }
+    return true;
+}
+
+void CPageExclusions::OnOK()
+{
+    UpdateData();
+    GetOptions()->SetExclusionRules(m_rules);
+
+    CPropertyPage::OnOK();
+}
+
+void CPageExclusions::OnEnChangeRules()
+{
+    SetModified();
+}
@@ -0,0 +1,55 @@
+// PageExclusions.h - Declaration of CPageExclusions
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_PAGEEXCLUSIONS_H__
+#define __WDS_PAGEEXCLUSIONS_H__
+#pragma once
+
+//
+// CPageExclusions. "Settings" property page "Exclusions".
+// The rules are checked (compiled) before the page can be left.
+//
+class CPageExclusions : public CPropertyPage
+{
+    DECLARE_DYNAMIC(CPageExclusions)
+    enum { IDD = IDD_PAGE_EXCLUSIONS };
+
+public:
+    CPageExclusions();
+    virtual ~CPageExclusions();
+
+protected:
+    virtual void DoDataExchange(CDataExchange* pDX);
+    virtual BOOL OnInitDialog();
+    virtual BOOL OnKillActive();
+    virtual void OnOK();
+
+    CString m_rules;
+
+    DECLARE_MESSAGE_MAP()
+    afx_msg void OnEnChangeRules();
+};
+
+#endif // __WDS_PAGEEXCLUSIONS_H__
@@ -62,6 +62,8 @@ void CPageGeneral::DoDataExchange(CDataExchange* pDX)
     DDX_Check(pDX, IDC_SHOWGRID, m_listGrid);
     DDX_Check(pDX, IDC_SHOWSTRIPES, m_listStripes);
     DDX_Check(pDX, IDC_FULLROWSELECTION, m_listFullRowSelection);
+    DDX_Text(pDX, IDC_MEMORYBUDGET, m_memoryBudget);
+    DDV_MinMaxInt(pDX, m_memoryBudget, 0, MAXMEMORYBUDGET);
 }
 
 
@@ -74,6 +76,7 @@ BEGIN_MESSAGE_MAP(CPageGeneral, CPropertyPage)
     ON_BN_CLICKED(IDC_SHOWGRID, OnBnClickedListGrid)
     ON_BN_CLICKED(IDC_SHOWSTRIPES, OnBnClickedListStripes)
     ON_BN_CLICKED(IDC_FULLROWSELECTION, OnBnClickedListFullRowSelection)
+    ON_EN_CHANGE(IDC_MEMORYBUDGET, OnEnChangeMemoryBudget)
 END_MESSAGE_MAP()
 
 
@@ -90,6 +93,7 @@ BOOL CPageGeneral::OnInitDialog()
     m_followMountPoints = GetOptions()->IsFollowMountPoints();
     m_followJunctionPoints = GetOptions()->IsFollowJunctionPoints();
     m_useWdsLocale = GetOptions()->IsUseWdsLocale();
+    m_memoryBudget = GetOptions()->GetMemoryBudget();
 
     m_followMountPoints = false;    // Otherwise we would see pacman only.
     m_ctlFollowMountPoints.ShowWindow(SW_HIDE); // Ignorance is bliss.
@@ -134,6 +138,7 @@ void CPageGeneral::OnOK()
     GetOptions()->SetListGrid(FALSE != m_listGrid);
     GetOptions()->SetListStripes(FALSE != m_listStripes);
     GetOptions()->SetListFullRowSelection(FALSE != m_listFullRowSelection);
+    GetOptions()->SetMemoryBudget(m_memoryBudget);
 
     LANGID id = (LANGID)m_combo.GetItemData(m_combo.GetCurSel());
     CLanguageOptions::SetLanguage(id);
@@ -176,6 +181,11 @@ void CPageGeneral::OnBnClickedListFullRowSelection()
     SetModified();
 }
 
+void CPageGeneral::OnEnChangeMemoryBudget()
+{
+    SetModified();
+}
+
 void CPageGeneral::OnCbnSelendokCombo()
 {
     int i = m_combo.GetCurSel();
@@ -54,6 +54,7 @@ protected:
     BOOL m_listGrid;
     BOOL m_listStripes;
     BOOL m_listFullRowSelection;
+    int m_memoryBudget;
 
     CComboBox m_combo;
     CButton m_ctlFollowMountPoints;
@@ -70,6 +71,7 @@ protected:
     afx_msg void OnBnClickedListGrid();
     afx_msg void OnBnClickedListStripes();
     afx_msg void OnBnClickedListFullRowSelection();
+    afx_msg void OnEnChangeMemoryBudget();
 };
 
 #endif // __WDS_PAGEGENERAL_H__
@@ -0,0 +1,488 @@
+// ReportWriter.cpp - Implementation of CReportWriter
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "ReportWriter.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const int BUFFER_SIZE = 256 * 1024;
+
+    // UTF-8 needs up to 3 bytes per UTF-16 code unit.
+    const int MAX_UTF8_PER_CHAR = 3;
+
+    // Indexed by ITEMTYPE
+    const char *typeNames[] = {
+        "mycomputer",
+        "drive",
+        "directory",
+        "file",
+        "filesfolder",
+        "freespace",
+        "unknown",
+        "excluded"
+    };
+
+    bool IsHighSurrogate(TCHAR c)
+    {
+        return c >= 0xD800 && c <= 0xDBFF;
+    }
+}
+
+CReportWriter::CReportWriter(REPORTFORMAT format, int maxDepth, ULONGLONG minSize)
+    : m_format(format)
+    , m_maxDepth(maxDepth)
+    , m_minSize(minSize)
+    , m_file(NULL)
+    , m_used(0)
+{
+    ASSERT(m_format >= 0 && m_format < REPORTFORMATCOUNT);
+    ASSERT(m_maxDepth >= 0);
+}
+
+CReportWriter::~CReportWriter()
+{
+}
+
+void CReportWriter::Write(LPCTSTR path, const CArray<const CItem *, const CItem *>& roots)
+{
+    CFile file(path, CFile::modeCreate | CFile::modeWrite | CFile::shareDenyWrite);
+    m_file = &file;
+
+    try
+    {
+        m_buffer.SetSize(BUFFER_SIZE);
+        m_used = 0;
+
+        switch (m_format)
+        {
+        case RF_CSV:
+            {
+                // The byte order mark tells spreadsheets, that this is UTF-8.
+                Put("\xEF\xBB\xBF" "Path,Type,Size,Files,Subdirs,LastChange\r\n");
+            }
+            break;
+
+        case RF_JSON:
+            {
+                Put("[\n");
+            }
+            break;
+
+        case RF_XML:
+            {
+                Put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<report>\n");
+            }
+            break;
+        }
+
+        for(int i = 0; i < roots.GetSize(); i++)
+        {
+            if(m_format == RF_JSON && i > 0)
+            {
+                Put(",\n");
+            }
+            m_path.Empty();
+            WriteItem(roots[i], 1);
+        }
+
+        switch (m_format)
+        {
+        case RF_JSON:
+            {
+                Put("\n]\n");
+            }
+            break;
+
+        case RF_XML:
+            {
+                Put("</report>\n");
+            }
+            break;
+        }
+
+        Flush();
+        file.Close();
+    }
+    catch(CException *)
+    {
+        file.Abort();
+        m_file = NULL;
+        throw;
+    }
+
+    m_file = NULL;
+    m_buffer.RemoveAll();
+}
+
+// Writes item and, up to m_maxDepth, its children not smaller than m_minSize.
+// m_path is the path of the parent (empty for roots and drives below
+// "My Computer") and is restored on return.
+//
+void CReportWriter::WriteItem(const CItem *item, int depth)
+{
+    int parentLength = m_path.GetLength();
+    if(item->GetType() == IT_MYCOMPUTER)
+    {
+        // No path
+    }
+    else if(parentLength == 0)
+    {
+        m_path = item->GetReportPath();
+    }
+    else
+    {
+        if(m_path[parentLength - 1] != wds::chrBackslash)
+        {
+            m_path += wds::chrBackslash;
+        }
+        m_path += item->GetName();
+    }
+
+    bool descend = !IsLeaf(item->GetType()) && (m_maxDepth == 0 || depth < m_maxDepth);
+
+    switch (m_format)
+    {
+    case RF_CSV:
+        {
+            if(item->GetType() != IT_MYCOMPUTER)
+            {
+                WriteCsvRow(item);
+            }
+        }
+        break;
+
+    case RF_JSON:
+        {
+            Put("{");
+            WriteAttributes(item, depth == 1);
+            Put(descend ? ",\"children\":[\n" : "}");
+        }
+        break;
+
+    case RF_XML:
+        {
+            Put("<item");
+            WriteAttributes(item, depth == 1);
+            Put(descend ? ">\n" : "/>\n");
+        }
+        break;
+    }
+
+    if(descend)
+    {
+        bool first = true;
+        for(int i = 0; i < item->GetChildrenCount(); i++)
+        {
+            const CItem *child = item->GetChild(i);
+            if(child->GetSize() < m_minSize)
+            {
+                // SetDone() has sorted the children by size, so all following are smaller.
+                if(item->IsDone())
+                {
+                    break;
+                }
+                continue;
+            }
+
+            if(m_format == RF_JSON && !first)
+            {
+                Put(",\n");
+            }
+            first = false;
+
+            WriteItem(child, depth + 1);
+        }
+
+        switch (m_format)
+        {
+        case RF_JSON:
+            {
+                Put("\n]}");
+            }
+            break;
+
+        case RF_XML:
+            {
+                Put("</item>\n");
+            }
+            break;
+        }
+    }
+
+    m_path.Truncate(parentLength);
+}
+
+void CReportWriter::WriteCsvRow(const CItem *item)
+{
+    PutString(m_path);
+    Put(",");
+    Put(typeNames[item->GetType()]);
+    Put(",");
+    PutNumber(item->GetSize());
+    Put(",");
+    PutNumber(item->GetFilesCount());
+    Put(",");
+    PutNumber(item->GetSubdirsCount());
+    Put(",");
+    PutTime(item->GetLastChange());
+    Put("\r\n");
+}
+
+// The fields of a JSON object or the attributes of an XML element.
+//
+void CReportWriter::WriteAttributes(const CItem *item, bool isRoot)
+{
+    const char *separator = (m_format == RF_JSON ? "," : " ");
+
+    PutName("name", "");
+    PutString(item->GetName());
+
+    if((isRoot && item->GetType() != IT_MYCOMPUTER) || item->GetType() == IT_DRIVE)
+    {
+        PutName("path", separator);
+        PutString(m_path);
+    }
+
+    PutName("type", separator);
+    Put("\"");
+    Put(typeNames[item->GetType()]);
+    Put("\"");
+
+    PutName("size", separator);
+    PutNumber(item->GetSize());
+
+    if(!IsLeaf(item->GetType()))
+    {
+        PutName("files", separator);
+        PutNumber(item->GetFilesCount());
+
+        PutName("subdirs", separator);
+        PutNumber(item->GetSubdirsCount());
+    }
+
+    FILETIME t = item->GetLastChange();
+    if(t.dwLowDateTime != 0 || t.dwHighDateTime != 0)
+    {
+        PutName("lastChange", separator);
+        PutTime(t);
+    }
+}
+
+void CReportWriter::PutName(const char *name, const char *separator)
+{
+    Put(separator);
+    if(m_format == RF_JSON)
+    {
+        Put("\"");
+        Put(name);
+        Put("\":");
+    }
+    else
+    {
+        if(*separator == 0)
+        {
+            Put(" ");
+        }
+        Put(name);
+        Put("=");
+    }
+}
+
+void CReportWriter::Put(const char *s)
+{
+    int length = (int)strlen(s);
+    if(m_used + length > BUFFER_SIZE)
+    {
+        Flush();
+    }
+    ASSERT(length <= BUFFER_SIZE);
+    memcpy(m_buffer.GetData() + m_used, s, length);
+    m_used += length;
+}
+
+// Appends length characters of s as UTF-8.
+//
+void CReportWriter::Put(LPCTSTR s, int length)
+{
+    while(length > 0)
+    {
+        int n = min(length, (BUFFER_SIZE - m_used) / MAX_UTF8_PER_CHAR);
+        if(n == 0)
+        {
+            Flush();
+            continue;
+        }
+
+        // Don't split a surrogate pair
+        if(n < length && n > 1 && IsHighSurrogate(s[n - 1]))
+        {
+            n--;
+        }
+
+#ifdef UNICODE
+        m_used += ::WideCharToMultiByte(CP_UTF8, 0, s, n, m_buffer.GetData() + m_used, BUFFER_SIZE - m_used, NULL, NULL);
+#else
+        CStringW w(s, n);
+        m_used += ::WideCharToMultiByte(CP_UTF8, 0, w, w.GetLength(), m_buffer.GetData() + m_used, BUFFER_SIZE - m_used, NULL, NULL);
+#endif
+        s += n;
+        length -= n;
+    }
+}
+
+// Writes s quoted and escaped as required by the format.
+// Runs of characters which need no escaping are copied at once.
+//
+void CReportWriter::PutString(LPCTSTR s)
+{
+    Put("\"");
+
+    LPCTSTR run = s;
+    for(; *s != 0; s++)
+    {
+        char buffer[8];
+        const char *escape = NULL;
+
+        switch (m_format)
+        {
+        case RF_CSV:
+            {
+                if(*s == _T('"'))
+                {
+                    escape = "\"\"";
+                }
+            }
+            break;
+
+        case RF_JSON:
+            {
+                if(*s == _T('"'))
+                {
+                    escape = "\\\"";
+                }
+                else if(*s == _T('\\'))
+                {
+                    escape = "\\\\";
+                }
+                else if((unsigned)*s < 0x20)
+                {
+                    sprintf_s(buffer, "\\u%04x", (unsigned)*s);
+                    escape = buffer;
+                }
+            }
+            break;
+
+        case RF_XML:
+            {
+                if(*s == _T('"'))
+                {
+                    escape = "&quot;";
+                }
+                else if(*s == _T('&'))
+                {
+                    escape = "&amp;";
+                }
+                else if(*s == _T('<'))
+                {
+                    escape = "&lt;";
+                }
+                else if(*s == _T('>'))
+                {
+                    escape = "&gt;";
+                }
+            }
+            break;
+        }
+
+        if(escape != NULL)
+        {
+            Put(run, (int)(s - run));
+            Put(escape);
+            run = s + 1;
+        }
+    }
+    Put(run, (int)(s - run));
+
+    Put("\"");
+}
+
+// Numbers are quoted in XML attributes only.
+//
+void CReportWriter::PutNumber(ULONGLONG n)
+{
+    char buffer[24];
+    _ui64toa_s(n, buffer, sizeof(buffer), 10);
+
+    if(m_format == RF_XML)
+    {
+        Put("\"");
+        Put(buffer);
+        Put("\"");
+    }
+    else
+    {
+        Put(buffer);
+    }
+}
+
+// ISO 8601, UTC. Empty for CSV, if unknown.
+//
+void CReportWriter::PutTime(const FILETIME& t)
+{
+    char buffer[32] = "";
+
+    SYSTEMTIME st;
+    if((t.dwLowDateTime != 0 || t.dwHighDateTime != 0) && ::FileTimeToSystemTime(&t, &st))
+    {
+        sprintf_s(buffer, "%04u-%02u-%02uT%02u:%02u:%02uZ", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    }
+
+    if(m_format == RF_CSV)
+    {
+        Put(buffer);
+    }
+    else
+    {
+        Put("\"");
+        Put(buffer);
+        Put("\"");
+    }
+}
+
+void CReportWriter::Flush()
+{
+    if(m_used > 0)
+    {
+        m_file->Write(m_buffer.GetData(), m_used);
+        m_used = 0;
+    }
+}
@@ -0,0 +1,82 @@
+// ReportWriter.h - Declaration of CReportWriter
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_REPORTWRITER_H__
+#define __WDS_REPORTWRITER_H__
+#pragma once
+
+class CItem;
+
+enum REPORTFORMAT
+{
+    RF_CSV,     // One row per item with its full path
+    RF_JSON,    // Nested objects with "children" arrays
+    RF_XML,     // Nested <item> elements
+    REPORTFORMATCOUNT
+};
+
+//
+// CReportWriter. Writes a report of CItem subtrees into a UTF-8 file.
+// It walks the items directly (not the rows of the directory list)
+// in preorder and writes each item as soon as it is visited through
+// a fixed size buffer, so neither time nor memory depends on anything
+// but the number of items written.
+//
+// maxDepth limits the levels below the roots (0 = all levels).
+// Items smaller than minSize are omitted with their subtrees.
+//
+// Write() throws CException *.
+//
+class CReportWriter
+{
+public:
+    CReportWriter(REPORTFORMAT format, int maxDepth, ULONGLONG minSize);
+    ~CReportWriter();
+
+    void Write(LPCTSTR path, const CArray<const CItem *, const CItem *>& roots);
+
+private:
+    void WriteItem(const CItem *item, int depth);
+    void WriteCsvRow(const CItem *item);
+    void WriteAttributes(const CItem *item, bool isRoot);
+    void PutName(const char *name, const char *separator);
+    void Put(const char *s);
+    void Put(LPCTSTR s, int length);
+    void PutString(LPCTSTR s);
+    void PutNumber(ULONGLONG n);
+    void PutTime(const FILETIME& t);
+    void Flush();
+
+    const REPORTFORMAT m_format;
+    const int m_maxDepth;
+    const ULONGLONG m_minSize;
+
+    CFile *m_file;                  // Valid during Write()
+    CArray<char, char> m_buffer;    // UTF-8 bytes not yet written
+    int m_used;                     // # Bytes used in m_buffer
+    CString m_path;                 // Path of the current item (grows and shrinks with the walk)
+};
+
+#endif // __WDS_REPORTWRITER_H__
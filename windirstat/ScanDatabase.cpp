@@ -0,0 +1,658 @@
+// ScanDatabase.cpp - Implementation of CScanDatabase
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "osspecific.h"
+#include "ScanDatabase.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    // Stored as PRAGMA user_version. Increment, if the meaning of the tables changes.
+    const int FORMAT_VERSION = 1;
+
+    // Rows per transaction of the export
+    const int ROWS_PER_TRANSACTION = 100000;
+
+    const char *SCHEMA =
+        "CREATE TABLE scan(key TEXT PRIMARY KEY, value TEXT);"
+        "CREATE TABLE extension(id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE);"
+        "CREATE TABLE node(id INTEGER PRIMARY KEY, parent_id INTEGER, type INTEGER NOT NULL, name TEXT NOT NULL,"
+            " size INTEGER NOT NULL, mtime INTEGER, attrs INTEGER, ext_id INTEGER);"
+        "CREATE TABLE filehash(path TEXT PRIMARY KEY, size INTEGER NOT NULL, mtime INTEGER NOT NULL,"
+            " partial INTEGER NOT NULL, full INTEGER);";
+
+    // The indexes are created after the inserts, which is much faster
+    // than maintaining them row by row.
+    const char *INDEXES =
+        "CREATE INDEX node_parent ON node(parent_id);"
+        "CREATE INDEX node_ext ON node(ext_id);"
+        "CREATE VIEW file AS SELECT node.id, node.parent_id, node.name, node.size, node.mtime, node.attrs, extension.name AS ext"
+            " FROM node LEFT JOIN extension ON node.ext_id = extension.id WHERE node.type = %d;";
+
+    sqlite3_int64 FileTimeToInt64(const FILETIME& t)
+    {
+        return (sqlite3_int64)(((ULONGLONG)t.dwHighDateTime << 32) | t.dwLowDateTime);
+    }
+
+    FILETIME Int64ToFileTime(sqlite3_int64 i)
+    {
+        FILETIME t;
+        t.dwLowDateTime = (DWORD)((ULONGLONG)i & 0xFFFFFFFF);
+        t.dwHighDateTime = (DWORD)((ULONGLONG)i >> 32);
+        return t;
+    }
+
+    // Rejects rows, which Export() cannot have written.
+    bool IsStoredType(sqlite3_int64 type)
+    {
+        return type >= IT_MYCOMPUTER && type <= IT_EXCLUDED;
+    }
+}
+
+//
+// The functions of sqlite3.dll we use.
+// We load the library at runtime, so WinDirStat runs without it.
+//
+class CSqliteApi
+{
+public:
+    typedef int (__cdecl *PFN_OPEN16)(const void *, sqlite3 **);
+    typedef int (__cdecl *PFN_CLOSE)(sqlite3 *);
+    typedef int (__cdecl *PFN_EXEC)(sqlite3 *, const char *, int (*)(void *, int, char **, char **), void *, char **);
+    typedef int (__cdecl *PFN_PREPARE_V2)(sqlite3 *, const char *, int, sqlite3_stmt **, const char **);
+    typedef int (__cdecl *PFN_BIND_INT64)(sqlite3_stmt *, int, sqlite3_int64);
+    typedef int (__cdecl *PFN_BIND_NULL)(sqlite3_stmt *, int);
+    typedef int (__cdecl *PFN_BIND_TEXT16)(sqlite3_stmt *, int, const void *, int, sqlite3_destructor_type);
+    typedef int (__cdecl *PFN_STEP)(sqlite3_stmt *);
+    typedef int (__cdecl *PFN_RESET)(sqlite3_stmt *);
+    typedef int (__cdecl *PFN_FINALIZE)(sqlite3_stmt *);
+    typedef sqlite3_int64 (__cdecl *PFN_COLUMN_INT64)(sqlite3_stmt *, int);
+    typedef const void *(__cdecl *PFN_COLUMN_TEXT16)(sqlite3_stmt *, int);
+    typedef int (__cdecl *PFN_COLUMN_TYPE)(sqlite3_stmt *, int);
+    typedef const void *(__cdecl *PFN_ERRMSG16)(sqlite3 *);
+
+    CSqliteApi()
+        : m_dll(_T("sqlite3.dll"))
+        , open16(m_dll.Handle(), "sqlite3_open16")
+        , close(m_dll.Handle(), "sqlite3_close")
+        , exec(m_dll.Handle(), "sqlite3_exec")
+        , prepare_v2(m_dll.Handle(), "sqlite3_prepare_v2")
+        , bind_int64(m_dll.Handle(), "sqlite3_bind_int64")
+        , bind_null(m_dll.Handle(), "sqlite3_bind_null")
+        , bind_text16(m_dll.Handle(), "sqlite3_bind_text16")
+        , step(m_dll.Handle(), "sqlite3_step")
+        , reset(m_dll.Handle(), "sqlite3_reset")
+        , finalize(m_dll.Handle(), "sqlite3_finalize")
+        , column_int64(m_dll.Handle(), "sqlite3_column_int64")
+        , column_text16(m_dll.Handle(), "sqlite3_column_text16")
+        , column_type(m_dll.Handle(), "sqlite3_column_type")
+        , errmsg16(m_dll.Handle(), "sqlite3_errmsg16")
+    {
+    }
+
+    bool IsSupported()
+    {
+        return open16.IsSupported() && close.IsSupported() && exec.IsSupported()
+            && prepare_v2.IsSupported() && bind_int64.IsSupported() && bind_null.IsSupported()
+            && bind_text16.IsSupported() && step.IsSupported() && reset.IsSupported()
+            && finalize.IsSupported() && column_int64.IsSupported() && column_text16.IsSupported()
+            && column_type.IsSupported() && errmsg16.IsSupported();
+    }
+
+private:
+    CDllModule m_dll;   // Must be constructed first
+
+public:
+    CDynamicApi<PFN_OPEN16> open16;
+    CDynamicApi<PFN_CLOSE> close;
+    CDynamicApi<PFN_EXEC> exec;
+    CDynamicApi<PFN_PREPARE_V2> prepare_v2;
+    CDynamicApi<PFN_BIND_INT64> bind_int64;
+    CDynamicApi<PFN_BIND_NULL> bind_null;
+    CDynamicApi<PFN_BIND_TEXT16> bind_text16;
+    CDynamicApi<PFN_STEP> step;
+    CDynamicApi<PFN_RESET> reset;
+    CDynamicApi<PFN_FINALIZE> finalize;
+    CDynamicApi<PFN_COLUMN_INT64> column_int64;
+    CDynamicApi<PFN_COLUMN_TEXT16> column_text16;
+    CDynamicApi<PFN_COLUMN_TYPE> column_type;
+    CDynamicApi<PFN_ERRMSG16> errmsg16;
+};
+
+namespace
+{
+    // Loaded on first use
+    CSqliteApi& GetSqliteApi()
+    {
+        static CSqliteApi api;
+        return api;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool CScanDatabase::IsAvailable()
+{
+    return GetSqliteApi().IsSupported();
+}
+
+CScanDatabase::CScanDatabase()
+    : m_api(GetSqliteApi())
+    , m_db(NULL)
+    , m_insertNode(NULL)
+    , m_insertExtension(NULL)
+    , m_lastId(0)
+    , m_pendingRows(0)
+{
+}
+
+CScanDatabase::~CScanDatabase()
+{
+    Close();
+}
+
+// Writes the tree below root and the file hashes into a new database file.
+// An existing file is replaced. On failure, the file is deleted.
+//
+void CScanDatabase::Export(const CItem *root, const CFileHashMap& hashes, LPCTSTR path)
+{
+    ASSERT(root->IsDone());
+
+    if(!IsAvailable())
+    {
+        MdThrowStringException(IDS_SQLITENOTAVAILABLE);
+    }
+
+    if(::GetFileAttributes(path) != INVALID_FILE_ATTRIBUTES && !::DeleteFile(path))
+    {
+        MdThrowWinError(::GetLastError(), path);
+    }
+
+    try
+    {
+        Open(path);
+
+        // The file is of no use, if the export fails, so we don't need a journal.
+        Exec("PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;");
+
+        CStringA version;
+        version.Format("PRAGMA user_version = %d;", FORMAT_VERSION);
+        Exec(version);
+        Exec(SCHEMA);
+
+        m_insertNode = Prepare("INSERT INTO node VALUES(?, ?, ?, ?, ?, ?, ?, ?);");
+        m_insertExtension = Prepare("INSERT INTO extension VALUES(?, ?);");
+        m_lastId = 0;
+        m_pendingRows = 0;
+        m_extensionIds.RemoveAll();
+
+        Exec("BEGIN;");
+        ExportItem(root, 0);
+        Exec("COMMIT;");
+
+        Finalize(m_insertNode);
+        Finalize(m_insertExtension);
+
+        ExportHashes(hashes);
+
+        sqlite3_stmt *insertScan = Prepare("INSERT INTO scan VALUES(?, ?);");
+        try
+        {
+            BindText(insertScan, 1, _T("root"));
+            BindText(insertScan, 2, root->GetType() == IT_MYCOMPUTER ? root->GetName() : root->GetPath());
+            Check(m_api.step.pfnFct(insertScan));
+            Check(m_api.reset.pfnFct(insertScan));
+
+            BindText(insertScan, 1, _T("exported"));
+            BindText(insertScan, 2, CTime::GetCurrentTime().FormatGmt(_T("%Y-%m-%d %H:%M:%S")));
+            Check(m_api.step.pfnFct(insertScan));
+        }
+        catch(CException *)
+        {
+            Finalize(insertScan);
+            throw;
+        }
+        Finalize(insertScan);
+
+        CStringA indexes;
+        indexes.Format(INDEXES, IT_FILE);
+        Exec(indexes);
+
+        Close();
+    }
+    catch(CException *)
+    {
+        Close();
+        ::DeleteFile(path);
+        throw;
+    }
+}
+
+// Builds a new tree from a database written by Export().
+// The root item has the ITF_ROOTITEM flag; the caller owns it.
+// The file categories of the scan plugins are not stored.
+// The stored file hashes are added to hashes.
+//
+CItem *CScanDatabase::Import(LPCTSTR path, CFileHashMap& hashes)
+{
+    if(!IsAvailable())
+    {
+        MdThrowStringException(IDS_SQLITENOTAVAILABLE);
+    }
+
+    // sqlite3_open16() would create an empty database.
+    if(::GetFileAttributes(path) == INVALID_FILE_ATTRIBUTES)
+    {
+        MdThrowStringExceptionF(IDS_THEFILEsDOESNOTEXIST, path);
+    }
+
+    CItem *root = NULL;
+    sqlite3_stmt *select = NULL;
+    try
+    {
+        Open(path);
+
+        select = Prepare("PRAGMA user_version;");
+        if(m_api.step.pfnFct(select) != SQLITE_ROW || m_api.column_int64.pfnFct(select, 0) != FORMAT_VERSION)
+        {
+            MdThrowStringExceptionF(IDS_sISNOTASCANDATABASE, path);
+        }
+        Finalize(select);
+
+        select = Prepare("SELECT id, parent_id, type, name, size, mtime, attrs FROM node ORDER BY id;");
+
+        // The ancestors of the current row. As the ids are in preorder,
+        // the parent of a row is always on this stack.
+        CArray<sqlite3_int64, sqlite3_int64> stackIds;
+        CArray<CItem *, CItem *> stackItems;
+
+        int rc;
+        while(SQLITE_ROW == (rc = m_api.step.pfnFct(select)))
+        {
+            sqlite3_int64 id = m_api.column_int64.pfnFct(select, 0);
+            bool hasParent = (m_api.column_type.pfnFct(select, 1) != SQLITE_NULL);
+            sqlite3_int64 parentId = m_api.column_int64.pfnFct(select, 1);
+            sqlite3_int64 storedType = m_api.column_int64.pfnFct(select, 2);
+
+            if(!IsStoredType(storedType) || hasParent != (root != NULL))
+            {
+                MdThrowStringExceptionF(IDS_sISNOTASCANDATABASE, path);
+            }
+
+            ITEMTYPE type = (ITEMTYPE)storedType;
+            if(type == IT_FREESPACE || type == IT_UNKNOWN)
+            {
+                continue;
+            }
+
+            // Directories, which are not ancestors of this row, are complete.
+            while(stackIds.GetSize() > 0 && stackIds[stackIds.GetSize() - 1] != parentId)
+            {
+                stackItems[stackItems.GetSize() - 1]->SetDone();
+                stackIds.RemoveAt(stackIds.GetSize() - 1);
+                stackItems.RemoveAt(stackItems.GetSize() - 1);
+            }
+
+            CItem *parent = NULL;
+            if(root != NULL)
+            {
+                if(stackItems.GetSize() == 0)
+                {
+                    MdThrowStringExceptionF(IDS_sISNOTASCANDATABASE, path);
+                }
+                parent = stackItems[stackItems.GetSize() - 1];
+            }
+
+            CItem *item = new CItem(parent == NULL ? (ITEMTYPE)(type | ITF_ROOTITEM) : type, GetColumnText(select, 3), true);
+            if(IsLeaf(type))
+            {
+                item->SetSize(m_api.column_int64.pfnFct(select, 4));
+            }
+            if(m_api.column_type.pfnFct(select, 5) != SQLITE_NULL)
+            {
+                item->SetLastChange(Int64ToFileTime(m_api.column_int64.pfnFct(select, 5)));
+            }
+            if(m_api.column_type.pfnFct(select, 6) != SQLITE_NULL)
+            {
+                item->SetAttributes((DWORD)m_api.column_int64.pfnFct(select, 6));
+            }
+
+            if(parent == NULL)
+            {
+                root = item;
+            }
+            else
+            {
+                if(IsLeaf(type))
+                {
+                    item->SetDone();
+                }
+                parent->AddChild(item);
+                if(type == IT_FILE)
+                {
+                    parent->UpwardAddFiles(1);
+                }
+                else if(type == IT_DIRECTORY)
+                {
+                    parent->UpwardAddSubdirs(1);
+                }
+            }
+
+            if(type == IT_DRIVE)
+            {
+                if(GetDocument()->OptionShowFreeSpace())
+                {
+                    item->CreateFreeSpaceItem();
+                }
+                if(GetDocument()->OptionShowUnknown())
+                {
+                    item->CreateUnknownItem();
+                }
+            }
+
+            if(!IsLeaf(type))
+            {
+                stackIds.Add(id);
+                stackItems.Add(item);
+            }
+        }
+        if(rc != SQLITE_DONE)
+        {
+            Check(rc);
+        }
+        Finalize(select);
+
+        if(root == NULL || IsLeaf(root->GetType()))
+        {
+            MdThrowStringExceptionF(IDS_sISNOTASCANDATABASE, path);
+        }
+
+        for(int i = (int)stackItems.GetSize() - 1; i >= 0; i--)
+        {
+            stackItems[i]->SetDone();
+        }
+
+        ImportHashes(hashes);
+
+        Close();
+    }
+    catch(CException *)
+    {
+        Finalize(select);
+        Close();
+        delete root;
+        throw;
+    }
+
+    return root;
+}
+
+void CScanDatabase::Open(LPCTSTR path)
+{
+    ASSERT(m_db == NULL);
+
+    int rc = m_api.open16.pfnFct((LPCWSTR)CStringW(path), &m_db);
+    if(rc != SQLITE_OK)
+    {
+        CString error = (m_db != NULL ? GetErrorMessage() : MdGetWinErrorText(::GetLastError()));
+        Close();
+        MdThrowStringException(error);
+    }
+}
+
+void CScanDatabase::Close()
+{
+    Finalize(m_insertNode);
+    Finalize(m_insertExtension);
+
+    if(m_db != NULL)
+    {
+        m_api.close.pfnFct(m_db);
+        m_db = NULL;
+    }
+}
+
+void CScanDatabase::Exec(const char *sql)
+{
+    Check(m_api.exec.pfnFct(m_db, sql, NULL, NULL, NULL));
+}
+
+sqlite3_stmt *CScanDatabase::Prepare(const char *sql)
+{
+    sqlite3_stmt *stmt = NULL;
+    Check(m_api.prepare_v2.pfnFct(m_db, sql, -1, &stmt, NULL));
+    return stmt;
+}
+
+void CScanDatabase::Finalize(sqlite3_stmt *& stmt)
+{
+    if(stmt != NULL)
+    {
+        m_api.finalize.pfnFct(stmt);
+        stmt = NULL;
+    }
+}
+
+// Throws the error message of the database, if rc is an error code.
+//
+void CScanDatabase::Check(int rc)
+{
+    if(rc != SQLITE_OK && rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        MdThrowStringException(GetErrorMessage());
+    }
+}
+
+CString CScanDatabase::GetErrorMessage()
+{
+    return CString((LPCWSTR)m_api.errmsg16.pfnFct(m_db));
+}
+
+// text must stay valid until the statement has been stepped.
+//
+void CScanDatabase::BindText(sqlite3_stmt *stmt, int column, LPCTSTR text)
+{
+#ifdef UNICODE
+    Check(m_api.bind_text16.pfnFct(stmt, column, text, -1, SQLITE_STATIC));
+#else
+    Check(m_api.bind_text16.pfnFct(stmt, column, (LPCWSTR)CStringW(text), -1, SQLITE_TRANSIENT));
+#endif
+}
+
+CString CScanDatabase::GetColumnText(sqlite3_stmt *stmt, int column)
+{
+    return CString((LPCWSTR)m_api.column_text16.pfnFct(stmt, column));
+}
+
+// Inserts item and, recursively, its children in preorder.
+//
+void CScanDatabase::ExportItem(const CItem *item, sqlite3_int64 parentId)
+{
+    sqlite3_int64 id = ++m_lastId;
+    ITEMTYPE type = item->GetType();
+
+    // Drives are recreated from their path, see CItem::CItem().
+    CString name = (type == IT_DRIVE ? item->GetPath() : item->GetName());
+    CString ext;
+
+    Check(m_api.bind_int64.pfnFct(m_insertNode, 1, id));
+    if(parentId != 0)
+    {
+        Check(m_api.bind_int64.pfnFct(m_insertNode, 2, parentId));
+    }
+    else
+    {
+        Check(m_api.bind_null.pfnFct(m_insertNode, 2));
+    }
+    Check(m_api.bind_int64.pfnFct(m_insertNode, 3, type));
+    BindText(m_insertNode, 4, name);
+    Check(m_api.bind_int64.pfnFct(m_insertNode, 5, (sqlite3_int64)item->GetSize()));
+    Check(m_api.bind_int64.pfnFct(m_insertNode, 6, FileTimeToInt64(item->GetLastChange())));
+
+    if(type == IT_FILE || type == IT_DIRECTORY || type == IT_DRIVE)
+    {
+        Check(m_api.bind_int64.pfnFct(m_insertNode, 7, item->GetAttributes()));
+    }
+    else
+    {
+        Check(m_api.bind_null.pfnFct(m_insertNode, 7));
+    }
+
+    if(type == IT_FILE)
+    {
+        ext = item->GetExtension();
+        Check(m_api.bind_int64.pfnFct(m_insertNode, 8, GetExtensionId(ext)));
+    }
+    else
+    {
+        Check(m_api.bind_null.pfnFct(m_insertNode, 8));
+    }
+
+    Check(m_api.step.pfnFct(m_insertNode));
+    Check(m_api.reset.pfnFct(m_insertNode));
+
+    if(++m_pendingRows >= ROWS_PER_TRANSACTION)
+    {
+        Exec("COMMIT; BEGIN;");
+        m_pendingRows = 0;
+    }
+
+    for(int i = 0; i < item->GetChildrenCount(); i++)
+    {
+        ExportItem(item->GetChild(i), id);
+    }
+}
+
+// Returns the id of the extension, inserting it on first use.
+//
+sqlite3_int64 CScanDatabase::GetExtensionId(LPCTSTR ext)
+{
+    sqlite3_int64 id;
+    if(m_extensionIds.Lookup(ext, id))
+    {
+        return id;
+    }
+
+    id = m_extensionIds.GetCount() + 1;
+
+    Check(m_api.bind_int64.pfnFct(m_insertExtension, 1, id));
+    BindText(m_insertExtension, 2, ext);
+    Check(m_api.step.pfnFct(m_insertExtension));
+    Check(m_api.reset.pfnFct(m_insertExtension));
+
+    m_extensionIds.SetAt(ext, id);
+    return id;
+}
+
+// Entries of files which have changed meanwhile are harmless,
+// CDuplicateFinder compares size and last change anyway.
+//
+void CScanDatabase::ExportHashes(const CFileHashMap& hashes)
+{
+    sqlite3_stmt *insertHash = Prepare("INSERT INTO filehash VALUES(?, ?, ?, ?, ?);");
+    try
+    {
+        Exec("BEGIN;");
+
+        POSITION pos = hashes.GetStartPosition();
+        while(pos != NULL)
+        {
+            CString key;
+            FILEHASH fh;
+            hashes.GetNextAssoc(pos, key, fh);
+
+            BindText(insertHash, 1, key);
+            Check(m_api.bind_int64.pfnFct(insertHash, 2, (sqlite3_int64)fh.size));
+            Check(m_api.bind_int64.pfnFct(insertHash, 3, FileTimeToInt64(fh.lastChange)));
+            Check(m_api.bind_int64.pfnFct(insertHash, 4, (sqlite3_int64)fh.partialHash));
+            if(fh.hasFullHash)
+            {
+                Check(m_api.bind_int64.pfnFct(insertHash, 5, (sqlite3_int64)fh.fullHash));
+            }
+            else
+            {
+                Check(m_api.bind_null.pfnFct(insertHash, 5));
+            }
+            Check(m_api.step.pfnFct(insertHash));
+            Check(m_api.reset.pfnFct(insertHash));
+        }
+
+        Exec("COMMIT;");
+    }
+    catch(CException *)
+    {
+        Finalize(insertHash);
+        throw;
+    }
+    Finalize(insertHash);
+}
+
+// Databases exported before the hashes were stored don't have the table.
+//
+void CScanDatabase::ImportHashes(CFileHashMap& hashes)
+{
+    sqlite3_stmt *select = Prepare("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = 'filehash';");
+    try
+    {
+        bool exists = (m_api.step.pfnFct(select) == SQLITE_ROW && m_api.column_int64.pfnFct(select, 0) > 0);
+        Finalize(select);
+        if(!exists)
+        {
+            return;
+        }
+
+        select = Prepare("SELECT path, size, mtime, partial, full FROM filehash;");
+
+        int rc;
+        while(SQLITE_ROW == (rc = m_api.step.pfnFct(select)))
+        {
+            FILEHASH fh;
+            fh.size = (ULONGLONG)m_api.column_int64.pfnFct(select, 1);
+            fh.lastChange = Int64ToFileTime(m_api.column_int64.pfnFct(select, 2));
+            fh.partialHash = (ULONGLONG)m_api.column_int64.pfnFct(select, 3);
+            fh.hasFullHash = (m_api.column_type.pfnFct(select, 4) != SQLITE_NULL);
+            fh.fullHash = (fh.hasFullHash ? (ULONGLONG)m_api.column_int64.pfnFct(select, 4) : 0);
+
+            hashes.SetAt(GetColumnText(select, 0), fh);
+        }
+        if(rc != SQLITE_DONE)
+        {
+            Check(rc);
+        }
+    }
+    catch(CException *)
+    {
+        Finalize(select);
+        throw;
+    }
+    Finalize(select);
+}
@@ -0,0 +1,98 @@
+// ScanDatabase.h - Declaration of CScanDatabase
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SCANDATABASE_H__
+#define __WDS_SCANDATABASE_H__
+#pragma once
+
+#include <3rdparty/sqlite3/sqlite3.h>
+
+#include "DuplicateFinder.h"
+
+class CItem;
+class CSqliteApi;
+
+//
+// CScanDatabase. Exports a scan result into an SQLite database and
+// imports it again. sqlite3.dll is loaded at runtime; without it
+// IsAvailable() returns false.
+//
+// The export streams the tree in preorder through prepared statements,
+// committing every ROWS_PER_TRANSACTION rows, so memory use is independent
+// of the size of the tree. The database can be queried with any SQLite tool:
+//
+// node(id, parent_id, type, name, size, mtime, attrs, ext_id)
+//   id        Preorder number, so a parent always has a smaller id than its children
+//   parent_id NULL for the root
+//   type      ITEMTYPE (IT_DRIVE = 1, IT_DIRECTORY = 2, IT_FILE = 3, ...)
+//   name      Drives store their path ("C:\"), all other items their name
+//   size      Bytes; the subtree size for drives and directories
+//   mtime     FILETIME as 64 bit integer (100ns units since 1601)
+//   attrs     File attributes (NULL for pseudo items)
+//   ext_id    extension.id of files
+// extension(id, name)
+// scan(key, value)   "root", "exported"
+// filehash(path, size, mtime, partial, full)
+//           Cached content hashes (FILEHASH), path in lower case
+// file               View of the files with their extension name
+//
+// The methods throw CException *.
+//
+class CScanDatabase
+{
+public:
+    static bool IsAvailable();
+
+    CScanDatabase();
+    ~CScanDatabase();
+
+    void Export(const CItem *root, const CFileHashMap& hashes, LPCTSTR path);
+    CItem *Import(LPCTSTR path, CFileHashMap& hashes);
+
+private:
+    void Open(LPCTSTR path);
+    void Close();
+    void Exec(const char *sql);
+    sqlite3_stmt *Prepare(const char *sql);
+    void Finalize(sqlite3_stmt *& stmt);
+    void Check(int rc);
+    CString GetErrorMessage();
+    void BindText(sqlite3_stmt *stmt, int column, LPCTSTR text);
+    CString GetColumnText(sqlite3_stmt *stmt, int column);
+    void ExportItem(const CItem *item, sqlite3_int64 parentId);
+    sqlite3_int64 GetExtensionId(LPCTSTR ext);
+    void ExportHashes(const CFileHashMap& hashes);
+    void ImportHashes(CFileHashMap& hashes);
+
+    CSqliteApi& m_api;
+    sqlite3 *m_db;
+    sqlite3_stmt *m_insertNode;
+    sqlite3_stmt *m_insertExtension;
+    sqlite3_int64 m_lastId;         // Id of the last exported node
+    int m_pendingRows;              // Rows inserted in the current transaction
+    CMap<CString, LPCTSTR, sqlite3_int64, sqlite3_int64> m_extensionIds;
+};
+
+#endif // __WDS_SCANDATABASE_H__
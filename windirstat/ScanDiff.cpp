@@ -0,0 +1,309 @@
+// ScanDiff.cpp - Implementation of CDiffNode and CScanDiff
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "ScanDiff.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const COLORREF COLOR_NEW = RGB(0, 190, 0);          // Didn't exist in the older scan
+    const COLORREF COLOR_GROWN = RGB(240, 150, 0);      // File which has grown
+    const COLORREF COLOR_COLLAPSED = RGB(90, 110, 230); // Directory not yet expanded
+
+    ULONGLONG GetFiles(const CItem *item)
+    {
+        if(item == NULL)
+        {
+            return 0;
+        }
+        return item->GetType() == IT_FILE ? 1 : item->GetFilesCount();
+    }
+}
+
+CDiffNode::CDiffNode(CDiffNode *parent, const CItem *oldItem, const CItem *newItem)
+    : m_parent(parent)
+    , m_oldItem(oldItem)
+    , m_newItem(newItem)
+    , m_growth(0)
+    , m_expanded(false)
+    , m_rect(0, 0, 0, 0)
+{
+    ASSERT(newItem != NULL);
+
+    LONGLONG delta = GetDeltaSize();
+    m_growth = (delta > 0 ? delta : 0);
+}
+
+CDiffNode::~CDiffNode()
+{
+    for(int i = 0; i < m_children.GetSize(); i++)
+    {
+        delete m_children[i];
+    }
+}
+
+COLORREF CDiffNode::TmiGetGraphColor() const
+{
+    if(m_oldItem == NULL)
+    {
+        return COLOR_NEW;
+    }
+    return IsExpandable() ? COLOR_COLLAPSED : COLOR_GROWN;
+}
+
+CDiffNode *CDiffNode::GetParent() const
+{
+    return m_parent;
+}
+
+const CItem *CDiffNode::GetOldItem() const
+{
+    return m_oldItem;
+}
+
+const CItem *CDiffNode::GetNewItem() const
+{
+    return m_newItem;
+}
+
+CString CDiffNode::GetPath() const
+{
+    return m_newItem->GetPath();
+}
+
+LONGLONG CDiffNode::GetDeltaSize() const
+{
+    return (LONGLONG)m_newItem->GetSize() - (LONGLONG)(m_oldItem == NULL ? 0 : m_oldItem->GetSize());
+}
+
+LONGLONG CDiffNode::GetDeltaFiles() const
+{
+    return (LONGLONG)GetFiles(m_newItem) - (LONGLONG)GetFiles(m_oldItem);
+}
+
+bool CDiffNode::IsExpanded() const
+{
+    return m_expanded;
+}
+
+// Whether the node may get children, i.e. it's a directory which
+// hasn't been expanded yet.
+//
+bool CDiffNode::IsExpandable() const
+{
+    return !m_expanded && !IsLeaf(m_newItem->GetType());
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Takes ownership of oldRoot.
+//
+CScanDiff::CScanDiff(const CItem *newRoot, CItem *oldRoot)
+    : m_oldRoot(oldRoot)
+    , m_nodeCount(1)
+{
+    bool comparable = !IsLeaf(oldRoot->GetType()) && !IsLeaf(newRoot->GetType());
+    m_root = new CDiffNode(NULL, comparable ? oldRoot : NULL, newRoot);
+}
+
+CScanDiff::~CScanDiff()
+{
+    delete m_root;
+    delete m_oldRoot;
+}
+
+CDiffNode *CScanDiff::GetRoot()
+{
+    return m_root;
+}
+
+int CScanDiff::GetNodeCount() const
+{
+    return m_nodeCount;
+}
+
+// Expands the tree below node breadth first, until maxNodes new nodes
+// have been created or nothing is left to expand. Then updates the growth
+// of node and its ancestors, so that the treemap is consistent again.
+//
+void CScanDiff::ExpandBelow(CDiffNode *node, int maxNodes)
+{
+    int limit = m_nodeCount + maxNodes;
+
+    CArray<CDiffNode *, CDiffNode *> queue;
+    queue.Add(node);
+    for(int i = 0; i < queue.GetSize() && m_nodeCount < limit; i++)
+    {
+        CDiffNode *n = queue[i];
+        if(n->IsExpandable())
+        {
+            Expand(n);
+        }
+        for(int j = 0; j < n->m_children.GetSize(); j++)
+        {
+            queue.Add(n->m_children[j]);
+        }
+    }
+
+    RecurseUpdateGrowth(node);
+    UpwardUpdateGrowth(node->m_parent);
+}
+
+// Drives are matched by path, all other items by name.
+//
+CString CScanDiff::GetKey(const CItem *item)
+{
+    return item->GetType() == IT_DRIVE ? item->GetPath() : item->GetName();
+}
+
+// <Free Space> and <Unknown> don't belong to the scanned data.
+//
+bool CScanDiff::IsComparable(const CItem *item)
+{
+    return item->GetType() != IT_FREESPACE && item->GetType() != IT_UNKNOWN;
+}
+
+int __cdecl CScanDiff::_compareByKey(const void *p1, const void *p2)
+{
+    const CItem *item1 = *(const CItem **)p1;
+    const CItem *item2 = *(const CItem **)p2;
+    return GetKey(item1).CompareNoCase(GetKey(item2));
+}
+
+int __cdecl CScanDiff::_compareByGrowth(const void *p1, const void *p2)
+{
+    const CDiffNode *node1 = *(const CDiffNode **)p1;
+    const CDiffNode *node2 = *(const CDiffNode **)p2;
+    return node1->m_growth < node2->m_growth ? 1 : node1->m_growth == node2->m_growth ? 0 : -1;
+}
+
+// Merges the children of both items in one pass over the lists sorted by key.
+//
+void CScanDiff::Expand(CDiffNode *node)
+{
+    ASSERT(node->IsExpandable());
+    node->m_expanded = true;
+
+    CArray<const CItem *, const CItem *> newChildren;
+    GetSortedChildren(node->m_newItem, newChildren);
+
+    CArray<const CItem *, const CItem *> oldChildren;
+    if(node->m_oldItem != NULL)
+    {
+        GetSortedChildren(node->m_oldItem, oldChildren);
+    }
+
+    int i = 0;
+    int j = 0;
+    while(i < newChildren.GetSize())
+    {
+        int r = (j == oldChildren.GetSize() ? -1 : _compareByKey(&newChildren[i], &oldChildren[j]));
+        if(r < 0)
+        {
+            AddChildIfGrown(node, NULL, newChildren[i++]);
+        }
+        else if(r == 0)
+        {
+            AddChildIfGrown(node, oldChildren[j++], newChildren[i++]);
+        }
+        else
+        {
+            j++; // Deleted. It hasn't grown.
+        }
+    }
+}
+
+void CScanDiff::GetSortedChildren(const CItem *item, CArray<const CItem *, const CItem *>& children)
+{
+    children.SetSize(0, item->GetChildrenCount());
+    for(int i = 0; i < item->GetChildrenCount(); i++)
+    {
+        if(IsComparable(item->GetChild(i)))
+        {
+            children.Add(item->GetChild(i));
+        }
+    }
+    qsort(children.GetData(), children.GetSize(), sizeof(const CItem *), &_compareByKey);
+}
+
+// A file which has become a directory (or vice versa) is new.
+//
+void CScanDiff::AddChildIfGrown(CDiffNode *node, const CItem *oldItem, const CItem *newItem)
+{
+    if(oldItem != NULL && IsLeaf(oldItem->GetType()) != IsLeaf(newItem->GetType()))
+    {
+        oldItem = NULL;
+    }
+
+    if(newItem->GetSize() <= (oldItem == NULL ? 0 : oldItem->GetSize()))
+    {
+        return;
+    }
+
+    node->m_children.Add(new CDiffNode(node, oldItem, newItem));
+    m_nodeCount++;
+}
+
+// Return: the new growth of node.
+//
+ULONGLONG CScanDiff::RecurseUpdateGrowth(CDiffNode *node)
+{
+    if(node->m_children.GetSize() == 0)
+    {
+        return node->m_growth;
+    }
+
+    ULONGLONG growth = 0;
+    for(int i = 0; i < node->m_children.GetSize(); i++)
+    {
+        growth += RecurseUpdateGrowth(node->m_children[i]);
+    }
+    qsort(node->m_children.GetData(), node->m_children.GetSize(), sizeof(CDiffNode *), &_compareByGrowth);
+
+    node->m_growth = growth;
+    return growth;
+}
+
+void CScanDiff::UpwardUpdateGrowth(CDiffNode *node)
+{
+    for(; node != NULL; node = node->m_parent)
+    {
+        ULONGLONG growth = 0;
+        for(int i = 0; i < node->m_children.GetSize(); i++)
+        {
+            growth += node->m_children[i]->m_growth;
+        }
+        qsort(node->m_children.GetData(), node->m_children.GetSize(), sizeof(CDiffNode *), &_compareByGrowth);
+
+        node->m_growth = growth;
+    }
+}
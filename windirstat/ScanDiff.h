@@ -0,0 +1,118 @@
+// ScanDiff.h - Declaration of CDiffNode and CScanDiff
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SCANDIFF_H__
+#define __WDS_SCANDIFF_H__
+#pragma once
+
+#include "treemap.h"
+
+class CItem;
+class CScanDiff;
+
+//
+// CDiffNode. An item of the current scan paired with the item of the same
+// name in an older scan (or NULL, if the item is new). Only items which
+// have grown get a node.
+//
+// As a CTreemap::Item, the size of a node is its growth: the sum of the
+// growth of its children, once it has been expanded, and its net growth
+// (delta size) before. So a treemap of the nodes shows where the bytes
+// have been added, as far as the tree has been expanded.
+//
+class CDiffNode: public CTreemap::Item
+{
+    friend class CScanDiff;
+
+public:
+    CDiffNode(CDiffNode *parent, const CItem *oldItem, const CItem *newItem);
+    ~CDiffNode();
+
+    // CTreemap::Item interface
+    virtual            bool TmiIsLeaf()                const { return m_children.GetSize() == 0; }
+    virtual           CRect TmiGetRectangle()          const { return m_rect; }
+    virtual            void TmiSetRectangle(const CRect& rc) { m_rect = rc; }
+    virtual        COLORREF TmiGetGraphColor()         const;
+    virtual             int TmiGetChildrenCount()      const { return (int)m_children.GetSize(); }
+    virtual CTreemap::Item *TmiGetChild(int c)         const { return m_children[c]; }
+    virtual       ULONGLONG TmiGetSize()               const { return m_growth; }
+
+    CDiffNode *GetParent() const;
+    const CItem *GetOldItem() const;
+    const CItem *GetNewItem() const;
+    CString GetPath() const;
+    LONGLONG GetDeltaSize() const;
+    LONGLONG GetDeltaFiles() const;
+    bool IsExpanded() const;
+    bool IsExpandable() const;
+
+private:
+    CDiffNode *m_parent;
+    const CItem *m_oldItem;         // NULL, if new
+    const CItem *m_newItem;
+    ULONGLONG m_growth;             // See above
+    bool m_expanded;                // Children have been created
+    CArray<CDiffNode *, CDiffNode *> m_children;    // Sorted by growth, descending
+    CRect m_rect;                   // Treemap rectangle
+};
+
+//
+// CScanDiff. Compares the current tree with an older scan (imported with
+// CScanDatabase) to find out what has grown.
+//
+// Size and file count of a directory are subtree totals in both trees,
+// so the delta of a node is known without looking at its subtree. Nodes are
+// only expanded on demand (ExpandBelow()), merging the children lists of
+// both items sorted by name, so a diff of huge trees stays interactive.
+//
+class CScanDiff
+{
+public:
+    CScanDiff(const CItem *newRoot, CItem *oldRoot);
+    ~CScanDiff();
+
+    CDiffNode *GetRoot();
+    int GetNodeCount() const;
+
+    void ExpandBelow(CDiffNode *node, int maxNodes);
+
+private:
+    static CString GetKey(const CItem *item);
+    static bool IsComparable(const CItem *item);
+    static int __cdecl _compareByKey(const void *p1, const void *p2);
+    static int __cdecl _compareByGrowth(const void *p1, const void *p2);
+
+    void Expand(CDiffNode *node);
+    void GetSortedChildren(const CItem *item, CArray<const CItem *, const CItem *>& children);
+    void AddChildIfGrown(CDiffNode *node, const CItem *oldItem, const CItem *newItem);
+    ULONGLONG RecurseUpdateGrowth(CDiffNode *node);
+    void UpwardUpdateGrowth(CDiffNode *node);
+
+    CItem *m_oldRoot;               // We own the older scan
+    CDiffNode *m_root;
+    int m_nodeCount;
+};
+
+#endif // __WDS_SCANDIFF_H__
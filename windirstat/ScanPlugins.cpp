@@ -0,0 +1,464 @@
+// ScanPlugins.cpp - Implementation of CScanPlugins
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "WDS_Lua_C.h"
+#include "ScanStatistics.h"
+#include "ScanPlugins.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const LPCTSTR PLUGINFOLDER = _T("\\plugins");
+
+    // Executed first in each lua_State. Gets the address of m_node and
+    // luaAddCategory(), defines the wds table for the plugin scripts and
+    // returns the function which Evaluate() calls for each entry.
+    // It returns the decision and the category number.
+    const char prelude[] =
+        "local nodeaddress, addcategory = ...\n"
+        "local ffi = require('ffi')\n"
+        "ffi.cdef[[\n"
+        "typedef struct {\n"
+        "    const char *name;\n"
+        "    int nameLength;\n"
+        "    int isDirectory;\n"
+        "    const char *folder;\n"
+        "    int folderLength;\n"
+        "    uint32_t attributes;\n"
+        "    uint64_t size;\n"
+        "    uint64_t lastWriteTime;\n"
+        "} wds_node;\n"
+        "]]\n"
+        "local node = ffi.cast('const wds_node *', nodeaddress)\n"
+        "local filters, classifiers, categories = {}, {}, {}\n"
+        "wds = {\n"
+        "    INCLUDE = 0, DONTRECURSE = 1, EXCLUDE = 2,\n"
+        "    READONLY = 0x01, HIDDEN = 0x02, SYSTEM = 0x04, DIRECTORY = 0x10, ARCHIVE = 0x20,\n"
+        "    REPARSE_POINT = 0x400, COMPRESSED = 0x800, ENCRYPTED = 0x4000,\n"
+        "}\n"
+        "function wds.addfilter(f) filters[#filters + 1] = f end\n"
+        "function wds.addclassifier(f) classifiers[#classifiers + 1] = f end\n"
+        "function wds.name(n) return ffi.string(n.name, n.nameLength) end\n"
+        "function wds.folder(n) return ffi.string(n.folder, n.folderLength) end\n"
+        "return function()\n"
+        "    local decision = 0\n"
+        "    for i = 1, #filters do\n"
+        "        local d = filters[i](node)\n"
+        "        if d == 2 then return 2, 0 end\n"
+        "        if d == 1 then decision = 1 end\n"
+        "    end\n"
+        "    if node.isDirectory ~= 0 then return decision, 0 end\n"
+        "    for i = 1, #classifiers do\n"
+        "        local c = classifiers[i](node)\n"
+        "        if c then\n"
+        "            local id = categories[c]\n"
+        "            if not id then\n"
+        "                id = addcategory(c)\n"
+        "                categories[c] = id\n"
+        "            end\n"
+        "            return decision, id\n"
+        "        end\n"
+        "    end\n"
+        "    return decision, 0\n"
+        "end\n";
+
+#ifdef _DEBUG
+    // The scripts of Benchmark()
+    const char benchmarkTrivial[] =
+        "wds.addfilter(function(n)\n"
+        "    if n.size > 1e9 then return wds.EXCLUDE end\n"
+        "end)\n";
+
+    const char benchmarkPatterns[] =
+        "local patterns = { '%.tmp$', '%.bak$', '^~%$', '%.log%.%d+$', '^thumbs%.db$',\n"
+        "    '%.obj$', '%.pch$', '%.ilk$', '^node_modules$', '^%.git$' }\n"
+        "wds.addfilter(function(n)\n"
+        "    local name = wds.name(n):lower()\n"
+        "    for i = 1, #patterns do\n"
+        "        if name:find(patterns[i]) then return wds.EXCLUDE end\n"
+        "    end\n"
+        "end)\n";
+
+    const int BENCHMARK_ENTRIES = 200000;
+#endif //_DEBUG
+}
+
+CStringArray CScanPlugins::_categories;
+
+CScanPlugins::CScanPlugins()
+    : m_L(NULL)
+    , m_dispatcher(LUA_NOREF)
+{
+    ZeroMemory(&m_node, sizeof(m_node));
+}
+
+CScanPlugins::~CScanPlugins()
+{
+    Close();
+}
+
+CString CScanPlugins::GetPluginFolder()
+{
+    return GetAppFolder() + PLUGINFOLDER;
+}
+
+CString CScanPlugins::GetCategoryName(unsigned char category)
+{
+    ASSERT(category > 0 && category <= _categories.GetSize());
+    return _categories[category - 1];
+}
+
+#ifdef _DEBUG
+// Runs BENCHMARK_ENTRIES synthetic entries through a lua_State
+// without filters, with a trivial filter and with a filter which
+// matches the names against several patterns.
+// Return: a human readable report.
+//
+CString CScanPlugins::Benchmark()
+{
+    static const LPCTSTR names[] = {
+        _T("report.docx"), _T("IMG_1234.JPG"), _T("setup.exe"), _T("thumbs.db"),
+        _T("main.obj"), _T("build.log.1"), _T("notes.txt"), _T("~$report.docx"),
+        _T("movie.mkv"), _T("library.dll"), _T("archive.tar.gz"), _T("precompiled.pch")
+    };
+
+    struct BENCHMARK
+    {
+        LPCTSTR title;
+        const char *script;
+    };
+    static const BENCHMARK benchmarks[] = {
+        { _T("No filter"), "" },
+        { _T("Trivial filter"), benchmarkTrivial },
+        { _T("Pattern filter"), benchmarkPatterns }
+    };
+
+    CString report;
+    report.Format(_T("%d entries each:\r\n"), BENCHMARK_ENTRIES);
+
+    FILETIME t;
+    ::GetSystemTimeAsFileTime(&t);
+
+    for(int b = 0; b < (int)countof(benchmarks); b++)
+    {
+        CScanPlugins plugins;
+        if(!plugins.CreateState() || !plugins.RunScript(benchmarks[b].script, strlen(benchmarks[b].script), benchmarks[b].title))
+        {
+            report += _T("\r\n") + plugins.GetError();
+            continue;
+        }
+
+        plugins.SetFolder(_T("C:\\Users\\Public\\Documents"));
+
+        LONGLONG start = CScanStatistics::GetCounter();
+        for(int i = 0; i < BENCHMARK_ENTRIES && plugins.IsActive(); i++)
+        {
+            unsigned char category;
+            plugins.Evaluate(names[i % countof(names)], false, FILE_ATTRIBUTE_ARCHIVE, i, t, category);
+        }
+        double seconds = CScanStatistics::CountsToSeconds(CScanStatistics::GetCounter() - start);
+
+        CString s;
+        if(!plugins.IsActive())
+        {
+            s.Format(_T("\r\n%s: %s"), benchmarks[b].title, (LPCTSTR)plugins.GetError());
+        }
+        else
+        {
+            s.Format(_T("\r\n%s: %s files/s"), benchmarks[b].title, (LPCTSTR)FormatCount((ULONGLONG)(seconds > 0 ? BENCHMARK_ENTRIES / seconds : 0)));
+        }
+        report += s;
+    }
+
+    return report;
+}
+#endif //_DEBUG
+
+// Creates the lua_State and runs the scripts of the plugin folder
+// in alphabetical order.
+// Return: false, if a script failed. GetError() tells why.
+// If there are no scripts, the object stays inactive.
+//
+bool CScanPlugins::Open()
+{
+    Close();
+    m_error.Empty();
+
+    CStringArray scripts;
+    CFileFind finder;
+    BOOL b = finder.FindFile(GetPluginFolder() + _T("\\*.lua"));
+    while(b)
+    {
+        b = finder.FindNextFile();
+        if(!finder.IsDirectory())
+        {
+            scripts.Add(finder.GetFilePath());
+        }
+    }
+    finder.Close();
+
+    if(scripts.GetSize() == 0)
+    {
+        return true;
+    }
+
+    qsort(scripts.GetData(), scripts.GetSize(), sizeof(CString), &_compareStrings);
+
+    if(!CreateState())
+    {
+        return false;
+    }
+
+    for(int i = 0; i < scripts.GetSize(); i++)
+    {
+        if(!RunScriptFile(scripts[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CScanPlugins::Close()
+{
+    if(m_L != NULL)
+    {
+        lua_close(m_L);
+        m_L = NULL;
+    }
+    m_dispatcher = LUA_NOREF;
+}
+
+bool CScanPlugins::IsActive() const
+{
+    return m_L != NULL;
+}
+
+CString CScanPlugins::GetError() const
+{
+    return m_error;
+}
+
+// Called once per directory, before the entries are evaluated.
+//
+void CScanPlugins::SetFolder(LPCTSTR folder)
+{
+    ToUtf8(folder, m_folder);
+    m_node.folder = m_folder;
+    m_node.folderLength = m_folder.GetLength();
+}
+
+// If a script fails, the plugins are closed and the entry is included.
+//
+PLUGINDECISION CScanPlugins::Evaluate(LPCTSTR name, bool isDirectory, DWORD attributes, ULONGLONG size, const FILETIME& lastWriteTime, unsigned char& category)
+{
+    ASSERT(IsActive());
+    category = 0;
+
+    ToUtf8(name, m_name);
+    m_node.name = m_name;
+    m_node.nameLength = m_name.GetLength();
+    m_node.isDirectory = isDirectory;
+    m_node.attributes = attributes;
+    m_node.size = size;
+    m_node.lastWriteTime = ((ULONGLONG)lastWriteTime.dwHighDateTime << 32) | lastWriteTime.dwLowDateTime;
+
+    lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_dispatcher);
+    if(0 != lua_pcall(m_L, 0, 2, 0))
+    {
+        Fail(name);
+        return PD_INCLUDE;
+    }
+
+    int decision = (int)lua_tointeger(m_L, -2);
+    int c = (int)lua_tointeger(m_L, -1);
+    lua_pop(m_L, 2);
+
+    if(c > 0 && c <= _categories.GetSize())
+    {
+        category = (unsigned char)c;
+    }
+
+    switch(decision)
+    {
+    case PD_DONTRECURSE:
+        return isDirectory ? PD_DONTRECURSE : PD_INCLUDE;
+    case PD_EXCLUDE:
+        return PD_EXCLUDE;
+    default:
+        return PD_INCLUDE;
+    }
+}
+
+int __cdecl CScanPlugins::_compareStrings(const void *p1, const void *p2)
+{
+    const CString *s1 = (const CString *)p1;
+    const CString *s2 = (const CString *)p2;
+    return s1->CompareNoCase(*s2);
+}
+
+// addcategory(name) of the prelude.
+// Return (on the Lua stack): the category number, or 0 if there are already 255 categories.
+//
+int CScanPlugins::luaAddCategory(lua_State *L)
+{
+    CString name = CA2T(luaL_checkstring(L, 1), CP_UTF8);
+
+    int c = 0;
+    for(int i = 0; i < _categories.GetSize(); i++)
+    {
+        if(_categories[i] == name)
+        {
+            c = i + 1;
+            break;
+        }
+    }
+
+    if(c == 0 && _categories.GetSize() < UCHAR_MAX)
+    {
+        c = (int)_categories.Add(name) + 1;
+    }
+
+    lua_pushinteger(L, c);
+    return 1;
+}
+
+// Reuses the buffer of utf8, so that there is no allocation per entry.
+//
+void CScanPlugins::ToUtf8(LPCTSTR s, CStringA& utf8)
+{
+    int length = lstrlen(s);
+    int size = ::WideCharToMultiByte(CP_UTF8, 0, s, length, NULL, 0, NULL, NULL);
+    ::WideCharToMultiByte(CP_UTF8, 0, s, length, utf8.GetBuffer(size + 1), size, NULL, NULL);
+    utf8.ReleaseBuffer(size);
+}
+
+// Creates the lua_State with the ffi, bit and jit libraries and runs the prelude.
+//
+bool CScanPlugins::CreateState()
+{
+    ASSERT(m_L == NULL);
+
+    m_L = luaWDS_open();
+    if(m_L == NULL)
+    {
+        m_error = _T("luaWDS_open() failed.");
+        return false;
+    }
+
+    const luaL_Reg libs[] = {
+        {LUA_BITLIBNAME, luaopen_bit},
+        {LUA_JITLIBNAME, luaopen_jit},
+        {LUA_FFILIBNAME, luaopen_ffi}
+    };
+    for(int i = 0; i < (int)countof(libs); i++)
+    {
+        lua_pushcfunction(m_L, libs[i].func);
+        lua_pushstring(m_L, libs[i].name);
+        lua_call(m_L, 1, 0);
+    }
+
+    if(0 != luaL_loadbuffer(m_L, prelude, strlen(prelude), "=prelude"))
+    {
+        Fail(_T("prelude"));
+        return false;
+    }
+    lua_pushlightuserdata(m_L, &m_node);
+    lua_pushcfunction(m_L, luaAddCategory);
+    if(0 != lua_pcall(m_L, 2, 1, 0))
+    {
+        Fail(_T("prelude"));
+        return false;
+    }
+    m_dispatcher = luaL_ref(m_L, LUA_REGISTRYINDEX);
+
+    return true;
+}
+
+bool CScanPlugins::RunScript(const char *script, size_t size, LPCTSTR name)
+{
+    CStringA chunkName = "=" + CStringA(CT2A(name, CP_UTF8));
+
+    if(0 != luaL_loadbuffer(m_L, script, size, chunkName) || 0 != lua_pcall(m_L, 0, 0, 0))
+    {
+        Fail(name);
+        return false;
+    }
+    return true;
+}
+
+// We read the file ourselves, because luaL_loadfile() doesn't take Unicode paths.
+//
+bool CScanPlugins::RunScriptFile(LPCTSTR path)
+{
+    CArray<char, char> script;
+    try
+    {
+        CFile file(path, CFile::modeRead | CFile::shareDenyWrite);
+        script.SetSize((INT_PTR)file.GetLength());
+        if(script.GetSize() > 0)
+        {
+            file.Read(script.GetData(), (UINT)script.GetSize());
+        }
+    }
+    catch(CFileException *pe)
+    {
+        TCHAR szError[1024];
+        pe->GetErrorMessage(szError, countof(szError));
+        pe->Delete();
+        m_error.Format(_T("%s: %s"), path, szError);
+        Close();
+        return false;
+    }
+
+    LPCTSTR name = _tcsrchr(path, wds::chrBackslash);
+    return RunScript(script.GetData(), script.GetSize(), name != NULL ? name + 1 : path);
+}
+
+// Takes the error message from the Lua stack and closes the lua_State.
+// Only the first error of a scan is kept.
+//
+void CScanPlugins::Fail(LPCTSTR name)
+{
+    if(m_error.IsEmpty())
+    {
+        const char *msg = lua_tostring(m_L, -1);
+        if(msg != NULL)
+        {
+            m_error = CA2T(msg, CP_UTF8);
+        }
+        else
+        {
+            m_error.Format(_T("%s: error object is not a string"), name);
+        }
+    }
+    Close();
+}
@@ -0,0 +1,116 @@
+// ScanPlugins.h - Declaration of CScanPlugins
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SCANPLUGINS_H__
+#define __WDS_SCANPLUGINS_H__
+#pragma once
+
+struct lua_State;
+
+//
+// Decisions of the scan filters, in increasing order of precedence.
+//
+enum PLUGINDECISION
+{
+    PD_INCLUDE,         // Count the entry (and read the directory)
+    PD_DONTRECURSE,     // Show the directory, but don't read its contents
+    PD_EXCLUDE          // Ignore the entry
+};
+
+//
+// CScanPlugins. Runs the Lua scripts of the plugin folder during a scan.
+// The scripts register filters and classifiers with wds.addfilter() and
+// wds.addclassifier(). For every directory entry, CItem::DoSomeWork()
+// calls Evaluate() before it creates a CItem:
+// - a filter returns wds.INCLUDE (or nil), wds.DONTRECURSE or wds.EXCLUDE,
+// - a classifier returns nil or a category name. The category of a file
+//   replaces its extension in the extension list and the treemap colors.
+//
+// The entry is passed to the scripts as a pointer to an FFI struct
+// (wds_node), which is filled in place. So no tables or strings are
+// built per entry, and LuaJIT can compile the filters.
+//
+// Each scan owns its own lua_State (see CDirstatDoc::SetWorkingItem()).
+// All methods are called by the gui thread.
+//
+class CScanPlugins
+{
+public:
+    CScanPlugins();
+    ~CScanPlugins();
+
+    static CString GetPluginFolder();
+    static CString GetCategoryName(unsigned char category);
+#ifdef _DEBUG
+    static CString Benchmark();
+#endif //_DEBUG
+
+    bool Open();
+    void Close();
+    bool IsActive() const;
+    CString GetError() const;
+
+    void SetFolder(LPCTSTR folder);
+    PLUGINDECISION Evaluate(LPCTSTR name, bool isDirectory, DWORD attributes, ULONGLONG size, const FILETIME& lastWriteTime, unsigned char& category);
+
+private:
+    //
+    // Must match the declaration of wds_node in the prelude (ScanPlugins.cpp).
+    //
+    struct WDSNODE
+    {
+        const char *name;           // UTF-8, not null terminated
+        int nameLength;
+        int isDirectory;
+        const char *folder;         // UTF-8 path of the directory being read
+        int folderLength;
+        DWORD attributes;
+        ULONGLONG size;
+        ULONGLONG lastWriteTime;    // FILETIME
+    };
+
+    static int __cdecl _compareStrings(const void *p1, const void *p2);
+    static int luaAddCategory(lua_State *L);
+    static void ToUtf8(LPCTSTR s, CStringA& utf8);
+
+    bool CreateState();
+    bool RunScript(const char *script, size_t size, LPCTSTR name);
+    bool RunScriptFile(LPCTSTR path);
+    void Fail(LPCTSTR name);
+
+    lua_State *m_L;
+    int m_dispatcher;       // Registry reference of the function returned by the prelude
+    WDSNODE m_node;
+    CStringA m_name;        // Buffer of m_node.name
+    CStringA m_folder;      // Buffer of m_node.folder
+    CString m_error;        // First error of the current scan
+
+    // Category names. Category c (1..255) is _categories[c - 1],
+    // 0 means "no category". Categories are never removed, because
+    // the items keep their numbers.
+    static CStringArray _categories;
+};
+
+#endif // __WDS_SCANPLUGINS_H__
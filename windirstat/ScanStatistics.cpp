@@ -0,0 +1,425 @@
+// ScanStatistics.cpp - Implementation of CScanStatistics
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+LONGLONG CScanStatistics::_frequency = 0;
+bool CScanStatistics::_scanning = false;
+LONGLONG CScanStatistics::_scanStart = 0;
+LONGLONG CScanStatistics::_scanEnd = 0;
+ULONGLONG CScanStatistics::_directories = 0;
+ULONGLONG CScanStatistics::_files = 0;
+ULONGLONG CScanStatistics::_bytes = 0;
+LONGLONG CScanStatistics::_time[SC_CATEGORYCOUNT];
+CScanStatistics::CVolumeStatisticsMap CScanStatistics::_volumes;
+ULONGLONG CScanStatistics::_itemsCreated = 0;
+ULONGLONG CScanStatistics::_itemsAlive = 0;
+ULONGLONG CScanStatistics::_itemsPeak = 0;
+
+LONGLONG CScanStatistics::GetCounter()
+{
+    LARGE_INTEGER li;
+    ::QueryPerformanceCounter(&li);
+    return li.QuadPart;
+}
+
+// Return: counts per second, or 0 if there is no performance counter.
+//
+LONGLONG CScanStatistics::GetFrequency()
+{
+    if(_frequency == 0)
+    {
+        LARGE_INTEGER li;
+        if(::QueryPerformanceFrequency(&li))
+        {
+            _frequency = li.QuadPart;
+        }
+    }
+    return _frequency;
+}
+
+double CScanStatistics::CountsToSeconds(LONGLONG counts)
+{
+    if(GetFrequency() == 0)
+    {
+        return 0;
+    }
+    return (double)counts / GetFrequency();
+}
+
+LONGLONG CScanStatistics::MillisecondsToCounts(DWORD ms)
+{
+    return GetFrequency() * ms / 1000;
+}
+
+void CScanStatistics::StartScan()
+{
+    _scanning = true;
+    _scanStart = GetCounter();
+    _scanEnd = _scanStart;
+    _directories = 0;
+    _files = 0;
+    _bytes = 0;
+    ZeroMemory(_time, sizeof(_time));
+    _volumes.RemoveAll();
+    _itemsCreated = 0;
+    _itemsPeak = _itemsAlive;
+}
+
+void CScanStatistics::EndScan()
+{
+    if(!_scanning)
+    {
+        return;
+    }
+
+    _scanning = false;
+    _scanEnd = GetCounter();
+
+    CEventTrace::Complete(TE_SCAN, _scanStart, _directories, _files);
+
+    WriteDump();
+}
+
+// Called by CItem::DoWorkUntil(), when it takes the entries of a directory.
+// counts: the duration of the enumeration (CEnumerationQueue::Fetch()).
+//
+void CScanStatistics::AddDirectory(LPCTSTR path, ULONGLONG files, ULONGLONG bytes, LONGLONG counts)
+{
+    _directories++;
+    _files += files;
+    _bytes += bytes;
+    _time[SC_ENUMERATION] += counts;
+
+    CString volume = GetVolumeOfPath(path);
+    VOLUMESTATISTICS vs;
+    if(!_volumes.Lookup(volume, vs))
+    {
+        ZeroMemory(&vs, sizeof(vs));
+    }
+
+    vs.directories++;
+    vs.counts += counts;
+    vs.maxCounts = max(vs.maxCounts, counts);
+
+    double microseconds = CountsToSeconds(counts) * 1000000;
+    int bucket = 0;
+    for(double limit = 10; bucket < LATENCY_BUCKETS - 1 && microseconds >= limit; limit *= 10)
+    {
+        bucket++;
+    }
+    vs.buckets[bucket]++;
+
+    _volumes.SetAt(volume, vs);
+}
+
+void CScanStatistics::AddTime(STATCATEGORY category, LONGLONG counts)
+{
+    ASSERT(category >= 0 && category < SC_CATEGORYCOUNT);
+    _time[category] += counts;
+}
+
+void CScanStatistics::ItemCreated()
+{
+    _itemsCreated++;
+    _itemsAlive++;
+    _itemsPeak = max(_itemsPeak, _itemsAlive);
+}
+
+void CScanStatistics::ItemDeleted()
+{
+    ASSERT(_itemsAlive > 0);
+    _itemsAlive--;
+}
+
+ULONGLONG CScanStatistics::GetItemsAlive()
+{
+    return _itemsAlive;
+}
+
+// Human readable, for the statistics dialog.
+//
+CString CScanStatistics::GetReport()
+{
+    double seconds = GetScanSeconds();
+
+    CString report;
+    CString s;
+
+    s.FormatMessage(_scanning ? IDS_STATSCANRUNNINGs : IDS_STATSCANFINISHEDs, (LPCTSTR)FormatDouble(seconds));
+    report += s + _T("\r\n\r\n");
+
+    s.FormatMessage(IDS_STATDIRECTORIESss, (LPCTSTR)FormatCount(_directories), (LPCTSTR)FormatDouble(seconds > 0 ? _directories / seconds : 0));
+    report += s + _T("\r\n");
+    s.FormatMessage(IDS_STATFILESss, (LPCTSTR)FormatCount(_files), (LPCTSTR)FormatDouble(seconds > 0 ? _files / seconds : 0));
+    report += s + _T("\r\n");
+    s.FormatMessage(IDS_STATBYTESss, (LPCTSTR)FormatBytes(_bytes), (LPCTSTR)FormatBytes(seconds > 0 ? (ULONGLONG)(_bytes / seconds) : 0));
+    report += s + _T("\r\n\r\n");
+
+    for(int i = 0; i < SC_CATEGORYCOUNT; i++)
+    {
+        s.FormatMessage(IDS_STATTIMEss, (LPCTSTR)GetCategoryTitle((STATCATEGORY)i), (LPCTSTR)FormatDouble(CountsToSeconds(_time[i]) * 1000));
+        report += s + _T("\r\n");
+    }
+
+    s.FormatMessage(IDS_STATITEMSsss, (LPCTSTR)FormatCount(_itemsCreated), (LPCTSTR)FormatCount(_itemsAlive), (LPCTSTR)FormatCount(_itemsPeak));
+    report += _T("\r\n") + s + _T("\r\n");
+    report += GetWDSApp()->GetCurrentProcessMemoryInfo();
+    report += _T("\r\n");
+
+    POSITION pos = _volumes.GetStartPosition();
+    while(pos != NULL)
+    {
+        CString volume;
+        VOLUMESTATISTICS vs;
+        _volumes.GetNextAssoc(pos, volume, vs);
+
+        s.FormatMessage(IDS_STATVOLUMEssss,
+            (LPCTSTR)volume,
+            (LPCTSTR)FormatCount(vs.directories),
+            (LPCTSTR)FormatDouble(CountsToSeconds(vs.counts) * 1000 / vs.directories),
+            (LPCTSTR)FormatDouble(CountsToSeconds(vs.maxCounts) * 1000));
+        report += _T("\r\n") + s + _T("\r\n");
+
+        LPCTSTR limits[LATENCY_BUCKETS] = { _T("< 10 us"), _T("< 100 us"), _T("< 1 ms"), _T("< 10 ms"), _T("< 100 ms"), _T("< 1 s"), _T(">= 1 s") };
+        for(int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            s.Format(_T("    %-9s %s\r\n"), limits[i], (LPCTSTR)FormatCount(vs.buckets[i]));
+            report += s;
+        }
+    }
+
+    return report;
+}
+
+// Machine readable: one "key=value" per line, invariant number format.
+//
+CString CScanStatistics::GetDump()
+{
+    CString dump;
+    CString s;
+
+    s.Format(_T("scan.seconds=%.6f\r\n"), GetScanSeconds());
+    dump += s;
+    s.Format(_T("scan.directories=%I64u\r\n"), _directories);
+    dump += s;
+    s.Format(_T("scan.files=%I64u\r\n"), _files);
+    dump += s;
+    s.Format(_T("scan.bytes=%I64u\r\n"), _bytes);
+    dump += s;
+
+    for(int i = 0; i < SC_CATEGORYCOUNT; i++)
+    {
+        CString name = GetCategoryName((STATCATEGORY)i);
+        name.Remove(_T(' '));
+        name.MakeLower();
+        s.Format(_T("time.%s.seconds=%.6f\r\n"), (LPCTSTR)name, CountsToSeconds(_time[i]));
+        dump += s;
+    }
+
+    s.Format(_T("items.created=%I64u\r\nitems.alive=%I64u\r\nitems.peak=%I64u\r\n"), _itemsCreated, _itemsAlive, _itemsPeak);
+    dump += s;
+
+    POSITION pos = _volumes.GetStartPosition();
+    while(pos != NULL)
+    {
+        CString volume;
+        VOLUMESTATISTICS vs;
+        _volumes.GetNextAssoc(pos, volume, vs);
+
+        s.Format(_T("volume.%s.directories=%I64u\r\n"), (LPCTSTR)volume, vs.directories);
+        dump += s;
+        s.Format(_T("volume.%s.seconds=%.6f\r\n"), (LPCTSTR)volume, CountsToSeconds(vs.counts));
+        dump += s;
+        s.Format(_T("volume.%s.maxseconds=%.6f\r\n"), (LPCTSTR)volume, CountsToSeconds(vs.maxCounts));
+        dump += s;
+        for(int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            s.Format(_T("volume.%s.latency%d=%I64u\r\n"), (LPCTSTR)volume, i, vs.buckets[i]);
+            dump += s;
+        }
+    }
+
+    return dump;
+}
+
+// "C:\dir\*.*" -> "C:", "\\server\share\dir\*.*" -> "\\server\share"
+//
+CString CScanStatistics::GetVolumeOfPath(LPCTSTR path)
+{
+    CString s = path;
+    if(s.GetLength() >= 2 && s[1] == wds::chrColon)
+    {
+        return s.Left(2).MakeUpper();
+    }
+
+    if(s.Left(2) == _T("\\\\"))
+    {
+        int i = s.Find(wds::chrBackslash, 2);
+        if(i != -1)
+        {
+            i = s.Find(wds::chrBackslash, i + 1);
+        }
+        if(i != -1)
+        {
+            return s.Left(i);
+        }
+    }
+    return s;
+}
+
+// Invariant, for the keys of the dump.
+//
+LPCTSTR CScanStatistics::GetCategoryName(STATCATEGORY category)
+{
+    switch(category)
+    {
+    case SC_ENUMERATION:
+        return _T("Enumeration");
+    case SC_SORTING:
+        return _T("Sorting");
+    case SC_PACMAN:
+        return _T("Pacman");
+    case SC_PAINTING:
+        return _T("Painting");
+    case SC_TREEMAP:
+        return _T("Treemap");
+    case SC_EXTENSIONDATA:
+        return _T("Extension Data");
+    case SC_PLUGINS:
+        return _T("Plugins");
+    case SC_EXCLUSIONS:
+        return _T("Exclusion Rules");
+    default:
+        ASSERT(0);
+        return wds::strEmpty;
+    }
+}
+
+// Localized, for the report.
+//
+CString CScanStatistics::GetCategoryTitle(STATCATEGORY category)
+{
+    UINT id = 0;
+    switch(category)
+    {
+    case SC_ENUMERATION:
+        id = IDS_STATCAT_ENUMERATION;
+        break;
+    case SC_SORTING:
+        id = IDS_STATCAT_SORTING;
+        break;
+    case SC_PACMAN:
+        id = IDS_STATCAT_PACMAN;
+        break;
+    case SC_PAINTING:
+        id = IDS_STATCAT_PAINTING;
+        break;
+    case SC_TREEMAP:
+        id = IDS_STATCAT_TREEMAP;
+        break;
+    case SC_EXTENSIONDATA:
+        id = IDS_STATCAT_EXTENSIONDATA;
+        break;
+    case SC_PLUGINS:
+        id = IDS_STATCAT_PLUGINS;
+        break;
+    case SC_EXCLUSIONS:
+        id = IDS_STATCAT_EXCLUSIONS;
+        break;
+    default:
+        ASSERT(0);
+        return wds::strEmpty;
+    }
+    return LoadString(id);
+}
+
+double CScanStatistics::GetScanSeconds()
+{
+    return CountsToSeconds((_scanning ? GetCounter() : _scanEnd) - _scanStart);
+}
+
+// Writes GetDump() to the file CPersistence::GetScanStatisticsFile(),
+// if this (registry-only) setting is not empty.
+//
+void CScanStatistics::WriteDump()
+{
+    CString dump = GetDump();
+    VTRACE(_T("Scan statistics:\r\n%s"), dump);
+
+    CString fileName = CPersistence::GetScanStatisticsFile();
+    if(fileName.IsEmpty())
+    {
+        return;
+    }
+
+    try
+    {
+        CStdioFile file(fileName, CFile::modeCreate | CFile::modeWrite | CFile::typeText);
+        dump.Remove(_T('\r'));
+        file.WriteString(dump);
+        file.Close();
+    }
+    catch(CFileException *pe)
+    {
+        VTRACE(_T("Cannot write %s"), fileName);
+        pe->Delete();
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+CStatisticsTimer *CStatisticsTimer::_current = NULL;
+
+CStatisticsTimer::CStatisticsTimer(STATCATEGORY category)
+    : m_category(category)
+    , m_outer(_current)
+    , m_start(CScanStatistics::GetCounter())
+    , m_inner(0)
+{
+    _current = this;
+}
+
+CStatisticsTimer::~CStatisticsTimer()
+{
+    ASSERT(_current == this);
+
+    LONGLONG elapsed = CScanStatistics::GetCounter() - m_start;
+    CScanStatistics::AddTime(m_category, elapsed - m_inner);
+
+    if(m_outer != NULL)
+    {
+        m_outer->m_inner += elapsed;
+    }
+    _current = m_outer;
+}
@@ -0,0 +1,129 @@
+// ScanStatistics.h - Declaration of CScanStatistics and CStatisticsTimer
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_SCANSTATISTICS_H__
+#define __WDS_SCANSTATISTICS_H__
+#pragma once
+
+//
+// Categories of time measured by CScanStatistics.
+// SC_ENUMERATION is I/O of the enumeration threads, the others are
+// work of the gui thread. So they may overlap.
+//
+enum STATCATEGORY
+{
+    SC_ENUMERATION,     // FindFirstFile()/FindNextFile(), measured by the CEnumerationThreads
+    SC_SORTING,         // CSortingListControl::SortItems()
+    SC_PACMAN,          // Driving the pacman animations
+    SC_PAINTING,        // Painting the lists and the graph view (without the treemap layout)
+    SC_TREEMAP,         // CTreemap::DrawTreemap()
+    SC_EXTENSIONDATA,   // CDirstatDoc::RebuildExtensionData()
+    SC_PLUGINS,         // CScanPlugins::Evaluate()
+    SC_EXCLUSIONS,      // CExclusionRules::BeginDirectory() and Match()
+    SC_CATEGORYCOUNT
+};
+
+// Enumeration latency histogram: bucket i counts the directories
+// which took less than 10^(i+1) microseconds. The last bucket is open.
+const int LATENCY_BUCKETS = 7;
+
+//
+// CScanStatistics. Throughput and latency figures of the current
+// (or last) scan, measured with QueryPerformanceCounter().
+// A scan starts when the document gets a working item and ends when
+// the root item is done. All methods are called by the gui thread.
+//
+class CScanStatistics
+{
+public:
+    static LONGLONG GetCounter();
+    static double CountsToSeconds(LONGLONG counts);
+    static LONGLONG MillisecondsToCounts(DWORD ms);
+
+    static void StartScan();
+    static void EndScan();
+
+    static void AddDirectory(LPCTSTR path, ULONGLONG files, ULONGLONG bytes, LONGLONG counts);
+    static void AddTime(STATCATEGORY category, LONGLONG counts);
+    static CString GetVolumeOfPath(LPCTSTR path);
+
+    static void ItemCreated();
+    static void ItemDeleted();
+    static ULONGLONG GetItemsAlive();
+
+    static CString GetReport();
+    static CString GetDump();
+
+private:
+    struct VOLUMESTATISTICS
+    {
+        ULONGLONG directories;
+        LONGLONG counts;                    // Sum of the enumeration times
+        LONGLONG maxCounts;                 // Slowest directory
+        ULONGLONG buckets[LATENCY_BUCKETS];
+    };
+    typedef CMap<CString, LPCTSTR, VOLUMESTATISTICS, VOLUMESTATISTICS&> CVolumeStatisticsMap;
+
+    static LONGLONG GetFrequency();
+    static LPCTSTR GetCategoryName(STATCATEGORY category);
+    static CString GetCategoryTitle(STATCATEGORY category);
+    static double GetScanSeconds();
+    static void WriteDump();
+
+    static LONGLONG _frequency;         // QueryPerformanceFrequency(), 0 until GetFrequency()
+    static bool _scanning;
+    static LONGLONG _scanStart;         // Counter at StartScan()
+    static LONGLONG _scanEnd;           // Counter at EndScan(), valid if !_scanning
+    static ULONGLONG _directories;
+    static ULONGLONG _files;
+    static ULONGLONG _bytes;
+    static LONGLONG _time[SC_CATEGORYCOUNT];
+    static CVolumeStatisticsMap _volumes;
+    static ULONGLONG _itemsCreated;     // CItems created since StartScan()
+    static ULONGLONG _itemsAlive;       // CItems existing
+    static ULONGLONG _itemsPeak;        // Maximum of _itemsAlive since StartScan()
+};
+
+//
+// CStatisticsTimer. Adds its lifetime to a category of CScanStatistics.
+// Timers may be nested (e.g. the treemap is drawn while painting);
+// the time of an inner timer is not counted by the outer one.
+//
+class CStatisticsTimer
+{
+public:
+    CStatisticsTimer(STATCATEGORY category);
+    ~CStatisticsTimer();
+
+private:
+    static CStatisticsTimer *_current;  // Innermost running timer
+
+    const STATCATEGORY m_category;
+    CStatisticsTimer *const m_outer;
+    const LONGLONG m_start;
+    LONGLONG m_inner;                   // Time of the inner timers
+};
+
+#endif // __WDS_SCANSTATISTICS_H__
@@ -0,0 +1,187 @@
+// TopFiles.cpp - Implementation of CTopFiles
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "item.h"
+#include "TopFiles.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+// Returns the best count files below root in descending order.
+//
+void CTopFiles::Find(const CItem *root, TOPFILESORDER order, int count, CArray<const CItem *, const CItem *>& files)
+{
+    files.RemoveAll();
+    if(count <= 0 || IsLeaf(root->GetType()))
+    {
+        return;
+    }
+
+    // Directories to expand. Their scores are inverted, so that the best bound is on top.
+    CMinHeap directories;
+
+    // The best files so far, the worst of them on top.
+    CMinHeap best;
+
+    ENTRY entry;
+    entry.score = ~GetScore(order, root);
+    entry.item = root;
+    directories.Push(entry);
+
+    while(directories.GetCount() > 0)
+    {
+        const CItem *dir = directories.Pop().item;
+        if(best.GetCount() == count && GetScore(order, dir) <= best.GetTop().score)
+        {
+            break; // Neither this nor any other remaining directory can contribute.
+        }
+
+        for(int i = 0; i < dir->GetChildrenCount(); i++)
+        {
+            const CItem *child = dir->GetChild(i);
+            if(child->GetType() != IT_FILE && IsLeaf(child->GetType()))
+            {
+                continue;
+            }
+
+            entry.score = GetScore(order, child);
+            entry.item = child;
+
+            if(best.GetCount() == count && entry.score <= best.GetTop().score)
+            {
+                continue;
+            }
+
+            if(child->GetType() == IT_FILE)
+            {
+                if(best.GetCount() == count)
+                {
+                    best.Pop();
+                }
+                best.Push(entry);
+            }
+            else
+            {
+                entry.score = ~entry.score;
+                directories.Push(entry);
+            }
+        }
+    }
+
+    files.SetSize(best.GetCount());
+    for(int i = best.GetCount() - 1; i >= 0; i--)
+    {
+        files[i] = best.Pop().item;
+    }
+}
+
+// Of a file, its size or time. Of a directory, the best score
+// any of its files can have.
+//
+ULONGLONG CTopFiles::GetScore(TOPFILESORDER order, const CItem *item)
+{
+    FILETIME t;
+    switch (order)
+    {
+    case TFO_LARGEST:
+        return item->GetLargestFile();
+
+    case TFO_NEWEST:
+        t = item->GetLastChange();
+        return ((ULONGLONG)t.dwHighDateTime << 32) | t.dwLowDateTime;
+
+    default:
+        ASSERT(order == TFO_OLDEST);
+        t = item->GetOldestFile();
+        return ~(((ULONGLONG)t.dwHighDateTime << 32) | t.dwLowDateTime);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int CTopFiles::CMinHeap::GetCount() const
+{
+    return (int)m_entries.GetSize();
+}
+
+const CTopFiles::ENTRY& CTopFiles::CMinHeap::GetTop() const
+{
+    ASSERT(GetCount() > 0);
+    return m_entries[0];
+}
+
+void CTopFiles::CMinHeap::Push(const ENTRY& entry)
+{
+    int i = (int)m_entries.Add(entry);
+    while(i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if(m_entries[parent].score <= entry.score)
+        {
+            break;
+        }
+        m_entries[i] = m_entries[parent];
+        i = parent;
+    }
+    m_entries[i] = entry;
+}
+
+CTopFiles::ENTRY CTopFiles::CMinHeap::Pop()
+{
+    ASSERT(GetCount() > 0);
+
+    ENTRY top = m_entries[0];
+    ENTRY last = m_entries[GetCount() - 1];
+    m_entries.SetSize(GetCount() - 1);
+
+    int n = GetCount();
+    if(n > 0)
+    {
+        int i = 0;
+        for(;;)
+        {
+            int child = 2 * i + 1;
+            if(child >= n)
+            {
+                break;
+            }
+            if(child + 1 < n && m_entries[child + 1].score < m_entries[child].score)
+            {
+                child++;
+            }
+            if(last.score <= m_entries[child].score)
+            {
+                break;
+            }
+            m_entries[i] = m_entries[child];
+            i = child;
+        }
+        m_entries[i] = last;
+    }
+    return top;
+}
@@ -0,0 +1,80 @@
+// TopFiles.h - Declaration of CTopFiles
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_TOPFILES_H__
+#define __WDS_TOPFILES_H__
+#pragma once
+
+class CItem;
+
+enum TOPFILESORDER
+{
+    TFO_LARGEST,
+    TFO_NEWEST,
+    TFO_OLDEST,
+    TOPFILESORDERCOUNT
+};
+
+//
+// CTopFiles. Finds the largest (newest, oldest) files of a subtree
+// without visiting all of it.
+//
+// Every directory knows bounds of its whole subtree: the size of its
+// largest file (CItem::GetLargestFile()), its last change and the time of
+// its oldest file (CItem::GetOldestFile()). Find() expands the directories
+// best bound first and keeps the best count files found so far.
+// As soon as no remaining directory can beat the worst of them, it stops.
+//
+class CTopFiles
+{
+public:
+    static void Find(const CItem *root, TOPFILESORDER order, int count, CArray<const CItem *, const CItem *>& files);
+
+private:
+    struct ENTRY
+    {
+        ULONGLONG score;    // Greater is better
+        const CItem *item;
+    };
+
+    //
+    // CMinHeap. Binary heap of ENTRYs, the smallest score on top.
+    //
+    class CMinHeap
+    {
+    public:
+        int GetCount() const;
+        const ENTRY& GetTop() const;
+        void Push(const ENTRY& entry);
+        ENTRY Pop();
+
+    private:
+        CArray<ENTRY, const ENTRY&> m_entries;
+    };
+
+    static ULONGLONG GetScore(TOPFILESORDER order, const CItem *item);
+};
+
+#endif // __WDS_TOPFILES_H__
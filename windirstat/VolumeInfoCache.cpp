@@ -0,0 +1,421 @@
+// VolumeInfoCache.cpp - Implementation of CVolumeInfoCache and CVolumeInfoThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "windirstat.h"
+#include "EventTrace.h"
+#include "VolumeInfoCache.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const int MAX_THREADS = 4;                      // Size of the thread pool
+    const DWORD TIME_TO_LIVE = 5000;                // ms, for accessible volumes
+    const DWORD FAILURE_TIME_TO_LIVE = 30000;       // ms, for inaccessible volumes
+    const DWORD QUERY_TIMEOUT = 3000;               // ms
+    const DWORD POLL_INTERVAL = 100;                // ms, see Query()
+}
+
+const UINT WMU_VOLUMEINFO = ::RegisterWindowMessage(_T("{2E5A8C41-7B93-4F06-A1D7-93C0E6B5F284}"));
+
+CCriticalSection CVolumeInfoCache::_cs;
+CVolumeInfoCache::CEntryMap CVolumeInfoCache::_entries;
+CStringList CVolumeInfoCache::_queue;
+CEvent CVolumeInfoCache::_resultEvent(false, true);
+int CVolumeInfoCache::_threadCount = 0;
+HWND CVolumeInfoCache::_notifyWindow = NULL;
+UINT CVolumeInfoCache::_serial = 0;
+
+// The new window gets a WMU_VOLUMEINFO at once, so that it catches up
+// with the results, which have been posted to its predecessor.
+// Return: the previous window, so that a dialog can restore it.
+//
+HWND CVolumeInfoCache::SetNotifyWindow(HWND hwnd)
+{
+    CSingleLock lock(&_cs, true);
+    HWND previous = _notifyWindow;
+    _notifyWindow = hwnd;
+    _serial++;
+    Notify();
+    return previous;
+}
+
+void CVolumeInfoCache::InvalidateNotifyWindow()
+{
+    SetNotifyWindow(NULL);
+}
+
+UINT CVolumeInfoCache::GetSerial()
+{
+    CSingleLock lock(&_cs, true);
+    return _serial;
+}
+
+// Never blocks. Starts a refresh, if the cached information is outdated.
+// Return: false, if there is no information yet (info is untouched then).
+// Otherwise info may be outdated. WMU_VOLUMEINFO will be posted as soon as
+// the refresh is done.
+//
+bool CVolumeInfoCache::Lookup(LPCTSTR rootPath, VOLUMEINFO& info)
+{
+    CSingleLock lock(&_cs, true);
+
+    CheckTimeouts();
+
+    CString key = MakeKey(rootPath);
+    const ENTRY& entry = GetEntry(key);
+    if(!IsFresh(entry, TIME_TO_LIVE))
+    {
+        Schedule(key);
+    }
+
+    if(!entry.valid)
+    {
+        return false;
+    }
+
+    info = entry.info;
+    return true;
+}
+
+// Returns the cached information, if it is not older than maxAge.
+// Otherwise waits for a refresh, but not longer than QUERY_TIMEOUT.
+// Return: false, if there is no information at all (info is set to "inaccessible").
+//
+bool CVolumeInfoCache::Query(LPCTSTR rootPath, VOLUMEINFO& info, DWORD maxAge)
+{
+    CString key = MakeKey(rootPath);
+    DWORD start = ::GetTickCount();
+
+    for(;;)
+    {
+        DWORD wait = 0;
+        {
+            CSingleLock lock(&_cs, true);
+
+            CheckTimeouts();
+
+            const ENTRY& entry = GetEntry(key);
+
+            DWORD elapsed = ::GetTickCount() - start;
+            if(!IsFresh(entry, maxAge) && elapsed < QUERY_TIMEOUT)
+            {
+                Schedule(key);
+                _resultEvent.ResetEvent();
+                wait = min(QUERY_TIMEOUT - elapsed, POLL_INTERVAL);
+            }
+            else if(!entry.valid)
+            {
+                info.success = false;
+                info.volumeName.Empty();
+                info.fileSystem.Empty();
+                info.total = 0;
+                info.free = 0;
+                return false;
+            }
+            else
+            {
+                info = entry.info;
+                return true;
+            }
+        }
+
+        // We wake up at least every POLL_INTERVAL to look for timeouts.
+        ::WaitForSingleObject(_resultEvent, wait);
+    }
+}
+
+// To be called, when we know that the volume has changed
+// (e.g. files have been deleted).
+//
+void CVolumeInfoCache::Invalidate(LPCTSTR rootPath)
+{
+    CSingleLock lock(&_cs, true);
+    GetEntry(MakeKey(rootPath)).outdated = true;
+}
+
+// Replacement for CDirstatApp::getDiskFreeSpace().
+// current: false: never block (see Lookup()), true: see Query().
+//
+bool CVolumeInfoCache::GetDiskFreeSpace(LPCTSTR rootPath, ULONGLONG& total, ULONGLONG& free, bool current)
+{
+    VOLUMEINFO info;
+    bool b = current ? Query(rootPath, info, TIME_TO_LIVE) : Lookup(rootPath, info);
+    if(!b)
+    {
+        total = 0;
+        free = 0;
+        return false;
+    }
+
+    total = info.total;
+    free = info.free;
+    return info.success;
+}
+
+// "C:\" and "c:" shall denote the same entry.
+//
+CString CVolumeInfoCache::MakeKey(LPCTSTR rootPath)
+{
+    CString key = rootPath;
+    key.MakeLower();
+    if(key.Right(1) != wds::chrBackslash)
+    {
+        key += wds::chrBackslash;
+    }
+    return key;
+}
+
+// Creates the entry, if necessary. The reference stays valid
+// (CMap doesn't move its associations).
+//
+CVolumeInfoCache::ENTRY& CVolumeInfoCache::GetEntry(const CString& key)
+{
+    CEntryMap::CPair *pair = _entries.PLookup(key);
+    if(pair == NULL)
+    {
+        ENTRY entry;
+        entry.info.success = false;
+        entry.info.total = 0;
+        entry.info.free = 0;
+        entry.valid = false;
+        entry.outdated = false;
+        entry.timestamp = 0;
+        entry.state = VS_IDLE;
+        entry.queryStart = 0;
+
+        _entries.SetAt(key, entry);
+        pair = _entries.PLookup(key);
+    }
+    return pair->value;
+}
+
+bool CVolumeInfoCache::IsFresh(const ENTRY& entry, DWORD maxAge)
+{
+    if(!entry.valid || entry.outdated || entry.state == VS_QUEUED || entry.state == VS_RUNNING)
+    {
+        return false;
+    }
+
+    if(entry.state == VS_ABANDONED)
+    {
+        // Querying again would only hang another thread.
+        return true;
+    }
+
+    DWORD timeToLive = entry.info.success ? maxAge : FAILURE_TIME_TO_LIVE;
+    return ::GetTickCount() - entry.timestamp <= timeToLive;
+}
+
+void CVolumeInfoCache::Schedule(const CString& key)
+{
+    ENTRY& entry = GetEntry(key);
+    if(entry.state != VS_IDLE)
+    {
+        return;
+    }
+
+    entry.state = VS_QUEUED;
+    _queue.AddTail(key);
+
+    StartThreads();
+}
+
+void CVolumeInfoCache::StartThreads()
+{
+    int needed = min(MAX_THREADS - _threadCount, (int)_queue.GetCount());
+    for(int i = 0; i < needed; i++)
+    {
+        _threadCount++;
+        new CVolumeInfoThread; // deletes itself
+    }
+}
+
+// Abandons the queries which have been running for longer than QUERY_TIMEOUT.
+// The volumes are considered inaccessible, and the threads don't count
+// as members of the pool any more.
+//
+void CVolumeInfoCache::CheckTimeouts()
+{
+    DWORD now = ::GetTickCount();
+    bool abandoned = false;
+
+    CEntryMap::CPair *pair = _entries.PGetFirstAssoc();
+    while(pair != NULL)
+    {
+        ENTRY& entry = pair->value;
+        if(entry.state == VS_RUNNING && now - entry.queryStart > QUERY_TIMEOUT)
+        {
+            VTRACE(_T("Query of %s timed out."), (LPCTSTR)pair->key);
+
+            entry.state = VS_ABANDONED;
+            entry.info.success = false;
+            entry.valid = true;
+            entry.outdated = false;
+            entry.timestamp = now;
+
+            _threadCount--;
+            abandoned = true;
+        }
+        pair = _entries.PGetNextAssoc(pair);
+    }
+
+    if(abandoned)
+    {
+        StartThreads();
+        Notify();
+    }
+}
+
+void CVolumeInfoCache::Notify()
+{
+    if(_notifyWindow != NULL)
+    {
+        // Posted, not sent: we hold _cs. An invalid or recycled window handle
+        // is harmless, see CDeleteThread::DeleteBatch().
+        ::PostMessage(_notifyWindow, WMU_VOLUMEINFO, _serial, 0);
+    }
+}
+
+// Called by the threads.
+// Return: false, if the thread shall terminate.
+//
+bool CVolumeInfoCache::PopQuery(CString& rootPath)
+{
+    CSingleLock lock(&_cs, true);
+
+    if(_queue.IsEmpty())
+    {
+        _threadCount--;
+        return false;
+    }
+
+    rootPath = _queue.RemoveHead();
+
+    ENTRY& entry = GetEntry(rootPath);
+    ASSERT(entry.state == VS_QUEUED);
+    entry.state = VS_RUNNING;
+    entry.queryStart = ::GetTickCount();
+    // An Invalidate() from now on requires another query.
+    entry.outdated = false;
+
+    return true;
+}
+
+// Called by the threads.
+// Return: false, if the query had been abandoned. The thread must terminate then,
+// because it has already been removed from the pool.
+//
+bool CVolumeInfoCache::StoreResult(const CString& rootPath, const VOLUMEINFO& info)
+{
+    CSingleLock lock(&_cs, true);
+
+    ENTRY& entry = GetEntry(rootPath);
+    ASSERT(entry.state == VS_RUNNING || entry.state == VS_ABANDONED);
+
+    bool abandoned = (entry.state == VS_ABANDONED);
+
+    entry.info = info;
+    entry.valid = true;
+    entry.timestamp = ::GetTickCount();
+    entry.state = VS_IDLE;
+
+    _resultEvent.SetEvent();
+    Notify();
+
+    return !abandoned;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The constructor starts the thread.
+//
+CVolumeInfoThread::CVolumeInfoThread()
+{
+    ASSERT(m_bAutoDelete);
+    VERIFY(CreateThread());
+}
+
+BOOL CVolumeInfoThread::InitInstance()
+{
+    CEventTrace::SetThreadName("Volume information");
+
+    CString rootPath;
+    while(CVolumeInfoCache::PopQuery(rootPath))
+    {
+        VOLUMEINFO info;
+        {
+            CTraceScope scope(TE_VOLUMEINFO);
+            RetrieveVolumeInfo(rootPath, info);
+            scope.SetArgs(info.success, 0);
+        }
+
+#ifdef TESTTHREADS
+        srand(::GetTickCount());
+        ::Sleep((rand() & 0x07) * 1000);
+#endif
+
+        if(!CVolumeInfoCache::StoreResult(rootPath, info))
+        {
+            break;
+        }
+    }
+
+    CEventTrace::ReleaseThreadBuffer();
+
+    ASSERT(m_bAutoDelete); // Object will delete itself.
+    return false; // no Run(), please!
+}
+
+// Does the calls, which may hang.
+//
+void CVolumeInfoThread::RetrieveVolumeInfo(LPCTSTR rootPath, VOLUMEINFO& info)
+{
+    UINT old = ::SetErrorMode(SEM_FAILCRITICALERRORS);
+
+    DWORD dummy;
+    BOOL b = ::GetVolumeInformation(rootPath, info.volumeName.GetBuffer(256), 256, NULL, &dummy, &dummy, info.fileSystem.GetBuffer(MAX_PATH), MAX_PATH);
+    info.volumeName.ReleaseBuffer();
+    info.fileSystem.ReleaseBuffer();
+    if(!b)
+    {
+        VTRACE(_T("GetVolumeInformation(%s) failed: %u"), rootPath, ::GetLastError());
+        info.volumeName.Empty();
+        info.fileSystem.Empty();
+    }
+
+    bool spaceOk = CDirstatApp::getDiskFreeSpace(rootPath, info.total, info.free);
+
+    ::SetErrorMode(old);
+
+    // This condition *can* become true if quotas exist!
+    //ASSERT(info.free <= info.total);
+
+    info.success = (FALSE != b) && spaceOk;
+}
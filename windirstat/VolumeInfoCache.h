@@ -0,0 +1,128 @@
+// VolumeInfoCache.h - Declaration of CVolumeInfoCache and CVolumeInfoThread
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_VOLUMEINFOCACHE_H__
+#define __WDS_VOLUMEINFOCACHE_H__
+#pragma once
+
+//
+// Registered message posted (PostMessage) to the notification window
+// whenever new volume information has arrived or a query has timed out.
+// wParam = serial, lParam = 0
+//
+extern const UINT WMU_VOLUMEINFO;
+
+//
+// Information about one volume, e.g. "C:\" or "\\server\share\".
+//
+struct VOLUMEINFO
+{
+    bool success;           // false, if the volume is not accessible or the query timed out
+    CString volumeName;     // Label, e.g. "BOOT"
+    CString fileSystem;     // e.g. "NTFS"
+    ULONGLONG total;        // Capacity
+    ULONGLONG free;         // Free space
+};
+
+//
+// CVolumeInfoCache. Caches the VOLUMEINFO of all volumes we have seen.
+// The entries are refreshed asynchronously by a small pool of
+// CVolumeInfoThreads, when they are older than a time to live.
+// GetVolumeInformation() and GetDiskFreeSpaceEx() may hang for ca. 30 sec,
+// if a network drive is not accessible. Queries which don't return within
+// QUERY_TIMEOUT are abandoned; the volume is then considered inaccessible
+// until the hanging thread returns.
+// The public methods are called by the gui thread.
+//
+class CVolumeInfoCache
+{
+public:
+    static HWND SetNotifyWindow(HWND hwnd);
+    static void InvalidateNotifyWindow();
+    static UINT GetSerial();
+
+    static bool Lookup(LPCTSTR rootPath, VOLUMEINFO& info);
+    static bool Query(LPCTSTR rootPath, VOLUMEINFO& info, DWORD maxAge);
+    static void Invalidate(LPCTSTR rootPath);
+
+    static bool GetDiskFreeSpace(LPCTSTR rootPath, ULONGLONG& total, ULONGLONG& free, bool current);
+
+private:
+    friend class CVolumeInfoThread;
+
+    enum STATE
+    {
+        VS_IDLE,        // No query pending
+        VS_QUEUED,      // Waiting for a free thread
+        VS_RUNNING,     // A thread is querying
+        VS_ABANDONED    // The query has timed out, but the thread has not yet returned
+    };
+
+    struct ENTRY
+    {
+        VOLUMEINFO info;
+        bool valid;         // info has been set at least once
+        bool outdated;      // Invalidate() has been called
+        DWORD timestamp;    // GetTickCount() when info was set
+        STATE state;
+        DWORD queryStart;   // GetTickCount() when the thread started, valid if VS_RUNNING
+    };
+    typedef CMap<CString, LPCTSTR, ENTRY, ENTRY&> CEntryMap;
+
+    static CString MakeKey(LPCTSTR rootPath);
+    static ENTRY& GetEntry(const CString& key);
+    static bool IsFresh(const ENTRY& entry, DWORD maxAge);
+    static void Schedule(const CString& key);
+    static void StartThreads();
+    static void CheckTimeouts();
+    static void Notify();
+
+    static bool PopQuery(CString& rootPath);
+    static bool StoreResult(const CString& rootPath, const VOLUMEINFO& info);
+
+    static CCriticalSection _cs;    // Synchronizes all the following members
+    static CEntryMap _entries;      // Key: MakeKey(rootPath)
+    static CStringList _queue;      // Keys waiting for a thread
+    static CEvent _resultEvent;     // Set by StoreResult(). Manual reset.
+    static int _threadCount;        // # Threads not abandoned
+    static HWND _notifyWindow;      // Receiver of WMU_VOLUMEINFO
+    static UINT _serial;            // Serial number of _notifyWindow
+};
+
+//
+// CVolumeInfoThread. Queries volumes until the queue of
+// CVolumeInfoCache is empty and then terminates itself.
+//
+class CVolumeInfoThread: public CWinThread
+{
+public:
+    CVolumeInfoThread();
+    virtual BOOL InitInstance();
+
+protected:
+    static void RetrieveVolumeInfo(LPCTSTR rootPath, VOLUMEINFO& info);
+};
+
+#endif // __WDS_VOLUMEINFOCACHE_H__
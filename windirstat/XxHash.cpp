@@ -0,0 +1,170 @@
+// XxHash.cpp - Implementation of CXxHash64
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#include "stdafx.h"
+#include "XxHash.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+namespace
+{
+    const ULONGLONG PRIME64_1 = 11400714785074694791ui64;
+    const ULONGLONG PRIME64_2 = 14029467366897019727ui64;
+    const ULONGLONG PRIME64_3 = 1609587929392839161ui64;
+    const ULONGLONG PRIME64_4 = 9650029242287828579ui64;
+    const ULONGLONG PRIME64_5 = 2870177450012600261ui64;
+}
+
+CXxHash64::CXxHash64(ULONGLONG seed)
+    : m_seed(seed)
+    , m_totalLength(0)
+    , m_v1(seed + PRIME64_1 + PRIME64_2)
+    , m_v2(seed + PRIME64_2)
+    , m_v3(seed)
+    , m_v4(seed - PRIME64_1)
+    , m_buffered(0)
+{
+}
+
+void CXxHash64::Update(const void *data, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + length;
+
+    m_totalLength += length;
+
+    if(m_buffered + length < sizeof(m_buffer))
+    {
+        memcpy(m_buffer + m_buffered, p, length);
+        m_buffered += length;
+        return;
+    }
+
+    if(m_buffered > 0)
+    {
+        size_t fill = sizeof(m_buffer) - m_buffered;
+        memcpy(m_buffer + m_buffered, p, fill);
+        p += fill;
+
+        m_v1 = Round(m_v1, Read64(m_buffer));
+        m_v2 = Round(m_v2, Read64(m_buffer + 8));
+        m_v3 = Round(m_v3, Read64(m_buffer + 16));
+        m_v4 = Round(m_v4, Read64(m_buffer + 24));
+        m_buffered = 0;
+    }
+
+    while(end - p >= 32)
+    {
+        m_v1 = Round(m_v1, Read64(p));
+        m_v2 = Round(m_v2, Read64(p + 8));
+        m_v3 = Round(m_v3, Read64(p + 16));
+        m_v4 = Round(m_v4, Read64(p + 24));
+        p += 32;
+    }
+
+    m_buffered = end - p;
+    memcpy(m_buffer, p, m_buffered);
+}
+
+ULONGLONG CXxHash64::Final() const
+{
+    ULONGLONG h;
+    if(m_totalLength >= 32)
+    {
+        h = _rotl64(m_v1, 1) + _rotl64(m_v2, 7) + _rotl64(m_v3, 12) + _rotl64(m_v4, 18);
+        h = MergeRound(h, m_v1);
+        h = MergeRound(h, m_v2);
+        h = MergeRound(h, m_v3);
+        h = MergeRound(h, m_v4);
+    }
+    else
+    {
+        h = m_seed + PRIME64_5;
+    }
+
+    h += m_totalLength;
+
+    const unsigned char *p = m_buffer;
+    const unsigned char *end = m_buffer + m_buffered;
+
+    while(end - p >= 8)
+    {
+        h ^= Round(0, Read64(p));
+        h = _rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if(end - p >= 4)
+    {
+        h ^= Read32(p) * PRIME64_1;
+        h = _rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while(p < end)
+    {
+        h ^= *p * PRIME64_5;
+        h = _rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+ULONGLONG CXxHash64::Round(ULONGLONG acc, ULONGLONG input)
+{
+    acc += input * PRIME64_2;
+    acc = _rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+ULONGLONG CXxHash64::MergeRound(ULONGLONG acc, ULONGLONG value)
+{
+    acc ^= Round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// The hash is defined on little endian values, like Windows has.
+//
+ULONGLONG CXxHash64::Read64(const unsigned char *p)
+{
+    ULONGLONG v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+ULONGLONG CXxHash64::Read32(const unsigned char *p)
+{
+    DWORD v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
@@ -0,0 +1,60 @@
+// XxHash.h - Declaration of CXxHash64
+//
+// WinDirStat - Directory Statistics
+// Copyright (C) 2003-2005 Bernhard Seifert
+// Copyright (C) 2004-2006, 2008 Oliver Schneider (assarbad.net)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Author(s): - bseifert -> http://windirstat.info/contact/bernhard/
+//            - assarbad -> http://windirstat.info/contact/oliver/
+//
+
+
+#ifndef __WDS_XXHASH_H__
+#define __WDS_XXHASH_H__
+#pragma once
+
+//
+// CXxHash64. Streaming implementation of the 64 bit xxHash (XXH64)
+// by Yann Collet. It is a non-cryptographic hash which runs at memory
+// speed, so hashing file contents is bound by the disk only.
+// Feed the data with Update() in pieces of any size, then call Final().
+//
+class CXxHash64
+{
+public:
+    CXxHash64(ULONGLONG seed = 0);
+
+    void Update(const void *data, size_t length);
+    ULONGLONG Final() const;
+
+private:
+    static ULONGLONG Round(ULONGLONG acc, ULONGLONG input);
+    static ULONGLONG MergeRound(ULONGLONG acc, ULONGLONG value);
+    static ULONGLONG Read64(const unsigned char *p);
+    static ULONGLONG Read32(const unsigned char *p);
+
+    ULONGLONG m_seed;
+    ULONGLONG m_totalLength;
+    ULONGLONG m_v1;
+    ULONGLONG m_v2;
+    ULONGLONG m_v3;
+    ULONGLONG m_v4;
+    unsigned char m_buffer[32];     // Incomplete stripe
+    size_t m_buffered;              // Bytes in m_buffer
+};
+
+#endif // __WDS_XXHASH_H__
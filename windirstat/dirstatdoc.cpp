@@ -29,6 +29,22 @@
 #include "osspecific.h"
 #include "deletewarningdlg.h"
 #include "modalshellapi.h"
+#include "DeleteQueue.h"
+#include "VolumeInfoCache.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
+#include "CleanupProgressDlg.h"
+#include "ScanDatabase.h"
+#include "ReportWriter.h"
+#include "SaveReportDlg.h"
+#include "ItemQuery.h"
+#include "QueryDlg.h"
+#include "TopFilesDlg.h"
+#include "DuplicatesDlg.h"
+#include "ScanDiff.h"
+#include "GrowthDlg.h"
+#include "ItemPager.h"
+#include "EnumerationQueue.h"
 #include "dirstatdoc.h"
 
 #ifdef _DEBUG
@@ -52,6 +68,13 @@ namespace
         RGB(255, 255, 150),
         RGB(255, 255, 255)
     };
+
+    const DWORD WORKSLICE = 600; // ms
+
+    // Scan preview (UpdateScanPreview())
+    const DWORD PREVIEWINTERVAL = 3000;     // ms, minimum time between two previews
+    const DWORD PREVIEWCOSTFACTOR = 10;     // A preview may take at most a tenth of the time
+    const ULONGLONG PREVIEWGROWTH = 50;     // A new preview, when the zoom item has grown by 1/50
 }
 
 CDirstatDoc *_theDocument;
@@ -75,7 +98,10 @@ CDirstatDoc::CDirstatDoc()
 
     m_showFreeSpace = CPersistence::GetShowFreeSpace();
     m_showUnknown = CPersistence::GetShowUnknown();
+    m_scanPreview = CPersistence::GetScanPreview();
     m_extensionDataValid = false;
+    ResetScanPreview();
+    m_deletedToTrashBin = false;
 
     VTRACE(_T("sizeof(CItem) = %d"), sizeof(CItem));
 }
@@ -84,6 +110,7 @@ CDirstatDoc::~CDirstatDoc()
 {
     CPersistence::SetShowFreeSpace(m_showFreeSpace);
     CPersistence::SetShowUnknown(m_showUnknown);
+    CPersistence::SetScanPreview(m_scanPreview);
 
     delete m_rootItem;
     _theDocument = NULL;
@@ -192,11 +219,14 @@ TCHAR CDirstatDoc::GetEncodingSeparator()
 
 void CDirstatDoc::DeleteContents()
 {
+    CItemPager::Reset();
+    CEnumerationQueue::Reset();
     delete m_rootItem;
     m_rootItem = NULL;
     SetWorkingItem(NULL);
     m_zoomItem = NULL;
     m_selectedItems.RemoveAll();
+    m_pendingSizes.RemoveAll();
     GetWDSApp()->ReReadMountPoints();
 }
 
@@ -274,8 +304,16 @@ BOOL CDirstatDoc::OnOpenDocument(LPCTSTR lpszPathName)
 
     SetWorkingItem(m_rootItem);
 
-    GetMainFrame()->MinimizeGraphView();
-    GetMainFrame()->MinimizeTypeView();
+    if(m_scanPreview)
+    {
+        GetMainFrame()->RestoreGraphView();
+        GetMainFrame()->RestoreTypeView();
+    }
+    else
+    {
+        GetMainFrame()->MinimizeGraphView();
+        GetMainFrame()->MinimizeTypeView();
+    }
 
     UpdateAllViews(NULL, HINT_NEWROOT);
     return true;
@@ -311,7 +349,13 @@ void CDirstatDoc::SetTitlePrefix(CString prefix)
 COLORREF CDirstatDoc::GetCushionColor(LPCTSTR ext)
 {
     SExtensionRecord r;
-    VERIFY(GetExtensionData()->Lookup(ext, r));
+    if(!GetExtensionData()->Lookup(ext, r))
+    {
+        // Scan preview: the scan has found the extension after
+        // the last RebuildExtensionData().
+        ASSERT(!m_rootItem->IsDone());
+        return RGB(150,150,150) | CTreemap::COLORFLAG_LIGHTER;
+    }
     return r.color;
 }
 
@@ -330,6 +374,11 @@ bool CDirstatDoc::OptionShowUnknown()
     return m_showUnknown;
 }
 
+bool CDirstatDoc::OptionScanPreview()
+{
+    return m_scanPreview;
+}
+
 const CExtensionData *CDirstatDoc::GetExtensionData()
 {
     if(!m_extensionDataValid)
@@ -339,11 +388,32 @@ const CExtensionData *CDirstatDoc::GetExtensionData()
     return &m_extensionData;
 }
 
+// While a session is scanning, the size of the roots which are done,
+// or, with the scan preview, the size scanned so far.
+// Base of the percentages of the type list.
+//
 ULONGLONG CDirstatDoc::GetRootSize()
 {
     ASSERT(m_rootItem != NULL);
-    ASSERT(IsRootDone());
-    return m_rootItem->GetSize();
+    ASSERT(IsAnyRootDone() || m_scanPreview);
+
+    if(m_rootItem->IsDone() || m_scanPreview)
+    {
+        return m_rootItem->GetSize();
+    }
+
+    CArray<CItem *, CItem *> roots;
+    GetSessionRoots(roots);
+
+    ULONGLONG size = 0;
+    for(int i = 0; i < roots.GetSize(); i++)
+    {
+        if(roots[i]->IsDone())
+        {
+            size += roots[i]->GetSize();
+        }
+    }
+    return size;
 }
 
 void CDirstatDoc::ForgetItemTree()
@@ -352,12 +422,23 @@ void CDirstatDoc::ForgetItemTree()
     // As "delete m_rootItem" can last a long time (many minutes), if
     // we have been paged out, we simply forget our item tree here and
     // hope that the system will free all our memory anyway.
+    CItemPager::Reset();
+    CEnumerationQueue::Reset();
     m_rootItem = NULL;
 
     m_zoomItem = NULL;
     m_selectedItems.RemoveAll();
 }
 
+// Length of the slices passed to Work(). The GUI is updated between
+// the slices. With animation, the slices are as short as one frame,
+// so that the animation timer gets its WM_TIMER in time.
+//
+DWORD CDirstatDoc::GetWorkSlice(bool animate)
+{
+    return animate ? CTreeListControl::FRAME_INTERVAL : WORKSLICE;
+}
+
 // This method does some work for ticks ms.
 // return: true if done or suspended.
 //
@@ -368,16 +449,38 @@ bool CDirstatDoc::Work(DWORD ticks)
         return true;
     }
 
+    // Also while suspended, so that a scan, which has exceeded
+    // the memory budget, can be suspended.
+    if(CItemPager::Trim(m_rootItem))
+    {
+        ClearReselectChildStack();
+    }
+
+    // Here, and not where the page in failed, which may have been anywhere.
+    ReportPageInError();
+
     if(GetMainFrame()->IsProgressSuspended())
     {
         return true;
     }
 
+    bool waiting = false;
     if(!m_rootItem->IsDone())
     {
-        m_rootItem->DoSomeWork(ticks);
+        bool pluginsActive = m_scanPlugins.IsActive();
+        int rootsDone = CountDoneSessionRoots();
+        {
+            CTraceScope scope(TE_WORK, ticks);
+            waiting = !m_rootItem->DoSomeWork(ticks);
+        }
+        if(pluginsActive && !m_scanPlugins.IsActive())
+        {
+            ReportScanPluginError();
+        }
         if(m_rootItem->IsDone())
         {
+            CScanStatistics::EndScan();
+
             m_extensionDataValid = false;
 
             GetMainFrame()->SetProgressPos100();
@@ -388,6 +491,22 @@ bool CDirstatDoc::Work(DWORD ticks)
         }
         else
         {
+            if(CountDoneSessionRoots() > rootsDone)
+            {
+                // A root of the session is done. It becomes interactive
+                // (treemap, type list), while the others are still scanning.
+                m_extensionDataValid = false;
+
+                if(rootsDone == 0)
+                {
+                    GetMainFrame()->RestoreTypeView();
+                    GetMainFrame()->RestoreGraphView();
+                }
+
+                UpdateAllViews(NULL, HINT_TREEMAPSTYLECHANGED); // Colors may have changed
+                UpdateAllViews(NULL);
+            }
+
             ASSERT(m_workingItem != NULL);
             if(m_workingItem != NULL) // to be honest, "defensive programming" is stupid, but c'est la vie: it's safer.
             {
@@ -395,6 +514,11 @@ bool CDirstatDoc::Work(DWORD ticks)
             }
 
             UpdateAllViews(NULL, HINT_SOMEWORKDONE);
+
+            if(m_scanPreview)
+            {
+                UpdateScanPreview();
+            }
         }
 
     }
@@ -405,7 +529,9 @@ bool CDirstatDoc::Work(DWORD ticks)
     }
     else
     {
-        return false;
+        // While all the work waits for the enumeration threads, we need
+        // no idle time. WMU_ENUMERATED wakes us up.
+        return waiting;
     }
 }
 
@@ -466,6 +592,178 @@ bool CDirstatDoc::IsZoomed()
     return GetZoomItem() != GetRootItem();
 }
 
+// Whether the treemap can be shown. While a session is scanning,
+// the user can zoom into the roots which are done. With the scan
+// preview, the treemap shows the tree as far as it has been scanned,
+// as soon as something has been found.
+//
+bool CDirstatDoc::IsTreemapAvailable()
+{
+    if(NULL == m_zoomItem)
+    {
+        return false;
+    }
+    return m_zoomItem->IsDone() || (m_scanPreview && m_zoomItem->TmiGetSize() > 0);
+}
+
+// The snapshot of the pending space of an undone drive (CItem::GetPendingSize()).
+//
+ULONGLONG CDirstatDoc::GetPendingSize(const CItem *drive)
+{
+    ULONGLONG pending = 0;
+    m_pendingSizes.Lookup(drive, pending);
+    return pending;
+}
+
+// The roots of the session: the children of "My Computer",
+// or the root item itself.
+//
+void CDirstatDoc::GetSessionRoots(CArray<CItem *, CItem *>& roots)
+{
+    roots.RemoveAll();
+
+    if(NULL == m_rootItem)
+    {
+        return;
+    }
+
+    if(IT_MYCOMPUTER == m_rootItem->GetType())
+    {
+        for(int i = 0; i < m_rootItem->GetChildrenCount(); i++)
+        {
+            roots.Add(m_rootItem->GetChild(i));
+        }
+    }
+    else
+    {
+        roots.Add(m_rootItem);
+    }
+}
+
+bool CDirstatDoc::IsAnyRootDone()
+{
+    return CountDoneSessionRoots() > 0;
+}
+
+// Adds drives or folders to the session, without restarting the scans
+// of the other roots. CItem::DoWorkUntil() interleaves the scans of all
+// roots. Their directories are enumerated by one thread per volume
+// (CEnumerationQueue), so a slow volume doesn't delay the others.
+// If the document has a single root yet, it becomes the first
+// root of the session under a new "My Computer".
+//
+void CDirstatDoc::AddSessionRoots(const CStringArray& paths)
+{
+    ASSERT(m_rootItem != NULL);
+
+    ClearReselectChildStack();
+
+    bool newRoot = false;
+    if(m_rootItem->GetType() != IT_MYCOMPUTER)
+    {
+        // The items will be inserted again under the new root.
+        CTreeListControl::GetTheTreeListControl()->RemoveAllRows();
+
+        CItem *root = new CItem((ITEMTYPE)(IT_MYCOMPUTER | ITF_ROOTITEM), LoadString(IDS_MYCOMPUTER));
+        root->AddSessionRoot(m_rootItem);
+        m_rootItem = root;
+        m_showMyComputer = true;
+        newRoot = true;
+    }
+
+    int added = 0;
+    for(int i = 0; i < paths.GetSize(); i++)
+    {
+        if(FindSessionRoot(paths[i]) != NULL)
+        {
+            continue;
+        }
+
+        CItem *item = NULL;
+        if(IsDrive(paths[i]))
+        {
+            item = new CItem(IT_DRIVE, paths[i]);
+            m_rootItem->AddSessionRoot(item);
+
+            if(OptionShowFreeSpace())
+            {
+                item->CreateFreeSpaceItem();
+            }
+            if(OptionShowUnknown())
+            {
+                item->CreateUnknownItem();
+            }
+        }
+        else
+        {
+            // ITF_ROOTITEM: the folder itself is neither excluded nor a junction to skip.
+            // No UpdateLastChange(): on an unresponsive share it would block us.
+            // The read job takes the last change from the entries.
+            item = new CItem((ITEMTYPE)(IT_DIRECTORY | ITF_ROOTITEM), paths[i]);
+            m_rootItem->AddSessionRoot(item);
+        }
+        added++;
+    }
+
+    if(added == 0 && !newRoot)
+    {
+        return;
+    }
+
+    m_extensionDataValid = false;
+    UpdateSessionTitle();
+
+    // Starts the scan, or adjusts the progress range
+    SetWorkingItem(m_rootItem);
+
+    UpdateAllViews(NULL, newRoot ? HINT_NEWROOT : HINT_NULL);
+}
+
+// Removes a root from the session, also while it is being scanned.
+// The other roots are not affected.
+//
+void CDirstatDoc::RemoveSessionRoot(CItem *root)
+{
+    ASSERT(m_rootItem != NULL);
+    ASSERT(IT_MYCOMPUTER == m_rootItem->GetType());
+    ASSERT(root->GetParent() == m_rootItem);
+
+    ClearReselectChildStack();
+
+    if(root->IsAncestorOf(GetZoomItem()))
+    {
+        SetZoomItem(m_rootItem);
+    }
+
+    for(int i = (int)m_selectedItems.GetSize() - 1; i >= 0; i--)
+    {
+        if(root->IsAncestorOf(m_selectedItems[i]))
+        {
+            m_selectedItems.RemoveAt(i);
+        }
+    }
+    if(m_selectedItems.GetSize() == 0)
+    {
+        AddSelection(m_rootItem);
+    }
+
+    m_pendingSizes.RemoveKey(root);
+    m_rootItem->RemoveSessionRoot(m_rootItem->FindChildIndex(root)); // --> delete root
+
+    m_extensionDataValid = false;
+    UpdateSessionTitle();
+
+    if(m_workingItem != NULL)
+    {
+        // Adjusts the progress range. If the root was the last one
+        // scanning, Work() will find "My Computer" done.
+        SetWorkingItem(m_rootItem);
+    }
+
+    UpdateAllViews(NULL, HINT_SELECTIONCHANGED);
+    UpdateAllViews(NULL);
+}
+
 void CDirstatDoc::RemoveAllSelections()
 {
     m_selectedItems.RemoveAll();
@@ -520,6 +818,14 @@ void CDirstatDoc::SetSelection(const CItem * /*item*/, bool /*keepReselectChildS
 {
 }
 
+// Replaces the selection by items. Other than AddSelection(),
+// this accepts items of different parents (the result of a query).
+//
+void CDirstatDoc::SelectItems(const CArray<CItem *, CItem *>& items)
+{
+    m_selectedItems.Copy(items);
+}
+
 CItem *CDirstatDoc::GetSelection(size_t i)
 {
     return m_selectedItems.GetCount() ? m_selectedItems[i] : 0;
@@ -542,6 +848,26 @@ bool CDirstatDoc::IsSelected(const CItem *item)
     return false;
 }
 
+// Collects the selected items, if all of them are files or directories,
+// which can be deleted.
+// Return: false, if the selection is empty or contains other items.
+//
+bool CDirstatDoc::GetDeletableSelection(CArray<CItem *, CItem *>& items)
+{
+    items.RemoveAll();
+    for(int i = 0; i < m_selectedItems.GetSize(); i++)
+    {
+        CItem *item = m_selectedItems[i];
+        if(item->GetType() != IT_DIRECTORY && item->GetType() != IT_FILE || item->IsRootItem())
+        {
+            items.RemoveAll();
+            return false;
+        }
+        items.Add(item);
+    }
+    return items.GetSize() > 0;
+}
+
 void CDirstatDoc::SetHighlightExtension(LPCTSTR ext)
 {
     m_highlightExtension = ext;
@@ -617,6 +943,13 @@ ULONGLONG CDirstatDoc::GetWorkingItemReadJobs()
     }
 }
 
+// Called by CItem::DoSomeWork(). The plugins are active only while a scan is running.
+//
+CScanPlugins *CDirstatDoc::GetScanPlugins()
+{
+    return &m_scanPlugins;
+}
+
 void CDirstatDoc::OpenItem(const CItem *item)
 {
     ASSERT(item != NULL);
@@ -718,11 +1051,14 @@ void CDirstatDoc::GetDriveItems(CArray<CItem *, CItem *>& drives)
 
     if(IT_MYCOMPUTER == root->GetType())
     {
+        // A session may contain folders, too.
         for(int i = 0; i < root->GetChildrenCount(); i++)
         {
             CItem *drive = root->GetChild(i);
-            ASSERT(IT_DRIVE == drive->GetType());
-            drives.Add(drive);
+            if(IT_DRIVE == drive->GetType())
+            {
+                drives.Add(drive);
+            }
         }
     }
     else if(IT_DRIVE == root->GetType())
@@ -731,6 +1067,128 @@ void CDirstatDoc::GetDriveItems(CArray<CItem *, CItem *>& drives)
     }
 }
 
+// Scan preview: lets treemap and type list show the tree as far as it has
+// been scanned. On a multi-hour scan, the complete layout can take seconds,
+// so this is throttled: not before PREVIEWINTERVAL ms, and not before
+// PREVIEWCOSTFACTOR times the duration of the last preview have elapsed,
+// and only, if the zoom item has grown by more than 1/PREVIEWGROWTH.
+//
+void CDirstatDoc::UpdateScanPreview()
+{
+    if(::GetTickCount() - m_previewTime < m_previewInterval)
+    {
+        return;
+    }
+
+    CItem *zoom = GetZoomItem();
+    if(zoom == NULL || zoom->IsDone())
+    {
+        return;
+    }
+
+    ULONGLONG size = zoom->GetSize();
+    if(size <= m_previewSize + m_previewSize / PREVIEWGROWTH)
+    {
+        return;
+    }
+
+    DWORD start = ::GetTickCount();
+
+    SnapshotPendingSizes();
+    m_extensionDataValid = false;
+
+    // The graph view draws synchronously, so that we can measure the time.
+    UpdateAllViews(NULL, HINT_SCANPREVIEW);
+
+    m_previewTime = ::GetTickCount();
+    m_previewInterval = max(PREVIEWINTERVAL, (m_previewTime - start) * PREVIEWCOSTFACTOR);
+    m_previewSize = size;
+}
+
+// The pending space of a drive is its used space minus what has been
+// scanned so far. It is shown as <Unknown>, so only drives with an
+// <Unknown> item have pending space.
+//
+void CDirstatDoc::SnapshotPendingSizes()
+{
+    m_pendingSizes.RemoveAll();
+
+    CArray<CItem *, CItem *> drives;
+    GetDriveItems(drives);
+
+    for(int i = 0; i < drives.GetSize(); i++)
+    {
+        if(drives[i]->IsDone() || drives[i]->FindUnknownItem() == NULL)
+        {
+            continue;
+        }
+
+        ULONGLONG range = drives[i]->GetProgressRange();
+        ULONGLONG pos = drives[i]->GetProgressPos();
+        m_pendingSizes.SetAt(drives[i], range > pos ? range - pos : 0);
+    }
+}
+
+// Called when a scan starts or ends.
+//
+void CDirstatDoc::ResetScanPreview()
+{
+    m_previewTime = ::GetTickCount();
+    m_previewInterval = PREVIEWINTERVAL;
+    m_previewSize = 0;
+    m_pendingSizes.RemoveAll();
+}
+
+int CDirstatDoc::CountDoneSessionRoots()
+{
+    CArray<CItem *, CItem *> roots;
+    GetSessionRoots(roots);
+
+    int done = 0;
+    for(int i = 0; i < roots.GetSize(); i++)
+    {
+        if(roots[i]->IsDone())
+        {
+            done++;
+        }
+    }
+    return done;
+}
+
+CItem *CDirstatDoc::FindSessionRoot(const CString& path)
+{
+    CArray<CItem *, CItem *> roots;
+    GetSessionRoots(roots);
+
+    for(int i = 0; i < roots.GetSize(); i++)
+    {
+        if(roots[i]->GetPath().CompareNoCase(path) == 0)
+        {
+            return roots[i];
+        }
+    }
+    return NULL;
+}
+
+// The title lists the roots of the session.
+//
+void CDirstatDoc::UpdateSessionTitle()
+{
+    CArray<CItem *, CItem *> roots;
+    GetSessionRoots(roots);
+
+    CString title;
+    for(int i = 0; i < roots.GetSize(); i++)
+    {
+        if(i > 0)
+        {
+            title += _T(", ");
+        }
+        title += roots[i]->GetPath();
+    }
+    SetTitle(title);
+}
+
 void CDirstatDoc::RefreshRecyclers()
 {
     CArray<CItem *, CItem *> drives;
@@ -747,15 +1205,34 @@ void CDirstatDoc::RefreshRecyclers()
 void CDirstatDoc::RebuildExtensionData()
 {
     CWaitCursor wc;
+    CStatisticsTimer timer(SC_EXTENSIONDATA);
+    CTraceScope scope(TE_EXTENSIONDATA);
 
     m_extensionData.RemoveAll();
-    m_rootItem->RecurseCollectExtensionData(&m_extensionData);
+    if(m_rootItem->IsDone() || m_scanPreview)
+    {
+        m_rootItem->RecurseCollectExtensionData(&m_extensionData);
+    }
+    else
+    {
+        // While the session is scanning: the roots which are done (see Work()).
+        CArray<CItem *, CItem *> roots;
+        GetSessionRoots(roots);
+        for(int i = 0; i < roots.GetSize(); i++)
+        {
+            if(roots[i]->IsDone())
+            {
+                roots[i]->RecurseCollectExtensionData(&m_extensionData);
+            }
+        }
+    }
 
     CStringArray sortedExtensions;
     SortExtensionData(sortedExtensions);
     SetExtensionColors(sortedExtensions);
 
     m_extensionDataValid = true;
+    scope.SetArgs(m_extensionData.GetCount(), 0);
 }
 
 void CDirstatDoc::SortExtensionData(CStringArray& sortedExtensions)
@@ -823,8 +1300,52 @@ void CDirstatDoc::SetWorkingItemAncestor(CItem *item)
     }
 }
 
+// The scan continues without the plugins.
+//
+void CDirstatDoc::ReportScanPluginError()
+{
+    CString msg;
+    msg.FormatMessage(IDS_SCANPLUGINFAILEDs, (LPCTSTR)m_scanPlugins.GetError());
+    AfxMessageBox(msg);
+}
+
+// A failed CItem::PageIn() has lost the children of a directory.
+// The views show it grayed out.
+//
+void CDirstatDoc::ReportPageInError()
+{
+    CString path;
+    CString error;
+    if(!CItemPager::TakeError(path, error))
+    {
+        return;
+    }
+
+    UpdateAllViews(NULL, HINT_TREEMAPSTYLECHANGED); // The cushion of the directory has turned gray
+
+    CString msg;
+    msg.FormatMessage(IDS_PAGEINFAILEDss, (LPCTSTR)path, (LPCTSTR)error);
+    AfxMessageBox(msg, MB_ICONWARNING);
+}
+
 void CDirstatDoc::SetWorkingItem(CItem *item)
 {
+    if(m_workingItem == NULL && item != NULL)
+    {
+        CScanStatistics::StartScan();
+        ResetScanPreview();
+
+        if(!m_scanPlugins.Open())
+        {
+            ReportScanPluginError();
+        }
+    }
+    else if(m_workingItem != NULL && item == NULL)
+    {
+        m_scanPlugins.Close();
+        ResetScanPreview();
+    }
+
     if(GetMainFrame() != NULL)
     {
         if(item != NULL)
@@ -839,15 +1360,26 @@ void CDirstatDoc::SetWorkingItem(CItem *item)
     m_workingItem = item;
 }
 
-// Deletes a file or directory via SHFileOperation.
+// Queues files and directories for deletion by the CDeleteThread,
+// which batches them into one single SHFileOperation.
+// The tree is updated in OnPathDeleted(), as soon as the thread reports back.
 // Return: false, if canceled
 //
-bool CDirstatDoc::DeletePhysicalItem(CItem *item, bool toTrashBin)
+bool CDirstatDoc::DeletePhysicalItems(const CArray<CItem *, CItem *>& items, bool toTrashBin)
 {
+    ASSERT(items.GetSize() > 0);
+
     if(CPersistence::GetShowDeleteWarning())
     {
         CDeleteWarningDlg warning;
-        warning.m_fileName = item->GetPath();
+        if(items.GetSize() == 1)
+        {
+            warning.m_fileName = items[0]->GetPath();
+        }
+        else
+        {
+            warning.m_fileName.FormatMessage(IDS_sANDdMORE, (LPCTSTR)items[0]->GetPath(), (int)items.GetSize() - 1);
+        }
         if(IDYES != warning.DoModal())
         {
             return false;
@@ -855,17 +1387,182 @@ bool CDirstatDoc::DeletePhysicalItem(CItem *item, bool toTrashBin)
         CPersistence::SetShowDeleteWarning(!warning.m_dontShowAgain);
     }
 
-    ASSERT(item->GetParent() != NULL);
+    CStringArray paths;
+    for(int i = 0; i < items.GetSize(); i++)
+    {
+        ASSERT(items[i]->GetParent() != NULL);
+        paths.Add(items[i]->GetPath());
+    }
 
-    CModalShellApi msa;
-    msa.DeleteFile(item->GetPath(), toTrashBin);
+    if(toTrashBin)
+    {
+        m_deletedToTrashBin = true;
+    }
 
-    RefreshItem(item);
+    CDeleteQueue::Enqueue(paths, toTrashBin);
     return true;
 }
 
+// Called by the main frame, when the CDeleteThread has processed a path.
+// The thread runs asynchronously, so we look up the item by its path again.
+//
+void CDirstatDoc::OnPathDeleted(const DELETEPROGRESS *dp)
+{
+    CString status;
+    status.FormatMessage(IDS_DELETINGdOFdd, dp->done, dp->total, dp->pending);
+    GetMainFrame()->SetMessageText(status);
+
+    if(m_rootItem == NULL)
+    {
+        return;
+    }
+
+    CString path = dp->path;
+    path.MakeLower();
+
+    CItem *item = m_rootItem->FindDirectoryByPath(path);
+    if(item != NULL && item->GetParent() != NULL && (item->GetType() == IT_FILE || item->GetType() == IT_DIRECTORY))
+    {
+        if(dp->deleted)
+        {
+            RemoveDeletedItem(item, dp->toTrashBin);
+        }
+        else
+        {
+            // Aborted or failed: the subtree may have been deleted partially.
+            RefreshItem(item);
+        }
+    }
+
+    if(dp->done == dp->total)
+    {
+        // One batch completed: update the views only once.
+        m_extensionDataValid = false;
+        UpdateAllViews(NULL);
+    }
+}
+
+// Called by the main frame, when the CDeleteThread has terminated.
+//
+void CDirstatDoc::OnDeleteQueueFinished()
+{
+    if(CDeleteQueue::IsBusy())
+    {
+        // A new thread has been started in the meantime.
+        return;
+    }
+
+    if(m_rootItem != NULL && m_deletedToTrashBin)
+    {
+        RefreshRecyclers();
+    }
+    m_deletedToTrashBin = false;
+
+    GetMainFrame()->SetMessageText(AFX_IDS_IDLEMESSAGE);
+    UpdateAllViews(NULL);
+}
+
+// Called by the main frame, when the CVolumeInfoCache has new information.
+// The drive items take it from the cache without waiting.
+// The treemap is only rebuilt, if it shows a <Free Space> or <Unknown>
+// item, which has changed size, because WMU_VOLUMEINFO arrives after
+// every refresh of the cache, mostly with the same values.
+//
+void CDirstatDoc::OnVolumeInfo()
+{
+    CArray<CItem *, CItem *> drives;
+    GetDriveItems(drives);
+
+    bool changed = false;
+    bool zoomedSpaceChanged = false;
+    for(int i = 0; i < drives.GetSize(); i++)
+    {
+        bool spaceChanged = false;
+        if(drives[i]->UpdateVolumeInfo(spaceChanged))
+        {
+            changed = true;
+        }
+        if(spaceChanged && GetZoomItem() != NULL && GetZoomItem()->IsAncestorOf(drives[i]))
+        {
+            zoomedSpaceChanged = true;
+        }
+    }
+
+    if(m_workingItem != NULL)
+    {
+        GetMainFrame()->SetProgressRange(m_workingItem->GetProgressRange());
+    }
+
+    if(zoomedSpaceChanged)
+    {
+        UpdateAllViews(NULL, HINT_ZOOMEDSPACECHANGED);
+    }
+    else if(changed)
+    {
+        UpdateAllViews(NULL, HINT_VOLUMEINFOCHANGED);
+    }
+}
+
+// Removes a physically deleted item from the tree without re-reading its parent.
+// Updates selection, zoom and working item accordingly.
+//
+void CDirstatDoc::RemoveDeletedItem(CItem *item, bool toTrashBin)
+{
+    ASSERT(item != NULL);
+
+    CItem *parent = item->GetParent();
+    ASSERT(parent != NULL);
+
+    ClearReselectChildStack();
+
+    if(item->IsAncestorOf(GetZoomItem()))
+    {
+        SetZoomItem(parent);
+    }
+
+    bool selectionChanged = false;
+    for(int i = (int)m_selectedItems.GetSize() - 1; i >= 0; i--)
+    {
+        if(item->IsAncestorOf(m_selectedItems[i]))
+        {
+            m_selectedItems.RemoveAt(i);
+            selectionChanged = true;
+        }
+    }
+    if(selectionChanged && m_selectedItems.GetSize() == 0)
+    {
+        AddSelection(parent);
+    }
+
+    if(item->IsAncestorOf(m_workingItem))
+    {
+        SetWorkingItem(parent);
+    }
+
+    parent->RemoveDeletedChild(parent->FindChildIndex(item)); // --> delete item
+
+    // Deleting (not recycling) has increased the free space of the drive
+    for(CItem *p = parent; p != NULL; p = p->GetParent())
+    {
+        if(p->GetType() == IT_DRIVE && p->IsDone() && !toTrashBin)
+        {
+            CVolumeInfoCache::Invalidate(p->GetPath());
+            p->UpdateFreeSpaceItem();
+            break;
+        }
+    }
+
+    if(selectionChanged)
+    {
+        UpdateAllViews(NULL, HINT_SELECTIONCHANGED);
+    }
+}
+
 void CDirstatDoc::SetZoomItem(CItem *item)
 {
+    // The treemap shall show the children.
+    item->PageIn();
+
     m_zoomItem = item;
     UpdateAllViews(NULL, HINT_ZOOMCHANGED);
 }
@@ -898,7 +1595,12 @@ void CDirstatDoc::RefreshItem(CItem *item)
 
     CItem *parent = item->GetParent();
 
-    if(!item->StartRefresh())
+    // The re-created items are added to the directory list at once.
+    CTreeListControl::GetTheTreeListControl()->BeginUpdate();
+    bool exists = item->StartRefresh();
+    CTreeListControl::GetTheTreeListControl()->EndUpdate();
+
+    if(!exists)
     {
         if(GetZoomItem() == item)
         {
@@ -967,7 +1669,7 @@ void CDirstatDoc::PerformUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, CItem
     {
         ASSERT(IT_DRIVE == item->GetType() || IT_DIRECTORY == item->GetType());
 
-        RecursiveUserDefinedCleanup(udc, path, path);
+        RecursiveUserDefinedCleanup(udc, item);
     }
     else
     {
@@ -1003,9 +1705,80 @@ void CDirstatDoc::RefreshAfterUserDefinedCleanup(const USERDEFINEDCLEANUP *udc,
     }
 }
 
-void CDirstatDoc::RecursiveUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CString& currentPath)
+// Runs the cleanup for item and all its subdirectories (depth first).
+// The directory tree is taken from our item tree, the commands are
+// executed concurrently by the CCleanupProgressDlg.
+//
+void CDirstatDoc::RecursiveUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, const CItem *item)
+{
+    CCleanupProgressDlg dlg(GetCOMSPEC(), udc->showConsoleWindow, GetOptions()->GetCleanupProcesses(), AfxGetMainWnd());
+
+    AddUserDefinedCleanupCommands(dlg, udc, item->GetPath(), item);
+
+    dlg.DoModal();
+
+    if(dlg.GetFailedCount() > 0)
+    {
+        CString msg;
+        msg.FormatMessage(IDS_UDC_dOFdFAILEDs, dlg.GetFailedCount(), dlg.GetCommandCount(), (LPCTSTR)dlg.GetFailureReport(10));
+        AfxMessageBox(msg, MB_ICONWARNING);
+    }
+}
+
+// Adds the commands for item and its subdirectories to dlg,
+// subdirectories first.
+// Return: index of the command for item.
+//
+int CDirstatDoc::AddUserDefinedCleanupCommands(CCleanupProgressDlg& dlg, const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CItem *item)
+{
+    ASSERT(IT_DRIVE == item->GetType() || IT_DIRECTORY == item->GetType());
+
+    CString currentPath = item->GetPath();
+
+    if(!item->IsReadJobDone())
+    {
+        // Not yet read: we have to ask the file system.
+        return AddUserDefinedCleanupCommands(dlg, udc, rootPath, currentPath);
+    }
+
+    CArray<int, int> children;
+    for(int i = 0; i < item->GetChildrenCount(); i++)
+    {
+        const CItem *child = item->GetChild(i);
+        if(IT_DIRECTORY != child->GetType())
+        {
+            continue;
+        }
+
+        CString childPath = child->GetPath();
+        if(GetWDSApp()->IsVolumeMountPoint(childPath) && !GetOptions()->IsFollowMountPoints())
+        {
+            continue;
+        }
+        if(GetWDSApp()->IsFolderJunction(childPath) && !GetOptions()->IsFollowJunctionPoints())
+        {
+            continue;
+        }
+
+        children.Add(AddUserDefinedCleanupCommands(dlg, udc, rootPath, child));
+    }
+
+    CString app, cmdline, directory;
+    PrepareUserDefinedCleanupProcess(true, udc->commandLine, rootPath, currentPath, app, cmdline, directory);
+
+    int command = dlg.AddCommand(directory, cmdline);
+    for(int k = 0; k < children.GetSize(); k++)
+    {
+        dlg.SetCommandParent(children[k], command);
+    }
+    return command;
+}
+
+// Same as above for directories which are not in our item tree (yet).
+//
+int CDirstatDoc::AddUserDefinedCleanupCommands(CCleanupProgressDlg& dlg, const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CString& currentPath)
 {
-    // (Depth first.)
+    CArray<int, int> children;
 
     CFileFind finder;
     BOOL b = finder.FindFile(currentPath + _T("\\*.*"));
@@ -1025,20 +1798,35 @@ void CDirstatDoc::RecursiveUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, con
             continue;
         }
 
-        RecursiveUserDefinedCleanup(udc, rootPath, finder.GetFilePath());
+        children.Add(AddUserDefinedCleanupCommands(dlg, udc, rootPath, finder.GetFilePath()));
     }
 
-    CallUserDefinedCleanup(true, udc->commandLine, rootPath, currentPath, udc->showConsoleWindow, true);
+    CString app, cmdline, directory;
+    PrepareUserDefinedCleanupProcess(true, udc->commandLine, rootPath, currentPath, app, cmdline, directory);
+
+    int command = dlg.AddCommand(directory, cmdline);
+    for(int k = 0; k < children.GetSize(); k++)
+    {
+        dlg.SetCommandParent(children[k], command);
+    }
+    return command;
 }
 
-void CDirstatDoc::CallUserDefinedCleanup(bool isDirectory, const CString& format, const CString& rootPath, const CString& currentPath, bool showConsoleWindow, bool wait)
+// Computes the parameters for CreateProcess().
+//
+void CDirstatDoc::PrepareUserDefinedCleanupProcess(bool isDirectory, const CString& format, const CString& rootPath, const CString& currentPath, CString& app, CString& cmdline, CString& directory)
 {
     CString userCommandLine = BuildUserDefinedCleanupCommandLine(format, rootPath, currentPath);
 
-    CString app = GetCOMSPEC();
-    CString cmdline;
+    app = GetCOMSPEC();
     cmdline.Format(_T("%s /C %s"), GetBaseNameFromPath(app), userCommandLine);
-    CString directory = isDirectory ? currentPath : GetFolderNameFromPath(currentPath);
+    directory = isDirectory ? currentPath : GetFolderNameFromPath(currentPath);
+}
+
+void CDirstatDoc::CallUserDefinedCleanup(bool isDirectory, const CString& format, const CString& rootPath, const CString& currentPath, bool showConsoleWindow, bool wait)
+{
+    CString app, cmdline, directory;
+    PrepareUserDefinedCleanupProcess(isDirectory, format, rootPath, currentPath, app, cmdline, directory);
 
     STARTUPINFO si;
     ZeroMemory(&si, sizeof(si));
@@ -1141,6 +1929,8 @@ BEGIN_MESSAGE_MAP(CDirstatDoc, CDocument)
     ON_COMMAND(ID_VIEW_SHOWFREESPACE, OnViewShowfreespace)
     ON_UPDATE_COMMAND_UI(ID_VIEW_SHOWUNKNOWN, OnUpdateViewShowunknown)
     ON_COMMAND(ID_VIEW_SHOWUNKNOWN, OnViewShowunknown)
+    ON_UPDATE_COMMAND_UI(ID_VIEW_SCANPREVIEW, OnUpdateViewScanpreview)
+    ON_COMMAND(ID_VIEW_SCANPREVIEW, OnViewScanpreview)
     ON_UPDATE_COMMAND_UI(ID_TREEMAP_SELECTPARENT, OnUpdateTreemapSelectparent)
     ON_COMMAND(ID_TREEMAP_SELECTPARENT, OnTreemapSelectparent)
     ON_UPDATE_COMMAND_UI(ID_TREEMAP_ZOOMIN, OnUpdateTreemapZoomin)
@@ -1158,12 +1948,29 @@ BEGIN_MESSAGE_MAP(CDirstatDoc, CDocument)
     ON_UPDATE_COMMAND_UI_RANGE(ID_USERDEFINEDCLEANUP0, ID_USERDEFINEDCLEANUP9, OnUpdateUserdefinedcleanup)
     ON_COMMAND_RANGE(ID_USERDEFINEDCLEANUP0, ID_USERDEFINEDCLEANUP9, OnUserdefinedcleanup)
     ON_UPDATE_COMMAND_UI(ID_REFRESHALL, OnUpdateRefreshall)
+    ON_UPDATE_COMMAND_UI(ID_FILE_ADDTOSESSION, OnUpdateFileAddtosession)
+    ON_COMMAND(ID_FILE_ADDTOSESSION, OnFileAddtosession)
+    ON_UPDATE_COMMAND_UI(ID_FILE_REMOVEFROMSESSION, OnUpdateFileRemovefromsession)
+    ON_COMMAND(ID_FILE_REMOVEFROMSESSION, OnFileRemovefromsession)
     ON_UPDATE_COMMAND_UI(ID_TREEMAP_RESELECTCHILD, OnUpdateTreemapReselectchild)
     ON_COMMAND(ID_TREEMAP_RESELECTCHILD, OnTreemapReselectchild)
     ON_UPDATE_COMMAND_UI(ID_CLEANUP_OPEN, OnUpdateCleanupOpen)
     ON_COMMAND(ID_CLEANUP_OPEN, OnCleanupOpen)
     ON_UPDATE_COMMAND_UI(ID_CLEANUP_PROPERTIES, OnUpdateCleanupProperties)
     ON_COMMAND(ID_CLEANUP_PROPERTIES, OnCleanupProperties)
+    ON_UPDATE_COMMAND_UI(ID_FILE_EXPORTSCAN, OnUpdateFileExportscan)
+    ON_COMMAND(ID_FILE_EXPORTSCAN, OnFileExportscan)
+    ON_COMMAND(ID_FILE_IMPORTSCAN, OnFileImportscan)
+    ON_UPDATE_COMMAND_UI(ID_FILE_COMPARESCAN, OnUpdateFileComparescan)
+    ON_COMMAND(ID_FILE_COMPARESCAN, OnFileComparescan)
+    ON_UPDATE_COMMAND_UI(ID_FILE_SAVEREPORT, OnUpdateFileSavereport)
+    ON_COMMAND(ID_FILE_SAVEREPORT, OnFileSavereport)
+    ON_UPDATE_COMMAND_UI(ID_EDIT_QUERY, OnUpdateEditQuery)
+    ON_COMMAND(ID_EDIT_QUERY, OnEditQuery)
+    ON_UPDATE_COMMAND_UI(ID_EDIT_TOPFILES, OnUpdateEditTopfiles)
+    ON_COMMAND(ID_EDIT_TOPFILES, OnEditTopfiles)
+    ON_UPDATE_COMMAND_UI(ID_EDIT_DUPLICATES, OnUpdateEditDuplicates)
+    ON_COMMAND(ID_EDIT_DUPLICATES, OnEditDuplicates)
 END_MESSAGE_MAP()
 
 
@@ -1177,6 +1984,8 @@ void CDirstatDoc::OnUpdateRefreshselected(CCmdUI *pCmdUI)
         && GetSelection(0)->GetType() != IT_FREESPACE
         // FIXME: Multi-select
         && GetSelection(0)->GetType() != IT_UNKNOWN
+        // FIXME: Multi-select
+        && GetSelection(0)->GetType() != IT_EXCLUDED
     );
 }
 
@@ -1196,6 +2005,51 @@ void CDirstatDoc::OnRefreshall()
     RefreshItem(GetRootItem());
 }
 
+void CDirstatDoc::OnUpdateFileAddtosession(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(GetRootItem() != NULL);
+}
+
+void CDirstatDoc::OnFileAddtosession()
+{
+    CSelectDrivesDlg dlg;
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CStringArray paths;
+    if(RADIO_AFOLDER == dlg.m_radio)
+    {
+        paths.Add(dlg.m_folderName);
+    }
+    else
+    {
+        paths.Copy(dlg.m_drives);
+    }
+
+    AddSessionRoots(paths);
+}
+
+void CDirstatDoc::OnUpdateFileRemovefromsession(CCmdUI *pCmdUI)
+{
+    // FIXME: Multi-select
+    const CItem *item = GetSelection(0);
+    pCmdUI->Enable(
+        item != NULL
+        && GetRootItem() != NULL
+        && IT_MYCOMPUTER == GetRootItem()->GetType()
+        && item->GetParent() == GetRootItem()
+        && GetRootItem()->GetChildrenCount() > 1
+    );
+}
+
+void CDirstatDoc::OnFileRemovefromsession()
+{
+    // FIXME: Multi-select
+    RemoveSessionRoot(GetSelection(0));
+}
+
 void CDirstatDoc::OnUpdateEditCopy(CCmdUI *pCmdUI)
 {
     // FIXME: Multi-select
@@ -1206,7 +2060,8 @@ void CDirstatDoc::OnUpdateEditCopy(CCmdUI *pCmdUI)
         item->GetType() != IT_MYCOMPUTER &&
         item->GetType() != IT_FILESFOLDER &&
         item->GetType() != IT_FREESPACE &&
-        item->GetType() != IT_UNKNOWN
+        item->GetType() != IT_UNKNOWN &&
+        item->GetType() != IT_EXCLUDED
     );
 }
 
@@ -1324,6 +2179,9 @@ void CDirstatDoc::OnViewShowunknown()
         m_showUnknown = true;
     }
 
+    // The pending space is shown as <Unknown>.
+    m_pendingSizes.RemoveAll();
+
     if(drives.GetSize() > 0)
     {
         SetWorkingItem(GetRootItem());
@@ -1332,25 +2190,57 @@ void CDirstatDoc::OnViewShowunknown()
     UpdateAllViews(NULL);
 }
 
-void CDirstatDoc::OnUpdateTreemapZoomin(CCmdUI *pCmdUI)
+void CDirstatDoc::OnUpdateViewScanpreview(CCmdUI *pCmdUI)
 {
-    pCmdUI->Enable(
-        m_rootItem != NULL && m_rootItem->IsDone()
-        // FIXME: Multi-select (2x)
-        && GetSelection(0) != NULL && GetSelection(0) != GetZoomItem()
-    );
+    pCmdUI->SetCheck(m_scanPreview);
 }
 
-void CDirstatDoc::OnTreemapZoomin()
+void CDirstatDoc::OnViewScanpreview()
+{
+    m_scanPreview = !m_scanPreview;
+
+    if(m_rootItem != NULL && !m_rootItem->IsDone())
+    {
+        ResetScanPreview();
+        m_extensionDataValid = false;
+
+        if(m_scanPreview)
+        {
+            GetMainFrame()->RestoreTypeView();
+            GetMainFrame()->RestoreGraphView();
+        }
+
+        UpdateAllViews(NULL);
+    }
+}
+
+// The child of the zoom item on the way to the selection,
+// or NULL, if the selection is not below the zoom item.
+//
+CItem *CDirstatDoc::GetZoomInItem()
 {
     // FIXME: Multi-select
     CItem *p = GetSelection(0);
     CItem *z = NULL;
-    while(p != GetZoomItem())
+    while(p != NULL && p != GetZoomItem())
     {
         z = p;
         p = p->GetParent();
     }
+    return p != NULL ? z : NULL;
+}
+
+// A root of a session is zoomable, as soon as it is done.
+//
+void CDirstatDoc::OnUpdateTreemapZoomin(CCmdUI *pCmdUI)
+{
+    CItem *z = GetZoomInItem();
+    pCmdUI->Enable(z != NULL && z->IsDone());
+}
+
+void CDirstatDoc::OnTreemapZoomin()
+{
+    CItem *z = GetZoomInItem();
     ASSERT(z != NULL);
     SetZoomItem(z);
 }
@@ -1358,7 +2248,7 @@ void CDirstatDoc::OnTreemapZoomin()
 void CDirstatDoc::OnUpdateTreemapZoomout(CCmdUI *pCmdUI)
 {
     pCmdUI->Enable(
-        m_rootItem != NULL && m_rootItem->IsDone()
+        m_rootItem != NULL
         && GetZoomItem() != m_rootItem
     );
 }
@@ -1379,6 +2269,8 @@ void CDirstatDoc::OnUpdateExplorerHere(CCmdUI *pCmdUI)
         && GetSelection(0)->GetType() != IT_FREESPACE
         // FIXME: Multi-select
         && GetSelection(0)->GetType() != IT_UNKNOWN
+        // FIXME: Multi-select
+        && GetSelection(0)->GetType() != IT_EXCLUDED
     );
 }
 
@@ -1433,6 +2325,8 @@ void CDirstatDoc::OnUpdateCommandPromptHere(CCmdUI *pCmdUI)
         // FIXME: Multi-select
         && GetSelection(0)->GetType() != IT_UNKNOWN
         // FIXME: Multi-select
+        && GetSelection(0)->GetType() != IT_EXCLUDED
+        // FIXME: Multi-select
         && ! GetSelection(0)->HasUncPath()
     );
 }
@@ -1458,62 +2352,36 @@ void CDirstatDoc::OnCommandPromptHere()
 
 void CDirstatDoc::OnUpdateCleanupDeletetotrashbin(CCmdUI *pCmdUI)
 {
-    // FIXME: Multi-select
-    CItem *item = GetSelection(0);
-
-    pCmdUI->Enable(
-        DirectoryListHasFocus()
-        && item != NULL
-        && (IT_DIRECTORY == item->GetType() || IT_FILE == item->GetType())
-        && !item->IsRootItem()
-    );
+    CArray<CItem *, CItem *> items;
+    pCmdUI->Enable(DirectoryListHasFocus() && GetDeletableSelection(items));
 }
 
 void CDirstatDoc::OnCleanupDeletetotrashbin()
 {
-    // FIXME: Multi-select
-    CItem *item = GetSelection(0);
-
-    if(NULL == item || item->GetType() != IT_DIRECTORY && item->GetType() != IT_FILE || item->IsRootItem())
+    CArray<CItem *, CItem *> items;
+    if(!GetDeletableSelection(items))
     {
         return;
     }
 
-    if(DeletePhysicalItem(item, true))
-    {
-        RefreshRecyclers();
-        UpdateAllViews(NULL);
-    }
+    DeletePhysicalItems(items, true);
 }
 
 void CDirstatDoc::OnUpdateCleanupDelete(CCmdUI *pCmdUI)
 {
-    // FIXME: Multi-select
-    CItem *item = GetSelection(0);
-
-    pCmdUI->Enable(
-        DirectoryListHasFocus()
-        && item != NULL
-        && (IT_DIRECTORY == item->GetType() || IT_FILE == item->GetType())
-        && !item->IsRootItem()
-    );
+    CArray<CItem *, CItem *> items;
+    pCmdUI->Enable(DirectoryListHasFocus() && GetDeletableSelection(items));
 }
 
 void CDirstatDoc::OnCleanupDelete()
 {
-    // FIXME: Multi-select
-    CItem *item = GetSelection(0);
-
-    if(NULL == item || item->GetType() != IT_DIRECTORY && item->GetType() != IT_FILE || item->IsRootItem())
+    CArray<CItem *, CItem *> items;
+    if(!GetDeletableSelection(items))
     {
         return;
     }
 
-    if(DeletePhysicalItem(item, false))
-    {
-        SetWorkingItem(GetRootItem());
-        UpdateAllViews(NULL);
-    }
+    DeletePhysicalItems(items, false);
 }
 
 void CDirstatDoc::OnUpdateUserdefinedcleanup(CCmdUI *pCmdUI)
@@ -1680,6 +2548,244 @@ void CDirstatDoc::OnCleanupProperties()
 //     }
 }
 
+void CDirstatDoc::OnUpdateFileExportscan(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone());
+}
+
+void CDirstatDoc::OnFileExportscan()
+{
+    CFileDialog dlg(false, _T("sqlite"), _T("windirstat-scan.sqlite"), OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST, LoadString(IDS_SCANDATABASEFILTER), AfxGetMainWnd());
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CWaitCursor wc;
+    try
+    {
+        CScanDatabase db;
+        db.Export(GetRootItem(), m_fileHashes, dlg.GetPathName());
+    }
+    catch(CException *pe)
+    {
+        pe->ReportError();
+        pe->Delete();
+    }
+}
+
+// Replaces the current tree by a scan exported with OnFileExportscan().
+//
+void CDirstatDoc::OnFileImportscan()
+{
+    CFileDialog dlg(true, _T("sqlite"), NULL, OFN_HIDEREADONLY | OFN_FILEMUSTEXIST, LoadString(IDS_SCANDATABASEFILTER), AfxGetMainWnd());
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CItem *root = NULL;
+    {
+        CWaitCursor wc;
+        try
+        {
+            CScanDatabase db;
+            root = db.Import(dlg.GetPathName(), m_fileHashes);
+        }
+        catch(CException *pe)
+        {
+            pe->ReportError();
+            pe->Delete();
+            return;
+        }
+    }
+
+    // Like OnOpenDocument(), but the tree is complete.
+    CDocument::OnNewDocument(); // --> DeleteContents()
+
+    m_rootItem = root;
+    m_zoomItem = m_rootItem;
+    m_showMyComputer = (m_rootItem->GetType() == IT_MYCOMPUTER);
+    m_extensionDataValid = false;
+
+    SetPathName(dlg.GetPathName(), false);
+
+    UpdateAllViews(NULL, HINT_NEWROOT);
+
+    GetMainFrame()->SetProgressPos100();
+    GetMainFrame()->RestoreTypeView();
+    GetMainFrame()->RestoreGraphView();
+}
+
+// The CScanDiff and CGrowthDlg hold pointers to the items of the tree.
+// While the dialog is modal, the CDeleteThread still removes the deleted
+// items (WMU_DELETEPROGRESS is sent, not posted), so we wait for it.
+//
+void CDirstatDoc::OnUpdateFileComparescan(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone() && !CDeleteQueue::IsBusy());
+}
+
+// Compares the current tree with a scan exported with OnFileExportscan().
+//
+void CDirstatDoc::OnFileComparescan()
+{
+    CFileDialog dlg(true, _T("sqlite"), NULL, OFN_HIDEREADONLY | OFN_FILEMUSTEXIST, LoadString(IDS_SCANDATABASEFILTER), AfxGetMainWnd());
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CItem *olderRoot = NULL;
+    {
+        CWaitCursor wc;
+        try
+        {
+            // The hashes of the older scan don't belong to this document.
+            CFileHashMap olderHashes;
+            CScanDatabase db;
+            olderRoot = db.Import(dlg.GetPathName(), olderHashes);
+        }
+        catch(CException *pe)
+        {
+            pe->ReportError();
+            pe->Delete();
+            return;
+        }
+    }
+
+    CScanDiff diff(GetRootItem(), olderRoot);
+    CGrowthDlg growth(&diff, AfxGetMainWnd());
+    growth.DoModal();
+}
+
+void CDirstatDoc::OnUpdateFileSavereport(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone());
+}
+
+// Writes the selected subtrees (or the whole tree, if nothing is selected)
+// into a CSV, JSON or XML file.
+//
+void CDirstatDoc::OnFileSavereport()
+{
+    CSaveReportDlg settings(AfxGetMainWnd());
+    if(IDOK != settings.DoModal())
+    {
+        return;
+    }
+
+    const LPCTSTR extensions[] = { _T("csv"), _T("json"), _T("xml") };
+    CString fileName = CString(_T("windirstat-report.")) + extensions[settings.m_format];
+
+    CFileDialog dlg(false, extensions[settings.m_format], fileName, OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST, LoadString(IDS_REPORTFILEFILTER), AfxGetMainWnd());
+    dlg.m_ofn.nFilterIndex = settings.m_format + 1;
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CArray<const CItem *, const CItem *> roots;
+    for(size_t i = 0; i < GetSelectionCount(); i++)
+    {
+        roots.Add(GetSelection(i));
+    }
+    if(roots.GetSize() == 0)
+    {
+        roots.Add(GetRootItem());
+    }
+
+    CWaitCursor wc;
+    try
+    {
+        CReportWriter writer((REPORTFORMAT)settings.m_format, settings.m_maxDepth, (ULONGLONG)settings.m_minSizeKB * 1024);
+        writer.Write(dlg.GetPathName(), roots);
+    }
+    catch(CException *pe)
+    {
+        pe->ReportError();
+        pe->Delete();
+    }
+}
+
+void CDirstatDoc::OnUpdateEditQuery(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone());
+}
+
+// Selects the items matching a query (see CItemQuery), so that
+// they can be saved with "Save Report" or deleted.
+//
+void CDirstatDoc::OnEditQuery()
+{
+    CQueryDlg dlg(AfxGetMainWnd());
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CItemQuery query;
+    CString error;
+    VERIFY(query.Compile(dlg.m_query, error));
+
+    CArray<CItem *, CItem *> results;
+    {
+        CWaitCursor wc;
+        if(!query.Evaluate(GetRootItem(), results))
+        {
+            CString msg;
+            msg.FormatMessage(IDS_QUERYSCOPENOTFOUNDs, (LPCTSTR)dlg.m_query);
+            AfxMessageBox(msg);
+            return;
+        }
+    }
+
+    SelectItems(results);
+    UpdateAllViews(NULL, HINT_SELECTIONCHANGED);
+
+    CString status;
+    status.FormatMessage(IDS_QUERYRESULTd, (int)results.GetSize());
+    GetMainFrame()->SetMessageText(status);
+}
+
+// Like OnUpdateFileComparescan(): CTopFilesDlg holds pointers to the files.
+//
+void CDirstatDoc::OnUpdateEditTopfiles(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone() && !CDeleteQueue::IsBusy());
+}
+
+void CDirstatDoc::OnEditTopfiles()
+{
+    CTopFilesDlg dlg(GetRootItem(), AfxGetMainWnd());
+    dlg.DoModal();
+}
+
+void CDirstatDoc::OnUpdateEditDuplicates(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(IsRootDone());
+}
+
+void CDirstatDoc::OnEditDuplicates()
+{
+    // Without the cache we only have to read more.
+    if(!m_hashCache.IsOpen())
+    {
+        try
+        {
+            m_hashCache.Open(CHashCache::GetDefaultPath());
+        }
+        catch(CException *pe)
+        {
+            VTRACE(_T("Hash cache: %s"), (LPCTSTR)MdGetExceptionMessage(pe));
+            pe->Delete();
+        }
+    }
+
+    CDuplicatesDlg dlg(GetRootItem(), m_fileHashes, m_hashCache.IsOpen() ? &m_hashCache : NULL, AfxGetMainWnd());
+    dlg.DoModal();
+}
+
 // CDirstatDoc Diagnostics
 #ifdef _DEBUG
 void CDirstatDoc::AssertValid() const
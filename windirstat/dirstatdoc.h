@@ -27,9 +27,14 @@
 #pragma once
 
 #include "selectdrivesdlg.h"
+#include "ScanPlugins.h"
+#include "DuplicateFinder.h"
+#include "HashCache.h"
 #include <common/wds_constants.h>
 
 class CItem;
+class CCleanupProgressDlg;
+struct DELETEPROGRESS;
 
 //
 // The treemap colors as calculated in CDirstatDoc::SetExtensionColors()
@@ -69,6 +74,9 @@ enum
     HINT_ZOOMCHANGED,               // Only zoom item has changed.
     HINT_REDRAWWINDOW,              // Only graphically redraw views.
     HINT_SOMEWORKDONE,              // Directory list shall process mouse messages first, then re-sort.
+    HINT_SCANPREVIEW,               // Treemap and type list shall show the tree as far as it has been scanned.
+    HINT_VOLUMEINFOCHANGED,         // Labels or free space of drives have arrived from the CVolumeInfoCache.
+    HINT_ZOOMEDSPACECHANGED,        // Like HINT_VOLUMEINFOCHANGED, and a <Free Space> or <Unknown> item within the zoom item has changed size.
 
     HINT_LISTSTYLECHANGED,          // Options: List style (grid/stripes) or treelist colors changed
     HINT_TREEMAPSTYLECHANGED        // Options: Treemap style (grid, colors etc.) changed
@@ -104,12 +112,14 @@ public:
 
     bool OptionShowFreeSpace();
     bool OptionShowUnknown();
+    bool OptionScanPreview();
 
     const CExtensionData *GetExtensionData();
     ULONGLONG GetRootSize();
 
     void ForgetItemTree();
-    bool Work(DWORD ticks); // return: true if done.
+    static DWORD GetWorkSlice(bool animate);
+    bool Work(DWORD ticks); // return: true if done (or waiting for the CEnumerationQueue).
     bool IsDrive(CString spec);
     void RefreshMountPointItems();
     void RefreshJunctionItems();
@@ -118,6 +128,13 @@ public:
     CItem *GetRootItem();
     CItem *GetZoomItem();
     bool IsZoomed();
+    bool IsTreemapAvailable();
+    ULONGLONG GetPendingSize(const CItem *drive);
+
+    void GetSessionRoots(CArray<CItem *, CItem *>& roots);
+    bool IsAnyRootDone();
+    void AddSessionRoots(const CStringArray& paths);
+    void RemoveSessionRoot(CItem *root);
 
     void RemoveAllSelections();
     bool CanAddSelection(const CItem *item);
@@ -129,6 +146,7 @@ public:
     // FIXME: Multi-select
     CItem *GetSelection(size_t i);
     void SetSelection(const CItem *item, bool keepReselectChildStack = false);
+    void SelectItems(const CArray<CItem *, CItem *>& items);
 
     void SetHighlightExtension(LPCTSTR ext);
     CString GetHighlightExtension();
@@ -136,13 +154,25 @@ public:
     void UnlinkRoot();
     bool UserDefinedCleanupWorksForItem(const USERDEFINEDCLEANUP *udc, const CItem *item);
     ULONGLONG GetWorkingItemReadJobs();
+    CScanPlugins *GetScanPlugins();
 
     void OpenItem(const CItem *item);
 
+    void OnPathDeleted(const DELETEPROGRESS *dp);
+    void OnDeleteQueueFinished();
+    void OnVolumeInfo();
+
 protected:
     void RecurseRefreshMountPointItems(CItem *item);
     void RecurseRefreshJunctionItems(CItem *item);
     void GetDriveItems(CArray<CItem *, CItem *>& drives);
+    int CountDoneSessionRoots();
+    CItem *FindSessionRoot(const CString& path);
+    void UpdateSessionTitle();
+    void UpdateScanPreview();
+    void SnapshotPendingSizes();
+    void ResetScanPreview();
+    CItem *GetZoomInItem();
     void RefreshRecyclers();
     void RebuildExtensionData();
     void SortExtensionData(CStringArray& sortedExtensions);
@@ -151,13 +181,20 @@ protected:
     static int __cdecl _compareExtensions(const void *ext1, const void *ext2);
     void SetWorkingItemAncestor(CItem *item);
     void SetWorkingItem(CItem *item);
-    bool DeletePhysicalItem(CItem *item, bool toTrashBin);
+    void ReportScanPluginError();
+    void ReportPageInError();
+    bool GetDeletableSelection(CArray<CItem *, CItem *>& items);
+    bool DeletePhysicalItems(const CArray<CItem *, CItem *>& items, bool toTrashBin);
+    void RemoveDeletedItem(CItem *item, bool toTrashBin);
     void SetZoomItem(CItem *item);
     void RefreshItem(CItem *item);
     void AskForConfirmation(const USERDEFINEDCLEANUP *udc, CItem *item);
     void PerformUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, CItem *item);
     void RefreshAfterUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, CItem *item);
-    void RecursiveUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CString& currentPath);
+    void RecursiveUserDefinedCleanup(const USERDEFINEDCLEANUP *udc, const CItem *item);
+    int AddUserDefinedCleanupCommands(CCleanupProgressDlg& dlg, const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CItem *item);
+    int AddUserDefinedCleanupCommands(CCleanupProgressDlg& dlg, const USERDEFINEDCLEANUP *udc, const CString& rootPath, const CString& currentPath);
+    void PrepareUserDefinedCleanupProcess(bool isDirectory, const CString& format, const CString& rootPath, const CString& currentPath, CString& app, CString& cmdline, CString& directory);
     void CallUserDefinedCleanup(bool isDirectory, const CString& format, const CString& rootPath, const CString& currentPath, bool showConsoleWindow, bool wait);
     CString BuildUserDefinedCleanupCommandLine(LPCTSTR format, LPCTSTR rootPath, LPCTSTR currentPath);
     void PushReselectChild(CItem *item);
@@ -169,8 +206,10 @@ protected:
 
     bool m_showFreeSpace;       // Whether to show the <Free Space> item
     bool m_showUnknown;         // Whether to show the <Unknown> item
+    bool m_scanPreview;         // Whether treemap and type list show the tree during the scan
 
-    bool m_showMyComputer;      // True, if the user selected more than one drive for scanning.
+    bool m_showMyComputer;      // True, if the user selected more than one drive for scanning,
+                                // or has added roots to the session (AddSessionRoots()).
                                 // In this case, we need a root pseudo item ("My Computer").
 
     CItem *m_rootItem;          // The very root item
@@ -179,18 +218,34 @@ protected:
     CString m_highlightExtension;   // Currently highlighted extension
     CItem *m_zoomItem;              // Current "zoom root"
     CItem *m_workingItem;           // Current item we are working on. For progress indication
+    CScanPlugins m_scanPlugins;     // Filters and classifiers of the running scan
+
+    // Scan preview (UpdateScanPreview())
+    DWORD m_previewTime;            // GetTickCount() of the last preview
+    DWORD m_previewInterval;        // Minimum time between two previews (ms)
+    ULONGLONG m_previewSize;        // Size of the zoom item at the last preview
+    CMap<const CItem *, const CItem *, ULONGLONG, ULONGLONG> m_pendingSizes; // Snapshot of the pending space of the drives (CItem::GetPendingSize())
 
     bool m_extensionDataValid;      // If this is false, m_extensionData must be rebuilt
     CExtensionData m_extensionData; // Base for the extension view and cushion colors
 
     CList<CItem *, CItem *> m_reselectChildStack; // Stack for the "Re-select Child"-Feature
 
+    bool m_deletedToTrashBin;       // Items have been queued for the recycle bin, refresh recyclers when the queue is done
+
+    CFileHashMap m_fileHashes;      // Content hashes computed by CDuplicateFinder, also stored in scan databases
+    CHashCache m_hashCache;         // Content hashes persisted between sessions, opened on first use
+
 protected:
     DECLARE_MESSAGE_MAP()
     afx_msg void OnUpdateRefreshselected(CCmdUI *pCmdUI);
     afx_msg void OnRefreshselected();
     afx_msg void OnUpdateRefreshall(CCmdUI *pCmdUI);
     afx_msg void OnRefreshall();
+    afx_msg void OnUpdateFileAddtosession(CCmdUI *pCmdUI);
+    afx_msg void OnFileAddtosession();
+    afx_msg void OnUpdateFileRemovefromsession(CCmdUI *pCmdUI);
+    afx_msg void OnFileRemovefromsession();
     afx_msg void OnUpdateEditCopy(CCmdUI *pCmdUI);
     afx_msg void OnEditCopy();
     afx_msg void OnCleanupEmptyrecyclebin();
@@ -198,6 +253,8 @@ protected:
     afx_msg void OnViewShowfreespace();
     afx_msg void OnUpdateViewShowunknown(CCmdUI *pCmdUI);
     afx_msg void OnViewShowunknown();
+    afx_msg void OnUpdateViewScanpreview(CCmdUI *pCmdUI);
+    afx_msg void OnViewScanpreview();
     afx_msg void OnUpdateTreemapZoomin(CCmdUI *pCmdUI);
     afx_msg void OnTreemapZoomin();
     afx_msg void OnUpdateTreemapZoomout(CCmdUI *pCmdUI);
@@ -220,6 +277,19 @@ protected:
     afx_msg void OnCleanupOpen();
     afx_msg void OnUpdateCleanupProperties(CCmdUI *pCmdUI);
     afx_msg void OnCleanupProperties();
+    afx_msg void OnUpdateFileExportscan(CCmdUI *pCmdUI);
+    afx_msg void OnUpdateFileComparescan(CCmdUI *pCmdUI);
+    afx_msg void OnFileExportscan();
+    afx_msg void OnFileImportscan();
+    afx_msg void OnFileComparescan();
+    afx_msg void OnUpdateFileSavereport(CCmdUI *pCmdUI);
+    afx_msg void OnFileSavereport();
+    afx_msg void OnUpdateEditQuery(CCmdUI *pCmdUI);
+    afx_msg void OnEditQuery();
+    afx_msg void OnUpdateEditTopfiles(CCmdUI *pCmdUI);
+    afx_msg void OnEditTopfiles();
+    afx_msg void OnUpdateEditDuplicates(CCmdUI *pCmdUI);
+    afx_msg void OnEditDuplicates();
 
 public:
     #ifdef _DEBUG
@@ -168,41 +168,6 @@ CDirstatView::~CDirstatView()
 {
 }
 
-CString CDirstatView::GenerateReport()
-{
-    CString report = GetOptions()->GetReportPrefix() + _T("\r\n");
-
-    for(size_t j = 0; j < GetDocument()->GetSelectionCount(); j++)
-    {
-        CItem *root = GetDocument()->GetSelection(j);
-        ASSERT(root != NULL);
-        ASSERT(root->IsVisible());
-
-        int r = m_treeListControl.FindTreeItem(root);
-
-        for(
-            int i = r;
-            i < m_treeListControl.GetItemCount()
-            && (i == r || m_treeListControl.GetItem(i)->GetIndent() > root->GetIndent());
-        i++
-            )
-        {
-            CItem *item = (CItem *)m_treeListControl.GetItem(i);
-
-            if(item->GetType() == IT_MYCOMPUTER)
-            {
-                continue;
-            }
-
-            report.AppendFormat(_T("%s %s\r\n"), PadWidthBlanks(FormatLongLongHuman(item->GetSize()), 11), item->GetReportPath());
-        }
-    }
-    report += _T("\r\n\r\n");
-    report += GetOptions()->GetReportSuffix();
-
-    return report;
-}
-
 // Just a shortcut for CMainFrame to obtain
 // the small font for the suspend button.
 CFont *CDirstatView::GetSmallFont()
@@ -215,6 +180,24 @@ void CDirstatView::SysColorChanged()
     m_treeListControl.SysColorChanged();
 }
 
+// Called by the animation frame clock of CMainFrame.
+// Only the rows on screen have a pacman to drive.
+//
+void CDirstatView::DrivePacmen()
+{
+    int top = m_treeListControl.GetTopIndex();
+    int end = min(top + m_treeListControl.GetCountPerPage() + 1, m_treeListControl.GetItemCount());
+    for(int i = top; i < end; i++)
+    {
+        CItem *item = (CItem *)m_treeListControl.GetItem(i);
+        if(item->DrivePacman())
+        {
+            // The cell is painted with the next WM_PAINT.
+            m_treeListControl.InvalidateRect(m_treeListControl.GetWholeSubitemRect(i, COL_SUBTREEPERCENTAGE), false);
+        }
+    }
+}
+
 BOOL CDirstatView::PreCreateWindow(CREATESTRUCT& cs)
 {
     return CView::PreCreateWindow(cs);
@@ -411,8 +394,14 @@ void CDirstatView::OnUpdate(CView *pSender, LPARAM lHint, CObject *pHint)
                 ::TranslateMessage(&msg);
                 ::DispatchMessage(&msg);
             }
+
+            // Repaints only what has changed, at most once per frame.
+            m_treeListControl.UpdateDuringWork();
         }
-        // fall through
+        break;
+
+    case HINT_VOLUMEINFOCHANGED:
+    case HINT_ZOOMEDSPACECHANGED:
     case 0:
         {
             m_treeListControl.Sort();
@@ -65,9 +65,9 @@ protected:
 
 public:
     virtual ~CDirstatView();
-    CString GenerateReport();
     CFont *GetSmallFont();
     void SysColorChanged();
+    void DrivePacmen();
 
 protected:
     virtual BOOL PreCreateWindow(CREATESTRUCT& cs);
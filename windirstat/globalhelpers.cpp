@@ -34,33 +34,85 @@
 
 namespace
 {
-    CString FormatLongLongNormal(ULONGLONG n)
+    // The separators are fetched from the system only once
+    // (and again, when the effective language changes).
+    struct LOCALECACHE
     {
-        // Returns formatted number like "123.456.789".
+        bool valid;
+        LANGID langid;
+        TCHAR thousandSeparator[8];     // LOCALE_STHOUSAND has max. 4 characters
+        TCHAR decimalSeparator[8];      // LOCALE_SDECIMAL has max. 4 characters
+    };
 
-        ASSERT(n >= 0);
+    LOCALECACHE _localeCache = { false, 0 };
 
-        CString all;
+    // Incremented by InvalidateFormatCache()
+    UINT _formatGeneration = 0;
 
-        do
+    const LOCALECACHE& GetLocaleCache()
+    {
+        LANGID langid = GetWDSApp()->GetEffectiveLangid();
+        if(!_localeCache.valid || _localeCache.langid != langid)
         {
-            int rest = (int)(n % 1000);
-            n/= 1000;
-
-            CString s;
-            if(n > 0)
+            LCID lcid = MAKELCID(langid, SORT_DEFAULT);
+            if(0 == ::GetLocaleInfo(lcid, LOCALE_STHOUSAND, _localeCache.thousandSeparator, (int)countof(_localeCache.thousandSeparator)))
             {
-                s.Format(_T("%s%03d"), GetLocaleThousandSeparator(), rest);
+                _tcscpy_s(_localeCache.thousandSeparator, countof(_localeCache.thousandSeparator), _T(","));
             }
-            else
+            if(0 == ::GetLocaleInfo(lcid, LOCALE_SDECIMAL, _localeCache.decimalSeparator, (int)countof(_localeCache.decimalSeparator)))
             {
-                s.Format(_T("%d"), rest);
+                _tcscpy_s(_localeCache.decimalSeparator, countof(_localeCache.decimalSeparator), _T("."));
             }
+            _localeCache.langid = langid;
+            _localeCache.valid = true;
+        }
+        return _localeCache;
+    }
+
+    // Like _sntprintf_s(), but returns the length of the
+    // (possibly truncated) text.
+    int PrintText(LPTSTR buffer, int size, LPCTSTR format, ...)
+    {
+        ASSERT(size > 0);
+
+        va_list args;
+        va_start(args, format);
+        int len = _vsntprintf_s(buffer, size, _TRUNCATE, format, args);
+        va_end(args);
+
+        if(len < 0)
+        {
+            len = (int)_tcslen(buffer);
+        }
+        return len;
+    }
+
+    int FormatLongLongNormal(ULONGLONG n, LPTSTR buffer, int size)
+    {
+        // Formats a number like "123.456.789".
+        // We build the text backwards, so we need no temporary strings.
+
+        LPCTSTR separator = GetLocaleCache().thousandSeparator;
+        int separatorLength = (int)_tcslen(separator);
+
+        TCHAR text[64];   // 20 digits and 6 separators
+        LPTSTR p = text + countof(text);
+        *--p = 0;
 
-            all = s + all;
+        int digits = 0;
+        do
+        {
+            if(digits > 0 && digits % 3 == 0)
+            {
+                p -= separatorLength;
+                memcpy(p, separator, separatorLength * sizeof(TCHAR));
+            }
+            *--p = (TCHAR)(_T('0') + (int)(n % 10));
+            n/= 10;
+            digits++;
         } while(n > 0);
 
-        return all;
+        return PrintText(buffer, size, _T("%s"), p);
     }
 
     void CacheString(CString& s, UINT resId, LPCTSTR defaultVal)
@@ -112,34 +164,62 @@ CString GetLocaleLanguage(LANGID langid)
 
 CString GetLocaleThousandSeparator()
 {
-    return GetLocaleString(LOCALE_STHOUSAND, GetWDSApp()->GetEffectiveLangid());
+    return GetLocaleCache().thousandSeparator;
 }
 
 CString GetLocaleDecimalSeparator()
 {
-    return GetLocaleString(LOCALE_SDECIMAL, GetWDSApp()->GetEffectiveLangid());
+    return GetLocaleCache().decimalSeparator;
+}
+
+// The owner drawn lists cache their formatted texts. Must be called,
+// when an option changes, which affects the formatting.
+//
+void InvalidateFormatCache()
+{
+    _localeCache.valid = false;
+    _formatGeneration++;
+}
+
+UINT GetFormatGeneration()
+{
+    return _formatGeneration;
 }
 
 CString FormatBytes(ULONGLONG const& n)
+{
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatBytes(n, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatBytes(ULONGLONG n, LPTSTR buffer, int size)
 {
     if(GetOptions()->IsHumanFormat())
     {
-        return FormatLongLongHuman(n);
+        return FormatLongLongHuman(n, buffer, size);
     }
     else
     {
-        return FormatLongLongNormal(n);
+        return FormatLongLongNormal(n, buffer, size);
     }
 }
 
 CString FormatLongLongHuman(ULONGLONG n)
 {
-    // Returns formatted number like "12,4 GB".
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatLongLongHuman(n, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatLongLongHuman(ULONGLONG n, LPTSTR buffer, int size)
+{
+    // Formats a number like "12,4 GB".
     ASSERT(n >= 0);
     const int base = 1024;
     const int half = base / 2;
 
-    CString s;
+    TCHAR number[FORMATBUFFERSIZE];
 
     double B = (int)(n % base);
     n/= base;
@@ -155,41 +235,58 @@ CString FormatLongLongHuman(ULONGLONG n)
 
     double TB = (int)(n);
 
+    // The GetSpec_*() strings are cached, so copying them doesn't allocate.
     if(TB != 0 || GB == base - 1 && MB >= half)
     {
-        s.Format(_T("%s %s"), FormatDouble(TB + GB/base), GetSpec_TB());
+        FormatDouble(TB + GB/base, number, (int)countof(number));
+        return PrintText(buffer, size, _T("%s %s"), number, (LPCTSTR)GetSpec_TB());
     }
     else if(GB != 0 || MB == base - 1 && KB >= half)
     {
-        s.Format(_T("%s %s"), FormatDouble(GB + MB/base), GetSpec_GB());
+        FormatDouble(GB + MB/base, number, (int)countof(number));
+        return PrintText(buffer, size, _T("%s %s"), number, (LPCTSTR)GetSpec_GB());
     }
     else if(MB != 0 || KB == base - 1 && B >= half)
     {
-        s.Format(_T("%s %s"), FormatDouble(MB + KB/base), GetSpec_MB());
+        FormatDouble(MB + KB/base, number, (int)countof(number));
+        return PrintText(buffer, size, _T("%s %s"), number, (LPCTSTR)GetSpec_MB());
     }
     else if(KB != 0)
     {
-        s.Format(_T("%s %s"), FormatDouble(KB + B/base), GetSpec_KB());
+        FormatDouble(KB + B/base, number, (int)countof(number));
+        return PrintText(buffer, size, _T("%s %s"), number, (LPCTSTR)GetSpec_KB());
     }
     else if(B != 0)
     {
-        s.Format(_T("%d %s"), (int)B, GetSpec_Bytes());
+        return PrintText(buffer, size, _T("%d %s"), (int)B, (LPCTSTR)GetSpec_Bytes());
     }
     else
     {
-        s = _T("0");
+        return PrintText(buffer, size, _T("0"));
     }
-
-    return s;
 }
 
 
 CString FormatCount(ULONGLONG const& n)
 {
-    return FormatLongLongNormal(n);
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatCount(n, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatCount(ULONGLONG n, LPTSTR buffer, int size)
+{
+    return FormatLongLongNormal(n, buffer, size);
 }
 
 CString FormatDouble(double d) // "98,4" or "98.4"
+{
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatDouble(d, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatDouble(double d, LPTSTR buffer, int size)
 {
     ASSERT(d >= 0);
 
@@ -198,10 +295,7 @@ CString FormatDouble(double d) // "98,4" or "98.4"
     int i = (int)floor(d);
     int r = (int)(10 * fmod(d, 1));
 
-    CString s;
-    s.Format(_T("%d%s%d"), i, GetLocaleDecimalSeparator(), r);
-
-    return s;
+    return PrintText(buffer, size, _T("%d%s%d"), i, GetLocaleCache().decimalSeparator, r);
 }
 
 CString PadWidthBlanks(CString n, int width)
@@ -225,24 +319,48 @@ CString PadWidthBlanks(CString n, int width)
 }
 
 CString FormatFileTime(const FILETIME& t)
+{
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatFileTime(t, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatFileTime(const FILETIME& t, LPTSTR buffer, int size)
 {
     SYSTEMTIME st;
     if(!::FileTimeToSystemTime(&t, &st))
     {
-        return MdGetWinErrorText(::GetLastError());
+        return PrintText(buffer, size, _T("%s"), (LPCTSTR)MdGetWinErrorText(::GetLastError()));
     }
 
     LCID lcid = MAKELCID(GetWDSApp()->GetEffectiveLangid(), SORT_DEFAULT);
 
-    CString date;
-    VERIFY(0 < ::GetDateFormat(lcid, DATE_SHORTDATE, &st, NULL, date.GetBuffer(256), 256));
-    date.ReleaseBuffer();
+    // "date  time"
+    int len = ::GetDateFormat(lcid, DATE_SHORTDATE, &st, NULL, buffer, size);
+    VERIFY(0 < len);
+    if(len <= 0)
+    {
+        buffer[0] = 0;
+        return 0;
+    }
+    len--; // The terminating null
 
-    CString time;
-    VERIFY(0 < GetTimeFormat(lcid, 0, &st, NULL, time.GetBuffer(256), 256));
-    time.ReleaseBuffer();
+    len += PrintText(buffer + len, size - len, _T("  "));
 
-    return date + _T("  ") + time;
+    if(len + 1 < size)
+    {
+        int timeLen = ::GetTimeFormat(lcid, 0, &st, NULL, buffer + len, size - len);
+        VERIFY(0 < timeLen);
+        if(timeLen > 0)
+        {
+            len += timeLen - 1;
+        }
+        else
+        {
+            buffer[len] = 0;
+        }
+    }
+    return len;
 }
 
 CString FormatAttributes(DWORD attr)
@@ -289,7 +407,13 @@ CString FormatAttributes(DWORD attr)
 
 CString FormatMilliseconds(DWORD ms)
 {
-    CString ret;
+    TCHAR buffer[FORMATBUFFERSIZE];
+    FormatMilliseconds(ms, buffer, (int)countof(buffer));
+    return buffer;
+}
+
+int FormatMilliseconds(DWORD ms, LPTSTR buffer, int size)
+{
     DWORD sec = (ms + 500) / 1000;
 
     DWORD s = sec % 60;
@@ -301,13 +425,12 @@ CString FormatMilliseconds(DWORD ms)
 
     if(h > 0)
     {
-        ret.Format(_T("%u:%02u:%02u"), h, m, s);
+        return PrintText(buffer, size, _T("%u:%02u:%02u"), h, m, s);
     }
     else
     {
-        ret.Format(_T("%u:%02u"), m, s);
+        return PrintText(buffer, size, _T("%u:%02u"), m, s);
     }
-    return ret;
 }
 
 bool GetVolumeName(LPCTSTR rootPath, CString& volumeName)
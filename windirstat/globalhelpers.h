@@ -29,18 +29,31 @@
 #pragma once
 #include <common/wds_constants.h>
 
+// Size of a stack buffer sufficient for the texts of the Format*() functions.
+// The buffer variants don't allocate memory; they truncate the text, if
+// the buffer is too small, and return its length.
+const int FORMATBUFFERSIZE = 128;
+
 CString GetLocaleString(LCTYPE lctype, LANGID langid);
 CString GetLocaleLanguage(LANGID langid);
 CString GetLocaleThousandSeparator();
 CString GetLocaleDecimalSeparator();
+void InvalidateFormatCache();
+UINT GetFormatGeneration();
 CString FormatBytes(ULONGLONG const& n);
+int FormatBytes(ULONGLONG n, LPTSTR buffer, int size);
 CString FormatLongLongHuman(ULONGLONG n);
+int FormatLongLongHuman(ULONGLONG n, LPTSTR buffer, int size);
 CString FormatCount(ULONGLONG const& n);
+int FormatCount(ULONGLONG n, LPTSTR buffer, int size);
 CString FormatDouble(double d);
+int FormatDouble(double d, LPTSTR buffer, int size);
 CString PadWidthBlanks(CString n, int width);
 CString FormatFileTime(const FILETIME& t);
+int FormatFileTime(const FILETIME& t, LPTSTR buffer, int size);
 CString FormatAttributes(DWORD attr);
 CString FormatMilliseconds(DWORD ms);
+int FormatMilliseconds(DWORD ms, LPTSTR buffer, int size);
 CString GetParseNameOfMyComputer();
 void GetPidlOfMyComputer(LPITEMIDLIST *ppidl);
 void ShellExecuteWithAssocDialog(HWND hwnd, LPCTSTR filename);
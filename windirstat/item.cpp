@@ -26,6 +26,15 @@
 #include "windirstat.h"
 #include "dirstatdoc.h" // GetItemColor()
 #include "mainframe.h"
+#include "VolumeInfoCache.h"
+#include "ScanStatistics.h"
+#include "EventTrace.h"
+#include "ScanPlugins.h"
+#include "ExclusionRules.h"
+#include "FileHistogram.h"
+#include "ItemPager.h"
+#include "FileFindWDS.h"
+#include "EnumerationQueue.h"
 #include "item.h"
 
 #ifdef _DEBUG
@@ -36,11 +45,41 @@ namespace
 {
     CString GetFreeSpaceItemName()  { return LoadString(IDS_FREESPACE_ITEM); }
     CString GetUnknownItemName()    { return LoadString(IDS_UNKNOWN_ITEM); }
+    CString GetExcludedItemName()   { return LoadString(IDS_EXCLUDED_ITEM); }
+    CString GetSummarizedItemName() { return LoadString(IDS_SUMMARIZED_ITEM); }
+
+    // Whether the scan descends into the directory path.
+    // attributes: as enumerated. Like CReparsePoints::IsFolderJunction(),
+    // but without asking the file system again.
+    bool IsFollowedDirectory(const CString& path, DWORD attributes)
+    {
+        if(GetWDSApp()->IsVolumeMountPoint(path))
+        {
+            return GetOptions()->IsFollowMountPoints();
+        }
+        if(attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+        {
+            return GetOptions()->IsFollowJunctionPoints();
+        }
+        return true;
+    }
 
     const SIZE sizeDeflatePacman = { 1, 2 };
 
     // File attribute packing
     const unsigned char INVALID_m_attributes = 0x80;
+
+    // oldestFile of a subtree without files
+    const FILETIME NO_OLDEST_FILE = { 0xFFFFFFFF, 0xFFFFFFFF };
+
+#ifdef _DEBUG
+    // BenchmarkAggregation()
+    const int BENCHMARK_DIRECTORIES = 200;
+    const int BENCHMARK_FILES = 100;    // per directory
+
+    // BenchmarkNameSorting()
+    const int BENCHMARK_SIBLINGS = 500000;
+#endif //_DEBUG
 }
 
 
@@ -50,12 +89,18 @@ CItem::CItem(ITEMTYPE type, LPCTSTR name, bool dontFollow)
     , m_size(0)
     , m_files(0)
     , m_subdirs(0)
+    , m_subtreeFiles(NULL)
+    , m_textVersion(0)
     , m_done(false)
-    , m_ticksWorked(0)
+    , m_pagedOut(false)
+    , m_pageLost(false)
+    , m_workCounts(0)
     , m_readJobs(0)
     , m_attributes(0)
+    , m_category(0)
+    , m_scanState(NULL)
 {
-    if(GetType() == IT_FILE || dontFollow || GetType() == IT_FREESPACE || GetType() == IT_UNKNOWN || GetType() == IT_MYCOMPUTER)
+    if(IsLeaf(GetType()) || dontFollow || GetType() == IT_MYCOMPUTER)
     {
         SetReadJobDone();
         m_readJobs = 0;
@@ -67,18 +112,40 @@ CItem::CItem(ITEMTYPE type, LPCTSTR name, bool dontFollow)
 
     if(GetType() == IT_DRIVE)
     {
-        m_name = FormatVolumeNameOfRootPath(m_name);
+        // Like FormatVolumeNameOfRootPath(), but doesn't wait for the drive.
+        // If the label is not cached yet, UpdateVolumeInfo() sets it later.
+        VOLUMEINFO info;
+        if(CVolumeInfoCache::Lookup(m_name, info) && info.success)
+        {
+            m_name = FormatVolumeName(m_name, info.volumeName);
+        }
     }
 
     ZeroMemory(&m_lastChange, sizeof(m_lastChange));
+
+    if(!IsLeaf(GetType()))
+    {
+        m_subtreeFiles = new SUBTREEFILES;
+    }
+
+    CScanStatistics::ItemCreated();
 }
 
 CItem::~CItem()
 {
+    CScanStatistics::ItemDeleted();
+
+    if(!IsLeaf(GetType()))
+    {
+        CItemPager::Forget(this);
+    }
+
     for(int i = 0; i < m_children.GetSize(); i++)
     {
         delete m_children[i];
     }
+    delete m_subtreeFiles;
+    delete m_scanState;
 }
 
 CRect CItem::TmiGetRectangle() const
@@ -140,8 +207,13 @@ bool CItem::DrawSubitem(int subitem, CDC *pdc, CRect rc, UINT state, int *width,
     return true;
 }
 
+// Formats into a stack buffer, so that the only allocation is
+// the returned string. GetCachedText() calls this only if
+// m_textVersion has changed.
+//
 CString CItem::GetText(int subitem) const
 {
+    TCHAR buffer[FORMATBUFFERSIZE];
     CString s;
     switch (subitem)
     {
@@ -160,59 +232,71 @@ CString CItem::GetText(int subitem) const
         else
         {
             if(m_readJobs == 1)
+            {
                 s.LoadString(IDS_ONEREADJOB);
+            }
             else
-                s.FormatMessage(IDS_sREADJOBS, FormatCount(m_readJobs));
+            {
+                FormatCount(m_readJobs, buffer, (int)countof(buffer));
+                s.FormatMessage(IDS_sREADJOBS, buffer);
+            }
         }
         break;
 
     case COL_PERCENTAGE:
         if(GetOptions()->IsShowTimeSpent() && MustShowReadJobs() || IsRootItem())
         {
-            s.Format(_T("[%s s]"), FormatMilliseconds(GetTicksWorked()));
+            FormatMilliseconds(GetTicksWorked(), buffer, (int)countof(buffer));
+            s.Format(_T("[%s s]"), buffer);
         }
         else
         {
-            s.Format(_T("%s%%"), FormatDouble(GetFraction() * 100));
+            FormatDouble(GetFraction() * 100, buffer, (int)countof(buffer));
+            s.Format(_T("%s%%"), buffer);
         }
         break;
 
     case COL_SUBTREETOTAL:
         {
-            s = FormatBytes(GetSize());
+            FormatBytes(GetSize(), buffer, (int)countof(buffer));
+            s = buffer;
         }
         break;
 
     case COL_ITEMS:
-        if(GetType() != IT_FILE && GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN)
+        if(!IsLeaf(GetType()))
         {
-            s = FormatCount(GetItemsCount());
+            FormatCount(GetItemsCount(), buffer, (int)countof(buffer));
+            s = buffer;
         }
         break;
 
     case COL_FILES:
-        if(GetType() != IT_FILE && GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN)
+        if(!IsLeaf(GetType()))
         {
-            s = FormatCount(GetFilesCount());
+            FormatCount(GetFilesCount(), buffer, (int)countof(buffer));
+            s = buffer;
         }
         break;
 
     case COL_SUBDIRS:
-        if(GetType() != IT_FILE && GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN)
+        if(!IsLeaf(GetType()))
         {
-            s = FormatCount(GetSubdirsCount());
+            FormatCount(GetSubdirsCount(), buffer, (int)countof(buffer));
+            s = buffer;
         }
         break;
 
     case COL_LASTCHANGE:
-        if(GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN)
+        if(GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN && GetType() != IT_EXCLUDED)
         {
-            s = FormatFileTime(m_lastChange);
+            FormatFileTime(m_lastChange, buffer, (int)countof(buffer));
+            s = buffer;
         }
         break;
 
     case COL_ATTRIBUTES:
-        if(GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN && GetType() != IT_MYCOMPUTER && GetType() != IT_FILESFOLDER)
+        if(GetType() != IT_FREESPACE && GetType() != IT_UNKNOWN && GetType() != IT_EXCLUDED && GetType() != IT_MYCOMPUTER && GetType() != IT_FILESFOLDER)
         {
             s = FormatAttributes(GetAttributes());
         }
@@ -229,6 +313,12 @@ CString CItem::GetText(int subitem) const
 
 COLORREF CItem::GetItemTextColor() const
 {
+    // The children could not be paged in (see PageIn()).
+    if(m_pageLost)
+    {
+        return ::GetSysColor(COLOR_GRAYTEXT);
+    }
+
     // Get the file/folder attributes
     DWORD attr = GetAttributes();
 
@@ -346,14 +436,43 @@ int CItem::CompareSibling(const CTreeListItem *tlib, int subitem) const
     return r;
 }
 
+// The name keys order like CompareNoCase(), which compares lower case.
+//
+bool CItem::GetSortKey(int subitem, CString& key) const
+{
+    if(subitem != COL_NAME)
+    {
+        return false;
+    }
+
+    key = (GetType() == IT_DRIVE ? GetPath() : m_name);
+    key.MakeLower();
+    return true;
+}
+
+// Pages our children in, if necessary. So everybody, who looks at
+// the children, gets them. Paging is invisible to the callers, therefore
+// even const methods do it. A failure is not reported here (see PageIn()).
+//
 int CItem::GetChildrenCount() const
 {
+    if(m_pagedOut)
+    {
+        const_cast<CItem *>(this)->PageIn();
+    }
     return int(m_children.GetSize());
 }
 
+// Doesn't page in, so that the tree list can draw the plus sign.
+//
+bool CItem::HasChildren() const
+{
+    return m_pagedOut || m_children.GetSize() > 0;
+}
+
 CTreeListItem *CItem::GetTreeListChild(int i) const
 {
-    return m_children[i];
+    return GetChild(i);
 }
 
 int CItem::GetImageToCache() const
@@ -374,7 +493,7 @@ int CItem::GetImageToCache() const
     {
         image = GetMyImageList()->getFreeSpaceImage();
     }
-    else if(GetType() == IT_UNKNOWN)
+    else if(GetType() == IT_UNKNOWN || GetType() == IT_EXCLUDED)
     {
         image = GetMyImageList()->getUnknownImage();
     }
@@ -398,6 +517,12 @@ int CItem::GetImageToCache() const
     return image;
 }
 
+UINT CItem::GetTextVersion() const
+{
+    // (Caching is done in CTreeListItem::m_vi.)
+    return m_textVersion;
+}
+
 void CItem::DrawAdditionalState(CDC *pdc, const CRect& rcLabel) const
 {
     if(!IsRootItem() && this == GetDocument()->GetZoomItem())
@@ -430,6 +555,201 @@ CItem *CItem::FindCommonAncestor(const CItem *item1, const CItem *item2)
     return const_cast<CItem *>(parent);
 }
 
+#ifdef _DEBUG
+// Adds BENCHMARK_DIRECTORIES directories with BENCHMARK_FILES files each
+// below chains of directories of increasing depth. Once with one
+// AddChild() per file, and once with AddChildren() per directory like
+// the read jobs do. The items are not part of the document.
+// Return: a human readable report.
+//
+CString CItem::BenchmarkAggregation()
+{
+    static const int depths[] = { 1, 10, 20, 40, 80 };
+
+    FILEINFO fi;
+    fi.name = _T("file.txt");
+    fi.attributes = FILE_ATTRIBUTE_ARCHIVE;
+    fi.category = 0;
+    ::GetSystemTimeAsFileTime(&fi.lastWriteTime);
+
+    CString report;
+    report.Format(_T("%d files each:\r\n"), BENCHMARK_DIRECTORIES * BENCHMARK_FILES);
+
+    for(int d = 0; d < (int)countof(depths); d++)
+    {
+        double seconds[2];
+        for(int batched = 0; batched < 2; batched++)
+        {
+            CItem *root = new CItem(IT_DIRECTORY, _T("benchmark"), true);
+            CItem *parent = root;
+            for(int i = 1; i < depths[d]; i++)
+            {
+                CItem *dir = new CItem(IT_DIRECTORY, _T("directory"), true);
+                parent->AddChild(dir);
+                parent->UpwardAddSubdirs(1);
+                parent = dir;
+            }
+
+            LONGLONG start = CScanStatistics::GetCounter();
+            for(int i = 0; i < BENCHMARK_DIRECTORIES; i++)
+            {
+                CItem *dir = new CItem(IT_DIRECTORY, _T("directory"), true);
+                parent->AddChild(dir);
+                parent->UpwardAddSubdirs(1);
+
+                if(batched)
+                {
+                    CArray<CItem *, CItem *> children;
+                    children.SetSize(0, BENCHMARK_FILES);
+                    for(int j = 0; j < BENCHMARK_FILES; j++)
+                    {
+                        fi.length = j * 1000;
+                        children.Add(MakeFileItem(fi));
+                    }
+                    dir->AddChildren(children, BENCHMARK_FILES, 0);
+                }
+                else
+                {
+                    for(int j = 0; j < BENCHMARK_FILES; j++)
+                    {
+                        fi.length = j * 1000;
+                        dir->AddFile(fi);
+                    }
+                    dir->UpwardAddFiles(BENCHMARK_FILES);
+                }
+            }
+            seconds[batched] = CScanStatistics::CountsToSeconds(CScanStatistics::GetCounter() - start);
+
+            ASSERT(root->GetFilesCount() == (ULONGLONG)BENCHMARK_DIRECTORIES * BENCHMARK_FILES);
+            delete root;
+        }
+
+        ULONGLONG files = (ULONGLONG)BENCHMARK_DIRECTORIES * BENCHMARK_FILES;
+        CString s;
+        s.Format(_T("\r\nDepth %d: %s files/s per file, %s files/s batched"), depths[d],
+            (LPCTSTR)FormatCount((ULONGLONG)(seconds[0] > 0 ? files / seconds[0] : 0)),
+            (LPCTSTR)FormatCount((ULONGLONG)(seconds[1] > 0 ? files / seconds[1] : 0)));
+        report += s;
+    }
+
+    return report;
+}
+
+// Sorts BENCHMARK_SIBLINGS file items by name, once with CompareSibling()
+// and once with the sort keys of CTreeListItem::SortSiblings().
+// Return: a human readable report.
+//
+CString CItem::BenchmarkNameSorting()
+{
+    static const LPCTSTR prefixes[] = {
+        _T("IMG_"), _T("img_"), _T("Report "), _T("report-"), _T("node_modules"), _T("~$"), _T("")
+    };
+
+    CArray<CTreeListItem *, CTreeListItem *> items;
+    items.SetSize(BENCHMARK_SIBLINGS);
+
+    FILEINFO fi;
+    fi.length = 0;
+    fi.attributes = FILE_ATTRIBUTE_ARCHIVE;
+    fi.category = 0;
+    ZeroMemory(&fi.lastWriteTime, sizeof(fi.lastWriteTime));
+
+    DWORD random = 4711;
+    int i = 0;
+    for(i = 0; i < BENCHMARK_SIBLINGS; i++)
+    {
+        random = random * 1103515245 + 12345;
+        fi.name.Format(_T("%s%07u.dat"), prefixes[(random >> 16) % countof(prefixes)], random % 10000000);
+        items[i] = MakeFileItem(fi);
+    }
+
+    CArray<CTreeListItem *, CTreeListItem *> sorted;
+    sorted.Copy(items);
+
+    LONGLONG start = CScanStatistics::GetCounter();
+    qsort(sorted.GetData(), sorted.GetSize(), sizeof(CTreeListItem *), &_compareByName);
+    double compareSeconds = CScanStatistics::CountsToSeconds(CScanStatistics::GetCounter() - start);
+
+    SSorting sorting;
+    sorting.column1 = COL_NAME;
+    sorting.column2 = COL_NAME;
+
+    start = CScanStatistics::GetCounter();
+    CTreeListItem::SortSiblings(items.GetData(), (int)items.GetSize(), sorting);
+    double keySeconds = CScanStatistics::CountsToSeconds(CScanStatistics::GetCounter() - start);
+
+    for(i = 0; i < BENCHMARK_SIBLINGS; i++)
+    {
+        ASSERT(i == 0 || items[i - 1]->CompareSibling(items[i], COL_NAME) <= 0);
+        delete items[i];
+    }
+
+    CString report;
+    report.Format(_T("%d siblings by name:\r\n\r\nCompareSibling(): %s ms\r\nSort keys: %s ms"), BENCHMARK_SIBLINGS,
+        (LPCTSTR)FormatCount((ULONGLONG)(compareSeconds * 1000)), (LPCTSTR)FormatCount((ULONGLONG)(keySeconds * 1000)));
+    return report;
+}
+
+// Scans path with the work slices of the animation off and on (after
+// a first scan, which fills the file system cache). Between the slices
+// we do the gui work of the main loop. The items are not part of the
+// document, the scan statistics are those of the last scan.
+// Return: a human readable report.
+//
+CString CItem::BenchmarkScanAnimation(LPCTSTR path)
+{
+    ULONGLONG files = 0;
+    BenchmarkScan(path, false, files);
+
+    double seconds[2];
+    for(int animate = 0; animate < 2; animate++)
+    {
+        seconds[animate] = BenchmarkScan(path, animate != 0, files);
+    }
+
+    CString report;
+    report.Format(_T("Scan of %s (%s files):\r\n\r\nAnimation off: %s ms, %s files/s\r\nAnimation on: %s ms, %s files/s"), path, (LPCTSTR)FormatCount(files),
+        (LPCTSTR)FormatCount((ULONGLONG)(seconds[0] * 1000)), (LPCTSTR)FormatCount((ULONGLONG)(seconds[0] > 0 ? files / seconds[0] : 0)),
+        (LPCTSTR)FormatCount((ULONGLONG)(seconds[1] * 1000)), (LPCTSTR)FormatCount((ULONGLONG)(seconds[1] > 0 ? files / seconds[1] : 0)));
+    return report;
+}
+
+// Return: the duration of the scan in seconds.
+//
+double CItem::BenchmarkScan(LPCTSTR path, bool animate, ULONGLONG& files)
+{
+    CItem *root = new CItem((ITEMTYPE)(IT_DIRECTORY | ITF_ROOTITEM), path);
+
+    CScanStatistics::StartScan();
+    LONGLONG start = CScanStatistics::GetCounter();
+
+    while(!root->IsDone())
+    {
+        root->DoSomeWork(CDirstatDoc::GetWorkSlice(animate));
+
+        GetDocument()->UpdateAllViews(NULL, HINT_SOMEWORKDONE);
+        if(animate)
+        {
+            GetMainFrame()->DriveAnimation();
+        }
+
+        MSG msg;
+        while(::PeekMessage(&msg, NULL, WM_PAINT, WM_PAINT, PM_REMOVE))
+        {
+            ::DispatchMessage(&msg);
+        }
+    }
+
+    double seconds = CScanStatistics::CountsToSeconds(CScanStatistics::GetCounter() - start);
+    CScanStatistics::EndScan();
+
+    files = root->GetFilesCount();
+    delete root;
+
+    return seconds;
+}
+#endif //_DEBUG
+
 bool CItem::IsAncestorOf(const CItem *item) const
 {
     const CItem *p = item;
@@ -467,6 +787,7 @@ ULONGLONG CItem::GetProgressRange() const
 
     case IT_FREESPACE:
     case IT_UNKNOWN:
+    case IT_EXCLUDED:
     default:
         {
             ASSERT(0);
@@ -498,6 +819,7 @@ ULONGLONG CItem::GetProgressPos() const
     case IT_FILESFOLDER:
     case IT_FREESPACE:
     case IT_UNKNOWN:
+    case IT_EXCLUDED:
     default:
         {
             ASSERT(0);
@@ -521,6 +843,7 @@ const CItem *CItem::UpwardGetRoot() const
 void CItem::UpdateLastChange()
 {
     ZeroMemory(&m_lastChange, sizeof(m_lastChange));
+    m_textVersion++;
     if(GetType() == IT_DIRECTORY || GetType() == IT_FILE)
     {
         CString path = GetPath();
@@ -543,6 +866,10 @@ void CItem::UpdateLastChange()
 
 CItem *CItem::GetChild(int i) const
 {
+    if(m_pagedOut)
+    {
+        const_cast<CItem *>(this)->PageIn();
+    }
     return m_children[i];
 }
 
@@ -574,17 +901,17 @@ void CItem::AddChild(CItem *child)
     UpwardAddSize(child->GetSize());
     UpwardAddReadJobs(child->GetReadJobs());
     UpwardUpdateLastChange(child->GetLastChange());
+    UpwardUpdateFileBounds(child->GetLargestFile(), child->GetOldestFile());
+    UpwardAddChildHistogram(child);
 
-    m_children.Add(child);
-    child->SetParent(this);
-
-    GetTreeListControl()->OnChildAdded(this, child);
+    LinkChild(child);
 }
 
 void CItem::RemoveChild(int i)
 {
     CItem *child = GetChild(i);
     m_children.RemoveAt(i);
+    DropWorkHeap();
     GetTreeListControl()->OnChildRemoved(this, child);
     delete child;
 }
@@ -593,16 +920,102 @@ void CItem::RemoveAllChildren()
 {
     GetTreeListControl()->OnRemovingAllChildren(this);
 
-    for(int i = 0; i < GetChildrenCount(); i++)
+    // No need to read the children back, only to delete them.
+    if(m_pagedOut)
+    {
+        CItemPager::Forget(this);
+        m_pagedOut = false;
+    }
+    m_pageLost = false;
+
+    for(int i = 0; i < m_children.GetSize(); i++)
     {
         delete m_children[i];
     }
     m_children.SetSize(0);
+    DropScanState(); // The target of the count job has gone, too.
+}
+
+// Called after the physical child item has been deleted.
+// Instead of re-reading this item (StartRefresh()) we simply
+// subtract the child's subtree totals from all ancestors.
+//
+void CItem::RemoveDeletedChild(int i)
+{
+    CItem *child = GetChild(i);
+    ASSERT(child->GetType() == IT_FILE || child->GetType() == IT_DIRECTORY);
+
+    if(child->GetType() == IT_DIRECTORY)
+    {
+        CEnumerationQueue::Cancel(child->GetPath());
+    }
+
+    UpwardSubtractReadJobs(child->GetReadJobs());
+    if(child->GetType() == IT_FILE)
+    {
+        UpwardSubtractFiles(1);
+    }
+    else
+    {
+        UpwardSubtractFiles(child->GetFilesCount());
+        UpwardSubtractSubdirs(child->GetSubdirsCount() + 1);
+    }
+    UpwardSubtractSize(child->GetSize());
+    UpwardSubtractChildHistogram(child);
+
+    RemoveChild(i); // --> delete child
+    UpwardRecalcLastChange();
+    UpwardRecalcFileBounds();
+    UpwardResortBySize();
+}
+
+// Adds a root of the session (a drive or a folder) to "My Computer", also
+// while the other roots are being scanned. The root may be scanned already
+// (the former root item of the document).
+//
+void CItem::AddSessionRoot(CItem *root)
+{
+    ASSERT(GetType() == IT_MYCOMPUTER);
+
+    if(IsDone())
+    {
+        UpwardSetUndone();
+    }
+
+    // AddChild() doesn't add these, as they grow later, normally.
+    UpwardAddFiles(root->GetFilesCount());
+    UpwardAddSubdirs(root->GetSubdirsCount());
+
+    AddChild(root);
+}
+
+// Like RemoveDeletedChild(), but the root need not be done.
+// Other than a directory, a root doesn't count itself as subdirectory.
+//
+void CItem::RemoveSessionRoot(int i)
+{
+    ASSERT(GetType() == IT_MYCOMPUTER);
+
+    CItem *root = GetChild(i);
+
+    // Its thread may hang on an unresponsive volume. Then it returns in vain.
+    CEnumerationQueue::Cancel(root->GetPath());
+
+    UpwardSubtractReadJobs(root->GetReadJobs());
+    UpwardSubtractFiles(root->GetFilesCount());
+    UpwardSubtractSubdirs(root->GetSubdirsCount());
+    UpwardSubtractSize(root->GetSize());
+    UpwardSubtractChildHistogram(root);
+
+    RemoveChild(i); // --> delete root
+    UpwardRecalcLastChange();
+    UpwardRecalcFileBounds();
 }
 
 void CItem::UpwardAddSubdirs(ULONGLONG dirCount)
 {
     m_subdirs += dirCount;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardAddSubdirs(dirCount);
@@ -612,6 +1025,7 @@ void CItem::UpwardAddSubdirs(ULONGLONG dirCount)
 void CItem::UpwardSubtractSubdirs(ULONGLONG dirCount)
 {
     m_subdirs -= dirCount;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardSubtractSubdirs(dirCount);
@@ -621,6 +1035,7 @@ void CItem::UpwardSubtractSubdirs(ULONGLONG dirCount)
 void CItem::UpwardAddFiles(ULONGLONG fileCount)
 {
     m_files += fileCount;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardAddFiles(fileCount);
@@ -630,6 +1045,7 @@ void CItem::UpwardAddFiles(ULONGLONG fileCount)
 void CItem::UpwardSubtractFiles(ULONGLONG fileCount)
 {
     m_files -= fileCount;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardSubtractFiles(fileCount);
@@ -639,6 +1055,7 @@ void CItem::UpwardSubtractFiles(ULONGLONG fileCount)
 void CItem::UpwardAddSize(ULONGLONG bytes)
 {
     m_size += bytes;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardAddSize(bytes);
@@ -648,15 +1065,51 @@ void CItem::UpwardAddSize(ULONGLONG bytes)
 void CItem::UpwardSubtractSize(ULONGLONG bytes)
 {
     m_size -= bytes;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardSubtractSize(bytes);
     }
 }
 
+// After the size of this item has changed: moves it to its new position
+// among the children of its parent, if the parent is done (SetDone() has
+// sorted them by size, which the treemap and the report require), and so
+// on up to the root. Undone parents are sorted by SetDone().
+//
+void CItem::UpwardResortBySize()
+{
+    for(CItem *item = this; item->GetParent() != NULL; item = item->GetParent())
+    {
+        CItem *parent = item->GetParent();
+        if(!parent->IsDone())
+        {
+            continue;
+        }
+
+        CArray<CItem *, CItem *>& children = parent->m_children;
+        int i = parent->FindChildIndex(item);
+
+        // Has grown: towards the front
+        while(i > 0 && children[i - 1]->GetSize() < item->GetSize())
+        {
+            children[i] = children[i - 1];
+            i--;
+        }
+        // Has shrunk: towards the end
+        while(i < children.GetSize() - 1 && children[i + 1]->GetSize() > item->GetSize())
+        {
+            children[i] = children[i + 1];
+            i++;
+        }
+        children[i] = item;
+    }
+}
+
 void CItem::UpwardAddReadJobs(ULONGLONG count)
 {
     m_readJobs += count;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardAddReadJobs(count);
@@ -667,6 +1120,7 @@ void CItem::UpwardAddReadJobs(ULONGLONG count)
 void CItem::UpwardSubtractReadJobs(ULONGLONG count)
 {
     m_readJobs -= count;
+    m_textVersion++;
     if(GetParent() != NULL)
     {
         GetParent()->UpwardSubtractReadJobs(count);
@@ -679,6 +1133,7 @@ void CItem::UpwardUpdateLastChange(const FILETIME& t)
     if(m_lastChange < t)
     {
         m_lastChange = t;
+        m_textVersion++;
         if(GetParent() != NULL)
         {
             GetParent()->UpwardUpdateLastChange(t);
@@ -686,9 +1141,14 @@ void CItem::UpwardUpdateLastChange(const FILETIME& t)
     }
 }
 
-// This method may also decrease the last change
+// This method may also decrease the last change.
+// Only our own time is read from disk. The ancestors merely compare
+// the old and the new time, see UpwardReplaceLastChange().
+//
 void CItem::UpwardRecalcLastChange()
 {
+    FILETIME oldTime = m_lastChange;
+
     UpdateLastChange();
 
     for(int i = 0; i < GetChildrenCount(); i++)
@@ -698,9 +1158,100 @@ void CItem::UpwardRecalcLastChange()
             m_lastChange = GetChild(i)->GetLastChange();
         }
     }
+    m_textVersion++;
+
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardReplaceLastChange(oldTime, m_lastChange);
+    }
+}
+
+void CItem::UpwardAddFileHistogram(ULONGLONG size, const FILETIME& t)
+{
+    m_subtreeFiles->histogram.AddFile(size, t);
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardAddFileHistogram(size, t);
+    }
+}
+
+void CItem::UpwardSubtractFileHistogram(ULONGLONG size, const FILETIME& t)
+{
+    m_subtreeFiles->histogram.SubtractFile(size, t);
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardSubtractFileHistogram(size, t);
+    }
+}
+
+void CItem::UpwardAddHistogram(const CFileHistogram& histogram)
+{
+    m_subtreeFiles->histogram.Add(histogram);
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardAddHistogram(histogram);
+    }
+}
+
+void CItem::UpwardSubtractHistogram(const CFileHistogram& histogram)
+{
+    ASSERT(&histogram != &m_subtreeFiles->histogram);
+    m_subtreeFiles->histogram.Subtract(histogram);
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardSubtractHistogram(histogram);
+    }
+}
+
+// Widens the file bounds. Removing items leaves them too wide, which
+// only makes CTopFiles visit more items, until UpwardRecalcFileBounds().
+//
+void CItem::UpwardUpdateFileBounds(ULONGLONG largest, const FILETIME& oldest)
+{
+    bool changed = false;
+    if(m_subtreeFiles->largestFile < largest)
+    {
+        m_subtreeFiles->largestFile = largest;
+        changed = true;
+    }
+    if(oldest < m_subtreeFiles->oldestFile)
+    {
+        m_subtreeFiles->oldestFile = oldest;
+        changed = true;
+    }
+    if(changed && GetParent() != NULL)
+    {
+        GetParent()->UpwardUpdateFileBounds(largest, oldest);
+    }
+}
+
+// This method may also narrow the file bounds.
+// Only the bounds stored in our children are read, so nothing is paged in.
+// A paged out (or lost) directory keeps its own bounds. A leaf has none.
+//
+void CItem::UpwardRecalcFileBounds()
+{
+    if(m_subtreeFiles != NULL && !m_pagedOut && !m_pageLost)
+    {
+        m_subtreeFiles->largestFile = 0;
+        m_subtreeFiles->oldestFile = NO_OLDEST_FILE;
+
+        for(int i = 0; i < m_children.GetSize(); i++)
+        {
+            const CItem *child = m_children[i];
+            if(m_subtreeFiles->largestFile < child->GetLargestFile())
+            {
+                m_subtreeFiles->largestFile = child->GetLargestFile();
+            }
+            if(child->GetOldestFile() < m_subtreeFiles->oldestFile)
+            {
+                m_subtreeFiles->oldestFile = child->GetOldestFile();
+            }
+        }
+    }
     if(GetParent() != NULL)
     {
-        GetParent()->UpwardRecalcLastChange();
+        GetParent()->UpwardRecalcFileBounds();
     }
 }
 
@@ -714,6 +1265,7 @@ void CItem::SetSize(ULONGLONG ownSize)
     ASSERT(IsLeaf(GetType()));
     ASSERT(ownSize >= 0);
     m_size = ownSize;
+    m_textVersion++;
 }
 
 ULONGLONG CItem::GetReadJobs() const
@@ -729,6 +1281,34 @@ FILETIME CItem::GetLastChange() const
 void CItem::SetLastChange(const FILETIME& t)
 {
     m_lastChange = t;
+    m_textVersion++;
+}
+
+// Size of the largest file in the subtree (at most)
+ULONGLONG CItem::GetLargestFile() const
+{
+    if(GetType() == IT_FILE)
+    {
+        return m_size;
+    }
+    return m_subtreeFiles != NULL ? m_subtreeFiles->largestFile : 0;
+}
+
+// Modification time of the oldest file in the subtree (at least)
+FILETIME CItem::GetOldestFile() const
+{
+    if(GetType() == IT_FILE)
+    {
+        return m_lastChange;
+    }
+    return m_subtreeFiles != NULL ? m_subtreeFiles->oldestFile : NO_OLDEST_FILE;
+}
+
+// Return: NULL, if leaf.
+//
+const CFileHistogram *CItem::GetHistogram() const
+{
+    return m_subtreeFiles != NULL ? &m_subtreeFiles->histogram : NULL;
 }
 
 // Encode the attributes to fit 1 byte
@@ -754,6 +1334,7 @@ void CItem::SetAttributes(DWORD attr)
     if(ret == INVALID_FILE_ATTRIBUTES)
     {
         m_attributes = (unsigned char)INVALID_m_attributes;
+        m_textVersion++;
         return;
     }
 
@@ -775,6 +1356,7 @@ void CItem::SetAttributes(DWORD attr)
     ret |= (attr & FILE_ATTRIBUTE_ENCRYPTED) >> 8;
 
     m_attributes = (unsigned char)ret;
+    m_textVersion++;
 }
 
 // Decode the attributes encoded by SetAttributes()
@@ -894,7 +1476,7 @@ CString CItem::GetReportPath() const
     {
         path += _T("\\");
     }
-    if((GetType() == IT_FILESFOLDER) || (GetType() == IT_FREESPACE) || (GetType() == IT_UNKNOWN))
+    if((GetType() == IT_FILESFOLDER) || (GetType() == IT_FREESPACE) || (GetType() == IT_UNKNOWN) || (GetType() == IT_EXCLUDED))
     {
         path += GetName();
     }
@@ -915,6 +1497,12 @@ CString CItem::GetExtension() const
     {
     case IT_FILE:
         {
+            if(m_category != 0)
+            {
+                ext = CScanPlugins::GetCategoryName(m_category);
+                break;
+            }
+
             int i = GetName().ReverseFind(wds::chrDot);
             if(i == -1)
             {
@@ -929,6 +1517,7 @@ CString CItem::GetExtension() const
         }
     case IT_FREESPACE:
     case IT_UNKNOWN:
+    case IT_EXCLUDED:
         {
             ext = GetName();
         }
@@ -972,6 +1561,7 @@ void CItem::SetReadJobDone(bool done)
         UpwardSubtractReadJobs(m_readJobs - 1);
     }
     m_readJobDone = done;
+    m_textVersion++;
 
 }
 
@@ -989,25 +1579,13 @@ void CItem::SetDone()
 
     if(GetType() == IT_DRIVE)
     {
-        UpdateFreeSpaceItem();
+        // The drive has been read completely, so we want current values.
+        CVolumeInfoCache::Invalidate(GetPath());
 
-        if(GetDocument()->OptionShowUnknown())
-        {
-            CItem *unknown = FindUnknownItem();
-
-            ULONGLONG total;
-            ULONGLONG free;
-            CDirstatApp::getDiskFreeSpace(GetPath(), total, free);
-
-            ULONGLONG unknownspace = total - GetSize();
-            if(!GetDocument()->OptionShowFreeSpace())
-            {
-                unknownspace -= free;
-            }
-            unknown->SetSize(unknownspace);
-
-            UpwardAddSize(unknownspace);
-        }
+        // Until the refresh has arrived (UpdateVolumeInfo()),
+        // the cached values are shown.
+        UpdateFreeSpaceItem();
+        UpdateUnknownItem();
     }
 
 // #ifdef _DEBUG
@@ -1022,74 +1600,176 @@ void CItem::SetDone()
 
     ZeroMemory(&m_rect, sizeof(m_rect));
 
+    DropScanState();
+
     m_done = true;
+    m_textVersion++;
 }
 
+// Return: the time spent on this item in ms.
+//
 DWORD CItem::GetTicksWorked() const
 {
-    return m_ticksWorked;
+    return (DWORD)(CScanStatistics::CountsToSeconds(m_workCounts) * 1000);
+}
+
+void CItem::AddWorkCounts(LONGLONG more)
+{
+    m_workCounts += more;
+    m_textVersion++;
 }
 
-void CItem::AddTicksWorked(DWORD more)
+// Works on this subtree for about ticks ms.
+// The budget is measured with the performance counter, so that
+// slices shorter than the GetTickCount() resolution (one frame) work.
+//
+bool CItem::DoSomeWork(DWORD ticks)
 {
-    m_ticksWorked += more;
+    return DoWorkUntil(CScanStatistics::GetCounter() + CScanStatistics::MillisecondsToCounts(ticks));
 }
 
-void CItem::DoSomeWork(DWORD ticks)
+// Reads this item, if not yet done, and then distributes the remaining
+// time among the undone children: each step works on the child with
+// the least work done so far, i.e. the top of the work heap (SCANSTATE).
+// The entries of the directories come from the CEnumerationQueue. A child,
+// which waits for them, is set aside for the rest of the call, so that it
+// doesn't hold up its siblings (e.g. a session root on an unresponsive
+// network share).
+// Return: false, if nothing could be done, because all the work waits
+// for the enumeration threads.
+//
+bool CItem::DoWorkUntil(LONGLONG deadline)
 {
     if(IsDone())
     {
-        return;
+        return true;
     }
 
-    StartPacman(true);
-
-    DriveVisualUpdateDuringWork();
-
-    DWORD start = ::GetTickCount();
+    LONGLONG start = CScanStatistics::GetCounter();
+    bool progress = false;
 
     if(GetType() == IT_DRIVE || GetType() == IT_DIRECTORY)
     {
         if(!IsReadJobDone())
         {
+            CString pattern = GetFindPattern();
+            LONGLONG enumerationCounts = 0;
+            CDirEntryArray *entries = CEnumerationQueue::Fetch(pattern, enumerationCounts);
+            if(entries == NULL)
+            {
+                return false;
+            }
+
             ULONGLONG dirCount = 0;
             ULONGLONG fileCount = 0;
 
             CList<FILEINFO, FILEINFO> files;
 
+            // The new children are linked only after the enumeration, so that
+            // AddChildren() can add their totals to the ancestors at once.
+            CArray<CItem *, CItem *> children;
+            CArray<CItem *, CItem *> summarize;
+
+            ULONGLONG bytes = 0;
 
-            CFileFindWDS finder;
-            BOOL b = finder.FindFile(GetFindPattern());
-            while(b)
+            CScanPlugins *plugins = GetDocument()->GetScanPlugins();
+            if(plugins->IsActive())
             {
-                DriveVisualUpdateDuringWork();
+                plugins->SetFolder(GetPath());
+            }
 
-                b = finder.FindNextFile();
-                if(finder.IsDots())
-                {
-                    continue;
-                }
-                if(finder.IsDirectory())
+            // Bytes of the excluded files, shown in <Excluded>. Excluded
+            // subdirectories are not entered at all (that is what the user
+            // wants to save); on a drive <Unknown> holds their bytes.
+            ULONGLONG excludedBytes = 0;
+            bool excluded = false;
+
+            CExclusionRules *rules = GetOptions()->GetCompiledExclusionRules();
+            {
+                CStatisticsTimer timer(SC_EXCLUSIONS);
+                rules->BeginDirectory(GetPath());
+            }
+
+            // The path of an entry, as CFileFind::GetFilePath() would return it
+            CString folder = pattern.Left(pattern.ReverseFind(wds::chrBackslash) + 1);
+
+            for(int i = 0; i < entries->GetSize(); i++)
+            {
+                const DIRENTRY& entry = (*entries)[i];
+                if(entry.directory)
                 {
+                    RULEACTION action;
+                    {
+                        CStatisticsTimer timer(SC_EXCLUSIONS);
+                        action = rules->Match(entry.name, true, 0, entry.lastWriteTime);
+                    }
+                    if(action == RA_EXCLUDE)
+                    {
+                        excluded = true;
+                        continue;
+                    }
+
+                    PLUGINDECISION decision = PD_INCLUDE;
+                    if(plugins->IsActive())
+                    {
+                        CStatisticsTimer timer(SC_PLUGINS);
+                        unsigned char category;
+                        decision = plugins->Evaluate(entry.name, true, entry.attributes, 0, entry.lastWriteTime, category);
+                    }
+                    if(decision == PD_EXCLUDE)
+                    {
+                        excluded = true;
+                        continue;
+                    }
+
                     dirCount++;
-                    AddDirectory(finder);
+                    CItem *child = MakeDirectoryItem(entry, folder + entry.name, decision == PD_DONTRECURSE || action == RA_SUMMARIZE);
+                    children.Add(child);
+                    if(action == RA_SUMMARIZE && decision != PD_DONTRECURSE)
+                    {
+                        summarize.Add(child);
+                    }
                 }
                 else
                 {
-                    fileCount++;
-
                     FILEINFO fi;
-                    fi.name = finder.GetFileName();
-                    fi.attributes = finder.GetAttributes();
-                    // Retrieve file size
-                    fi.length = finder.GetCompressedLength();
-                    finder.GetLastWriteTime(&fi.lastWriteTime);
-                    // (We don't use GetLastWriteTime(CTime&) here, because, if the file has
-                    // an invalid timestamp, that function would ASSERT and throw an Exception.)
+                    fi.name = entry.name;
+                    fi.attributes = entry.attributes;
+                    fi.length = entry.length;
+                    fi.lastWriteTime = entry.lastWriteTime;
+                    fi.category = 0;
+
+                    RULEACTION action;
+                    {
+                        CStatisticsTimer timer(SC_EXCLUSIONS);
+                        action = rules->Match(fi.name, false, fi.length, fi.lastWriteTime);
+                    }
+                    if(action == RA_EXCLUDE)
+                    {
+                        excludedBytes += fi.length;
+                        excluded = true;
+                        continue;
+                    }
+
+                    if(plugins->IsActive())
+                    {
+                        CStatisticsTimer timer(SC_PLUGINS);
+                        if(PD_EXCLUDE == plugins->Evaluate(fi.name, false, fi.attributes, fi.length, fi.lastWriteTime, fi.category))
+                        {
+                            excludedBytes += fi.length;
+                            excluded = true;
+                            continue;
+                        }
+                    }
 
+                    fileCount++;
                     files.AddTail(fi);
+                    bytes += fi.length;
                 }
             }
+            delete entries;
+
+            CScanStatistics::AddDirectory(pattern, fileCount, bytes, enumerationCounts);
 
 //             CItem *filesFolder = 0;
 //             if(dirCount > 0 && fileCount > 1)
@@ -1106,31 +1786,55 @@ void CItem::DoSomeWork(DWORD ticks)
             for(POSITION pos = files.GetHeadPosition(); pos != NULL; files.GetNext(pos))
             {
                 const FILEINFO& fi = files.GetAt(pos);
-                this->AddFile(fi);
+                children.Add(MakeFileItem(fi));
+            }
+
+            if(excluded)
+            {
+                children.Add(MakeExcludedItem(excludedBytes));
+            }
+
+            GetTreeListControl()->BeginUpdate();
+
+            AddChildren(children, fileCount, dirCount);
+
+            for(int i = 0; i < summarize.GetSize(); i++)
+            {
+                summarize[i]->StartSummarize();
             }
 
+            GetTreeListControl()->EndUpdate();
+
 //             if(filesFolder != NULL)
 //             {
-                this->UpwardAddFiles(fileCount);
-                if(dirCount > 0 && fileCount > 0)
+                if(dirCount > 0 && fileCount > 0 && !HasCountJob())
                 {
                     this->SetDone();
                 }
 //             }
 
-            UpwardAddSubdirs(dirCount);
+            // Read ahead: the enumeration threads list the subdirectories,
+            // while we are busy with their siblings.
+            for(int i = 0; i < children.GetSize() && !IsDone(); i++)
+            {
+                if(children[i]->GetType() == IT_DIRECTORY && !children[i]->IsReadJobDone())
+                {
+                    CEnumerationQueue::Request(children[i]->GetFindPattern());
+                }
+            }
+
             SetReadJobDone();
-            AddTicksWorked(::GetTickCount() - start);
+            AddWorkCounts(CScanStatistics::GetCounter() - start);
+            progress = true;
         }
         if(GetType() == IT_DRIVE)
         {
             UpdateFreeSpaceItem();
         }
 
-        if(::GetTickCount() - start > ticks)
+        if(CScanStatistics::GetCounter() >= deadline)
         {
-            StartPacman(false);
-            return;
+            return true;
         }
     }
     if(GetType() == IT_DRIVE || GetType() == IT_DIRECTORY || GetType() == IT_MYCOMPUTER)
@@ -1138,52 +1842,89 @@ void CItem::DoSomeWork(DWORD ticks)
         ASSERT(IsReadJobDone());
         if(IsDone())
         {
-            StartPacman(false);
-            return;
+            return true;
+        }
+
+        // Our own count job comes first. It keeps to the deadline, too.
+        // While it waits for the enumeration threads, the children go on.
+        if(HasCountJob())
+        {
+            if(ContinueCountJob(deadline))
+            {
+                progress = true;
+            }
+            if(CScanStatistics::GetCounter() >= deadline)
+            {
+                return true;
+            }
         }
-        if(GetChildrenCount() == 0)
+
+        if(GetChildrenCount() == 0 && !HasCountJob())
         {
             SetDone();
-            StartPacman(false);
-            return;
+            return true;
         }
 
-        DWORD startChildren = ::GetTickCount();
-        while(::GetTickCount() - start < ticks)
+        if(m_scanState == NULL || !m_scanState->workHeapValid)
         {
-            DWORD minticks = UINT_MAX;
-            CItem *minchild = NULL;
-            for(int i = 0; i < GetChildrenCount(); i++)
+            BuildWorkHeap();
+        }
+        CArray<CItem *, CItem *>& workHeap = m_scanState->workHeap;
+
+        // At least one step, even if the read job has used up the time.
+        // Children, which wait for the enumeration threads, are set aside.
+        CArray<CItem *, CItem *> waiting;
+        LONGLONG startChildren = CScanStatistics::GetCounter();
+        do
+        {
+            if(workHeap.GetSize() == 0)
             {
-                CItem *child = GetChild(i);
-                if(child->IsDone())
+                if(waiting.GetSize() == 0 && !HasCountJob())
                 {
-                    continue;
-                }
-                if(child->GetTicksWorked() < minticks)
-                {
-                    minticks = child->GetTicksWorked();
-                    minchild = child;
+                    SetDone();
+                    progress = true;
                 }
+                break;
+            }
+
+            CItem *child = workHeap[0];
+            bool moved = child->DoWorkUntil(deadline);
+            if(moved)
+            {
+                progress = true;
             }
-            if(minchild == NULL)
+            else
             {
-                SetDone();
-                break;
+                waiting.Add(child);
             }
-            DWORD tickssofar = ::GetTickCount() - start;
-            if(ticks > tickssofar)
+
+            // The child has got more work, so it sinks (or leaves the heap).
+            if(child->IsDone() || !moved)
+            {
+                int last = (int)workHeap.GetSize() - 1;
+                workHeap[0] = workHeap[last];
+                workHeap.SetSize(last);
+            }
+            SiftDownWorkHeap(0);
+        }
+        while(CScanStatistics::GetCounter() < deadline);
+
+        if(waiting.GetSize() > 0)
+        {
+            workHeap.Append(waiting);
+            for(int i = (int)workHeap.GetSize() / 2 - 1; i >= 0; i--)
             {
-                minchild->DoSomeWork(ticks - tickssofar);
+                SiftDownWorkHeap(i);
             }
         }
-        AddTicksWorked(::GetTickCount() - startChildren);
+        AddWorkCounts(CScanStatistics::GetCounter() - startChildren);
     }
     else
     {
         SetDone();
+        progress = true;
     }
-    StartPacman(false);
+    return progress;
 }
 
 // Return: false if deleted
@@ -1191,8 +1932,10 @@ bool CItem::StartRefresh()
 {
     ASSERT(GetType() != IT_FREESPACE);
     ASSERT(GetType() != IT_UNKNOWN);
+    ASSERT(GetType() != IT_EXCLUDED);
 
-    m_ticksWorked = 0;
+    m_workCounts = 0;
+    m_textVersion++;
 
     // Special case IT_MYCOMPUTER
     if(GetType() == IT_MYCOMPUTER)
@@ -1208,6 +1951,12 @@ bool CItem::StartRefresh()
     }
     ASSERT(GetType() == IT_FILE || GetType() == IT_DRIVE || GetType() == IT_DIRECTORY || GetType() == IT_FILESFOLDER);
 
+    // The entries requested for the old subtree may be outdated.
+    if(GetType() == IT_DRIVE || GetType() == IT_DIRECTORY)
+    {
+        CEnumerationQueue::Cancel(GetPath());
+    }
+
     bool wasExpanded = IsVisible() && IsExpanded();
     int oldScrollPosition = 0;
     if(IsVisible())
@@ -1218,6 +1967,15 @@ bool CItem::StartRefresh()
     UncacheImage();
 
     // Upward clear data
+    if(GetParent() != NULL)
+    {
+        GetParent()->UpwardSubtractChildHistogram(this); // before UpdateLastChange() changes our bucket
+    }
+    if(m_subtreeFiles != NULL)
+    {
+        m_subtreeFiles->histogram = CFileHistogram();
+    }
+
     UpdateLastChange();
 
     UpwardSetUndone();
@@ -1246,10 +2004,13 @@ bool CItem::StartRefresh()
 
     RemoveAllChildren();
     UpwardRecalcLastChange();
+    UpwardRecalcFileBounds();
 
     // Special case IT_FILESFOLDER
     if(GetType() == IT_FILESFOLDER)
     {
+        CArray<CItem *, CItem *> children;
+
         CFileFindWDS finder;
         BOOL b = finder.FindFile(GetFindPattern());
         while(b)
@@ -1264,10 +2025,11 @@ bool CItem::StartRefresh()
             // Retrieve file size
             fi.length = finder.GetCompressedLength();
             finder.GetLastWriteTime(&fi.lastWriteTime);
+            fi.category = 0;
 
-            AddFile(fi);
-            UpwardAddFiles(1);
+            children.Add(MakeFileItem(fi));
         }
+        AddChildren(children, children.GetSize(), 0);
         SetDone();
 
         if(wasExpanded)
@@ -1328,6 +2090,8 @@ bool CItem::StartRefresh()
 
                 UpwardAddSize(fi.length);
                 UpwardUpdateLastChange(GetLastChange());
+                GetParent()->UpwardUpdateFileBounds(GetSize(), GetLastChange());
+                GetParent()->UpwardAddChildHistogram(this);
                 GetParent()->UpwardAddFiles(1);
             }
         }
@@ -1347,6 +2111,14 @@ bool CItem::StartRefresh()
         return true;
     }
 
+    if(GetType() == IT_DIRECTORY && !IsRootItem() && IsSummarized())
+    {
+        m_readJobDone = true; // GetReadJobs() is 0 here, see above.
+        m_textVersion++;
+        StartSummarize();
+        return true;
+    }
+
     // Initiate re-read
     SetReadJobDone(false);
 
@@ -1398,6 +2170,10 @@ void CItem::UpwardSetUndone()
     }
 
     m_done = false;
+    m_textVersion++;
+
+    // The child which has become undone is not in the heap.
+    DropWorkHeap();
 
     if(GetParent() != NULL)
     {
@@ -1405,19 +2181,68 @@ void CItem::UpwardSetUndone()
     }
 }
 
+// Called, when the CVolumeInfoCache has new information (WMU_VOLUMEINFO).
+// Takes the label and, if we are done, the free space from the cache,
+// because the gui thread must not wait for an inaccessible drive.
+// spaceChanged: whether the size of our <Free Space> or <Unknown> item
+// has changed, i.e. whether a treemap, which shows us, is out of date.
+// Return: true, if something has changed.
+//
+bool CItem::UpdateVolumeInfo(bool& spaceChanged)
+{
+    ASSERT(GetType() == IT_DRIVE);
+
+    spaceChanged = false;
+
+    VOLUMEINFO info;
+    if(!CVolumeInfoCache::Lookup(GetPath(), info) || !info.success)
+    {
+        return false;
+    }
+
+    bool changed = false;
+
+    CString name = FormatVolumeName(GetPath(), info.volumeName);
+    if(name != m_name)
+    {
+        m_name = name;
+        m_textVersion++;
+        changed = true;
+    }
+
+    if(IsDone())
+    {
+        CItem *freeSpace = FindFreeSpaceItem();
+        CItem *unknown = FindUnknownItem();
+        ULONGLONG freeBefore = (freeSpace != NULL ? freeSpace->GetSize() : 0);
+        ULONGLONG unknownBefore = (unknown != NULL ? unknown->GetSize() : 0);
+
+        UpdateFreeSpaceItem();
+        UpdateUnknownItem();
+
+        if((freeSpace != NULL && freeSpace->GetSize() != freeBefore)
+        || (unknown != NULL && unknown->GetSize() != unknownBefore))
+        {
+            spaceChanged = true;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
 void CItem::RefreshRecycler()
 {
     ASSERT(GetType() == IT_DRIVE);
-    DWORD dummy;
-    CString system;
     int i = 0;
-    BOOL b = GetVolumeInformation(GetPath(), NULL, 0, NULL, &dummy, &dummy, system.GetBuffer(128), 128);
-    system.ReleaseBuffer();
-    if(!b)
+    VOLUMEINFO info;
+    // The file system doesn't change, so any cached information will do.
+    if(!CVolumeInfoCache::Query(GetPath(), info, INFINITE) || info.fileSystem.IsEmpty())
     {
         VTRACE(_T("GetVolumeInformation(%s) failed."), GetPath());
         return; // nix zu machen
     }
+    CString system = info.fileSystem;
 
     CString recycler;
     if(system.CompareNoCase(_T("NTFS")) == 0)
@@ -1458,7 +2283,7 @@ void CItem::CreateFreeSpaceItem()
 
     ULONGLONG total;
     ULONGLONG free;
-    CDirstatApp::getDiskFreeSpace(GetPath(), total, free);
+    CVolumeInfoCache::GetDiskFreeSpace(GetPath(), total, free, false);
 
     CItem *freespace = new CItem(IT_FREESPACE, GetFreeSpaceItemName());
     freespace->SetSize(free);
@@ -1495,12 +2320,13 @@ void CItem::UpdateFreeSpaceItem()
 
     ULONGLONG total;
     ULONGLONG free;
-    CDirstatApp::getDiskFreeSpace(GetPath(), total, free);
+    CVolumeInfoCache::GetDiskFreeSpace(GetPath(), total, free, false);
 
     ULONGLONG before = freeSpaceItem->GetSize();
     ULONGLONG diff = free - before;
 
     freeSpaceItem->UpwardAddSize(diff);
+    freeSpaceItem->UpwardResortBySize();
 
     ASSERT(freeSpaceItem->GetSize() == free);
 }
@@ -1546,6 +2372,41 @@ CItem *CItem::FindUnknownItem() const
     }
 }
 
+// <Unknown> is the used space of the volume, which the scan has not found
+// (e.g. because of access rights).
+//
+void CItem::UpdateUnknownItem()
+{
+    ASSERT(GetType() == IT_DRIVE);
+
+    if(!GetDocument()->OptionShowUnknown())
+    {
+        return;
+    }
+
+    CItem *unknown = FindUnknownItem();
+    ASSERT(unknown != NULL);
+
+    ULONGLONG total;
+    ULONGLONG free;
+    CVolumeInfoCache::GetDiskFreeSpace(GetPath(), total, free, false);
+
+    ULONGLONG before = unknown->GetSize();
+    ULONGLONG found = GetSize() - before;
+
+    // An imported scan (CScanDatabase) may not match the local volume.
+    ULONGLONG unknownspace = (total > found ? total - found : 0);
+    if(!GetDocument()->OptionShowFreeSpace())
+    {
+        unknownspace = (unknownspace > free ? unknownspace - free : 0);
+    }
+
+    unknown->UpwardAddSize(unknownspace - before);
+    unknown->UpwardResortBySize();
+
+    ASSERT(unknown->GetSize() == unknownspace);
+}
+
 void CItem::RemoveUnknownItem()
 {
     ASSERT(GetType() == IT_DRIVE);
@@ -1619,6 +2480,30 @@ void CItem::RecurseCollectExtensionData(CExtensionData *ed)
             ed->SetAt(ext, r);
         }
     }
+    else if(m_pagedOut)
+    {
+        // Don't page in the whole tree for the extension list.
+        const CExtensionData *paged = CItemPager::GetExtensionData(this);
+        POSITION pos = paged->GetStartPosition();
+        while(pos != NULL)
+        {
+            CString ext;
+            SExtensionRecord p;
+            paged->GetNextAssoc(pos, ext, p);
+
+            SExtensionRecord r;
+            if(ed->Lookup(ext, r))
+            {
+                r.bytes += p.bytes;
+                r.files += p.files;
+            }
+            else
+            {
+                r = p;
+            }
+            ed->SetAt(ext, r);
+        }
+    }
     else
     {
         for(int i = 0; i < GetChildrenCount(); i++)
@@ -1628,6 +2513,261 @@ void CItem::RecurseCollectExtensionData(CExtensionData *ed)
     }
 }
 
+bool CItem::IsPagedOut() const
+{
+    return m_pagedOut;
+}
+
+bool CItem::IsPageLost() const
+{
+    return m_pageLost;
+}
+
+// If the file cannot be read, we lose the children. The subtree
+// totals remain, so the item looks like a summarized directory, but
+// grayed out, until it is refreshed. We may be called in the middle of
+// anything (painting, UpwardRecalc...()), so the error is not shown here,
+// but recorded for CDirstatDoc::Work().
+// Return: false, if the children are lost.
+//
+bool CItem::PageIn()
+{
+    if(!m_pagedOut)
+    {
+        return !m_pageLost;
+    }
+    m_pagedOut = false;
+
+    try
+    {
+        CItemPager::PageIn(this);
+    }
+    catch(CException *pe)
+    {
+        CItemPager::SetError(this, pe);
+        pe->Delete();
+
+        // Those read so far. Nested pages attached to them go with them.
+        for(int i = 0; i < m_children.GetSize(); i++)
+        {
+            delete m_children[i];
+        }
+        m_children.SetSize(0);
+        CItemPager::Forget(this);
+
+        m_pageLost = true;
+        m_textVersion++;
+        return false;
+    }
+    return true;
+}
+
+// Scan preview: the used space of an undone drive, which the scan has not
+// yet found. The treemap shows it as the size of <Unknown>, so the drive,
+// My Computer and <Unknown> include it in TmiGetSize(). The document takes
+// a snapshot of it (CDirstatDoc::UpdateScanPreview()), so that the sizes of
+// a treemap layout are consistent.
+//
+ULONGLONG CItem::GetPendingSize() const
+{
+    switch (GetType())
+    {
+    case IT_MYCOMPUTER:
+        {
+            if(IsDone())
+            {
+                return 0;
+            }
+
+            ULONGLONG pending = 0;
+            for(int i = 0; i < GetChildrenCount(); i++)
+            {
+                pending += GetChild(i)->GetPendingSize();
+            }
+            return pending;
+        }
+
+    case IT_DRIVE:
+        {
+            return IsDone() ? 0 : GetDocument()->GetPendingSize(this);
+        }
+
+    case IT_UNKNOWN:
+        {
+            return GetParent() != NULL ? GetParent()->GetPendingSize() : 0;
+        }
+
+    default:
+        {
+            return 0;
+        }
+    }
+}
+
+// Scan preview: SetDone() sorts the children by size, which the treemap
+// requires. While undone, this sorts them for a provisional layout.
+// Done subtrees are sorted already, and subtrees smaller than minSize
+// (less than a pixel) don't get a layout of their own, so only the
+// visible part of the scan frontier is sorted.
+//
+void CItem::SortChildrenForPreview(ULONGLONG minSize)
+{
+    if(IsDone() || m_pagedOut || IsLeaf(GetType()))
+    {
+        return;
+    }
+
+    qsort(m_children.GetData(), m_children.GetSize(), sizeof(CItem *), &_compareByTreemapSize);
+
+    for(int i = 0; i < m_children.GetSize(); i++)
+    {
+        if(m_children[i]->TmiGetSize() < minSize)
+        {
+            break;
+        }
+        m_children[i]->SortChildrenForPreview(minSize);
+    }
+}
+
+// Collects the outermost done directories with at least minItems items,
+// which CItemPager may page out.
+//
+void CItem::CollectPagingCandidates(CArray<CItem *, CItem *>& candidates, ULONGLONG minItems)
+{
+    // m_children, because GetChild() would page in.
+    for(int i = 0; i < m_children.GetSize(); i++)
+    {
+        CItem *child = m_children[i];
+        if(IsLeaf(child->GetType()) || child->m_pagedOut || child->GetItemsCount() < minItems)
+        {
+            continue;
+        }
+
+        if(child->GetType() == IT_DIRECTORY && child->IsDone() && !CItemPager::IsPinned(child))
+        {
+            candidates.Add(child);
+        }
+        else
+        {
+            child->CollectPagingCandidates(candidates, minItems);
+        }
+    }
+}
+
+// Writes our children and their subtrees, except the children of
+// paged out directories, which are referenced by their page ids.
+//
+void CItem::WriteChildren(CArchive& ar, ULONGLONG& items, CArray<int, int>& nestedPages) const
+{
+    ar << (DWORD)m_children.GetSize();
+    for(int i = 0; i < m_children.GetSize(); i++)
+    {
+        const CItem *child = m_children[i];
+        items++;
+
+        ar << (WORD)child->m_type;
+        ar << child->m_name;
+        ar << child->m_size << child->m_files << child->m_subdirs;
+        ar << child->m_lastChange.dwLowDateTime << child->m_lastChange.dwHighDateTime;
+        ar << child->m_attributes << child->m_category;
+        ar << child->m_workCounts;
+        ar << child->m_rect.left << child->m_rect.top << child->m_rect.right << child->m_rect.bottom;
+
+        if(IsLeaf(child->GetType()))
+        {
+            continue;
+        }
+
+        const SUBTREEFILES *subtreeFiles = child->m_subtreeFiles;
+        ar << subtreeFiles->largestFile;
+        ar << subtreeFiles->oldestFile.dwLowDateTime << subtreeFiles->oldestFile.dwHighDateTime;
+        ar.Write(&subtreeFiles->histogram, sizeof(subtreeFiles->histogram));
+        ar << (BYTE)child->m_pagedOut;
+        if(child->m_pagedOut)
+        {
+            int id = CItemPager::GetPageId(child);
+            ar << (DWORD)id;
+            nestedPages.Add(id);
+        }
+        else
+        {
+            child->WriteChildren(ar, items, nestedPages);
+        }
+    }
+}
+
+// Counterpart of WriteChildren().
+//
+void CItem::ReadChildren(CArchive& ar)
+{
+    ASSERT(m_children.GetSize() == 0);
+
+    DWORD count = 0;
+    ar >> count;
+    m_children.SetSize(0, count);
+    for(DWORD i = 0; i < count; i++)
+    {
+        WORD type = 0;
+        CString name;
+        ar >> type >> name;
+
+        CItem *child = new CItem((ITEMTYPE)type, name, true);
+        child->m_done = true;
+        child->SetParent(this);
+        m_children.Add(child);
+
+        ar >> child->m_size >> child->m_files >> child->m_subdirs;
+        ar >> child->m_lastChange.dwLowDateTime >> child->m_lastChange.dwHighDateTime;
+        ar >> child->m_attributes >> child->m_category;
+        ar >> child->m_workCounts;
+        ar >> child->m_rect.left >> child->m_rect.top >> child->m_rect.right >> child->m_rect.bottom;
+
+        if(IsLeaf(child->GetType()))
+        {
+            continue;
+        }
+
+        SUBTREEFILES *subtreeFiles = child->m_subtreeFiles;
+        ar >> subtreeFiles->largestFile;
+        ar >> subtreeFiles->oldestFile.dwLowDateTime >> subtreeFiles->oldestFile.dwHighDateTime;
+        if(ar.Read(&subtreeFiles->histogram, sizeof(subtreeFiles->histogram)) != sizeof(subtreeFiles->histogram))
+        {
+            AfxThrowArchiveException(CArchiveException::endOfFile);
+        }
+        BYTE pagedOut = 0;
+        ar >> pagedOut;
+        if(pagedOut != 0)
+        {
+            DWORD id = 0;
+            ar >> id;
+            CItemPager::Attach(child, (int)id);
+            child->m_pagedOut = true;
+        }
+        else
+        {
+            child->ReadChildren(ar);
+        }
+    }
+}
+
+// Called by CItemPager, after our children have been written.
+//
+void CItem::ReleaseChildren()
+{
+    ASSERT(IsDone());
+    ASSERT(!IsVisible());
+
+    for(int i = 0; i < m_children.GetSize(); i++)
+    {
+        delete m_children[i];
+    }
+    m_children.SetSize(0);
+    m_children.FreeExtra();
+    DropWorkHeap();
+
+    m_pagedOut = true;
+}
+
 int __cdecl CItem::_compareBySize(const void *p1, const void *p2)
 {
     CItem *item1 = *(CItem **)p1;
@@ -1641,14 +2781,42 @@ int __cdecl CItem::_compareBySize(const void *p1, const void *p2)
     return signum(size2 - size1); // biggest first
 }
 
+// Like _compareBySize(), but the <Unknown> item of a drive, which is
+// being scanned, has the size of the pending space (scan preview).
+//
+int __cdecl CItem::_compareByTreemapSize(const void *p1, const void *p2)
+{
+    CItem *item1 = *(CItem **)p1;
+    CItem *item2 = *(CItem **)p2;
+
+    ULONGLONG size1 = item1->TmiGetSize();
+    ULONGLONG size2 = item2->TmiGetSize();
+
+    return signum(size2 - size1); // biggest first
+}
+
+#ifdef _DEBUG
+int __cdecl CItem::_compareByName(const void *p1, const void *p2)
+{
+    CItem *item1 = (CItem *)*(CTreeListItem **)p1;
+    CItem *item2 = (CItem *)*(CTreeListItem **)p2;
+
+    return item1->CompareSibling(item2, COL_NAME);
+}
+#endif //_DEBUG
+
 ULONGLONG CItem::GetProgressRangeMyComputer() const
 {
     ASSERT(GetType() == IT_MYCOMPUTER);
 
+    // Folders of the session have no range.
     ULONGLONG range = 0;
     for(int i  =  0; i < GetChildrenCount(); i++)
     {
-        range += GetChild(i)->GetProgressRangeDrive();
+        if(GetChild(i)->GetType() == IT_DRIVE)
+        {
+            range += GetChild(i)->GetProgressRangeDrive();
+        }
     }
     return range;
 }
@@ -1660,7 +2828,10 @@ ULONGLONG CItem::GetProgressPosMyComputer() const
     ULONGLONG pos = 0;
     for(int i  =  0; i < GetChildrenCount(); i++)
     {
-        pos += GetChild(i)->GetProgressPosDrive();
+        if(GetChild(i)->GetType() == IT_DRIVE)
+        {
+            pos += GetChild(i)->GetProgressPosDrive();
+        }
     }
     return pos;
 }
@@ -1669,7 +2840,7 @@ ULONGLONG CItem::GetProgressRangeDrive() const
 {
     ULONGLONG total;
     ULONGLONG free;
-    CDirstatApp::getDiskFreeSpace(GetPath(), total, free);
+    CVolumeInfoCache::GetDiskFreeSpace(GetPath(), total, free, false);
 
     total -= free;
 
@@ -1698,7 +2869,15 @@ COLORREF CItem::GetGraphColor() const
     {
     case IT_UNKNOWN:
         {
-            color = RGB(255,255,0) | CTreemap::COLORFLAG_LIGHTER;
+            if(GetPendingSize() > 0)
+            {
+                // Scan preview: the space, which has not yet been found
+                color = RGB(200,200,200) | CTreemap::COLORFLAG_LIGHTER | CTreemap::COLORFLAG_PENDING;
+            }
+            else
+            {
+                color = RGB(255,255,0) | CTreemap::COLORFLAG_LIGHTER;
+            }
         }
         break;
 
@@ -1708,12 +2887,25 @@ COLORREF CItem::GetGraphColor() const
         }
         break;
 
+    case IT_EXCLUDED:
+        {
+            color = RGB(200,200,200) | CTreemap::COLORFLAG_LIGHTER;
+        }
+        break;
+
     case IT_FILE:
         {
             color = GetDocument()->GetCushionColor(GetExtension());
         }
         break;
 
+    case IT_DIRECTORY:
+        {
+            // Only a paged out (or lost) directory is a leaf of the treemap.
+            color = m_pagedOut || m_pageLost ? RGB(150,150,150) | CTreemap::COLORFLAG_LIGHTER : RGB(0,0,0);
+        }
+        break;
+
     default:
         {
             color = RGB(0,0,0);
@@ -1812,6 +3004,7 @@ CString CItem::UpwardGetPathWithoutBackslash() const
 
     case IT_FREESPACE:
     case IT_UNKNOWN:
+    case IT_EXCLUDED:
         break;
 
     default:
@@ -1823,73 +3016,458 @@ CString CItem::UpwardGetPathWithoutBackslash() const
     return path;
 }
 
-void CItem::AddDirectory(CFileFindWDS& finder)
+// Creates a directory item, which is not yet linked into the tree.
+// dontRecurse: a scan plugin or a summarize rule wants the directory without its contents.
+//
+CItem *CItem::MakeDirectoryItem(const DIRENTRY& entry, const CString& path, bool dontRecurse)
 {
-    bool dontFollow = GetWDSApp()->IsVolumeMountPoint(finder.GetFilePath()) && !GetOptions()->IsFollowMountPoints();
+    bool dontFollow = dontRecurse || !IsFollowedDirectory(path, entry.attributes);
 
-    dontFollow |= GetWDSApp()->IsFolderJunction(finder.GetFilePath()) && !GetOptions()->IsFollowJunctionPoints();
-
-    CItem *child = new CItem(IT_DIRECTORY, finder.GetFileName(), dontFollow);
-    FILETIME t;
-    finder.GetLastWriteTime(&t);
-    child->SetLastChange(t);
-    child->SetAttributes(finder.GetAttributes());
-    AddChild(child);
+    CItem *child = new CItem(IT_DIRECTORY, entry.name, dontFollow);
+    child->SetLastChange(entry.lastWriteTime);
+    child->SetAttributes(entry.attributes);
+    return child;
 }
 
-void CItem::AddFile(const FILEINFO& fi)
+CItem *CItem::MakeFileItem(const FILEINFO& fi)
 {
     CItem *child = new CItem(IT_FILE, fi.name);
     child->SetSize(fi.length);
     child->SetLastChange(fi.lastWriteTime);
     child->SetAttributes(fi.attributes);
+    child->m_category = fi.category;
     child->SetDone();
+    return child;
+}
 
-    AddChild(child);
+// Creates the pseudo file <Excluded>, which holds the bytes of the files
+// an exclusion rule or a scan plugin has removed from a directory.
+// The removed subdirectories are not counted.
+//
+CItem *CItem::MakeExcludedItem(ULONGLONG bytes)
+{
+    CItem *child = new CItem(IT_EXCLUDED, GetExcludedItemName());
+    child->SetSize(bytes);
+    child->SetDone();
+    return child;
+}
+
+void CItem::AddFile(const FILEINFO& fi)
+{
+    AddChild(MakeFileItem(fi));
 }
 
-void CItem::DriveVisualUpdateDuringWork()
+// Batched AddChild() for the results of a read job. The totals of all
+// children (plus files and subdirs) are added to the ancestors in one
+// walk up the parent chain, instead of several walks per child.
+//
+void CItem::AddChildren(const CArray<CItem *, CItem *>& children, ULONGLONG files, ULONGLONG subdirs)
 {
-    MSG msg;
-    while(PeekMessage(&msg, NULL, WM_PAINT, WM_PAINT, PM_REMOVE))
+    ASSERT(!IsDone());
+
+    CHILDTOTALS totals;
+    totals.files = files;
+    totals.subdirs = subdirs;
+
+    int i = 0;
+    for(i = 0; i < children.GetSize(); i++)
+    {
+        totals.Add(children[i]);
+    }
+
+    // As in AddChild(): first add numbers, then link the children.
+    UpwardAddTotals(totals);
+
+    // Linked like in LinkChild(), but the tree list gets all rows at once.
+    int first = GetChildrenCount();
+    for(i = 0; i < children.GetSize(); i++)
     {
-        DispatchMessage(&msg);
+        m_children.Add(children[i]);
+        children[i]->SetParent(this);
     }
+    DropWorkHeap();
+
+    GetTreeListControl()->OnChildrenAdded(this, first);
+}
+
+// Inserts the child without touching any totals.
+//
+void CItem::LinkChild(CItem *child)
+{
+    m_children.Add(child);
+    child->SetParent(this);
+    DropWorkHeap();
 
-    GetMainFrame()->DrivePacman();
-    UpwardDrivePacman();
+    GetTreeListControl()->OnChildAdded(this, child);
 }
 
-void CItem::UpwardDrivePacman()
+// Collects the undone children and heapifies them by m_workCounts.
+// O(children), but only once per change of the children.
+//
+void CItem::BuildWorkHeap()
 {
-    if(!GetOptions()->IsPacmanAnimation())
+    SCANSTATE *scanState = GetScanState();
+    ASSERT(!scanState->workHeapValid);
+    ASSERT(scanState->workHeap.GetSize() == 0);
+
+    int i = 0;
+    for(i = 0; i < GetChildrenCount(); i++)
     {
-        return;
+        if(!GetChild(i)->IsDone())
+        {
+            scanState->workHeap.Add(GetChild(i));
+        }
+    }
+    scanState->workHeapValid = true;
+
+    for(i = (int)scanState->workHeap.GetSize() / 2 - 1; i >= 0; i--)
+    {
+        SiftDownWorkHeap(i);
     }
+}
+
+void CItem::SiftDownWorkHeap(int i)
+{
+    CItem **heap = m_scanState->workHeap.GetData();
+    int n = (int)m_scanState->workHeap.GetSize();
+
+    for(;;)
+    {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if(left < n && heap[left]->m_workCounts < heap[smallest]->m_workCounts)
+        {
+            smallest = left;
+        }
+        if(right < n && heap[right]->m_workCounts < heap[smallest]->m_workCounts)
+        {
+            smallest = right;
+        }
+        if(smallest == i)
+        {
+            break;
+        }
+        CItem *t = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = t;
+        i = smallest;
+    }
+}
+
+// The heap is rebuilt by the next DoWorkUntil().
+//
+void CItem::DropWorkHeap()
+{
+    if(m_scanState != NULL)
+    {
+        m_scanState->workHeap.RemoveAll();
+        m_scanState->workHeapValid = false;
+    }
+}
+
+CItem::SCANSTATE *CItem::GetScanState()
+{
+    if(m_scanState == NULL)
+    {
+        m_scanState = new SCANSTATE;
+    }
+    return m_scanState;
+}
+
+// Drops the work heap and the count job.
+//
+void CItem::DropScanState()
+{
+    delete m_scanState;
+    m_scanState = NULL;
+}
+
+void CItem::UpwardAddTotals(const CHILDTOTALS& totals)
+{
+    m_size += totals.size;
+    m_textVersion++;
+    m_readJobs += totals.readJobs;
+    m_files += totals.files;
+    m_subdirs += totals.subdirs;
+    if(m_lastChange < totals.lastChange)
+    {
+        m_lastChange = totals.lastChange;
+    }
+    if(m_subtreeFiles->largestFile < totals.largestFile)
+    {
+        m_subtreeFiles->largestFile = totals.largestFile;
+    }
+    if(totals.oldestFile < m_subtreeFiles->oldestFile)
+    {
+        m_subtreeFiles->oldestFile = totals.oldestFile;
+    }
+    m_subtreeFiles->histogram.Add(totals.histogram);
 
-    DrivePacman();
     if(GetParent() != NULL)
     {
-        GetParent()->UpwardDrivePacman();
+        GetParent()->UpwardAddTotals(totals);
+    }
+}
+
+CItem::CHILDTOTALS::CHILDTOTALS()
+    : size(0)
+    , readJobs(0)
+    , files(0)
+    , subdirs(0)
+    , largestFile(0)
+    , oldestFile(NO_OLDEST_FILE)
+{
+    ZeroMemory(&lastChange, sizeof(lastChange));
+}
+
+CItem::SCANSTATE::SCANSTATE()
+    : workHeapValid(false)
+{
+    countJob.target = NULL;
+}
+
+CItem::SUBTREEFILES::SUBTREEFILES()
+    : largestFile(0)
+    , oldestFile(NO_OLDEST_FILE)
+{
+}
+
+// Adds what AddChild() would add to the ancestors.
+//
+void CItem::CHILDTOTALS::Add(const CItem *child)
+{
+    size += child->GetSize();
+    readJobs += child->GetReadJobs();
+    if(lastChange < child->GetLastChange())
+    {
+        lastChange = child->GetLastChange();
+    }
+    if(largestFile < child->GetLargestFile())
+    {
+        largestFile = child->GetLargestFile();
+    }
+    if(child->GetOldestFile() < oldestFile)
+    {
+        oldestFile = child->GetOldestFile();
+    }
+    if(child->GetType() == IT_FILE)
+    {
+        histogram.AddFile(child->GetSize(), child->GetLastChange());
+    }
+    else if(child->GetHistogram() != NULL)
+    {
+        histogram.Add(*child->GetHistogram());
+    }
+}
+
+// Called for a directory which matches a summarize rule. Adds only one
+// pseudo file <Summarized>, which holds the bytes of the whole subtree.
+// So the totals are right, but no items are created. The subtree is
+// counted by a count job, i.e. step by step in DoWorkUntil().
+//
+void CItem::StartSummarize()
+{
+    ASSERT(GetType() == IT_DIRECTORY);
+    ASSERT(IsReadJobDone());
+
+    CItem *child = new CItem(IT_EXCLUDED, GetSummarizedItemName());
+    child->SetDone();
+    AddChild(child);
+
+    StartCountJob(child);
+    if(IsFollowedDirectory(GetPath(), GetAttributes()))
+    {
+        PushCountFolder(GetPath());
+    }
+}
+
+// The caller pushes the directories (PushCountFolder()).
+//
+void CItem::StartCountJob(CItem *target)
+{
+    ASSERT(!HasCountJob());
+    ASSERT(target->GetParent() == this);
+
+    GetScanState()->countJob.target = target;
+}
+
+// Pushes a directory onto the stack of the count job and requests its
+// entries, so that the enumeration threads are ahead of us.
+//
+void CItem::PushCountFolder(const CString& path)
+{
+    m_scanState->countJob.pending.AddHead(path);
+    CEnumerationQueue::Request(path + _T("\\*.*"));
+}
+
+// Counts the pending directories of the count job until the deadline,
+// but at least one, unless the entries of the next one have not yet
+// arrived (CEnumerationQueue).
+// The job is deleted, when it is finished.
+// Return: false, if nothing could be done.
+//
+bool CItem::ContinueCountJob(LONGLONG deadline)
+{
+    ASSERT(HasCountJob());
+    CStringList& pending = m_scanState->countJob.pending;
+
+    bool progress = false;
+    LONGLONG start = CScanStatistics::GetCounter();
+    while(!pending.IsEmpty())
+    {
+        CString path = pending.GetHead();
+        LONGLONG counts = 0;
+        CDirEntryArray *entries = CEnumerationQueue::Fetch(path + _T("\\*.*"), counts);
+        if(entries == NULL)
+        {
+            break;
+        }
+        pending.RemoveHead();
+        CountFolder(path, *entries);
+        delete entries;
+        progress = true;
+
+        if(CScanStatistics::GetCounter() >= deadline)
+        {
+            break;
+        }
+    }
+    AddWorkCounts(CScanStatistics::GetCounter() - start);
+
+    if(pending.IsEmpty())
+    {
+        DropCountJob();
+        progress = true;
+    }
+    return progress;
+}
+
+// One step of the count job. The subdirectories of path are pushed
+// onto the stack, the bytes of its files are added to the target.
+//
+void CItem::CountFolder(const CString& path, const CDirEntryArray& entries)
+{
+    ULONGLONG files = 0;
+    ULONGLONG subdirs = 0;
+    ULONGLONG bytes = 0;
+    FILETIME lastChange;
+    ZeroMemory(&lastChange, sizeof(lastChange));
+
+    for(int i = 0; i < entries.GetSize(); i++)
+    {
+        const DIRENTRY& entry = entries[i];
+        if(lastChange < entry.lastWriteTime)
+        {
+            lastChange = entry.lastWriteTime;
+        }
+
+        if(entry.directory)
+        {
+            subdirs++;
+            CString subdir = path + _T("\\") + entry.name;
+            if(IsFollowedDirectory(subdir, entry.attributes))
+            {
+                PushCountFolder(subdir);
+            }
+        }
+        else
+        {
+            files++;
+            bytes += entry.length;
+        }
     }
+
+    CItem *target = m_scanState->countJob.target;
+    target->UpwardAddSize(bytes);
+    target->UpwardUpdateLastChange(lastChange);
+    UpwardAddFiles(files);
+    UpwardAddSubdirs(subdirs);
 }
 
-void CItem::DrivePacman()
+bool CItem::HasCountJob() const
+{
+    return m_scanState != NULL && m_scanState->countJob.target != NULL;
+}
+
+void CItem::DropCountJob()
+{
+    if(m_scanState != NULL)
+    {
+        m_scanState->countJob.target = NULL;
+        m_scanState->countJob.pending.RemoveAll();
+    }
+}
+
+// Whether a summarize rule matches this directory. Used by StartRefresh().
+//
+bool CItem::IsSummarized()
+{
+    CExclusionRules *rules = GetOptions()->GetCompiledExclusionRules();
+    if(rules->IsEmpty())
+    {
+        return false;
+    }
+
+    rules->BeginDirectory(GetParent()->GetPath());
+    return RA_SUMMARIZE == rules->Match(GetName(), true, 0, GetLastChange());
+}
+
+// Called by the animation frame clock for the items on screen
+// (see CDirstatView::DrivePacmen()), not by the scan itself.
+// The pacman of an item moves, as long as the item is not done.
+// Return: true, if the pacman cell must be repainted.
+//
+bool CItem::DrivePacman()
 {
     if(!IsVisible())
     {
-        return;
+        return false;
     }
 
-    if(!CTreeListItem::DrivePacman(GetReadJobs()))
+    StartPacman(!IsDone());
+    return CTreeListItem::DrivePacman(GetReadJobs());
+}
+
+// The last change of a child has changed from oldTime to newTime.
+// Only if the child has been our newest one and has become older,
+// we must recalculate. Otherwise the ancestors stay untouched.
+//
+void CItem::UpwardReplaceLastChange(const FILETIME& oldTime, const FILETIME& newTime)
+{
+    if(m_lastChange < newTime)
     {
-        return;
+        UpwardUpdateLastChange(newTime);
     }
+    else if(newTime < oldTime && !(oldTime < m_lastChange))
+    {
+        UpwardRecalcLastChange();
+    }
+}
 
-    int i = GetTreeListControl()->FindTreeItem(this);
+// Adds the files of the child's subtree to our histograms and to
+// those of our ancestors.
+//
+void CItem::UpwardAddChildHistogram(const CItem *child)
+{
+    if(child->GetType() == IT_FILE)
+    {
+        UpwardAddFileHistogram(child->GetSize(), child->GetLastChange());
+    }
+    else if(child->GetHistogram() != NULL)
+    {
+        UpwardAddHistogram(*child->GetHistogram());
+    }
+}
 
-    CClientDC dc(GetTreeListControl());
-    CRect rc = GetTreeListControl()->GetWholeSubitemRect(i, COL_SUBTREEPERCENTAGE);
-    rc.DeflateRect(sizeDeflatePacman);
-    DrawPacman(&dc, rc, GetTreeListControl()->GetItemSelectionBackgroundColor(i));
+void CItem::UpwardSubtractChildHistogram(const CItem *child)
+{
+    if(child->GetType() == IT_FILE)
+    {
+        UpwardSubtractFileHistogram(child->GetSize(), child->GetLastChange());
+    }
+    else if(child->GetHistogram() != NULL)
+    {
+        UpwardSubtractHistogram(*child->GetHistogram());
+    }
 }
@@ -29,7 +29,8 @@
 #include "Treelistcontrol.h"
 #include "treemap.h"
 #include "dirstatdoc.h" // CExtensionData
-#include "FileFindWDS.h" // CFileFindWDS
+#include "EnumerationQueue.h" // CDirEntryArray
+#include "FileHistogram.h" // CFileHistogram
 #include <common/wds_constants.h>
 
 // Columns
@@ -56,13 +57,14 @@ enum ITEMTYPE
     IT_FILESFOLDER,     // Pseudo Folder "<Files>"
     IT_FREESPACE,       // Pseudo File "<Free Space>"
     IT_UNKNOWN,         // Pseudo File "<Unknown>"
+    IT_EXCLUDED,        // Pseudo File "<Excluded>" or "<Summarized>" (see CExclusionRules)
 
     ITF_FLAGS    = 0xF000,
     ITF_ROOTITEM = 0x8000   // This is an additional flag, not a type.
 };
 
 // Whether an item type is a leaf type
-inline bool IsLeaf(ITEMTYPE t) { return t == IT_FILE || t == IT_FREESPACE || t == IT_UNKNOWN; }
+inline bool IsLeaf(ITEMTYPE t) { return t == IT_FILE || t == IT_FREESPACE || t == IT_UNKNOWN || t == IT_EXCLUDED; }
 
 // Compare FILETIMEs
 inline bool operator< (const FILETIME& t1, const FILETIME& t2)
@@ -110,6 +112,62 @@ class CItem: public CTreeListItem, public CTreemap::Item
         ULONGLONG length;
         FILETIME lastWriteTime;
         DWORD attributes;
+        unsigned char category;     // See CScanPlugins
+    };
+
+    // Totals of several new children, which AddChildren() adds to all
+    // ancestors in one single walk up the parent chain.
+    struct CHILDTOTALS
+    {
+        CHILDTOTALS();
+        void Add(const CItem *child);
+
+        ULONGLONG size;
+        ULONGLONG readJobs;
+        ULONGLONG files;
+        ULONGLONG subdirs;
+        FILETIME lastChange;
+        ULONGLONG largestFile;
+        FILETIME oldestFile;
+        CFileHistogram histogram;
+    };
+
+    // A walk over directories, for which no items are created: the subtree
+    // of a summarized directory.
+    // It enumerates one directory per step (see ContinueCountJob()), so that
+    // it keeps to the time budget of DoWorkUntil().
+    struct COUNTJOB
+    {
+        CItem *target;          // <Summarized>, which gets the bytes and the last change
+        CStringList pending;    // Directories not yet counted (a stack). Their entries have been requested.
+    };
+
+    // What only an undone directory needs for DoWorkUntil(). Created on
+    // demand and deleted by SetDone(), so that the items of a finished
+    // scan only pay for the pointer.
+    struct SCANSTATE
+    {
+        SCANSTATE();
+
+        // Our undone children, a min-heap by m_workCounts (see DoWorkUntil()).
+        // Invalid, if the children have changed since it was built.
+        CArray<CItem *, CItem *> workHeap;
+        bool workHeapValid;
+
+        // Pending walk over a summarized directory. Its target is NULL, if none.
+        COUNTJOB countJob;
+    };
+
+    // The bounds and the histogram of the files in a subtree. A file item
+    // derives its bounds from its own size and time, so only the items,
+    // which can have children, have one.
+    struct SUBTREEFILES
+    {
+        SUBTREEFILES();
+
+        ULONGLONG largestFile;      // Upper bound of the file sizes in subtree (see CTopFiles)
+        FILETIME oldestFile;        // Lower bound of the file modification times in subtree
+        CFileHistogram histogram;   // Bytes by age and files by size in subtree
     };
 
 public:
@@ -121,23 +179,31 @@ public:
     virtual CString GetText(int subitem) const;
     virtual COLORREF GetItemTextColor() const;
     virtual int CompareSibling(const CTreeListItem *tlib, int subitem) const;
+    virtual bool GetSortKey(int subitem, CString& key) const;
     virtual int GetChildrenCount() const;
+    virtual bool HasChildren() const;
     virtual CTreeListItem *GetTreeListChild(int i) const;
     virtual int GetImageToCache() const;
+    virtual UINT GetTextVersion() const;
     virtual void DrawAdditionalState(CDC *pdc, const CRect& rcLabel) const;
 
     // CTreemap::Item interface
-    virtual            bool TmiIsLeaf()                const { return IsLeaf(GetType()); }
+    virtual            bool TmiIsLeaf()                const { return IsLeaf(GetType()) || m_pagedOut || m_pageLost; }
     virtual           CRect TmiGetRectangle()          const;
     virtual            void TmiSetRectangle(const CRect& rc);
     virtual        COLORREF TmiGetGraphColor()         const { return GetGraphColor(); }
-    virtual             int TmiGetChildrenCount()      const { return GetChildrenCount(); }
+    virtual             int TmiGetChildrenCount()      const { return m_pagedOut ? 0 : GetChildrenCount(); }
     virtual CTreemap::Item *TmiGetChild(int c)         const { return GetChild(c); }
-    virtual       ULONGLONG TmiGetSize()               const { return GetSize(); }
+    virtual       ULONGLONG TmiGetSize()               const { return GetSize() + GetPendingSize(); }
 
     // CItem
     static int GetSubtreePercentageWidth();
     static CItem *FindCommonAncestor(const CItem *item1, const CItem *item2);
+#ifdef _DEBUG
+    static CString BenchmarkAggregation();
+    static CString BenchmarkNameSorting();
+    static CString BenchmarkScanAnimation(LPCTSTR path);
+#endif //_DEBUG
 
     bool IsAncestorOf(const CItem *item) const;
     ULONGLONG GetProgressRange() const;
@@ -150,21 +216,34 @@ public:
     void AddChild(CItem *child);
     void RemoveChild(int i);
     void RemoveAllChildren();
+    void RemoveDeletedChild(int i);
+    void AddSessionRoot(CItem *root);
+    void RemoveSessionRoot(int i);
     void UpwardAddSubdirs(ULONGLONG dirCount);
     void UpwardSubtractSubdirs(ULONGLONG dirCount);
     void UpwardAddFiles(ULONGLONG fileCount);
     void UpwardSubtractFiles(ULONGLONG fileCount);
     void UpwardAddSize(ULONGLONG bytes);
     void UpwardSubtractSize(ULONGLONG bytes);
+    void UpwardResortBySize();
     void UpwardAddReadJobs(ULONGLONG count);
     void UpwardSubtractReadJobs(ULONGLONG count);
     void UpwardUpdateLastChange(const FILETIME& t);
     void UpwardRecalcLastChange();
+    void UpwardAddFileHistogram(ULONGLONG size, const FILETIME& t);
+    void UpwardSubtractFileHistogram(ULONGLONG size, const FILETIME& t);
+    void UpwardAddHistogram(const CFileHistogram& histogram);
+    void UpwardSubtractHistogram(const CFileHistogram& histogram);
+    void UpwardUpdateFileBounds(ULONGLONG largest, const FILETIME& oldest);
+    void UpwardRecalcFileBounds();
     ULONGLONG GetSize() const;
     void SetSize(ULONGLONG ownSize);
     ULONGLONG GetReadJobs() const;
     FILETIME GetLastChange() const;
     void SetLastChange(const FILETIME& t);
+    ULONGLONG GetLargestFile() const;
+    FILETIME GetOldestFile() const;
+    const CFileHistogram *GetHistogram() const;
     void SetAttributes(DWORD attr);
     DWORD GetAttributes() const;
     int GetSortAttributes() const;
@@ -186,23 +265,37 @@ public:
     bool IsDone() const;
     void SetDone();
     DWORD GetTicksWorked() const;
-    void AddTicksWorked(DWORD more);
-    void DoSomeWork(DWORD ticks);
+    void AddWorkCounts(LONGLONG more);
+    bool DoSomeWork(DWORD ticks);
+    bool DrivePacman();
     bool StartRefresh();
     void UpwardSetUndone();
     void RefreshRecycler();
+    bool UpdateVolumeInfo(bool& spaceChanged);
     void CreateFreeSpaceItem();
     CItem *FindFreeSpaceItem() const;
     void UpdateFreeSpaceItem();
     void RemoveFreeSpaceItem();
     void CreateUnknownItem();
     CItem *FindUnknownItem() const;
+    void UpdateUnknownItem();
     void RemoveUnknownItem();
     CItem *FindDirectoryByPath(const CString& path);
     void RecurseCollectExtensionData(CExtensionData *ed);
+    bool IsPagedOut() const;
+    bool IsPageLost() const;
+    bool PageIn();
+    void CollectPagingCandidates(CArray<CItem *, CItem *>& candidates, ULONGLONG minItems);
+    ULONGLONG GetPendingSize() const;
+    void SortChildrenForPreview(ULONGLONG minSize);
 
 private:
     static int __cdecl _compareBySize(const void *p1, const void *p2);
+    static int __cdecl _compareByTreemapSize(const void *p1, const void *p2);
+#ifdef _DEBUG
+    static int __cdecl _compareByName(const void *p1, const void *p2);
+    static double BenchmarkScan(LPCTSTR path, bool animate, ULONGLONG& files);
+#endif //_DEBUG
     ULONGLONG GetProgressRangeMyComputer() const;
     ULONGLONG GetProgressPosMyComputer() const;
     ULONGLONG GetProgressRangeDrive() const;
@@ -213,29 +306,63 @@ private:
     int FindFreeSpaceItemIndex() const;
     int FindUnknownItemIndex() const;
     CString UpwardGetPathWithoutBackslash() const;
-    void AddDirectory(CFileFindWDS& finder);
+    static CItem *MakeDirectoryItem(const DIRENTRY& entry, const CString& path, bool dontRecurse);
+    static CItem *MakeFileItem(const FILEINFO& fi);
+    static CItem *MakeExcludedItem(ULONGLONG bytes);
     void AddFile(const FILEINFO& fi);
-    void DriveVisualUpdateDuringWork();
-    void UpwardDrivePacman();
-    void DrivePacman();
+    void AddChildren(const CArray<CItem *, CItem *>& children, ULONGLONG files, ULONGLONG subdirs);
+    void LinkChild(CItem *child);
+    bool DoWorkUntil(LONGLONG deadline);
+    void BuildWorkHeap();
+    void SiftDownWorkHeap(int i);
+    void DropWorkHeap();
+    SCANSTATE *GetScanState();
+    void DropScanState();
+    void UpwardAddTotals(const CHILDTOTALS& totals);
+    void StartSummarize();
+    void StartCountJob(CItem *target);
+    bool ContinueCountJob(LONGLONG deadline);
+    void PushCountFolder(const CString& path);
+    void CountFolder(const CString& path, const CDirEntryArray& entries);
+    bool HasCountJob() const;
+    void DropCountJob();
+    bool IsSummarized();
+    void UpwardReplaceLastChange(const FILETIME& oldTime, const FILETIME& newTime);
+    void UpwardAddChildHistogram(const CItem *child);
+    void UpwardSubtractChildHistogram(const CItem *child);
+
+    // CItemPager
+    friend class CItemPager;
+    void WriteChildren(CArchive& ar, ULONGLONG& items, CArray<int, int>& nestedPages) const;
+    void ReadChildren(CArchive& ar);
+    void ReleaseChildren();
 
     ITEMTYPE m_type;            // Indicates our type. See ITEMTYPE.
     CString m_name;             // Display name
-    ULONGLONG m_size;           // OwnSize, if IT_FILE or IT_FREESPACE, or IT_UNKNOWN; SubtreeTotal else.
+    ULONGLONG m_size;           // OwnSize, if IT_FILE or IT_FREESPACE, or IT_UNKNOWN, or IT_EXCLUDED; SubtreeTotal else.
     ULONGLONG m_files;          // # Files in subtree
     ULONGLONG m_subdirs;        // # Folder in subtree
     FILETIME m_lastChange;      // Last modification time OF SUBTREE
+    SUBTREEFILES *m_subtreeFiles;// NULL, if leaf.
+    UINT m_textVersion;         // Incremented, whenever a value shown by GetText() changes.
     unsigned char m_attributes; // Packed file attributes of the item
+    unsigned char m_category;   // Category assigned by a scan plugin, or 0. Replaces the extension.
 
     bool m_readJobDone;         // FindFiles() (our own read job) is finished.
     bool m_done;                // Whole Subtree is done.
-    DWORD m_ticksWorked;        // ms time spent on this item.
+    bool m_pagedOut;            // Our children have been paged out (see CItemPager).
+    bool m_pageLost;            // Paging in has failed. Only the subtree totals are left, until StartRefresh().
+    LONGLONG m_workCounts;      // Time spent on this item (performance counter counts).
     ULONGLONG m_readJobs;       // # "read jobs" in subtree.
 
 
     // Our children. When "this" is set to "done", this array is sorted by child size.
+    // While undone, SortChildrenForPreview() sorts it for the scan preview.
     CArray<CItem *, CItem *> m_children;
 
+    // NULL, if we are done or have not yet needed it.
+    SCANSTATE *m_scanState;
+
     // For GraphView:
     RECT m_rect;                // Finally, this is our coordinates in the Treemap view.
 };
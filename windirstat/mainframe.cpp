@@ -28,14 +28,23 @@
 #include "graphview.h"
 #include "dirstatview.h"
 #include "typeview.h"
+#include "histogramview.h"
 #include "dirstatdoc.h"
 #include "osspecific.h"
 #include "item.h"
+#include "DeleteQueue.h"
+#include "VolumeInfoCache.h"
+#include "EnumerationQueue.h"
+#include "ScanStatistics.h"
+#include "ScanStatisticsDlg.h"
+#include "EventTrace.h"
+#include "ScanPlugins.h"
 
 #include "pagecleanups.h"
 #include "pagetreelist.h"
 #include "pagetreemap.h"
 #include "pagegeneral.h"
+#include "PageExclusions.h"
 
 #include <common/version.h>
 
@@ -72,6 +81,8 @@ namespace
         IDC_DEADFOCUS       // ID of dead-focus window
     };
 
+    const UINT ANIMATION_TIMER = 1; // Drives the pacmen while the progress is shown
+
     // Clipboard-Opener
     class COpenClipboard
     {
@@ -404,11 +415,25 @@ BEGIN_MESSAGE_MAP(CMainFrame, CFrameWnd)
     ON_COMMAND(ID_CONFIGURE, OnConfigure)
     ON_WM_DESTROY()
     ON_COMMAND(ID_TREEMAP_HELPABOUTTREEMAPS, OnTreemapHelpabouttreemaps)
+    ON_COMMAND(ID_HELP_SCANSTATISTICS, OnHelpScanstatistics)
+    ON_COMMAND(ID_HELP_EXPORTTRACE, OnHelpExporttrace)
+#ifdef _DEBUG
+    ON_COMMAND(ID_HELP_BENCHMARKPLUGINS, OnHelpBenchmarkplugins)
+    ON_COMMAND(ID_HELP_BENCHMARKAGGREGATION, OnHelpBenchmarkaggregation)
+    ON_COMMAND(ID_HELP_BENCHMARKSORTING, OnHelpBenchmarksorting)
+    ON_UPDATE_COMMAND_UI(ID_HELP_BENCHMARKANIMATION, OnUpdateHelpBenchmarkanimation)
+    ON_COMMAND(ID_HELP_BENCHMARKANIMATION, OnHelpBenchmarkanimation)
+#endif //_DEBUG
+    ON_WM_TIMER()
     ON_BN_CLICKED(IDC_SUSPEND, OnBnClickedSuspend)
     ON_WM_SYSCOLORCHANGE()
 #ifdef SUPPORT_W7_TASKBAR
     ON_REGISTERED_MESSAGE(s_taskBarMessage, OnTaskButtonCreated)
 #endif // SUPPORT_W7_TASKBAR
+    ON_REGISTERED_MESSAGE(WMU_DELETEPROGRESS, OnDeleteProgress)
+    ON_REGISTERED_MESSAGE(WMU_DELETEFINISHED, OnDeleteFinished)
+    ON_REGISTERED_MESSAGE(WMU_VOLUMEINFO, OnVolumeInfo)
+    ON_REGISTERED_MESSAGE(WMU_ENUMERATED, OnEnumerated)
 END_MESSAGE_MAP()
 
 static UINT indicators[] =
@@ -439,6 +464,7 @@ CMainFrame *CMainFrame::GetTheFrame()
 CMainFrame::CMainFrame()
     : m_wndSplitter(_T("main"))
     , m_wndSubSplitter(_T("sub"))
+    , m_wndTypeSplitter(_T("types"))
     , m_progressVisible(false)
     , m_progressRange(100)
     , m_logicalFocus(LF_NONE)
@@ -492,10 +518,13 @@ void CMainFrame::ShowProgress(ULONGLONG range)
         CreatePacmanProgress();
     }
     UpdateProgress();
+
+    SetTimer(ANIMATION_TIMER, CTreeListControl::FRAME_INTERVAL, NULL);
 }
 
 void CMainFrame::HideProgress()
 {
+    KillTimer(ANIMATION_TIMER);
     DestroyProgress();
     if(m_progressVisible)
     {
@@ -508,6 +537,29 @@ void CMainFrame::HideProgress()
     }
 }
 
+// The range may become known, when the scan is already running,
+// because the CVolumeInfoCache doesn't wait for the drives.
+//
+void CMainFrame::SetProgressRange(ULONGLONG range)
+{
+    if(!m_progressVisible || range == m_progressRange
+    || GetOptions()->IsFollowMountPoints() || GetOptions()->IsFollowJunctionPoints())
+    {
+        return;
+    }
+
+    if(m_progressRange == 0 || range == 0)
+    {
+        // Switch between pacman and progress bar
+        ShowProgress(range);
+    }
+    else
+    {
+        m_progressRange = range;
+        SetProgressPos(m_progressPos);
+    }
+}
+
 void CMainFrame::SetProgressPos(ULONGLONG pos)
 {
     if(m_progressRange > 0 && pos > m_progressRange)
@@ -547,6 +599,33 @@ void CMainFrame::DrivePacman()
     m_pacman.Drive(GetDocument()->GetWorkingItemReadJobs());
 }
 
+// One frame of the animation. Called by the ANIMATION_TIMER, i.e. between
+// the work slices of the scan, and only reads the progress of the items.
+// The pacmen of the directory list move only if the option is set.
+//
+void CMainFrame::DriveAnimation()
+{
+    CStatisticsTimer timer(SC_PACMAN);
+    CTraceScope scope(TE_PACMAN);
+
+    DrivePacman();
+
+    if(GetOptions()->IsPacmanAnimation() && !IsProgressSuspended())
+    {
+        GetDirstatView()->DrivePacmen();
+    }
+}
+
+void CMainFrame::OnTimer(UINT_PTR nIDEvent)
+{
+    if(nIDEvent != ANIMATION_TIMER)
+    {
+        CFrameWnd::OnTimer(nIDEvent);
+        return;
+    }
+    DriveAnimation();
+}
+
 void CMainFrame::UpdateProgress()
 {
     if(m_progressVisible)
@@ -705,6 +784,10 @@ int CMainFrame::OnCreate(LPCREATESTRUCT lpCreateStruct)
     ShowControlBar(&m_wndToolBar, CPersistence::GetShowToolbar(), false);
     ShowControlBar(&m_wndStatusBar, CPersistence::GetShowStatusbar(), false);
 
+    CDeleteQueue::SetNotifyWindow(m_hWnd);
+    CVolumeInfoCache::SetNotifyWindow(m_hWnd);
+    CEnumerationQueue::SetNotifyWindow(m_hWnd);
+
     return 0;
 }
 
@@ -773,16 +856,71 @@ void CMainFrame::OnDestroy()
     CPersistence::SetShowFileTypes(GetTypeView()->IsShowTypes());
     CPersistence::SetShowTreemap(GetGraphView()->IsShowTreemap());
 
+    CDeleteQueue::InvalidateNotifyWindow();
+    CVolumeInfoCache::InvalidateNotifyWindow();
+    CEnumerationQueue::InvalidateNotifyWindow();
+
     CFrameWnd::OnDestroy();
 }
 
+// The CDeleteThread hangs in SendMessage() while we handle this,
+// so lParam is valid.
+//
+LRESULT CMainFrame::OnDeleteProgress(WPARAM wParam, LPARAM lParam)
+{
+    if(wParam != CDeleteQueue::GetSerial())
+    {
+        return 0;
+    }
+
+    GetDocument()->OnPathDeleted((const DELETEPROGRESS *)lParam);
+    return 0;
+}
+
+LRESULT CMainFrame::OnDeleteFinished(WPARAM wParam, LPARAM /*lParam*/)
+{
+    if(wParam != CDeleteQueue::GetSerial())
+    {
+        return 0;
+    }
+
+    GetDocument()->OnDeleteQueueFinished();
+    return 0;
+}
+
+// Posted by the CVolumeInfoCache, e.g. when the label of a drive
+// has arrived, which CItem could not wait for.
+//
+LRESULT CMainFrame::OnVolumeInfo(WPARAM wParam, LPARAM /*lParam*/)
+{
+    if(wParam != CVolumeInfoCache::GetSerial())
+    {
+        return 0;
+    }
+
+    GetDocument()->OnVolumeInfo();
+    return 0;
+}
+
+// Posted by the CEnumerationQueue, when the scan has been waiting for the
+// entries of a directory. There is nothing to do: after this message the
+// idle processing starts again, i.e. CDirstatDoc::Work() goes on.
+//
+LRESULT CMainFrame::OnEnumerated(WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+    return 0;
+}
+
 BOOL CMainFrame::OnCreateClient(LPCREATESTRUCT /*lpcs*/, CCreateContext* pContext)
 {
     VERIFY(m_wndSplitter.CreateStatic(this, 2, 1));
     VERIFY(m_wndSplitter.CreateView(1, 0, RUNTIME_CLASS(CGraphView), CSize(100, 100), pContext));
     VERIFY(m_wndSubSplitter.CreateStatic(&m_wndSplitter, 1, 2, WS_CHILD | WS_VISIBLE | WS_BORDER, m_wndSplitter.IdFromRowCol(0, 0)));
     VERIFY(m_wndSubSplitter.CreateView(0, 0, RUNTIME_CLASS(CDirstatView), CSize(700, 500), pContext));
-    VERIFY(m_wndSubSplitter.CreateView(0, 1, RUNTIME_CLASS(CTypeView), CSize(100, 500), pContext));
+    VERIFY(m_wndTypeSplitter.CreateStatic(&m_wndSubSplitter, 2, 1, WS_CHILD | WS_VISIBLE | WS_BORDER, m_wndSubSplitter.IdFromRowCol(0, 1)));
+    VERIFY(m_wndTypeSplitter.CreateView(0, 0, RUNTIME_CLASS(CTypeView), CSize(100, 300), pContext));
+    VERIFY(m_wndTypeSplitter.CreateView(1, 0, RUNTIME_CLASS(CHistogramView), CSize(100, 200), pContext));
+    m_wndTypeSplitter.RestoreSplitterPos(0.6);
 
     MinimizeGraphView();
     MinimizeTypeView();
@@ -864,7 +1002,7 @@ CGraphView *CMainFrame::GetGraphView()
 
 CTypeView *CMainFrame::GetTypeView()
 {
-    CWnd *pWnd = m_wndSubSplitter.GetPane(0, 1);
+    CWnd *pWnd = m_wndTypeSplitter.GetPane(0, 0);
     CTypeView *pView = DYNAMIC_DOWNCAST(CTypeView, pWnd);
     return pView;
 }
@@ -1200,11 +1338,13 @@ void CMainFrame::OnConfigure()
     CPageTreelist treelist;
     CPageTreemap treemap;
     CPageCleanups cleanups;
+    CPageExclusions exclusions;
 
     sheet.AddPage(&general);
     sheet.AddPage(&treelist);
     sheet.AddPage(&treemap);
     sheet.AddPage(&cleanups);
+    sheet.AddPage(&exclusions);
 
     sheet.DoModal();
 
@@ -1221,6 +1361,108 @@ void CMainFrame::OnTreemapHelpabouttreemaps()
     GetWDSApp()->DoContextHelp(IDH_Treemap);
 }
 
+void CMainFrame::OnHelpScanstatistics()
+{
+    CScanStatisticsDlg::Show(this);
+}
+
+// Writes the event trace in the format of chrome://tracing.
+//
+void CMainFrame::OnHelpExporttrace()
+{
+    CFileDialog dlg(false, _T("json"), _T("windirstat-trace.json"),
+        OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST,
+        LoadString(IDS_TRACEFILEFILTER), this);
+    if(IDOK != dlg.DoModal())
+    {
+        return;
+    }
+
+    CString error;
+    if(!CEventTrace::ExportChromeTrace(dlg.GetPathName(), error))
+    {
+        CString msg;
+        msg.FormatMessage(IDS_CANNOTWRITEss, (LPCTSTR)dlg.GetPathName(), (LPCTSTR)error);
+        AfxMessageBox(msg);
+    }
+}
+
+#ifdef _DEBUG
+// The benchmarks are tools for the developers, so they are not
+// in the release build.
+
+// Measures the per-file cost of the scan plugins with synthetic entries.
+//
+void CMainFrame::OnHelpBenchmarkplugins()
+{
+    CString report;
+    {
+        CWaitCursor wc;
+        report = CScanPlugins::Benchmark();
+    }
+    AfxMessageBox(report, MB_ICONINFORMATION);
+}
+
+// Compares the per file and the batched propagation of the subtree
+// totals (CItem::AddChildren()) for several depths.
+//
+void CMainFrame::OnHelpBenchmarkaggregation()
+{
+    CString report;
+    {
+        CWaitCursor wc;
+        report = CItem::BenchmarkAggregation();
+    }
+    AfxMessageBox(report, MB_ICONINFORMATION);
+}
+
+// Compares the name sorting with and without sort keys
+// (CTreeListItem::SortSiblings()).
+//
+void CMainFrame::OnHelpBenchmarksorting()
+{
+    CString report;
+    {
+        CWaitCursor wc;
+        report = CItem::BenchmarkNameSorting();
+    }
+    AfxMessageBox(report, MB_ICONINFORMATION);
+}
+
+// The benchmark scans on its own, so not during a scan of the document.
+//
+void CMainFrame::OnUpdateHelpBenchmarkanimation(CCmdUI *pCmdUI)
+{
+    pCmdUI->Enable(GetDocument()->GetRootItem() == NULL || GetDocument()->IsRootDone());
+}
+
+// Compares the scan throughput of the selected folder (or the Windows
+// directory) with the work slices of the animation off and on.
+//
+void CMainFrame::OnHelpBenchmarkanimation()
+{
+    CString path;
+    const CItem *item = GetDocument()->GetSelectionCount() == 1 ? GetDocument()->GetSelection(0) : NULL;
+    if(item != NULL && (item->GetType() == IT_DIRECTORY || item->GetType() == IT_DRIVE))
+    {
+        path = item->GetPath();
+    }
+    else
+    {
+        TCHAR windir[MAX_PATH];
+        ::GetWindowsDirectory(windir, countof(windir));
+        path = windir;
+    }
+
+    CString report;
+    {
+        CWaitCursor wc;
+        report = CItem::BenchmarkScanAnimation(path);
+    }
+    AfxMessageBox(report, MB_ICONINFORMATION);
+}
+#endif //_DEBUG
+
 void CMainFrame::OnSysColorChange()
 {
     CFrameWnd::OnSysColorChange();
@@ -35,6 +35,7 @@ class CMainFrame;
 class CDirstatView;
 class CGraphView;
 class CTypeView;
+class CHistogramView;
 
 //
 // The "logical focus" can be
@@ -168,10 +169,12 @@ public:
 
     void ShowProgress(ULONGLONG range);
     void HideProgress();
+    void SetProgressRange(ULONGLONG range);
     void SetProgressPos(ULONGLONG pos);
     void SetProgressPos100();
     bool IsProgressSuspended();
     void DrivePacman();
+    void DriveAnimation();
 
     void UpdateProgress();
     void AppendUserDefinedCleanups(CMenu *menu);
@@ -200,7 +203,8 @@ protected:
     ULONGLONG m_progressRange;  // Progress range. A range of 0 means that we have no range available. In this case we should display pacman.
     ULONGLONG m_progressPos;    // Progress position (<= progressRange, or an item count in case of m_progressRang == 0)
 
-    CMySplitterWnd m_wndSubSplitter;    // Contains the two upper views
+    CMySplitterWnd m_wndTypeSplitter;   // Contains the type view and the histogram view
+    CMySplitterWnd m_wndSubSplitter;    // Contains the directory list and m_wndTypeSplitter
     CMySplitterWnd m_wndSplitter;       // Contains (a) m_wndSubSplitter and (b) the graph view.
 
     CStatusBar  m_wndStatusBar;     // Status bar
@@ -232,9 +236,23 @@ protected:
     afx_msg void OnDestroy();
     afx_msg void OnBnClickedSuspend();
     afx_msg void OnTreemapHelpabouttreemaps();
+    afx_msg void OnHelpScanstatistics();
+    afx_msg void OnHelpExporttrace();
+#ifdef _DEBUG
+    afx_msg void OnHelpBenchmarkplugins();
+    afx_msg void OnHelpBenchmarkaggregation();
+    afx_msg void OnHelpBenchmarksorting();
+    afx_msg void OnUpdateHelpBenchmarkanimation(CCmdUI *pCmdUI);
+    afx_msg void OnHelpBenchmarkanimation();
+#endif //_DEBUG
+    afx_msg void OnTimer(UINT_PTR nIDEvent);
 #ifdef SUPPORT_W7_TASKBAR
     afx_msg LRESULT OnTaskButtonCreated(WPARAM, LPARAM);
 #endif // SUPPORT_W7_TASKBAR
+    afx_msg LRESULT OnDeleteProgress(WPARAM, LPARAM);
+    afx_msg LRESULT OnDeleteFinished(WPARAM, LPARAM);
+    afx_msg LRESULT OnVolumeInfo(WPARAM, LPARAM);
+    afx_msg LRESULT OnEnumerated(WPARAM, LPARAM);
 
 public:
     #ifdef _DEBUG
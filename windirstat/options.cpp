@@ -42,6 +42,7 @@ namespace
     const LPCTSTR entryShowTreemap          = _T("showTreemap");
     const LPCTSTR entryShowToolbar          = _T("showToolbar");
     const LPCTSTR entryShowStatusbar        = _T("showStatusbar");
+    const LPCTSTR entryScanPreview          = _T("scanPreview");
     const LPCTSTR entryMainWindowPlacement  = _T("mainWindowPlacement");
     const LPCTSTR entrySplitterPosS         = _T("%s-splitterPos");
     const LPCTSTR entryColumnOrderS         = _T("%s-columnOrder");
@@ -56,6 +57,13 @@ namespace
     const LPCTSTR entrySelectDrivesFolder   = _T("selectDrivesFolder");
     const LPCTSTR entrySelectDrivesDrives   = _T("selectDrivesDrives");
     const LPCTSTR entryShowDeleteWarning    = _T("showDeleteWarning");
+    const LPCTSTR entryReportFormat         = _T("reportFormat");
+    const LPCTSTR entryReportMaxDepth       = _T("reportMaxDepth");
+    const LPCTSTR entryReportMinSize        = _T("reportMinSize");
+    const LPCTSTR entryQuery                = _T("query");
+    const LPCTSTR entryTopFilesOrder        = _T("topFilesOrder");
+    const LPCTSTR entryScanStatisticsFile   = _T("scanStatisticsFile");
+    const LPCTSTR entryEventTrace           = _T("eventTrace");
     const LPCTSTR sectionBarState           = _T("persistence\\barstate");
 
     const LPCTSTR entryLanguage             = _T("language");
@@ -82,6 +90,9 @@ namespace
     const LPCTSTR entryFollowMountPoints    = _T("followMountPoints");
     const LPCTSTR entryFollowJunctionPoints = _T("followJunctionPoints");
     const LPCTSTR entryUseWdsLocale         = _T("useWdsLocale");
+    const LPCTSTR entryMemoryBudget         = _T("memoryBudget");
+    const LPCTSTR entryExclusionRules       = _T("exclusionRules");
+    const LPCTSTR entryCleanupProcesses     = _T("cleanupProcesses");
 
     const LPCTSTR sectionUserDefinedCleanupD= _T("options\\userDefinedCleanup%02d");
     const LPCTSTR entryEnabled              = _T("enabled");
@@ -175,6 +186,16 @@ void CPersistence::SetShowStatusbar(bool show)
     getProfileBool(sectionPersistence, entryShowStatusbar, show);
 }
 
+bool CPersistence::GetScanPreview()
+{
+    return getProfileBool(sectionPersistence, entryScanPreview, true);
+}
+
+void CPersistence::SetScanPreview(bool preview)
+{
+    setProfileBool(sectionPersistence, entryScanPreview, preview);
+}
+
 void CPersistence::GetMainWindowPlacement(/* [in/out] */ WINDOWPLACEMENT& wp)
 {
     ASSERT(wp.length == sizeof(wp));
@@ -372,6 +393,75 @@ void CPersistence::SetShowDeleteWarning(bool show)
     getProfileBool(sectionPersistence, entryShowDeleteWarning, show);
 }
 
+int CPersistence::GetReportFormat()
+{
+    int format = getProfileInt(sectionPersistence, entryReportFormat, 0);
+    checkRange(format, 0, 2);
+    return format;
+}
+
+void CPersistence::SetReportFormat(int format)
+{
+    setProfileInt(sectionPersistence, entryReportFormat, format);
+}
+
+int CPersistence::GetReportMaxDepth()
+{
+    int depth = getProfileInt(sectionPersistence, entryReportMaxDepth, 0);
+    checkRange(depth, 0, 1000);
+    return depth;
+}
+
+void CPersistence::SetReportMaxDepth(int depth)
+{
+    setProfileInt(sectionPersistence, entryReportMaxDepth, depth);
+}
+
+// In KB
+int CPersistence::GetReportMinSize()
+{
+    int kb = getProfileInt(sectionPersistence, entryReportMinSize, 0);
+    checkRange(kb, 0, INT_MAX);
+    return kb;
+}
+
+void CPersistence::SetReportMinSize(int kb)
+{
+    setProfileInt(sectionPersistence, entryReportMinSize, kb);
+}
+
+CString CPersistence::GetQuery()
+{
+    return getProfileString(sectionPersistence, entryQuery, _T("//file[size>1G]"));
+}
+
+void CPersistence::SetQuery(LPCTSTR query)
+{
+    setProfileString(sectionPersistence, entryQuery, query);
+}
+
+int CPersistence::GetTopFilesOrder()
+{
+    int order = getProfileInt(sectionPersistence, entryTopFilesOrder, 0);
+    checkRange(order, 0, 2);
+    return order;
+}
+
+void CPersistence::SetTopFilesOrder(int order)
+{
+    setProfileInt(sectionPersistence, entryTopFilesOrder, order);
+}
+
+CString CPersistence::GetScanStatisticsFile()
+{
+    return getProfileString(sectionPersistence, entryScanStatisticsFile);
+}
+
+bool CPersistence::GetEventTrace()
+{
+    return getProfileBool(sectionPersistence, entryEventTrace, true);
+}
+
 void CPersistence::SetArray(LPCTSTR entry, const CArray<int, int>& arr)
 {
     CString value;
@@ -662,6 +752,7 @@ void COptions::SetHumanFormat(bool human)
     if(m_humanFormat != human)
     {
         m_humanFormat = human;
+        InvalidateFormatCache();
         GetDocument()->UpdateAllViews(NULL, HINT_NULL);
         GetWDSApp()->UpdateRamUsage();
     }
@@ -690,6 +781,7 @@ void COptions::SetShowTimeSpent(bool show)
     if(m_showTimeSpent != show)
     {
         m_showTimeSpent = show;
+        InvalidateFormatCache();
     }
 }
 
@@ -812,10 +904,59 @@ void COptions::SetUseWdsLocale(bool use)
     if(m_useWdsLocale != use)
     {
         m_useWdsLocale = use;
+        InvalidateFormatCache();
         GetDocument()->UpdateAllViews(NULL, HINT_NULL);
     }
 }
 
+CString COptions::GetExclusionRules()
+{
+    return m_exclusionRules;
+}
+
+// The rules take effect with the next scan or refresh.
+// CPageExclusions has already checked them.
+//
+void COptions::SetExclusionRules(LPCTSTR rules)
+{
+    m_exclusionRules = rules;
+
+    CString error;
+    if(!m_compiledExclusionRules.Compile(m_exclusionRules, error))
+    {
+        VTRACE(_T("%s"), (LPCTSTR)error);
+    }
+}
+
+CExclusionRules *COptions::GetCompiledExclusionRules()
+{
+    return &m_compiledExclusionRules;
+}
+
+int COptions::GetMemoryBudget()
+{
+    return m_memoryBudget;
+}
+
+// Takes effect with the next CItemPager::Trim().
+//
+void COptions::SetMemoryBudget(int mb)
+{
+    checkRange(mb, 0, MAXMEMORYBUDGET);
+    m_memoryBudget = mb;
+}
+
+int COptions::GetCleanupProcesses()
+{
+    return m_cleanupProcesses;
+}
+
+void COptions::SetCleanupProcesses(int count)
+{
+    checkRange(count, 1, MAXCLEANUPPROCESSES);
+    m_cleanupProcesses = count;
+}
+
 CString COptions::GetReportSubject()
 {
     return m_reportSubject;
@@ -889,11 +1030,19 @@ void COptions::SaveToRegistry()
     getProfileBool(sectionOptions, entryFollowMountPoints, m_followMountPoints);
     getProfileBool(sectionOptions, entryFollowJunctionPoints, m_followJunctionPoints);
     getProfileBool(sectionOptions, entryUseWdsLocale, m_useWdsLocale);
+    setProfileInt(sectionOptions, entryMemoryBudget, m_memoryBudget);
+
+    // The registry value has one line only.
+    CString rules = m_exclusionRules;
+    rules.Remove(_T('\r'));
+    rules.Replace(_T('\n'), wds::chrPipe);
+    setProfileString(sectionOptions, entryExclusionRules, rules);
 
     for(i  =  0; i < USERDEFINEDCLEANUPCOUNT; i++)
     {
         SaveUserDefinedCleanup(i);
     }
+    setProfileInt(sectionOptions, entryCleanupProcesses, m_cleanupProcesses);
 
 
     // We must distinguish between 'empty' and 'default'.
@@ -964,11 +1113,20 @@ void COptions::LoadFromRegistry()
     m_followJunctionPoints = getProfileBool(sectionOptions, entryFollowJunctionPoints, false);
     // use user locale by default
     m_useWdsLocale = getProfileBool(sectionOptions, entryUseWdsLocale, false);
+    // No paging by default
+    m_memoryBudget = getProfileInt(sectionOptions, entryMemoryBudget, 0);
+    checkRange(m_memoryBudget, 0, MAXMEMORYBUDGET);
+
+    CString rules = getProfileString(sectionOptions, entryExclusionRules);
+    rules.Replace(wds::strPipe, _T("\r\n"));
+    SetExclusionRules(rules);
 
     for(i = 0; i < USERDEFINEDCLEANUPCOUNT; i++)
     {
         ReadUserDefinedCleanup(i);
     }
+    m_cleanupProcesses = getProfileInt(sectionOptions, entryCleanupProcesses, 4);
+    checkRange(m_cleanupProcesses, 1, MAXCLEANUPPROCESSES);
 
 
     CString s = getProfileString(sectionOptions, entryReportSubject);
@@ -28,6 +28,7 @@
 
 #ifndef __NOT_WDS
 #include "treemap.h"
+#include "ExclusionRules.h"
 #endif // __NOT_WDS
 #include <common/wds_constants.h>
 #include <common/SimpleIni.h>
@@ -67,6 +68,12 @@ struct USERDEFINEDCLEANUP
 
 #define USERDEFINEDCLEANUPCOUNT 10
 
+// Upper limit for concurrent processes of a recursive user defined cleanup.
+#define MAXCLEANUPPROCESSES MAXIMUM_WAIT_OBJECTS
+
+// Upper limit for the memory budget of the item tree (MB). 0 means unlimited.
+#define MAXMEMORYBUDGET (1024 * 1024)
+
 #define TREELISTCOLORCOUNT 8
 
 // Base interface for retrieving/storing configuration
@@ -221,6 +228,9 @@ public:
     static bool GetShowStatusbar();
     static void SetShowStatusbar(bool show);
 
+    static bool GetScanPreview();
+    static void SetScanPreview(bool preview);
+
     static void GetMainWindowPlacement(/* [in/out] */ WINDOWPLACEMENT& wp);
     static void SetMainWindowPlacement(const WINDOWPLACEMENT& wp);
 
@@ -259,6 +269,28 @@ public:
     static bool GetShowDeleteWarning();
     static void SetShowDeleteWarning(bool show);
 
+    // Settings of CSaveReportDlg
+    static int GetReportFormat();
+    static void SetReportFormat(int format);
+    static int GetReportMaxDepth();
+    static void SetReportMaxDepth(int depth);
+    static int GetReportMinSize();
+    static void SetReportMinSize(int kb);
+
+    // Last query of CQueryDlg
+    static CString GetQuery();
+    static void SetQuery(LPCTSTR query);
+
+    // Selected order of CTopFilesDlg
+    static int GetTopFilesOrder();
+    static void SetTopFilesOrder(int order);
+
+    // Not in the gui. See CScanStatistics::WriteDump().
+    static CString GetScanStatisticsFile();
+
+    // Not in the gui. See CEventTrace.
+    static bool GetEventTrace();
+
 private:
     static void SetArray(LPCTSTR entry, const CArray<int, int>& arr);
     static void GetArray(LPCTSTR entry, /* in/out */ CArray<int, int>& arr);
@@ -354,6 +386,15 @@ public:
     bool IsUseWdsLocale();
     void SetUseWdsLocale(bool use);
 
+    // Memory of the item tree (MB), above which CItemPager pages out. 0 = unlimited.
+    int GetMemoryBudget();
+    void SetMemoryBudget(int mb);
+
+    // Exclusion and summarize rules, one per line (see CExclusionRules)
+    CString GetExclusionRules();
+    void SetExclusionRules(LPCTSTR rules);
+    CExclusionRules *GetCompiledExclusionRules();
+
     void GetUserDefinedCleanups(USERDEFINEDCLEANUP udc[USERDEFINEDCLEANUPCOUNT]);
     void SetUserDefinedCleanups(const USERDEFINEDCLEANUP udc[USERDEFINEDCLEANUPCOUNT]);
 
@@ -361,6 +402,10 @@ public:
     bool IsUserDefinedCleanupEnabled(int i);
     const USERDEFINEDCLEANUP *GetUserDefinedCleanup(int i);
 
+    // Maximum number of concurrent processes of a recursive user defined cleanup
+    int GetCleanupProcesses();
+    void SetCleanupProcesses(int count);
+
     CString GetReportSubject();
     CString GetReportDefaultSubject();
     void SetReportSubject(LPCTSTR subject);
@@ -394,8 +439,13 @@ private:
     bool m_followMountPoints;
     bool m_followJunctionPoints;
     bool m_useWdsLocale;
+    int m_memoryBudget;
+
+    CString m_exclusionRules;
+    CExclusionRules m_compiledExclusionRules;
 
     USERDEFINEDCLEANUP m_userDefinedCleanup[USERDEFINEDCLEANUPCOUNT];
+    int m_cleanupProcesses;
 
     CString m_reportSubject;
     CString m_reportPrefix;
@@ -24,6 +24,7 @@
 #define IDD_PAGE_TREEMAP                143
 #define IDD_PAGE_GENERAL                144
 #define IDD_PAGE_REPORT                 146
+#define IDD_PAGE_EXCLUSIONS             147
 #define IDS_RESOURCEVERSION             199
 #define IDS_ABOUT_ABOUTTEXTss           200
 #define IDS_ABOUT_THANKSTOTEXT          201
@@ -105,6 +106,57 @@
 #define IDS_LANGUAGERESTARTNOW          277
 #define IDS_ABOUT_AUTHORS               278
 #define IDS_ABOUT_AUTHORSTEXTs          279
+#define IDS_sANDdMORE                   280
+#define IDS_DELETINGdOFdd               281
+#define IDS_sEXITCODEd                  282
+#define IDS_CLEANUPSTATUSdddd           283
+#define IDS_CLEANUPCANCELEDdddd         284
+#define IDS_UDC_dOFdFAILEDs             285
+#define IDS_TRACEFILEFILTER             286
+#define IDS_CANNOTWRITEss               287
+#define IDS_SCANPLUGINFAILEDs           288
+#define IDS_INVALIDEXCLUSIONRULEds      289
+#define IDS_EXCLUDED_ITEM               290
+#define IDS_SUMMARIZED_ITEM             291
+#define IDS_EXCLUSIONSYNTAX             292
+#define IDS_SCANDATABASEFILTER          293
+#define IDS_SQLITENOTAVAILABLE          294
+#define IDS_sISNOTASCANDATABASE         295
+#define IDS_REPORTFILEFILTER            296
+#define IDS_INVALIDQUERYds              297
+#define IDS_QUERYRESULTd                298
+#define IDS_QUERYSCOPENOTFOUNDs         299
+#define IDS_QUERYSYNTAX                 300
+#define IDS_TOPFILES_LARGEST            301
+#define IDS_TOPFILES_NEWEST             302
+#define IDS_TOPFILES_OLDEST             303
+#define IDS_TOPFILESCOL_FOLDER          304
+#define IDS_DUPLICATESPARTIALdds        305
+#define IDS_DUPLICATESFULLdds           306
+#define IDS_DUPLICATESRESULTds          307
+#define IDS_DUPLICATESCOL_RECLAIMABLE   308
+#define IDS_GROWTHNODEsss               309
+#define IDS_HISTOGRAMAGE                310
+#define IDS_HISTOGRAMSIZE               311
+#define IDS_HISTOGRAMNOFILES            312
+#define IDS_RAMUSAGEPAGEDsss            313
+#define IDS_STATSCANRUNNINGs            314
+#define IDS_STATSCANFINISHEDs           315
+#define IDS_STATDIRECTORIESss           316
+#define IDS_STATFILESss                 317
+#define IDS_STATBYTESss                 318
+#define IDS_STATTIMEss                  319
+#define IDS_STATITEMSsss                320
+#define IDS_STATVOLUMEssss              321
+#define IDS_STATCAT_ENUMERATION         322
+#define IDS_STATCAT_SORTING             323
+#define IDS_STATCAT_PACMAN              324
+#define IDS_STATCAT_PAINTING            325
+#define IDS_STATCAT_TREEMAP             326
+#define IDS_STATCAT_EXTENSIONDATA       327
+#define IDS_STATCAT_PLUGINS             328
+#define IDS_STATCAT_EXCLUSIONS          329
+#define IDS_PAGEINFAILEDss              330
 #define IDS_TRANSLATORS                 899
 #define IDR_TEXT1                       900
 #define IDR_AUTHORS                     900
@@ -112,6 +164,13 @@
 #define IDB_BITMAP1                     902
 #define IDB_JUNCTIONPOINT               902
 #define IDD_CHECKFORUPDATE              903
+#define IDD_CLEANUPPROGRESS             910
+#define IDD_SCANSTATISTICS              911
+#define IDD_SAVEREPORT                  912
+#define IDD_QUERY                       913
+#define IDD_TOPFILES                    914
+#define IDD_DUPLICATES                  915
+#define IDD_GROWTH                      916
 #define IDC_ALLDRIVES                   1000
 #define IDC_GROUPS                      1000
 #define IDC_ALLLOCALDRIVES              1000
@@ -193,6 +252,28 @@
 #define IDC_LIST1                       1226
 #define IDC_STATIC_URL                  1227
 #define IDC_STATIC_TEXT                 1228
+#define IDC_CLEANUPPROCESSES            1230
+#define IDC_PROGRESS                    1231
+#define IDC_CURRENTPATH                 1232
+#define IDC_STATUS                      1233
+#define IDC_STATISTICS                  1234
+#define IDC_EXCLUSIONRULES              1235
+#define IDC_EXCLUSIONSYNTAX             1236
+#define IDC_REPORTCSV                   1237
+#define IDC_REPORTJSON                  1238
+#define IDC_REPORTXML                   1239
+#define IDC_REPORTDEPTH                 1240
+#define IDC_REPORTMINSIZE               1241
+#define IDC_QUERY                       1242
+#define IDC_QUERYSYNTAX                 1243
+#define IDC_TOPFILESORDER               1244
+#define IDC_TOPFILES                    1245
+#define IDC_DUPLICATEGROUPS             1246
+#define IDC_DUPLICATEFILES              1247
+#define IDC_GROWTHZOOM                  1248
+#define IDC_GROWTHTREEMAP               1249
+#define IDC_GROWTHZOOMOUT               1250
+#define IDC_MEMORYBUDGET                1251
 #define ID_FILE_OPENURL                 32771
 #define ID_FILE_OPENRECENT              32772
 #define ID_FILE_REFRESHALL              32773
@@ -257,15 +338,31 @@
 #define ID_BUTTON33021                  33021
 #define ID_POPUP_TOGGLE                 33023
 #define ID_HELP_CHECKFORUPDATES         33024
+#define ID_HELP_SCANSTATISTICS          33027
+#define ID_HELP_EXPORTTRACE             33028
+#define ID_HELP_BENCHMARKPLUGINS        33029
+#define ID_HELP_BENCHMARKAGGREGATION    33037
+#define ID_HELP_BENCHMARKSORTING        33038
+#define ID_HELP_BENCHMARKANIMATION      33039
+#define ID_FILE_IMPORTSCAN              33030
+#define ID_FILE_EXPORTSCAN              33031
+#define ID_FILE_SAVEREPORT              33032
+#define ID_EDIT_QUERY                   33033
+#define ID_EDIT_TOPFILES                33034
+#define ID_EDIT_DUPLICATES              33035
+#define ID_FILE_COMPARESCAN             33036
+#define ID_FILE_ADDTOSESSION            33040
+#define ID_FILE_REMOVEFROMSESSION       33041
+#define ID_VIEW_SCANPREVIEW             33042
 #define ID_INDICATOR_MEMORYUSAGE        59142
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        905
-#define _APS_NEXT_COMMAND_VALUE         33025
-#define _APS_NEXT_CONTROL_VALUE         1229
+#define _APS_NEXT_RESOURCE_VALUE        917
+#define _APS_NEXT_COMMAND_VALUE         33043
+#define _APS_NEXT_CONTROL_VALUE         1252
 #define _APS_NEXT_SYMED_VALUE           104
 #endif
 #endif
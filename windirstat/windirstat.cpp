@@ -32,6 +32,8 @@
 #include "dirstatdoc.h"
 #include "graphview.h"
 #include "osspecific.h"
+#include "EventTrace.h"
+#include "ItemPager.h"
 #include <Dbghelp.h> // for mini dumps
 
 #ifdef _DEBUG
@@ -461,7 +463,14 @@ CString CDirstatApp::GetCurrentProcessMemoryInfo()
     CString n = PadWidthBlanks(FormatBytes(m_workingSet), 11);
 
     CString s;
-    s.FormatMessage(IDS_RAMUSAGEs, n);
+    if(CItemPager::GetPagedOutItems() > 0)
+    {
+        s.FormatMessage(IDS_RAMUSAGEPAGEDsss, n, FormatCount(CItemPager::GetResidentItems()), FormatCount(CItemPager::GetPagedOutItems()));
+    }
+    else
+    {
+        s.FormatMessage(IDS_RAMUSAGEs, n);
+    }
 
     return s;
 }
@@ -509,6 +518,9 @@ BOOL CDirstatApp::InitInstance()
     Inherited::SetRegistryKey(_T("Seifert"));
     Inherited::LoadStdProfileSettings(4);
 
+    CEventTrace::Enable(CPersistence::GetEventTrace());
+    CEventTrace::SetThreadName("Main");
+
     m_langid = GetBuiltInLanguage();
 
     LANGID langid = CLanguageOptions::GetLanguage();
@@ -737,7 +749,7 @@ BOOL CDirstatApp::OnIdle(LONG lCount)
     bool more = false;
 
     CDirstatDoc *doc = GetDocument();
-    if((doc) && (!doc->Work(600)))
+    if((doc) && (!doc->Work(CDirstatDoc::GetWorkSlice(GetOptions()->IsPacmanAnimation()))))
     {
         more = true;
     }